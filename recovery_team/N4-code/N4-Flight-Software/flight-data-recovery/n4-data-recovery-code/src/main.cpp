@@ -4,26 +4,45 @@
  */
 
 #include <SerialFlash.h>
-#include "data-types.h"
+#include "flight_log.h"   // on-flash record format - shared with the flight software
+#include "flight_log_codec.h"
+#include "flight_directory.h" // flights kept in the log - shared with the flight software
+#include "flight_log_dump.h"  // binary dump frames - shared with n4-dump-receiver
+#include "flight_log_le.h"
 
 #define BAUDRATE 115200
+#define MAX_BAD_PAGES 8   // consecutive pages that fail the CRC before we stop reading
+#define DUMP_BAUDRATE 921600      // binary dump baud rate - the fastest the CP2102 USB-UART runs without errors
+#define DUMP_IDLE_TIMEOUT 10000   // ms without a request before binary mode is left
 
 const byte PIN_FLASH_CS = 5; // Change this to match the Chip Select pin on your board
 SerialFlashFile file;
 
 uint8_t dumpFileNumber = 1;
 
-// telemetry packet
-telemetry_type_t oneRecord;
+const char* flight_data_file = "flight_data.txt";  // must match the flight software data log filename
+
+// one decoded record
+flight_log_sample_t oneRecord;
 
 /* User fucntion prototypes */
 void checkForSerialCommand();
 void showMenu();
 void dumpOneRecording();
+void dumpPages(uint32_t generation, uint32_t first_page, uint32_t end_page);
+bool openLog(flight_log_header_t* header);
+FLIGHT_LOG_STATUS readFlight(uint16_t slot, uint32_t generation, flight_entry_t* entry);
+uint32_t flightEndPage(uint16_t slot, const flight_log_header_t* header);
+void listFlights();
+void dumpFlight();
+void binaryDump();
+void printRecord();
 void listFiles();
 void spaces(int);
 
 void setup() {
+  // room for a whole dump block so the next flash read overlaps the UART transmit
+  Serial.setTxBufferSize(2 * FLIGHT_LOG_DUMP_BLOCK_SIZE);
   Serial.begin(BAUDRATE);
   if(!SerialFlash.begin(PIN_FLASH_CS)) {
     Serial.println(F("Flash not found! Check wiring."));
@@ -61,6 +80,21 @@ void checkForSerialCommand() {
         showMenu();
         break;
 
+      case 'b':
+        binaryDump();
+        showMenu();
+        break;
+
+      case 'f':
+        listFlights();
+        showMenu();
+        break;
+
+      case 'n':
+        dumpFlight();
+        showMenu();
+        break;
+
       default:
         showMenu();
         break;
@@ -105,60 +139,366 @@ void showMenu() {
   Serial.println(F("\nMENU OPTIONS:"));
   Serial.println(F("d : Dump Data"));
   Serial.println(F("l : List Files"));
+  Serial.println(F("f : List Flights"));
+  Serial.println(F("n : Dump One Flight"));
+  Serial.println(F("b : Binary Dump - run n4-dump-receiver on the ground station"));
 
 }
 
+// print oneRecord as a CSV row
+void printRecord() {
+  Serial.print( oneRecord.record_number );
+  Serial.print( "," );
+  Serial.print( oneRecord.timestamp_ms );
+  Serial.print( "," );
+  Serial.print( oneRecord.operation_mode );
+  Serial.print( "," );
+  Serial.print( oneRecord.state );
+  Serial.print( "," );
+  Serial.print( oneRecord.log_policy );
+  Serial.print( "," );
+  Serial.print( oneRecord.ax, 3 );
+  Serial.print( "," );
+  Serial.print( oneRecord.ay, 3 );
+  Serial.print( "," );
+  Serial.print( oneRecord.az, 3 );
+  Serial.print( "," );
+  Serial.print( oneRecord.pitch );
+  Serial.print( "," );
+  Serial.print( oneRecord.roll );
+  Serial.print( "," );
+  Serial.print( oneRecord.gx );
+  Serial.print( "," );
+  Serial.print( oneRecord.gy );
+  Serial.print( "," );
+  Serial.print( oneRecord.gz );
+  Serial.print( "," );
+  Serial.print( oneRecord.latitude, 7 );
+  Serial.print( "," );
+  Serial.print( oneRecord.longitude, 7 );
+  Serial.print( "," );
+  Serial.print( oneRecord.gps_altitude );
+  Serial.print( "," );
+  Serial.print( oneRecord.pressure );
+  Serial.print( "," );
+  Serial.print( oneRecord.temperature );
+  Serial.print( "," );
+  Serial.print( oneRecord.rel_altitude );
+  Serial.print( "," );
+  Serial.println( oneRecord.velocity, 1 );
+}
+
+// decode the pages of a paged log from first_page up to end_page, or up to the end of the
+// recorded data - every page holds whole frames and starts with a keyframe
+void dumpPages(uint32_t generation, uint32_t first_page, uint32_t end_page) {
+  uint8_t page[FLIGHT_LOG_PAGE_SIZE];
+  flight_log_page_t page_header;
+  flight_log_codec_t codec;
+  int32_t fields[FLIGHT_LOG_FIELD_COUNT];
+  int32_t session = -1;
+  uint8_t bad_pages = 0;
+
+  if ( end_page > file.size() / FLIGHT_LOG_PAGE_SIZE ) {
+    end_page = file.size() / FLIGHT_LOG_PAGE_SIZE;
+  }
+
+  for ( uint32_t address = first_page * FLIGHT_LOG_PAGE_SIZE; address < end_page * FLIGHT_LOG_PAGE_SIZE; address += FLIGHT_LOG_PAGE_SIZE ) {
+    file.seek( address );
+    file.read( page, FLIGHT_LOG_PAGE_SIZE );
+
+    FLIGHT_LOG_STATUS status = flightLogDecodePageHeader( page, generation, &page_header );
+    if ( status == FLIGHT_LOG_ERASED ) {
+      // end of the recorded data
+      break;
+    } else if ( status != FLIGHT_LOG_OK ) {
+      // a page torn by a reset is followed by good pages, a run of bad pages was left
+      // over from before the log was last erased
+      if ( ++bad_pages > MAX_BAD_PAGES ) {
+        break;
+      }
+      Serial.print( F("# skipped corrupt page at ") );
+      Serial.println( address );
+      continue;
+    }
+
+    bad_pages = 0;
+
+    // the flight computer restarted - timestamps and record numbers start again
+    if ( page_header.session != session ) {
+      session = page_header.session;
+      Serial.print( F("# session ") );
+      Serial.println( session );
+    }
+
+    flightLogCodecReset( &codec );
+
+    size_t offset = 0;
+    while ( offset < page_header.length ) {
+      size_t used;
+      if ( flightLogDecompress( &codec, page + FLIGHT_LOG_PAGE_HEADER_SIZE + offset, page_header.length - offset, fields, &used ) != FLIGHT_LOG_OK ) {
+        break;
+      }
+      offset += used;
+
+      flightLogFromFields( fields, &oneRecord );
+      printRecord();
+    }
+  }
+}
+
+// send one binary dump frame
+void sendFrame( uint8_t type, uint32_t index, const uint8_t* payload, uint16_t length ) {
+  uint8_t header[FLIGHT_LOG_DUMP_FRAME_HEADER_SIZE];
+  flightLogDumpFrameHeader( header, type, index, length );
+
+  // the sync bytes are not covered by the CRC
+  uint32_t crc = flightLogCrc32( header + 2, sizeof(header) - 2, 0 );
+  crc = flightLogCrc32( payload, length, crc );
+
+  uint8_t trailer[4];
+  put32( trailer, crc );
+
+  Serial.write( header, sizeof(header) );
+  Serial.write( payload, length );
+  Serial.write( trailer, sizeof(trailer) );
+}
+
+// send one block of raw flash
+void sendBlock( uint32_t index, uint32_t capacity ) {
+  static uint8_t block[FLIGHT_LOG_DUMP_BLOCK_SIZE];
+  uint32_t address = index * FLIGHT_LOG_DUMP_BLOCK_SIZE;
+  uint32_t length = FLIGHT_LOG_DUMP_BLOCK_SIZE;
+
+  if ( address >= capacity ) {
+    return;
+  }
+  if ( address + length > capacity ) {
+    length = capacity - address;
+  }
+
+  SerialFlash.read( address, block, length );
+  sendFrame( FLIGHT_LOG_DUMP_BLOCK, index, block, length );
+}
+
+// stream the whole flash chip as CRC checked frames at DUMP_BAUDRATE, see flight_log_dump.h
+// the receiver requests again any block that fails its CRC
+void binaryDump() {
+  uint8_t id[5];
+  SerialFlash.readID( id );
+
+  flight_log_dump_info_t info;
+  info.capacity = SerialFlash.capacity( id );
+  info.block_size = FLIGHT_LOG_DUMP_BLOCK_SIZE;
+  info.block_count = ( info.capacity + FLIGHT_LOG_DUMP_BLOCK_SIZE - 1 ) / FLIGHT_LOG_DUMP_BLOCK_SIZE;
+  info.log_address = 0;
+  info.log_size = 0;
+
+  file = SerialFlash.open( flight_data_file );
+  if ( file ) {
+    info.log_address = file.getFlashAddress();
+    info.log_size = file.size();
+    file.close();
+  }
+
+  Serial.print( F("BINARY ") );
+  Serial.println( DUMP_BAUDRATE );
+  Serial.flush();
+  Serial.updateBaudRate( DUMP_BAUDRATE );
+
+  uint8_t request[FLIGHT_LOG_DUMP_REQUEST_SIZE];
+  uint32_t last_request = millis();
+  bool done = false;
+
+  Serial.setTimeout( 100 );
+  while ( !done && millis() - last_request < DUMP_IDLE_TIMEOUT ) {
+    if ( Serial.readBytes( request, sizeof(request) ) != sizeof(request) ) {
+      continue;
+    }
+    last_request = millis();
+
+    uint32_t argument = get32( request + 1 );
+
+    switch ( request[0] ) {
+      case FLIGHT_LOG_DUMP_REQUEST_INFO: {
+        uint8_t payload[FLIGHT_LOG_DUMP_INFO_SIZE];
+        flightLogDumpEncodeInfo( &info, payload );
+        sendFrame( FLIGHT_LOG_DUMP_INFO, 0, payload, sizeof(payload) );
+        break;
+      }
+
+      case FLIGHT_LOG_DUMP_REQUEST_STREAM:
+        for ( uint32_t index = argument; index < info.block_count; index++ ) {
+          sendBlock( index, info.capacity );
+        }
+        sendFrame( FLIGHT_LOG_DUMP_END, 0, NULL, 0 );
+        break;
+
+      case FLIGHT_LOG_DUMP_REQUEST_BLOCK:
+        sendBlock( argument, info.capacity );
+        break;
+
+      case FLIGHT_LOG_DUMP_REQUEST_QUIT:
+        done = true;
+        break;
+
+      default:
+        // out of step with the receiver - drop whatever is left of the request
+        while ( Serial.available() ) {
+          Serial.read();
+        }
+        break;
+    }
+  }
+
+  Serial.flush();
+  Serial.updateBaudRate( BAUDRATE );
+  Serial.setTimeout( 1000 );
+}
+
+// open the flight log and read its header
+bool openLog(flight_log_header_t* header) {
+  uint8_t buffer[FLIGHT_LOG_HEADER_SIZE];
+
+  file = SerialFlash.open( flight_data_file );
+  if ( !file ) {
+    Serial.println( F("No flight log found") );
+    return false;
+  }
+
+  file.read( buffer, FLIGHT_LOG_HEADER_SIZE );
+  if ( flightLogDecodeHeader( buffer, header ) != FLIGHT_LOG_OK ) {
+    Serial.println( F("Not a flight log we can decode") );
+    file.close();
+    return false;
+  }
+
+  return true;
+}
+
+// read one flight directory slot
+FLIGHT_LOG_STATUS readFlight(uint16_t slot, uint32_t generation, flight_entry_t* entry) {
+  uint8_t buffer[FLIGHT_DIRECTORY_SLOT_SIZE];
+
+  file.seek( flightDirectorySlotOffset( slot ) );
+  file.read( buffer, sizeof(buffer) );
+  return flightDirectoryDecode( buffer, generation, entry );
+}
+
+// a flight ends where the next readable flight starts, or at the end of the log
+uint32_t flightEndPage(uint16_t slot, const flight_log_header_t* header) {
+  flight_entry_t entry;
+  uint16_t slots = header->directory_pages * FLIGHT_DIRECTORY_SLOTS_PER_PAGE;
+
+  for ( uint16_t next = slot + 1; next < slots; next++ ) {
+    FLIGHT_LOG_STATUS status = readFlight( next, header->generation, &entry );
+    if ( status == FLIGHT_LOG_OK ) {
+      return entry.first_page;
+    } else if ( status == FLIGHT_LOG_ERASED ) {
+      break;
+    }
+  }
+
+  return file.size() / FLIGHT_LOG_PAGE_SIZE;
+}
+
+// print the flight directory - one line per flight
+void listFlights() {
+  flight_log_header_t header;
+  flight_entry_t entry;
+
+  Serial.println(F("\n================ Flights ================"));
+  if ( !openLog( &header ) ) {
+    return;
+  }
+
+  uint16_t slots = header.directory_pages * FLIGHT_DIRECTORY_SLOTS_PER_PAGE;
+  for ( uint16_t slot = 0; slot < slots; slot++ ) {
+    FLIGHT_LOG_STATUS status = readFlight( slot, header.generation, &entry );
+    if ( status == FLIGHT_LOG_ERASED ) {
+      break;
+    } else if ( status != FLIGHT_LOG_OK ) {
+      Serial.print( F("flight ") ); Serial.print( slot ); Serial.println( F(": unreadable directory slot") );
+      continue;
+    }
+
+    Serial.print( F("flight ") ); Serial.print( entry.flight );
+    Serial.print( F(": session ") ); Serial.print( entry.session );
+    Serial.print( F(" pages ") ); Serial.print( entry.first_page );
+    Serial.print( F("-") ); Serial.print( flightEndPage( slot, &header ) );
+    Serial.print( F(" config 0x") ); Serial.print( entry.config, HEX );
+
+    if ( entry.closed ) {
+      Serial.print( F(" closed in state ") ); Serial.print( entry.state );
+      Serial.print( F(" records ") ); Serial.print( entry.records );
+      Serial.print( F(" duration ") ); Serial.print( ( entry.end_ms - entry.start_ms ) / 1000 );
+      Serial.print( F("s resets ") ); Serial.println( entry.resets );
+    } else {
+      Serial.println( F(" not closed") );
+    }
+  }
+
+  file.close();
+}
+
+// ask for a flight number and dump that flight as CSV
+void dumpFlight() {
+  flight_log_header_t header;
+  flight_entry_t entry;
+
+  Serial.println( F("Flight number?") );
+  Serial.setTimeout( 10000 );
+  long flight = Serial.parseInt();
+  Serial.setTimeout( 1000 );
+
+  if ( !openLog( &header ) ) {
+    return;
+  }
+
+  uint16_t slots = header.directory_pages * FLIGHT_DIRECTORY_SLOTS_PER_PAGE;
+  if ( flight < 0 || flight >= slots ||
+       readFlight( flight, header.generation, &entry ) != FLIGHT_LOG_OK ) {
+    Serial.println( F("No such flight") );
+    file.close();
+    return;
+  }
+
+  Serial.print(F("\n================ Flight ")); Serial.print( flight ); Serial.println(F(" ================"));
+  Serial.println(F("record_number,timestamp_ms,operation_mode,state,log_policy,ax,ay,az,pitch,roll,gx,gy,gz,latitude,longitude,gps_altitude,pressure,temperature,rel_altitude,velocity"));
+  dumpPages( header.generation, entry.first_page, flightEndPage( flight, &header ) );
+  file.close();
+}
+
 // generate a CSV formatted output of one flight's worth of recordings
 void dumpOneRecording() {
+  uint8_t buffer[FLIGHT_LOG_HEADER_SIZE];
+  flight_log_header_t header;
+
   Serial.println(F("\n================ Flight data ================"));
-  file = SerialFlash.open( "flight.txt" );
+  file = SerialFlash.open( flight_data_file );
 
   Serial.print(F("Files Found: ")); Serial.println(file);
 
   if (file) {
     Serial.print( F("Contents of file: ") );
-    Serial.println( F("flight.txt" ));
+    Serial.println( flight_data_file );
+
+    // check the log was written with a record schema we know
+    file.read( buffer, FLIGHT_LOG_HEADER_SIZE );
+    FLIGHT_LOG_STATUS status = flightLogDecodeHeader( buffer, &header );
+    if ( status != FLIGHT_LOG_OK ) {
+      Serial.print( F("Not a flight log we can decode, status ") );
+      Serial.println( status );
+      file.close();
+      return;
+    }
+
+    Serial.print( F("Schema version: ") ); Serial.println( header.version );
+    Serial.print( F("Generation: ") ); Serial.println( header.generation );
 
     // print out the headings
-    Serial.println(F("record_number,operation_mode,state,ax,ay,az,pitch,roll,gx,gy,gz,alt,velocity,pressure,temp"));
-    
-    do {
-      file.read( (uint8_t *)&oneRecord, sizeof(oneRecord) );
-
-      // library doesn't know where end of actual written data is so we have
-      // to look for it ourselves!
-      if ( oneRecord.record_number != 0xFFFFFFFF ) {
-        Serial.print( oneRecord.record_number );
-        Serial.print( "," );
-        Serial.print( oneRecord.operation_mode );
-        Serial.print( "," );
-        Serial.print( oneRecord.state );
-        Serial.print( "," );
-        Serial.print( oneRecord.acc_data.ax );
-        Serial.print( "," );
-        Serial.print( oneRecord.acc_data.ay );
-        Serial.print( "," );
-        Serial.print( oneRecord.acc_data. az );
-        Serial.print( "," );
-        Serial.print( oneRecord.acc_data.pitch );
-        Serial.print( "," );
-        Serial.print( oneRecord.acc_data.roll );
-        Serial.print( "," );
-        Serial.print( oneRecord.gyro_data.gx );
-        Serial.print( "," );
-        Serial.print( oneRecord.gyro_data.gy );
-        Serial.print( "," );
-        Serial.print( oneRecord.gyro_data.gz );
-        Serial.print( "," );
-        Serial.print( oneRecord.alt_data.altitude );
-        Serial.print( "," );
-        Serial.print( oneRecord.alt_data.velocity );
-        Serial.print( "," );
-        Serial.print( oneRecord.alt_data.pressure );
-        Serial.print( "," );
-        Serial.println( oneRecord.alt_data.temperature );
-      }
-    } while ( oneRecord.record_number != 0xFFFFFFFF );
+    Serial.println(F("record_number,timestamp_ms,operation_mode,state,log_policy,ax,ay,az,pitch,roll,gx,gy,gz,latitude,longitude,gps_altitude,pressure,temperature,rel_altitude,velocity"));
+
+    dumpPages( header.generation, flightLogFirstPage( &header ), UINT32_MAX );
     file.close();
   }
   else {
@@ -0,0 +1,361 @@
+/**
+ * @file n4_dump_receiver.cpp
+ * @brief ground side of the data recovery tool's binary dump, see flight_log_dump.h
+ *
+ * Puts the recovery tool in binary mode, streams the whole flash chip as CRC checked blocks,
+ * asks again for every block that was corrupted or lost, and writes:
+ * - the flash image
+ * - the flight log file cut out of the image, ready for the log decoder
+ *
+ * usage: n4_dump_receiver <serial port> <image file> [log file]
+ * e.g.   n4_dump_receiver /dev/ttyUSB0 flash.bin flight_log.bin
+ *
+ * Linux and macOS only. Build from this directory:
+ * g++ -O2 -std=c++11 -I../../n4-flight-software/lib/flight_log n4_dump_receiver.cpp ../../n4-flight-software/lib/flight_log/flight_log_dump.cpp -o n4_dump_receiver
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+#include "flight_log_dump.h"
+#include "flight_log_le.h"
+
+#define MENU_BAUDRATE 115200        /*!< the recovery tool menu baud rate */
+#define LINE_TIMEOUT_MS 5000        /*!< time to wait for the recovery tool to enter binary mode */
+#define FRAME_TIMEOUT_MS 2000       /*!< time without a byte after which the stream is given up */
+#define MAX_RETRIES 5               /*!< requests for one block before it is given up */
+
+/**
+ * Result of reading one frame
+ */
+typedef enum {
+    FRAME_OK = 0,
+    FRAME_BAD,                      /*!< CRC or header check failed */
+    FRAME_TIMEOUT
+} FRAME_STATUS;
+
+/**
+ * One received frame
+ */
+typedef struct {
+    uint8_t type;
+    uint32_t index;
+    uint16_t length;
+    uint8_t payload[FLIGHT_LOG_DUMP_BLOCK_SIZE];
+} frame_t;
+
+static double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static speed_t baudConstant(uint32_t baud) {
+    switch(baud) {
+        case 115200: return B115200;
+        case 230400: return B230400;
+#ifdef B460800
+        case 460800: return B460800;
+#endif
+#ifdef B921600
+        case 921600: return B921600;
+#endif
+#ifdef B1000000
+        case 1000000: return B1000000;
+#endif
+#ifdef B1500000
+        case 1500000: return B1500000;
+#endif
+#ifdef B2000000
+        case 2000000: return B2000000;
+#endif
+        default: return 0;
+    }
+}
+
+static bool setBaud(int fd, uint32_t baud) {
+    speed_t speed = baudConstant(baud);
+    struct termios tty;
+
+    if(speed == 0 || tcgetattr(fd, &tty) != 0) {
+        return false;
+    }
+
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+
+    return tcsetattr(fd, TCSANOW, &tty) == 0;
+}
+
+/**
+ * @brief read exactly len bytes
+ * @return false if no byte arrived for timeout_ms
+ */
+static bool readExact(int fd, uint8_t* buffer, size_t len, int timeout_ms) {
+    while(len) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if(poll(&pfd, 1, timeout_ms) <= 0) {
+            return false;
+        }
+
+        ssize_t n = read(fd, buffer, len);
+        if(n < 0 && errno != EINTR && errno != EAGAIN) {
+            return false;
+        }
+        if(n > 0) {
+            buffer += n;
+            len -= n;
+        }
+    }
+
+    return true;
+}
+
+static bool sendRequest(int fd, uint8_t command, uint32_t argument) {
+    uint8_t request[FLIGHT_LOG_DUMP_REQUEST_SIZE] = {
+        command, (uint8_t)argument, (uint8_t)(argument >> 8), (uint8_t)(argument >> 16), (uint8_t)(argument >> 24)
+    };
+
+    return write(fd, request, sizeof(request)) == sizeof(request);
+}
+
+/**
+ * @brief read the next frame, skipping anything before its sync bytes
+ */
+static FRAME_STATUS readFrame(int fd, frame_t* frame) {
+    uint8_t header[FLIGHT_LOG_DUMP_FRAME_HEADER_SIZE];
+    uint8_t byte = 0, previous = 0;
+
+    // hunt for the sync bytes
+    do {
+        previous = byte;
+        if(!readExact(fd, &byte, 1, FRAME_TIMEOUT_MS)) {
+            return FRAME_TIMEOUT;
+        }
+    } while(previous != (FLIGHT_LOG_DUMP_SYNC & 0xFF) || byte != (FLIGHT_LOG_DUMP_SYNC >> 8));
+
+    header[0] = previous;
+    header[1] = byte;
+    if(!readExact(fd, header + 2, sizeof(header) - 2, FRAME_TIMEOUT_MS)) {
+        return FRAME_TIMEOUT;
+    }
+
+    frame->type = header[2];
+    frame->index = get32(header + 3);
+    frame->length = get16(header + 7);
+
+    // a corrupted length would make us swallow the frames after it
+    if(frame->length > FLIGHT_LOG_DUMP_BLOCK_SIZE) {
+        return FRAME_BAD;
+    }
+
+    uint8_t trailer[4];
+    if(!readExact(fd, frame->payload, frame->length, FRAME_TIMEOUT_MS) || !readExact(fd, trailer, sizeof(trailer), FRAME_TIMEOUT_MS)) {
+        return FRAME_TIMEOUT;
+    }
+
+    uint32_t crc = flightLogCrc32(header + 2, sizeof(header) - 2, 0);
+    crc = flightLogCrc32(frame->payload, frame->length, crc);
+    uint32_t received = get32(trailer);
+
+    return crc == received ? FRAME_OK : FRAME_BAD;
+}
+
+/**
+ * @brief select binary mode from the recovery tool menu and switch to its baud rate
+ */
+static bool enterBinaryMode(int fd) {
+    char line[64];
+    size_t used = 0;
+    double deadline = nowSeconds() + LINE_TIMEOUT_MS / 1000.0;
+
+    tcflush(fd, TCIOFLUSH);
+    if(write(fd, "b", 1) != 1) {
+        return false;
+    }
+
+    while(nowSeconds() < deadline) {
+        uint8_t c;
+        if(!readExact(fd, &c, 1, LINE_TIMEOUT_MS)) {
+            break;
+        }
+
+        if(c != '\n') {
+            if(used < sizeof(line) - 1) {
+                line[used++] = c;
+            }
+            continue;
+        }
+
+        line[used] = '\0';
+        used = 0;
+
+        unsigned long baud;
+        if(sscanf(line, "BINARY %lu", &baud) == 1) {
+            if(!setBaud(fd, baud)) {
+                fprintf(stderr, "this host cannot run the port at %lu baud\n", baud);
+                return false;
+            }
+
+            // let the recovery tool switch its UART before the first request
+            usleep(100000);
+            tcflush(fd, TCIFLUSH);
+            printf("binary mode at %lu baud\n", baud);
+            return true;
+        }
+    }
+
+    fprintf(stderr, "the recovery tool did not enter binary mode - is it showing its menu?\n");
+    return false;
+}
+
+static bool writeFile(const char* path, const uint8_t* data, size_t len) {
+    FILE* f = fopen(path, "wb");
+    if(f == NULL || fwrite(data, 1, len, f) != len) {
+        fprintf(stderr, "could not write %s\n", path);
+        if(f) {
+            fclose(f);
+        }
+        return false;
+    }
+
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        fprintf(stderr, "usage: %s <serial port> <image file> [log file]\n", argv[0]);
+        return 1;
+    }
+
+    int fd = open(argv[1], O_RDWR | O_NOCTTY);
+    if(fd < 0 || !setBaud(fd, MENU_BAUDRATE)) {
+        fprintf(stderr, "could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    if(!enterBinaryMode(fd)) {
+        close(fd);
+        return 1;
+    }
+
+    static frame_t frame;
+    flight_log_dump_info_t info;
+    bool have_info = false;
+
+    for(int attempt = 0; attempt < MAX_RETRIES && !have_info; attempt++) {
+        sendRequest(fd, FLIGHT_LOG_DUMP_REQUEST_INFO, 0);
+        if(readFrame(fd, &frame) == FRAME_OK && frame.type == FLIGHT_LOG_DUMP_INFO && frame.length == FLIGHT_LOG_DUMP_INFO_SIZE) {
+            flightLogDumpDecodeInfo(frame.payload, &info);
+            have_info = true;
+        }
+    }
+
+    if(!have_info || info.block_size != FLIGHT_LOG_DUMP_BLOCK_SIZE || info.capacity == 0) {
+        fprintf(stderr, "no usable info frame from the recovery tool\n");
+        close(fd);
+        return 1;
+    }
+
+    printf("flash %u bytes in %u blocks, flight log %u bytes at 0x%06x\n",
+           info.capacity, info.block_count, info.log_size, info.log_address);
+
+    std::vector<uint8_t> image(info.capacity, 0xFF);
+    std::vector<bool> received(info.block_count, false);
+    uint32_t received_count = 0, bad_frames = 0, retried = 0;
+    double start = nowSeconds();
+
+    // stream the whole chip
+    sendRequest(fd, FLIGHT_LOG_DUMP_REQUEST_STREAM, 0);
+    while(1) {
+        FRAME_STATUS status = readFrame(fd, &frame);
+        if(status == FRAME_TIMEOUT || (status == FRAME_OK && frame.type == FLIGHT_LOG_DUMP_END)) {
+            break;
+        }
+
+        if(status == FRAME_BAD || frame.type != FLIGHT_LOG_DUMP_BLOCK || frame.index >= info.block_count) {
+            bad_frames++;
+            continue;
+        }
+
+        uint32_t address = frame.index * FLIGHT_LOG_DUMP_BLOCK_SIZE;
+        if(address + frame.length > info.capacity) {
+            bad_frames++;
+            continue;
+        }
+
+        memcpy(&image[address], frame.payload, frame.length);
+        if(!received[frame.index]) {
+            received[frame.index] = true;
+            received_count++;
+        }
+
+        if(received_count % 64 == 0) {
+            double elapsed = nowSeconds() - start;
+            printf("\r%u/%u blocks, %.0f kB/s   ", received_count, info.block_count,
+                   received_count * (FLIGHT_LOG_DUMP_BLOCK_SIZE / 1024.0) / (elapsed > 0 ? elapsed : 1));
+            fflush(stdout);
+        }
+    }
+    printf("\n");
+
+    // ask again for every block that was corrupted or lost
+    uint32_t failed = 0;
+    for(uint32_t index = 0; index < info.block_count; index++) {
+        for(int attempt = 0; attempt < MAX_RETRIES && !received[index]; attempt++) {
+            retried++;
+            tcflush(fd, TCIFLUSH);
+            sendRequest(fd, FLIGHT_LOG_DUMP_REQUEST_BLOCK, index);
+
+            if(readFrame(fd, &frame) == FRAME_OK && frame.type == FLIGHT_LOG_DUMP_BLOCK && frame.index == index) {
+                memcpy(&image[index * FLIGHT_LOG_DUMP_BLOCK_SIZE], frame.payload, frame.length);
+                received[index] = true;
+                received_count++;
+            }
+        }
+
+        if(!received[index]) {
+            fprintf(stderr, "block %u lost - left as 0xFF in the image\n", index);
+            failed++;
+        }
+    }
+
+    sendRequest(fd, FLIGHT_LOG_DUMP_REQUEST_QUIT, 0);
+    close(fd);
+
+    double elapsed = nowSeconds() - start;
+    printf("%u bytes in %.1f s (%.0f kB/s), %u bad frames, %u block requests, %u blocks lost\n",
+           info.capacity, elapsed, info.capacity / 1024.0 / elapsed, bad_frames, retried, failed);
+
+    if(!writeFile(argv[2], image.data(), image.size())) {
+        return 1;
+    }
+    printf("image written to %s\n", argv[2]);
+
+    if(argc > 3) {
+        if(info.log_size == 0 || info.log_address + info.log_size > info.capacity) {
+            fprintf(stderr, "the flash holds no flight log file\n");
+            return 1;
+        }
+        if(!writeFile(argv[3], &image[info.log_address], info.log_size)) {
+            return 1;
+        }
+        printf("flight log written to %s\n", argv[3]);
+    }
+
+    return failed ? 1 : 0;
+}
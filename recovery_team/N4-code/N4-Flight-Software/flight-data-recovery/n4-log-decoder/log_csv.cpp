@@ -0,0 +1,97 @@
+/**
+ * @file log_csv.cpp
+ * @brief Format decoded flight records as CSV rows
+ */
+
+#include "log_csv.h"
+#include "flight_log.h"
+
+/**
+ * @brief print an unsigned integer
+ * @return end of the printed text
+ */
+static char* printUnsigned(char* out, uint32_t value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while(value);
+
+    while(n) {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+/**
+ * @brief print a number with a fixed number of decimals, rounded the way Arduino's
+ * Print::print(double, digits) rounds, so that the CSV matches the recovery tool's.
+ * snprintf is several times slower and rounds ties differently
+ * @return end of the printed text
+ */
+static char* printFixed(char* out, double value, uint8_t digits) {
+    if(value < 0.0) {
+        *out++ = '-';
+        value = -value;
+    }
+
+    double rounding = 0.5;
+    for(uint8_t i = 0; i < digits; i++) {
+        rounding /= 10.0;
+    }
+    value += rounding;
+
+    uint32_t integer = (uint32_t)value;
+    double remainder = value - integer;
+    out = printUnsigned(out, integer);
+
+    if(digits) {
+        *out++ = '.';
+    }
+    while(digits--) {
+        remainder *= 10.0;
+        uint8_t digit = (uint8_t)remainder;
+        *out++ = '0' + digit;
+        remainder -= digit;
+    }
+    return out;
+}
+
+/**
+ * @brief print one record as a CSV row, newline included
+ * @param out at least LOG_CSV_ROW_SIZE bytes
+ * @param session logging session the record was written in
+ * @param fields the record, see flight_log_fields.def
+ * @return bytes printed
+ */
+size_t logCsvRow(char* out, uint16_t session, const int32_t* fields) {
+    flight_log_sample_t sample;
+    flightLogFromFields(fields, &sample);
+
+    char* p = out;
+
+    p = printUnsigned(p, session); *p++ = ',';
+    p = printUnsigned(p, sample.record_number); *p++ = ',';
+    p = printUnsigned(p, sample.timestamp_ms); *p++ = ',';
+    p = printUnsigned(p, sample.operation_mode); *p++ = ',';
+    p = printUnsigned(p, sample.state); *p++ = ',';
+    p = printUnsigned(p, sample.log_policy); *p++ = ',';
+    p = printFixed(p, sample.ax, 3); *p++ = ',';
+    p = printFixed(p, sample.ay, 3); *p++ = ',';
+    p = printFixed(p, sample.az, 3); *p++ = ',';
+    p = printFixed(p, sample.pitch, 2); *p++ = ',';
+    p = printFixed(p, sample.roll, 2); *p++ = ',';
+    p = printFixed(p, sample.gx, 2); *p++ = ',';
+    p = printFixed(p, sample.gy, 2); *p++ = ',';
+    p = printFixed(p, sample.gz, 2); *p++ = ',';
+    p = printFixed(p, sample.latitude, 7); *p++ = ',';
+    p = printFixed(p, sample.longitude, 7); *p++ = ',';
+    p = printUnsigned(p, sample.gps_altitude); *p++ = ',';
+    p = printFixed(p, sample.pressure, 2); *p++ = ',';
+    p = printFixed(p, sample.temperature, 2); *p++ = ',';
+    p = printFixed(p, sample.rel_altitude, 2); *p++ = ',';
+    p = printFixed(p, sample.velocity, 1); *p++ = '\n';
+
+    return p - out;
+}
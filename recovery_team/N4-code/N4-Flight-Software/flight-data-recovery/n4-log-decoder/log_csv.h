@@ -0,0 +1,20 @@
+/**
+ * @file log_csv.h
+ * @brief CSV rows of decoded flight records, shared by the log decoder and the log query tool
+ *
+ * The columns are the recovery tool's, after a session column, printed at the same precision
+ * and with the same rounding, so that rows from every tool compare equal.
+ */
+
+#ifndef LOG_CSV_H
+#define LOG_CSV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_CSV_HEADER "session,record_number,timestamp_ms,operation_mode,state,log_policy,ax,ay,az,pitch,roll,gx,gy,gz,latitude,longitude,gps_altitude,pressure,temperature,rel_altitude,velocity\n"
+#define LOG_CSV_ROW_SIZE 320                /*!< longer than the longest CSV row */
+
+size_t logCsvRow(char* out, uint16_t session, const int32_t* fields);
+
+#endif // LOG_CSV_H
@@ -0,0 +1,240 @@
+/**
+ * @file log_index.cpp
+ * @brief Build, store and search the sparse flight log index
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "log_index.h"
+#include "flight_log.h"
+#include "flight_log_le.h"
+
+static uint8_t fieldState(const int32_t* fields) {
+    return fields[FIELD_FLAGS] & 0x0F;
+}
+
+/**
+ * @brief add a decoded page. Pages must be added in flash order
+ * @param offset page address, from the log header
+ * @param session logging session from the page header
+ * @param fields the records of the page, see flight_log_fields.def
+ * @param count records in the page
+ * @param stride int32 values from one record to the next
+ */
+void logIndexAddPage(log_index_t* index, uint32_t offset, uint16_t session, const int32_t* fields, size_t count, size_t stride) {
+    if(count == 0) {
+        return;
+    }
+
+    // a new session, or a clock that went backwards, starts a new segment so that the
+    // timestamps in every segment stay sorted
+    bool new_segment = index->segments.empty() || index->segments.back().session != session ||
+                       (uint32_t)fields[FIELD_TIMESTAMP] < index->entries.back().timestamp_ms;
+
+    if(new_segment) {
+        log_index_segment_t segment = {session, (uint32_t)index->entries.size(), 0};
+        index->segments.push_back(segment);
+    }
+
+    uint16_t segment = index->segments.size() - 1;
+    uint8_t state = new_segment ? LOG_INDEX_NO_STATE : index->transitions.back().to;
+
+    log_index_entry_t entry;
+    entry.offset = offset;
+    entry.timestamp_ms = fields[FIELD_TIMESTAMP];
+    entry.record_number = fields[FIELD_RECORD_NUMBER];
+    entry.segment = segment;
+    entry.state = fieldState(fields);
+    entry.records = count;
+    index->entries.push_back(entry);
+    index->segments.back().count++;
+
+    for(size_t i = 0; i < count; i++) {
+        const int32_t* record = fields + i * stride;
+        if(fieldState(record) == state) {
+            continue;
+        }
+
+        log_index_transition_t transition;
+        transition.offset = offset;
+        transition.timestamp_ms = record[FIELD_TIMESTAMP];
+        transition.record_number = record[FIELD_RECORD_NUMBER];
+        transition.segment = segment;
+        transition.from = state;
+        transition.to = fieldState(record);
+        index->transitions.push_back(transition);
+
+        state = transition.to;
+    }
+}
+
+/**
+ * @brief write the index to a file
+ */
+bool logIndexWrite(const char* path, const log_index_t* index) {
+    FILE* f = fopen(path, "wb");
+    if(f == NULL) {
+        fprintf(stderr, "could not create %s\n", path);
+        return false;
+    }
+
+    uint8_t header[LOG_INDEX_HEADER_SIZE] = {};
+    put32(header, LOG_INDEX_MAGIC);
+    header[4] = LOG_INDEX_VERSION;
+    uint8_t* p = put32(header + 8, index->log_offset);
+    p = put32(p, index->log_size);
+    p = put32(p, index->generation);
+    p = put32(p, index->entries.size());
+    p = put32(p, index->segments.size());
+    put32(p, index->transitions.size());
+    fwrite(header, 1, sizeof(header), f);
+
+    for(size_t i = 0; i < index->entries.size(); i++) {
+        const log_index_entry_t& entry = index->entries[i];
+        uint8_t buffer[LOG_INDEX_ENTRY_SIZE];
+        p = put32(buffer, entry.offset);
+        p = put32(p, entry.timestamp_ms);
+        p = put32(p, entry.record_number);
+        p = put16(p, entry.segment);
+        p[0] = entry.state;
+        p[1] = entry.records;
+        fwrite(buffer, 1, sizeof(buffer), f);
+    }
+
+    for(size_t i = 0; i < index->segments.size(); i++) {
+        const log_index_segment_t& segment = index->segments[i];
+        uint8_t buffer[LOG_INDEX_SEGMENT_SIZE] = {};
+        put16(buffer, segment.session);
+        p = put32(buffer + 4, segment.first);
+        put32(p, segment.count);
+        fwrite(buffer, 1, sizeof(buffer), f);
+    }
+
+    for(size_t i = 0; i < index->transitions.size(); i++) {
+        const log_index_transition_t& transition = index->transitions[i];
+        uint8_t buffer[LOG_INDEX_TRANSITION_SIZE];
+        p = put32(buffer, transition.offset);
+        p = put32(p, transition.timestamp_ms);
+        p = put32(p, transition.record_number);
+        p = put16(p, transition.segment);
+        p[0] = transition.from;
+        p[1] = transition.to;
+        fwrite(buffer, 1, sizeof(buffer), f);
+    }
+
+    bool ok = ferror(f) == 0;
+    ok = fclose(f) == 0 && ok;
+    if(!ok) {
+        fprintf(stderr, "could not write %s\n", path);
+    }
+    return ok;
+}
+
+/**
+ * @brief read an index written by logIndexWrite()
+ * @return false if the file is not an index this version can read, or is truncated
+ */
+bool logIndexRead(const char* path, log_index_t* index) {
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) {
+        fprintf(stderr, "could not open %s\n", path);
+        return false;
+    }
+
+    uint8_t header[LOG_INDEX_HEADER_SIZE];
+    if(fread(header, 1, sizeof(header), f) != sizeof(header) || get32(header) != LOG_INDEX_MAGIC) {
+        fprintf(stderr, "%s is not a log index\n", path);
+        fclose(f);
+        return false;
+    }
+
+    if(header[4] != LOG_INDEX_VERSION) {
+        fprintf(stderr, "index version %u, this tool reads version %u - decode the log again\n", header[4], LOG_INDEX_VERSION);
+        fclose(f);
+        return false;
+    }
+
+    index->log_offset = get32(header + 8);
+    index->log_size = get32(header + 12);
+    index->generation = get32(header + 16);
+    index->entries.resize(get32(header + 20));
+    index->segments.resize(get32(header + 24));
+    index->transitions.resize(get32(header + 28));
+
+    bool ok = true;
+
+    for(size_t i = 0; ok && i < index->entries.size(); i++) {
+        uint8_t buffer[LOG_INDEX_ENTRY_SIZE];
+        ok = fread(buffer, 1, sizeof(buffer), f) == sizeof(buffer);
+
+        log_index_entry_t& entry = index->entries[i];
+        entry.offset = get32(buffer);
+        entry.timestamp_ms = get32(buffer + 4);
+        entry.record_number = get32(buffer + 8);
+        entry.segment = get16(buffer + 12);
+        entry.state = buffer[14];
+        entry.records = buffer[15];
+    }
+
+    for(size_t i = 0; ok && i < index->segments.size(); i++) {
+        uint8_t buffer[LOG_INDEX_SEGMENT_SIZE];
+        ok = fread(buffer, 1, sizeof(buffer), f) == sizeof(buffer);
+
+        log_index_segment_t& segment = index->segments[i];
+        segment.session = get16(buffer);
+        segment.first = get32(buffer + 4);
+        segment.count = get32(buffer + 8);
+        ok = ok && segment.first + segment.count <= index->entries.size();
+    }
+
+    for(size_t i = 0; ok && i < index->transitions.size(); i++) {
+        uint8_t buffer[LOG_INDEX_TRANSITION_SIZE];
+        ok = fread(buffer, 1, sizeof(buffer), f) == sizeof(buffer);
+
+        log_index_transition_t& transition = index->transitions[i];
+        transition.offset = get32(buffer);
+        transition.timestamp_ms = get32(buffer + 4);
+        transition.record_number = get32(buffer + 8);
+        transition.segment = get16(buffer + 12);
+        transition.from = buffer[14];
+        transition.to = buffer[15];
+        ok = ok && transition.segment < index->segments.size();
+    }
+
+    fclose(f);
+    if(!ok) {
+        fprintf(stderr, "%s is truncated or corrupt\n", path);
+    }
+    return ok;
+}
+
+/**
+ * @brief find the page to start decoding at for a time in a segment - the last page that
+ * starts at or before the time, or the first page of the segment. O(log n)
+ * @return entry index
+ */
+size_t logIndexFindTime(const log_index_t* index, uint16_t segment, uint32_t timestamp_ms) {
+    const log_index_segment_t& s = index->segments[segment];
+    std::vector<log_index_entry_t>::const_iterator first = index->entries.begin() + s.first;
+    std::vector<log_index_entry_t>::const_iterator last = first + s.count;
+
+    std::vector<log_index_entry_t>::const_iterator found = std::upper_bound(first, last, timestamp_ms,
+        [](uint32_t t, const log_index_entry_t& entry) { return t < entry.timestamp_ms; });
+
+    return (found == first ? first : found - 1) - index->entries.begin();
+}
+
+/**
+ * @brief find the entry of a page. O(log n)
+ * @return entry index, or the entry count if no page starts at offset
+ */
+size_t logIndexFindOffset(const log_index_t* index, uint32_t offset) {
+    std::vector<log_index_entry_t>::const_iterator found = std::lower_bound(index->entries.begin(), index->entries.end(), offset,
+        [](const log_index_entry_t& entry, uint32_t o) { return entry.offset < o; });
+
+    if(found == index->entries.end() || found->offset != offset) {
+        return index->entries.size();
+    }
+    return found - index->entries.begin();
+}
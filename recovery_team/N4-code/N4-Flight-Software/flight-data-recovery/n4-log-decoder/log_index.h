@@ -0,0 +1,103 @@
+/**
+ * @file log_index.h
+ * @brief Sparse time index over a paged flight log, written by n4_log_decoder and read by
+ * n4_log_query
+ *
+ * Every page of the flight log starts with a keyframe, so decoding can
+ * start at any page. The index keeps one entry per decoded page with its first timestamp,
+ * record number and flight state, so that a time range is found with a binary search and
+ * only the pages that hold it are decoded.
+ *
+ * Timestamps and record numbers restart when the flight computer reboots. The entries are
+ * grouped into segments - runs of pages from one logging session - and searched by time
+ * within a segment.
+ *
+ * Flight state changes are kept as transition markers. The first record of every segment is
+ * a marker from LOG_INDEX_NO_STATE.
+ *
+ * File layout, every value little-endian:
+ *
+ * | field       | type                    |                                            |
+ * |-------------|-------------------------|--------------------------------------------|
+ * | magic       | uint32                  | LOG_INDEX_MAGIC                            |
+ * | version     | uint8                   | LOG_INDEX_VERSION                          |
+ * | -           | 3 x uint8               | reserved, 0                                |
+ * | log offset  | uint32                  | log header offset in the decoded file      |
+ * | log size    | uint32                  | bytes of log covered, from the log header  |
+ * | generation  | uint32                  | generation of the indexed log              |
+ * | entries     | uint32                  |                                            |
+ * | segments    | uint32                  |                                            |
+ * | transitions | uint32                  |                                            |
+ * | entries     | entries x 16 bytes      | log_index_entry_t, in flash order          |
+ * | segments    | segments x 12 bytes     | log_index_segment_t, in flash order        |
+ * | transitions | transitions x 16 bytes  | log_index_transition_t, in flash order     |
+ */
+
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define LOG_INDEX_MAGIC 0x5849344EUL        /*!< "N4IX" when read as bytes */
+#define LOG_INDEX_VERSION 1                 /*!< bump on every layout change */
+#define LOG_INDEX_HEADER_SIZE 32
+#define LOG_INDEX_ENTRY_SIZE 16
+#define LOG_INDEX_SEGMENT_SIZE 12
+#define LOG_INDEX_TRANSITION_SIZE 16
+#define LOG_INDEX_NO_STATE 0xFF             /*!< transition "from" at the start of a segment */
+
+/**
+ * One decoded page
+ */
+typedef struct {
+    uint32_t offset;                /*!< page address, from the log header */
+    uint32_t timestamp_ms;          /*!< of the first record in the page */
+    uint32_t record_number;         /*!< of the first record in the page */
+    uint16_t segment;               /*!< segment the page belongs to */
+    uint8_t state;                  /*!< flight state of the first record in the page */
+    uint8_t records;                /*!< records in the page */
+} log_index_entry_t;
+
+/**
+ * A run of pages from one logging session
+ */
+typedef struct {
+    uint16_t session;
+    uint32_t first;                 /*!< first entry */
+    uint32_t count;                 /*!< entries */
+} log_index_segment_t;
+
+/**
+ * A flight state change
+ */
+typedef struct {
+    uint32_t offset;                /*!< page holding the first record in the new state */
+    uint32_t timestamp_ms;          /*!< of the first record in the new state */
+    uint32_t record_number;         /*!< of the first record in the new state */
+    uint16_t segment;
+    uint8_t from;                   /*!< previous state, LOG_INDEX_NO_STATE at the start of a segment */
+    uint8_t to;                     /*!< new state */
+} log_index_transition_t;
+
+/**
+ * An index, in memory
+ */
+typedef struct {
+    uint32_t log_offset;            /*!< log header offset in the decoded file */
+    uint32_t log_size;              /*!< bytes of log covered, from the log header */
+    uint32_t generation;            /*!< generation of the indexed log */
+    std::vector<log_index_entry_t> entries;
+    std::vector<log_index_segment_t> segments;
+    std::vector<log_index_transition_t> transitions;
+} log_index_t;
+
+void logIndexAddPage(log_index_t* index, uint32_t offset, uint16_t session, const int32_t* fields, size_t count, size_t stride);
+bool logIndexWrite(const char* path, const log_index_t* index);
+bool logIndexRead(const char* path, log_index_t* index);
+
+size_t logIndexFindTime(const log_index_t* index, uint16_t segment, uint32_t timestamp_ms);
+size_t logIndexFindOffset(const log_index_t* index, uint32_t offset);
+
+#endif // LOG_INDEX_H
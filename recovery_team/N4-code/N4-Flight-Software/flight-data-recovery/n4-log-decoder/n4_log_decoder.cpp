@@ -0,0 +1,468 @@
+/**
+ * @file n4_log_decoder.cpp
+ * @brief decode a flight log, or a whole flash image, into CSV and columnar files on the host
+ *
+ * The input is memory mapped and its pages are split across worker threads. Every page is CRC
+ * checked and starts with a keyframe, so pages are decoded independently. They are merged in
+ * flash order with the recovery tool's rules - the log ends at the first erased page or after
+ * MAX_BAD_PAGES corrupt pages in a row.
+ *
+ * The record layout comes from lib/flight_log, the code the flight software writes the log
+ * with, so this decoder cannot drift from the firmware.
+ *
+ * Outputs:
+ * - CSV: the session, then the recovery tool's columns at the same precision
+ * - columnar (optional): every column as one little-endian int32 array in stored units, so
+ *   that analysis tools can load a column without parsing text:
+ *
+ * | field   | type                 |                                           |
+ * |---------|----------------------|-------------------------------------------|
+ * | magic   | uint32               | COLUMNS_MAGIC                             |
+ * | version | uint8                | COLUMNS_VERSION                           |
+ * | count   | uint8                | columns                                   |
+ * | -       | uint16               | reserved, 0                               |
+ * | rows    | uint32               | rows in every column                      |
+ * | columns | count x 32 bytes     | name (16), unit (8), scale (float64)      |
+ * | data    | count x rows x int32 | one column after the other                |
+ *
+ * Divide a column by its scale to get it in its unit. Column 0 is the session, the others
+ * are the record fields in the order of flight_log_fields.def.
+ * - index (-i): the sparse time and flight state index n4_log_query uses to
+ *   decode only the pages it needs, see log_index.h
+ *
+ * usage: n4_log_decoder [-j threads] [-i index file] <log or image> <csv file> [columnar file]
+ * e.g.   n4_log_decoder -i flight.idx flight_log.bin flight.csv flight.n4c
+ *
+ * Linux and macOS only. Build from this directory:
+ * g++ -O2 -std=c++11 -pthread -I../../n4-flight-software/lib/flight_log n4_log_decoder.cpp log_csv.cpp log_index.cpp ../../n4-flight-software/lib/flight_log/flight_log.cpp ../../n4-flight-software/lib/flight_log/flight_log_codec.cpp ../../n4-flight-software/lib/flight_log/flight_directory.cpp -o n4_log_decoder
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "flight_log.h"
+#include "flight_log_codec.h"
+#include "flight_directory.h"
+#include "flight_log_le.h"
+#include "log_csv.h"
+#include "log_index.h"
+
+#define MAX_BAD_PAGES 8                     /*!< consecutive corrupt pages after which the log ends, as in the recovery tool */
+#define HEADER_SEARCH_ALIGN 256             /*!< SerialFlash files start on a page boundary */
+#define COLUMNS_MAGIC 0x4C43344EUL          /*!< "N4CL" when read as bytes */
+#define COLUMNS_VERSION 1
+#define COLUMNS_HEADER_SIZE 12              /*!< bytes before the column descriptions */
+#define COLUMN_NAME_SIZE 16
+#define COLUMN_UNIT_SIZE 8
+#define COLUMN_INFO_SIZE (COLUMN_NAME_SIZE + COLUMN_UNIT_SIZE + 8)
+#define COLUMN_COUNT (1 + FLIGHT_LOG_FIELD_COUNT)   /*!< the session, then every record field */
+
+static_assert(COLUMN_INFO_SIZE == 32, "column description layout changed");
+static_assert(COLUMN_COUNT <= 255, "the column count must fit in a uint8_t");
+
+/**
+ * Result of decoding one page
+ */
+typedef enum {
+    PAGE_OK = 0,
+    PAGE_ERASED,                    /*!< the end of the recorded data */
+    PAGE_CORRUPT,                   /*!< failed the header or CRC check */
+    PAGE_BAD_FRAME                  /*!< passed the CRC, but a frame did not decode - the rows before it are kept */
+} PAGE_STATUS;
+
+/**
+ * What a worker found in one page
+ */
+typedef struct {
+    uint8_t status;                 /*!< PAGE_STATUS */
+    uint16_t session;
+    size_t text_end;                /*!< end of the page's rows in the worker's CSV text */
+    size_t row_end;                 /*!< end of the page's rows in the worker's columns */
+} page_result_t;
+
+/**
+ * The output of one worker - a run of consecutive pages or records
+ */
+typedef struct {
+    size_t first;                   /*!< first page or record */
+    size_t count;                   /*!< pages to decode */
+    std::string text;               /*!< CSV rows */
+    std::vector<int32_t> rows;      /*!< COLUMN_COUNT values per row */
+} chunk_t;
+
+/**
+ * The decoded log, in flash order
+ */
+typedef struct {
+    std::vector<chunk_t> chunks;
+    std::vector<size_t> text_used;  /*!< bytes of each chunk's text that belong to the log */
+    std::vector<size_t> rows_used;  /*!< rows of each chunk that belong to the log */
+    size_t rows;
+    uint32_t pages;
+    uint32_t bad_pages;
+    uint32_t bad_frames;
+} decoded_log_t;
+
+/**
+ * @brief add one record as a CSV row and as a row of columns
+ */
+static void appendRow(chunk_t* chunk, uint16_t session, const int32_t* fields) {
+    char row[LOG_CSV_ROW_SIZE];
+    chunk->text.append(row, logCsvRow(row, session, fields));
+
+    chunk->rows.push_back(session);
+    chunk->rows.insert(chunk->rows.end(), fields, fields + FLIGHT_LOG_FIELD_COUNT);
+}
+
+/**
+ * @brief decode a run of pages. Pages are numbered from the first log page
+ */
+static void decodePages(const uint8_t* log, uint32_t first_page, uint32_t generation, chunk_t* chunk, page_result_t* results) {
+    flight_log_page_t page_header;
+    flight_log_codec_t codec;
+    int32_t fields[FLIGHT_LOG_FIELD_COUNT];
+
+    for(size_t i = 0; i < chunk->count; i++) {
+        const uint8_t* page = log + (chunk->first + i + first_page) * FLIGHT_LOG_PAGE_SIZE;
+        page_result_t* result = &results[i];
+
+        FLIGHT_LOG_STATUS status = flightLogDecodePageHeader(page, generation, &page_header);
+        if(status == FLIGHT_LOG_ERASED) {
+            result->status = PAGE_ERASED;
+        } else if(status != FLIGHT_LOG_OK) {
+            result->status = PAGE_CORRUPT;
+        } else {
+            result->status = PAGE_OK;
+            result->session = page_header.session;
+
+            flightLogCodecReset(&codec);
+
+            size_t offset = 0;
+            while(offset < page_header.length) {
+                size_t used;
+                if(flightLogDecompress(&codec, page + FLIGHT_LOG_PAGE_HEADER_SIZE + offset, page_header.length - offset, fields, &used) != FLIGHT_LOG_OK) {
+                    result->status = PAGE_BAD_FRAME;
+                    break;
+                }
+                offset += used;
+                appendRow(chunk, page_header.session, fields);
+            }
+        }
+
+        result->text_end = chunk->text.size();
+        result->row_end = chunk->rows.size() / COLUMN_COUNT;
+    }
+}
+
+/**
+ * @brief split count items into runs for the workers and run them
+ */
+template <typename Work>
+static void runWorkers(decoded_log_t* out, size_t count, unsigned threads, Work work) {
+    if(threads > count) {
+        threads = count ? count : 1;
+    }
+
+    out->chunks.resize(threads);
+    size_t first = 0;
+    for(unsigned i = 0; i < threads; i++) {
+        out->chunks[i].first = first;
+        out->chunks[i].count = count / threads + (i < count % threads);
+        first += out->chunks[i].count;
+    }
+
+    std::vector<std::thread> workers;
+    for(unsigned i = 1; i < threads; i++) {
+        workers.push_back(std::thread(work, &out->chunks[i]));
+    }
+    work(&out->chunks[0]);
+    for(size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+static void decodePagedLog(const uint8_t* log, size_t size, const flight_log_header_t* header, unsigned threads, decoded_log_t* out, log_index_t* index) {
+    uint32_t first_page = flightLogFirstPage(header);
+    uint32_t generation = header->generation;
+    size_t pages = size / FLIGHT_LOG_PAGE_SIZE > first_page ? size / FLIGHT_LOG_PAGE_SIZE - first_page : 0;
+    std::vector<page_result_t> results(pages);
+
+    runWorkers(out, pages, threads, [&](chunk_t* chunk) {
+        decodePages(log, first_page, generation, chunk, &results[chunk->first]);
+    });
+
+    // merge in flash order - keep the pages before the end of the log
+    uint32_t bad_run = 0;
+    out->text_used.assign(out->chunks.size(), 0);
+    out->rows_used.assign(out->chunks.size(), 0);
+
+    for(size_t c = 0; c < out->chunks.size(); c++) {
+        const chunk_t& chunk = out->chunks[c];
+        for(size_t i = 0; i < chunk.count; i++) {
+            const page_result_t& result = results[chunk.first + i];
+
+            if(result.status == PAGE_ERASED) {
+                return;
+            } else if(result.status == PAGE_CORRUPT) {
+                // a page torn by a reset is followed by good pages, a run of bad pages was left
+                // over from before the log was last erased
+                if(++bad_run > MAX_BAD_PAGES) {
+                    return;
+                }
+                out->bad_pages++;
+                fprintf(stderr, "skipped corrupt page at %zu\n", (chunk.first + i + first_page) * FLIGHT_LOG_PAGE_SIZE);
+                continue;
+            }
+
+            bad_run = 0;
+            out->pages++;
+            if(result.status == PAGE_BAD_FRAME) {
+                out->bad_frames++;
+                fprintf(stderr, "undecodable frame in page at %zu\n", (chunk.first + i + first_page) * FLIGHT_LOG_PAGE_SIZE);
+            }
+
+            size_t offset = (chunk.first + i + first_page) * FLIGHT_LOG_PAGE_SIZE;
+            if(index != NULL) {
+                const int32_t* rows = chunk.rows.data() + out->rows_used[c] * COLUMN_COUNT;
+                logIndexAddPage(index, offset, result.session, rows + 1, result.row_end - out->rows_used[c], COLUMN_COUNT);
+                index->log_size = offset + FLIGHT_LOG_PAGE_SIZE;
+            }
+
+            out->rows += result.row_end - out->rows_used[c];
+            out->text_used[c] = result.text_end;
+            out->rows_used[c] = result.row_end;
+        }
+    }
+}
+
+/**
+ * @brief list the flights in the flight directory
+ */
+static void printFlights(const uint8_t* log, size_t size, const flight_log_header_t* header) {
+    flight_entry_t entry;
+    uint32_t slots = header->directory_pages * FLIGHT_DIRECTORY_SLOTS_PER_PAGE;
+
+    for(uint32_t slot = 0; slot < slots && flightDirectorySlotOffset(slot) + FLIGHT_DIRECTORY_SLOT_SIZE <= size; slot++) {
+        FLIGHT_LOG_STATUS status = flightDirectoryDecode(log + flightDirectorySlotOffset(slot), header->generation, &entry);
+        if(status == FLIGHT_LOG_ERASED) {
+            break;
+        } else if(status != FLIGHT_LOG_OK) {
+            fprintf(stderr, "flight %u: unreadable directory slot\n", slot);
+        } else if(entry.closed) {
+            fprintf(stderr, "flight %u: session %u, from page %u, closed in state %u after %u records\n",
+                    entry.flight, entry.session, entry.first_page, entry.state, entry.records);
+        } else {
+            fprintf(stderr, "flight %u: session %u, from page %u, not closed\n", entry.flight, entry.session, entry.first_page);
+        }
+    }
+}
+
+/**
+ * @brief find the flight log in the input
+ * A log file starts with the log header. In a flash image the header is searched for on
+ * every page boundary
+ * @return offset of the log header, or size if there is none
+ */
+static size_t findLog(const uint8_t* data, size_t size, flight_log_header_t* header) {
+    for(size_t offset = 0; offset + FLIGHT_LOG_HEADER_SIZE <= size; offset += HEADER_SEARCH_ALIGN) {
+        if(get32(data + offset) == FLIGHT_LOG_MAGIC && flightLogDecodeHeader(data + offset, header) == FLIGHT_LOG_OK) {
+            return offset;
+        }
+    }
+    return size;
+}
+
+static bool writeCsv(const char* path, const decoded_log_t* log) {
+    FILE* f = fopen(path, "wb");
+    if(f == NULL) {
+        fprintf(stderr, "could not create %s\n", path);
+        return false;
+    }
+
+    fputs(LOG_CSV_HEADER, f);
+    for(size_t c = 0; c < log->chunks.size(); c++) {
+        fwrite(log->chunks[c].text.data(), 1, log->text_used[c], f);
+    }
+
+    bool ok = ferror(f) == 0;
+    ok = fclose(f) == 0 && ok;
+    if(!ok) {
+        fprintf(stderr, "could not write %s\n", path);
+    }
+    return ok;
+}
+
+static bool writeColumns(const char* path, const decoded_log_t* log, unsigned threads) {
+    FILE* f = fopen(path, "wb");
+    if(f == NULL) {
+        fprintf(stderr, "could not create %s\n", path);
+        return false;
+    }
+
+    uint8_t header[COLUMNS_HEADER_SIZE] = {};
+    put32(header, COLUMNS_MAGIC);
+    header[4] = COLUMNS_VERSION;
+    header[5] = COLUMN_COUNT;
+    put32(header + 8, log->rows);
+    fwrite(header, 1, sizeof(header), f);
+
+    for(uint8_t column = 0; column < COLUMN_COUNT; column++) {
+        uint8_t info[COLUMN_INFO_SIZE] = {};
+        const char* name = "session";
+        const char* unit = "";
+        double scale = 1.0;
+
+        if(column > 0) {
+            const flight_log_field_info_t* field = flightLogFieldInfo(column - 1);
+            name = field->column;
+            unit = field->unit;
+            scale = field->scale;
+        }
+
+        strncpy((char*)info, name, COLUMN_NAME_SIZE - 1);
+        strncpy((char*)info + COLUMN_NAME_SIZE, unit, COLUMN_UNIT_SIZE - 1);
+        memcpy(info + COLUMN_NAME_SIZE + COLUMN_UNIT_SIZE, &scale, sizeof(scale));
+        fwrite(info, 1, sizeof(info), f);
+    }
+
+    // transpose the rows of every chunk into its place in the columns
+    std::vector<int32_t> columns((size_t)COLUMN_COUNT * log->rows);
+    std::vector<std::thread> workers;
+    size_t row = 0;
+
+    for(size_t c = 0; c < log->chunks.size(); c++) {
+        const int32_t* rows = log->chunks[c].rows.data();
+        size_t count = log->rows_used[c];
+        int32_t* out = columns.data();
+        size_t total = log->rows;
+
+        workers.push_back(std::thread([=]() {
+            for(size_t r = 0; r < count; r++) {
+                for(uint8_t column = 0; column < COLUMN_COUNT; column++) {
+                    out[column * total + row + r] = rows[r * COLUMN_COUNT + column];
+                }
+            }
+        }));
+        row += count;
+
+        if(workers.size() >= threads) {
+            for(size_t i = 0; i < workers.size(); i++) {
+                workers[i].join();
+            }
+            workers.clear();
+        }
+    }
+    for(size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    // stored little-endian, as on every host this is built for
+    fwrite(columns.data(), sizeof(int32_t), columns.size(), f);
+
+    bool ok = ferror(f) == 0;
+    ok = fclose(f) == 0 && ok;
+    if(!ok) {
+        fprintf(stderr, "could not write %s\n", path);
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    unsigned threads = std::thread::hardware_concurrency();
+    const char* index_file = NULL;
+    int arg = 1;
+
+    while(arg + 1 < argc && argv[arg][0] == '-') {
+        if(strcmp(argv[arg], "-j") == 0) {
+            threads = atoi(argv[arg + 1]);
+        } else if(strcmp(argv[arg], "-i") == 0) {
+            index_file = argv[arg + 1];
+        } else {
+            break;
+        }
+        arg += 2;
+    }
+
+    if(argc - arg < 2 || argc - arg > 3 || threads == 0) {
+        fprintf(stderr, "usage: %s [-j threads] [-i index file] <log or image> <csv file> [columnar file]\n", argv[0]);
+        return 1;
+    }
+
+    const char* input = argv[arg];
+    const char* csv = argv[arg + 1];
+    const char* columnar = argc - arg == 3 ? argv[arg + 2] : NULL;
+
+    auto start = std::chrono::steady_clock::now();
+
+    int fd = open(input, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "could not open %s\n", input);
+        return 1;
+    }
+
+    size_t size = st.st_size;
+    if(size < FLIGHT_LOG_HEADER_SIZE) {
+        fprintf(stderr, "%s is too small to hold a flight log\n", input);
+        close(fd);
+        return 1;
+    }
+
+    const uint8_t* data = (const uint8_t*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        fprintf(stderr, "could not map %s\n", input);
+        return 1;
+    }
+    madvise((void*)data, size, MADV_WILLNEED);
+
+    flight_log_header_t header;
+    size_t offset = findLog(data, size, &header);
+    if(offset == size) {
+        fprintf(stderr, "no flight log found in %s\n", input);
+        munmap((void*)data, size);
+        return 1;
+    }
+
+    fprintf(stderr, "flight log at %zu: schema version %u, generation %u\n", offset, header.version, header.generation);
+
+    decoded_log_t log = {};
+    log_index_t index = {};
+    const uint8_t* start_of_log = data + offset;
+    size_t log_size = size - offset;
+
+    index.log_offset = offset;
+    index.log_size = FLIGHT_LOG_PAGE_SIZE;
+    index.generation = header.generation;
+
+    printFlights(start_of_log, log_size, &header);
+    decodePagedLog(start_of_log, log_size, &header, threads, &log, index_file != NULL ? &index : NULL);
+
+    bool ok = writeCsv(csv, &log);
+    if(ok && columnar != NULL) {
+        ok = writeColumns(columnar, &log, threads);
+    }
+    if(ok && index_file != NULL) {
+        ok = logIndexWrite(index_file, &index);
+    }
+
+    munmap((void*)data, size);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%zu records in %u pages, %u corrupt pages skipped, %u pages with undecodable frames", log.rows, log.pages, log.bad_pages, log.bad_frames);
+    if(index_file != NULL) {
+        fprintf(stderr, ", %zu index entries, %zu segments, %zu state changes", index.entries.size(), index.segments.size(), index.transitions.size());
+    }
+    fprintf(stderr, ", %u threads, %.3f s\n", threads, elapsed);
+
+    return ok ? 0 : 1;
+}
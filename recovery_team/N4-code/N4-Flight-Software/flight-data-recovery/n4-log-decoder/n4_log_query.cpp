@@ -0,0 +1,270 @@
+/**
+ * @file n4_log_query.cpp
+ * @brief print a slice of a recovered flight log by time or flight state, without decoding the
+ * whole log
+ *
+ * Uses the index n4_log_decoder -i writes (see log_index.h) to find the first page of the
+ * slice with a binary search, then decodes only the pages that hold it. Rows are printed as
+ * CSV in the decoder's format.
+ *
+ * usage: n4_log_query <log or image> <index> <query>
+ *   --time FROM TO [SESSION]     records from FROM to TO ms, in every session or in SESSION
+ *   --state STATE                records in a flight state, e.g. DROGUE_DESCENT
+ *   --around STATE MS            records within MS ms of the first change to a flight state
+ *   --transitions                every flight state change
+ *
+ * e.g.   n4_log_query flight_log.bin flight.idx --around APOGEE 100
+ *
+ * The log must be the file the index was built from. Linux and macOS only. Build from this
+ * directory:
+ * g++ -O2 -std=c++11 -I../../n4-flight-software/lib/flight_log -I../../n4-flight-software/src n4_log_query.cpp log_csv.cpp log_index.cpp ../../n4-flight-software/lib/flight_log/flight_log.cpp ../../n4-flight-software/lib/flight_log/flight_log_codec.cpp ../../n4-flight-software/src/states.cpp -o n4_log_query
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flight_log.h"
+#include "flight_log_codec.h"
+#include "log_csv.h"
+#include "log_index.h"
+#include "states.h"
+
+#define ANY_STATE 0xFF
+
+/**
+ * The log being queried
+ */
+typedef struct {
+    const uint8_t* log;             /*!< the log header */
+    log_index_t index;
+    uint32_t printed;               /*!< rows printed */
+    uint32_t pages;                 /*!< pages decoded */
+} query_t;
+
+/**
+ * @brief parse a flight state name or number
+ * @return ANY_STATE if it is neither
+ */
+static uint8_t parseState(const char* text) {
+    for(uint8_t state = PRE_FLIGHT_GROUND; state <= POST_FLIGHT_GROUND; state++) {
+        if(strcmp(text, flightStateString(state)) == 0) {
+            return state;
+        }
+    }
+
+    char* end;
+    unsigned long state = strtoul(text, &end, 10);
+    return *end == '\0' && end != text && state <= POST_FLIGHT_GROUND ? state : ANY_STATE;
+}
+
+static const char* stateName(uint8_t state) {
+    return state == LOG_INDEX_NO_STATE ? "-" : flightStateString(state);
+}
+
+/**
+ * @brief check that a page still holds what the index says it holds
+ */
+static bool entryMatches(const query_t* q, const log_index_entry_t& entry) {
+    flight_log_page_t page_header;
+    flight_log_codec_t codec;
+    int32_t fields[FLIGHT_LOG_FIELD_COUNT];
+    size_t used;
+
+    const uint8_t* page = q->log + entry.offset;
+    if(flightLogDecodePageHeader(page, q->index.generation, &page_header) != FLIGHT_LOG_OK) {
+        return false;
+    }
+
+    flightLogCodecReset(&codec);
+    if(flightLogDecompress(&codec, page + FLIGHT_LOG_PAGE_HEADER_SIZE, page_header.length, fields, &used) != FLIGHT_LOG_OK) {
+        return false;
+    }
+
+    return q->index.segments[entry.segment].session == page_header.session &&
+           (uint32_t)fields[FIELD_TIMESTAMP] == entry.timestamp_ms &&
+           (uint32_t)fields[FIELD_RECORD_NUMBER] == entry.record_number &&
+           (fields[FIELD_FLAGS] & 0x0F) == entry.state;
+}
+
+/**
+ * @brief print the records of a segment from from_ms to to_ms, in a state or in any state
+ */
+static void printRange(query_t* q, uint16_t segment, uint32_t from_ms, uint32_t to_ms, uint8_t state) {
+    const log_index_segment_t& s = q->index.segments[segment];
+    flight_log_page_t page_header;
+    flight_log_codec_t codec;
+    int32_t fields[FLIGHT_LOG_FIELD_COUNT];
+    char row[LOG_CSV_ROW_SIZE];
+
+    for(size_t e = logIndexFindTime(&q->index, segment, from_ms); e < s.first + s.count; e++) {
+        const log_index_entry_t& entry = q->index.entries[e];
+        if(entry.timestamp_ms > to_ms) {
+            break;
+        }
+
+        const uint8_t* page = q->log + entry.offset;
+        if(flightLogDecodePageHeader(page, q->index.generation, &page_header) != FLIGHT_LOG_OK) {
+            fprintf(stderr, "page at %u no longer passes its CRC check\n", entry.offset);
+            continue;
+        }
+        q->pages++;
+
+        flightLogCodecReset(&codec);
+
+        size_t offset = 0;
+        while(offset < page_header.length) {
+            size_t used;
+            if(flightLogDecompress(&codec, page + FLIGHT_LOG_PAGE_HEADER_SIZE + offset, page_header.length - offset, fields, &used) != FLIGHT_LOG_OK) {
+                break;
+            }
+            offset += used;
+
+            uint32_t timestamp_ms = fields[FIELD_TIMESTAMP];
+            if(timestamp_ms < from_ms || timestamp_ms > to_ms) {
+                continue;
+            }
+            if(state != ANY_STATE && (fields[FIELD_FLAGS] & 0x0F) != state) {
+                continue;
+            }
+
+            fwrite(row, 1, logCsvRow(row, page_header.session, fields), stdout);
+            q->printed++;
+        }
+    }
+}
+
+static void queryTime(query_t* q, uint32_t from_ms, uint32_t to_ms, long session) {
+    for(uint16_t segment = 0; segment < q->index.segments.size(); segment++) {
+        if(session < 0 || q->index.segments[segment].session == session) {
+            printRange(q, segment, from_ms, to_ms, ANY_STATE);
+        }
+    }
+}
+
+static void queryState(query_t* q, uint8_t state) {
+    const std::vector<log_index_transition_t>& transitions = q->index.transitions;
+
+    for(size_t i = 0; i < transitions.size(); i++) {
+        if(transitions[i].to != state) {
+            continue;
+        }
+
+        // until the next change in the same segment
+        uint32_t to_ms = UINT32_MAX;
+        if(i + 1 < transitions.size() && transitions[i + 1].segment == transitions[i].segment) {
+            to_ms = transitions[i + 1].timestamp_ms;
+        }
+
+        printRange(q, transitions[i].segment, transitions[i].timestamp_ms, to_ms, state);
+    }
+}
+
+static bool queryAround(query_t* q, uint8_t state, uint32_t window_ms) {
+    const std::vector<log_index_transition_t>& transitions = q->index.transitions;
+
+    for(size_t i = 0; i < transitions.size(); i++) {
+        if(transitions[i].to == state) {
+            uint32_t t = transitions[i].timestamp_ms;
+            fprintf(stderr, "%s at %u ms, record %u, session %u\n", flightStateString(state), t,
+                    transitions[i].record_number, q->index.segments[transitions[i].segment].session);
+
+            uint32_t to_ms = t + window_ms < t ? UINT32_MAX : t + window_ms;
+            printRange(q, transitions[i].segment, t > window_ms ? t - window_ms : 0, to_ms, ANY_STATE);
+            return true;
+        }
+    }
+
+    fprintf(stderr, "the log never changes to %s\n", flightStateString(state));
+    return false;
+}
+
+static void printTransitions(const query_t* q) {
+    printf("session,record_number,timestamp_ms,from,to\n");
+    for(size_t i = 0; i < q->index.transitions.size(); i++) {
+        const log_index_transition_t& transition = q->index.transitions[i];
+        printf("%u,%u,%u,%s,%s\n", q->index.segments[transition.segment].session, transition.record_number,
+               transition.timestamp_ms, stateName(transition.from), stateName(transition.to));
+    }
+}
+
+static int usage(const char* name) {
+    fprintf(stderr, "usage: %s <log or image> <index> --time FROM TO [SESSION] | --state STATE | --around STATE MS | --transitions\n", name);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 4) {
+        return usage(argv[0]);
+    }
+
+    query_t q = {};
+    if(!logIndexRead(argv[2], &q.index)) {
+        return 1;
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    // the index must have been built from this log, and the log must not have been erased since
+    size_t size = st.st_size;
+    flight_log_header_t header;
+    if(size < (size_t)q.index.log_offset + q.index.log_size) {
+        fprintf(stderr, "%s is shorter than the log the index was built from\n", argv[1]);
+        close(fd);
+        return 1;
+    }
+
+    const uint8_t* data = (const uint8_t*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        fprintf(stderr, "could not map %s\n", argv[1]);
+        return 1;
+    }
+
+    q.log = data + q.index.log_offset;
+    bool matches = flightLogDecodeHeader(q.log, &header) == FLIGHT_LOG_OK && header.generation == q.index.generation;
+    if(matches && !q.index.entries.empty()) {
+        matches = entryMatches(&q, q.index.entries.front()) && entryMatches(&q, q.index.entries.back());
+    }
+    if(!matches) {
+        fprintf(stderr, "%s was not built from %s - decode the log again with -i\n", argv[2], argv[1]);
+        munmap((void*)data, size);
+        return 1;
+    }
+
+    const char* query = argv[3];
+    int args = argc - 4;
+    bool ok = true;
+
+    if(strcmp(query, "--transitions") == 0 && args == 0) {
+        printTransitions(&q);
+    } else if(strcmp(query, "--time") == 0 && (args == 2 || args == 3)) {
+        fputs(LOG_CSV_HEADER, stdout);
+        queryTime(&q, strtoul(argv[4], NULL, 10), strtoul(argv[5], NULL, 10), args == 3 ? atol(argv[6]) : -1);
+    } else if(strcmp(query, "--state") == 0 && args == 1 && parseState(argv[4]) != ANY_STATE) {
+        fputs(LOG_CSV_HEADER, stdout);
+        queryState(&q, parseState(argv[4]));
+    } else if(strcmp(query, "--around") == 0 && args == 2 && parseState(argv[4]) != ANY_STATE) {
+        fputs(LOG_CSV_HEADER, stdout);
+        ok = queryAround(&q, parseState(argv[4]), strtoul(argv[5], NULL, 10));
+    } else {
+        munmap((void*)data, size);
+        return usage(argv[0]);
+    }
+
+    if(strcmp(query, "--transitions") != 0) {
+        fprintf(stderr, "%u records from %u of %zu pages\n", q.printed, q.pages, q.index.entries.size());
+    }
+
+    munmap((void*)data, size);
+    return ok ? 0 : 1;
+}
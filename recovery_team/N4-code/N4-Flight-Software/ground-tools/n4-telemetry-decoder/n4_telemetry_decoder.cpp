@@ -0,0 +1,201 @@
+/**
+ * @file n4_telemetry_decoder.cpp
+ * @brief ground side of the binary telemetry, see telemetry_frame.h and telemetry_delta.h
+ *
+ * Reads MQTT telemetry messages as hex, one message per line - the output of
+ * mosquitto_sub -F %x - and prints the samples of every binary frame as CSV in the log
+ * decoder's format, so telemetry and recovered flight logs compare row by row. Frames carry
+ * no logging session, so the session column is 0. Messages that are not frames, such as CSV
+ * telemetry rows, are counted and skipped.
+ *
+ * Delta frames are decoded in the order received. Samples lost on the way are counted, and
+ * the samples after a loss are dropped up to the next keyframe.
+ *
+ * With --xbee, stdin is the raw byte stream of the ground XBee in escaped API mode (AP=2),
+ * see xbee_frame.h. Frames with a bad checksum are dropped, and the flight events, which
+ * arrive as text, are printed to stderr.
+ *
+ * usage: n4_telemetry_decoder [--xbee] [csv file]
+ * e.g.   mosquitto_sub -h <broker> -t n4/flight-computer-1 -F %x | n4_telemetry_decoder telemetry.csv
+ *        stty -F /dev/ttyUSB0 9600 raw && n4_telemetry_decoder --xbee telemetry.csv < /dev/ttyUSB0
+ *
+ * Build from this directory:
+ * g++ -O2 -std=c++11 -I../../n4-flight-software/lib/flight_log -I../../n4-flight-software/lib/telemetry -I../../n4-flight-software/lib/xbee -I../../flight-data-recovery/n4-log-decoder n4_telemetry_decoder.cpp ../../flight-data-recovery/n4-log-decoder/log_csv.cpp ../../n4-flight-software/lib/flight_log/flight_log.cpp ../../n4-flight-software/lib/flight_log/flight_log_codec.cpp ../../n4-flight-software/lib/telemetry/telemetry_frame.cpp ../../n4-flight-software/lib/telemetry/telemetry_delta.cpp ../../n4-flight-software/lib/xbee/xbee_frame.cpp -o n4_telemetry_decoder
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "flight_log.h"
+#include "telemetry_frame.h"
+#include "telemetry_delta.h"
+#include "xbee_frame.h"
+#include "log_csv.h"
+
+#define LINE_SIZE (2 * TELEMETRY_FRAME_SIZE(TELEMETRY_FRAME_MAX_SAMPLES) + 2)    /*!< hex of the longest frame, newline and NUL */
+
+/**
+ * Counts printed at the end
+ */
+typedef struct {
+    uint32_t messages;
+    uint32_t frames;
+    uint32_t samples;
+    uint32_t not_frames;            /*!< CSV rows and other text */
+    uint32_t bad_frames;            /*!< unknown version or schema, or truncated */
+    uint64_t frame_bytes;
+} decoder_stats_t;
+
+static int hexDigit(char c) {
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    } else if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief convert one line of hex to bytes, stopping at the first character that is not a
+ * hex digit
+ * @return bytes converted
+ */
+static size_t parseHex(const char* line, uint8_t* out, size_t size) {
+    size_t len = 0;
+    while(len < size) {
+        int high = hexDigit(line[2 * len]);
+        int low = high < 0 ? -1 : hexDigit(line[2 * len + 1]);
+        if(low < 0) {
+            break;
+        }
+        out[len++] = (high << 4) | low;
+    }
+    return len;
+}
+
+static const char* statusString(TELEMETRY_STATUS status) {
+    switch(status) {
+        case TELEMETRY_UNSUPPORTED_VERSION: return "unsupported frame version";
+        case TELEMETRY_UNKNOWN_SCHEMA: return "unknown schema";
+        case TELEMETRY_TRUNCATED: return "truncated";
+        case TELEMETRY_CORRUPT: return "corrupt sample";
+        default: return "not a frame";
+    }
+}
+
+/**
+ * @brief decode one message and print its samples
+ * @return TELEMETRY_BAD_MAGIC if the message is not a frame
+ */
+static TELEMETRY_STATUS decodeMessage(const uint8_t* message, size_t len, FILE* out, decoder_stats_t* stats, telemetry_delta_decoder_t* delta) {
+    static int32_t fields[TELEMETRY_FRAME_MAX_SAMPLES][FLIGHT_LOG_FIELD_COUNT];
+    uint16_t sequences[TELEMETRY_FRAME_MAX_SAMPLES];
+    char row[LOG_CSV_ROW_SIZE];
+
+    stats->messages++;
+
+    telemetry_frame_t frame;
+    TELEMETRY_STATUS status = telemetryFrameDecode(message, len, &frame);
+    if(status == TELEMETRY_BAD_MAGIC) {
+        stats->not_frames++;
+        return status;
+    } else if(status != TELEMETRY_OK) {
+        fprintf(stderr, "message %u: %s\n", stats->messages, statusString(status));
+        stats->bad_frames++;
+        return status;
+    }
+
+    stats->frames++;
+    stats->frame_bytes += len;
+
+    uint8_t decoded = frame.count;
+    if(frame.schema == TELEMETRY_SCHEMA_DELTA) {
+        status = telemetryDeltaDecode(delta, &frame, fields, sequences, &decoded);
+        if(status != TELEMETRY_OK) {
+            fprintf(stderr, "message %u: %s\n", stats->messages, statusString(status));
+            stats->bad_frames++;
+        }
+    } else {
+        for(uint8_t i = 0; i < frame.count; i++) {
+            telemetryFrameSample(&frame, i, fields[i]);
+        }
+    }
+
+    for(uint8_t i = 0; i < decoded; i++) {
+        fwrite(row, 1, logCsvRow(row, 0, fields[i]), out);
+        stats->samples++;
+    }
+    fflush(out);
+
+    return status;
+}
+
+int main(int argc, char** argv) {
+    bool xbee = argc > 1 && strcmp(argv[1], "--xbee") == 0;
+    if(argc > 2 + xbee) {
+        fprintf(stderr, "usage: %s [--xbee] [csv file] - reads hex messages, or with --xbee the XBee API stream, from stdin\n", argv[0]);
+        return 1;
+    }
+
+    const char* path = argc == 2 + xbee ? argv[1 + xbee] : NULL;
+    FILE* out = path ? fopen(path, "w") : stdout;
+    if(out == NULL) {
+        fprintf(stderr, "could not create %s\n", path);
+        return 1;
+    }
+    fputs(LOG_CSV_HEADER, out);
+
+    decoder_stats_t stats = {};
+    telemetry_delta_decoder_t delta;
+    telemetryDeltaDecoderInit(&delta);
+
+    if(xbee) {
+        static xbee_parser_t parser;
+        xbeeParserInit(&parser);
+
+        int c;
+        while((c = getchar()) != EOF) {
+            XBEE_PARSE result = xbeeParse(&parser, c);
+            const uint8_t* data;
+            size_t len;
+
+            if(result == XBEE_PARSE_BAD_CHECKSUM || result == XBEE_PARSE_TOO_LONG) {
+                fprintf(stderr, "XBee frame dropped: %s\n", result == XBEE_PARSE_TOO_LONG ? "too long" : "bad checksum");
+            } else if(result == XBEE_PARSE_FRAME && xbeeFrameRfData(parser.data, parser.length, &data, &len)) {
+                // flight events arrive as text
+                if(decodeMessage(data, len, out, &stats, &delta) == TELEMETRY_BAD_MAGIC) {
+                    fprintf(stderr, "event: %.*s\n", (int)len, (const char*)data);
+                }
+            }
+        }
+
+        fprintf(stderr, "XBee: %u frames, %u bad checksum, %u too long, %u bytes outside frames\n",
+                parser.stats.frames, parser.stats.bad_checksum, parser.stats.too_long, parser.stats.discarded);
+    } else {
+        char line[LINE_SIZE];
+        uint8_t message[LINE_SIZE / 2];
+
+        while(fgets(line, sizeof(line), stdin) != NULL) {
+            size_t len = parseHex(line, message, sizeof(message));
+            if(len > 0) {
+                decodeMessage(message, len, out, &stats, &delta);
+            }
+        }
+    }
+
+    fprintf(stderr, "%u messages: %u frames with %u samples, %.1f bytes per sample, %u not frames, %u bad frames\n",
+            stats.messages, stats.frames, stats.samples, stats.samples ? (double)stats.frame_bytes / stats.samples : 0.0,
+            stats.not_frames, stats.bad_frames);
+    if(delta.stats.frames) {
+        fprintf(stderr, "delta: %u frames, %u keyframes, %u samples lost, %u dropped waiting for a keyframe, %u resyncs\n",
+                delta.stats.frames, delta.stats.keyframes, delta.stats.lost, delta.stats.skipped, delta.stats.resyncs);
+    }
+
+    if(out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
@@ -22,6 +22,7 @@
 #define DEBUGGING 1                           /*!< allow debugging to terminal. Set to 0 pre flight to disable serial terminal printing and improve speed  */
 #define LOG_TO_MEMORY 0                      /*!< allow data logging to memory. Set to 1 to log data to external flash memory. Must be set during flight */
 #define DEBUG_TO_TERMINAL 1                 /*!< allow create task that prints data to terminal. Set to 0 before flight  */
+#define LOG_TO_SD 0                         /*!< also write the flash log pages to the SD card. Needs LOG_TO_MEMORY */
 
 #if DEBUGGING
     #define debug(x) Serial.print(x)
@@ -33,6 +34,11 @@
     #define debugf(x, y)
 #endif // DEBUG
 
+/* profiling parameters */
+#define PROFILE_TASKS 1                     /*!< set to 1 to collect per-task CPU load, loop time and stack headroom */
+#define PROFILER_REPORT_INTERVAL 5000       /*!< time in ms between periodic profiler reports. A report is also sent on every flight state change */
+#define TIMING_PROBES 1                     /*!< set to 1 to collect hot path latency histograms. Set to 0 to compile all timing probes out */
+
 /* end of debug parameters */
 
 /* MPU config parameters */
@@ -74,10 +80,86 @@
 #define FLIGHT_STATES_QUEUE_LENGTH 1        /*!< length of the flight states queue */
 #define CONSUME_TASK_DELAY    10
 
+/* flash data logging */
+#define LOGGER_PAGE_SIZE 256                /*!< SPI flash program page size */
+#define LOGGER_PAGE_BUFFERS 4               /*!< page buffers between the log task and the flash writer task */
+#define LOGGER_PAGE_STALL_US 3000           /*!< page programs slower than this are counted as stalls - datasheet worst case page program time */
+#define LOGGER_FLUSH_TIMEOUT 1000           /*!< time in ms without new samples after which the partially filled page is written out */
+#define LOGGER_SERVICE_INTERVAL 100         /*!< time in ms between log maintenance runs when no page is waiting */
+#define LOGGER_ERASE_AHEAD_BLOCKS 2         /*!< erase blocks kept erased ahead of the write position in flight */
+#define LOGGER_ERASE_AHEAD_GROUND_BLOCKS 8  /*!< erase blocks kept erased ahead of the write position on the pad */
+#define LOG_INTERVAL_GROUND 100             /*!< time in ms between logged samples on the ground, see log_policy.h */
+#define LOG_INTERVAL_DESCENT 20             /*!< time in ms between logged samples under parachute */
+#define LOGGER_HISTORY_SAMPLES 300          /*!< samples kept in RAM on the pad and logged at full rate on launch - 3s at the task IMU rate. 0 to disable */
+#define LOGGER_HISTORY_FLUSH_WAIT 20        /*!< time in ms to wait for a free page buffer while logging the history */
+
+/* SD card data logging - a copy of the flash log, see sd_logger.h */
+#define SD_LOG_FILE_SIZE (16UL * 1024 * 1024)   /*!< bytes preallocated for the log file at boot */
+#define SD_BUFFER_PAGES 64                  /*!< log pages queued between the flash writer and the SD writer task. Power of 2 */
+#define SD_WRITE_PAGES 32                   /*!< log pages written to the card in one block write - 8KB */
+#define SD_FLUSH_TIMEOUT 1000               /*!< time in ms after which fewer than SD_WRITE_PAGES pages are written out and the file is flushed */
+#define SD_WRITE_SLOW_US 20000              /*!< block writes slower than this are counted as slow */
+#define SD_SERVICE_INTERVAL 50              /*!< time in ms between SD writer task runs */
+
+/* event logging - see system_logger.h */
+#define EVENT_LOG_QUEUE_LENGTH 64           /*!< event messages queued in RAM for the event log task. Power of 2 */
+#define EVENT_LOG_LINE_SIZE 128             /*!< longest formatted event log line, longer messages are truncated */
+#define EVENT_LOG_SERVICE_INTERVAL 100      /*!< time in ms between event log task runs */
+#define EVENT_LOG_FLUSH_INTERVAL 1000       /*!< time in ms between event log file flushes */
+#define TRACING 1                           /*!< set to 1 to record binary trace events, see trace.h. Set to 0 to compile every TRACE() out */
+#define TRACE_MIN_LEVEL 1                   /*!< LOG_LEVEL below which TRACE() compiles to nothing - 1 is INFO */
+#define TRACE_QUEUE_LENGTH 64               /*!< trace events queued in RAM for the event log task. Power of 2 */
+#define TRACE_BATCH_SIZE 256                /*!< bytes of trace records written to the file at once */
+
+/* cyclic executive */
+#define CYCLIC_EXECUTIVE 0                  /*!< set to 1 to run IMU, barometer, filter, state machine and pyro check from one timer driven task */
+#define CYCLIC_FRAME_RATE 200               /*!< cyclic executive frames per second. The 5ms frame must hold the worst case IMU burst read, about 1.6ms of bus time at 100kHz I2C - see PROBE_IMU_READ */
+#define CYCLIC_IMU_DIVIDER 2                /*!< read the IMU every n frames - 100Hz at the default frame rate */
+#define CYCLIC_TIMER_ID 0                   /*!< hardware timer that releases the frames */
+#define CYCLIC_EXECUTIVE_PRIORITY 5         /*!< must be above the other flight tasks */
+
+/* telemetry encoding - see telemetry_frame.h */
+#define TELEMETRY_ENCODING_CSV 0            /*!< one CSV text row per sample */
+#define TELEMETRY_ENCODING_BINARY 1         /*!< one binary telemetry frame per sample */
+#define TELEMETRY_ENCODING_DELTA 2          /*!< delta compressed binary frames, see telemetry_delta.h */
+#define TELEMETRY_ENCODING TELEMETRY_ENCODING_CSV   /*!< encoding at boot. Switched at run time with the TELEMETRY_CSV, TELEMETRY_BINARY and TELEMETRY_DELTA commands */
+/* TELEMETRY_KEYFRAME_INTERVAL is in telemetry_delta.h, so that the host tests use the flight value */
+
+/* telemetry batching - see telemetry_batch.h */
+/* TELEMETRY_BATCH_SAMPLES and TELEMETRY_BATCH_MS are in telemetry_batch.h, so that the host tests use the flight values */
+#define MQTT_BUFFER_SIZE 1024               /*!< PubSubClient packet buffer. Bounds the batch size - 20 binary samples or 8 CSV rows */
+#define TELEMETRY_SUMMARY_INTERVAL 500      /*!< time in ms between samples sent on the summary topic. 0 turns the summary off */
+
+/* MQTT publisher - see mqtt_publisher.h */
+#define MQTT_TELEMETRY_SIZE (MQTT_BUFFER_SIZE - 7 - sizeof(MQTT_TELEMETRY_TOPIC))  /*!< largest telemetry message - the client buffer less the MQTT header and topic */
+#define MQTT_TELEMETRY_QUEUE_LENGTH 8       /*!< telemetry messages queued for the MQTT publisher task. Power of 2 */
+#define MQTT_TELEMETRY_MAX_AGE 2000         /*!< time in ms after which queued telemetry is dropped instead of sent */
+#define MQTT_EVENT_SIZE 64                  /*!< longest flight event message, longer ones are truncated */
+#define MQTT_EVENT_QUEUE_LENGTH 16          /*!< flight events queued for the MQTT publisher task. Power of 2 */
+#define MQTT_EVENT_RETAINED 1               /*!< publish flight events retained, so that a ground station that connects late sees the last one */
+#define MQTT_SUMMARY_SIZE 256               /*!< longest summary message - one CSV row, or a diagnostics line */
+#define MQTT_SUMMARY_QUEUE_LENGTH 32        /*!< summary and diagnostics messages queued for the MQTT publisher task. Holds a full profiler report. Power of 2 */
+#define MQTT_BACKOFF_MIN 500                /*!< time in ms before the first reconnect attempt, doubled after every failure */
+#define MQTT_BACKOFF_MAX 30000              /*!< longest time in ms between reconnect attempts */
+#define MQTT_SERVICE_INTERVAL 10            /*!< longest time in ms between MQTT publisher task runs */
+#define MQTT_PUBLISH_BURST 4                /*!< telemetry messages published per run, so that client.loop() runs often */
+
+/* XBee downlink - see xbee_link.h. The modules run in escaped API mode, AP=2 */
+#define XBEE_TX_PIN 32                      /*!< ESP32 pin wired to the XBee DIN, in place of the flash LED - see pin_assignment.MD */
+#define XBEE_RX_PIN 34                      /*!< ESP32 pin wired to the XBee DOUT */
+#define XBEE_TX_BUFFER_SIZE 2048            /*!< UART driver TX ring. Frames that do not fit are dropped - about 2s of data at 9600 baud */
+#define XBEE_RX_BUFFER_SIZE 256             /*!< UART driver RX ring - must be above the 128 byte hardware FIFO */
+#define XBEE_PAYLOAD_SIZE 256               /*!< largest RF payload - the module NP setting, 256 on the XBee-PRO 900HP. Bounds the XBee telemetry batch */
+#define XBEE_SAMPLE_DIVIDER 4               /*!< send one telemetry sample in n over the XBee, and every state change. 4 loads 9600 baud to about 40% at 100 samples/s, see test/xbee-loopback-test */
+#define XBEE_DESTINATION 0x000000000000FFFFULL  /*!< 64 bit address of the ground XBee. 0xFFFF broadcasts */
+
 /* MQTT constants */
 const char MQTT_SERVER[30] = "65.108.85.88";
 const char MQTT_TELEMETRY_TOPIC[30] = "n4/flight-computer-1";             /* make this topic unique to every rocket */
 const char MQTT_ARMING_TOPIC[30] = "n4/commands";             /* make this topic unique to every rocket */
+const char MQTT_DIAGNOSTICS_TOPIC[30] = "n4/flight-computer-1/diag";  /* profiler and other diagnostics reports */
+const char MQTT_EVENTS_TOPIC[32] = "n4/flight-computer-1/events";   /* state changes, arming and deployments */
+const char MQTT_SUMMARY_TOPIC[32] = "n4/flight-computer-1/summary"; /* one sample every TELEMETRY_SUMMARY_INTERVAL ms */
 
 
 
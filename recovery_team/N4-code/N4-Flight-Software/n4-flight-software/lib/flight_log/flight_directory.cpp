@@ -0,0 +1,105 @@
+/**
+ * @file flight_directory.cpp
+ * @brief Encode and decode the flight directory slots
+ */
+
+#include <string.h>
+#include "flight_directory.h"
+#include "flight_log_le.h"
+
+/**
+ * @brief CRC of the bytes of a half before its CRC, with the generation folded in
+ */
+static uint16_t halfCrc(const uint8_t* half, uint32_t generation) {
+    return flightLogCrc16(half, FLIGHT_DIRECTORY_HALF_SIZE - 2, 0xFFFF) ^ (uint16_t)generation;
+}
+
+static bool halfErased(const uint8_t* half) {
+    for(uint8_t i = 0; i < FLIGHT_DIRECTORY_HALF_SIZE; i++) {
+        if(half[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief fill in the open half of a slot
+ * @param slot FLIGHT_DIRECTORY_HALF_SIZE bytes, programmed at flightDirectorySlotOffset()
+ * @return number of bytes written
+ */
+size_t flightDirectoryEncodeOpen(const flight_entry_t* entry, uint32_t generation, uint8_t* slot) {
+    uint8_t* p = slot;
+    *p++ = FLIGHT_DIRECTORY_TAG;
+    *p++ = entry->config;
+    p = put16(p, entry->flight);
+    p = put16(p, entry->session);
+    p = put32(p, entry->first_page);
+    p = put32(p, entry->start_ms);
+    put16(p, halfCrc(slot, generation));
+
+    return FLIGHT_DIRECTORY_HALF_SIZE;
+}
+
+/**
+ * @brief fill in the close half of a slot
+ * @param half FLIGHT_DIRECTORY_HALF_SIZE bytes, programmed FLIGHT_DIRECTORY_HALF_SIZE bytes
+ * after the start of the slot
+ * @return number of bytes written
+ */
+size_t flightDirectoryEncodeClose(const flight_entry_t* entry, uint32_t generation, uint8_t* half) {
+    uint8_t* p = half;
+    *p++ = entry->state;
+    *p++ = entry->resets;
+    p = put32(p, entry->end_page);
+    p = put32(p, entry->records);
+    p = put32(p, entry->end_ms);
+    put16(p, halfCrc(half, generation));
+
+    return FLIGHT_DIRECTORY_HALF_SIZE;
+}
+
+/**
+ * @brief read one slot
+ * A close half that fails its CRC - torn by a reset while it was programmed - leaves the
+ * flight open
+ * @param slot FLIGHT_DIRECTORY_SLOT_SIZE bytes
+ * @param generation log generation from the log header
+ * @param entry decoded slot
+ * @return FLIGHT_LOG_ERASED for a free slot, FLIGHT_LOG_CORRUPT if the open half fails its CRC
+ */
+FLIGHT_LOG_STATUS flightDirectoryDecode(const uint8_t* slot, uint32_t generation, flight_entry_t* entry) {
+    const uint8_t* close = slot + FLIGHT_DIRECTORY_HALF_SIZE;
+
+    memset(entry, 0, sizeof(*entry));
+
+    if(halfErased(slot)) {
+        return FLIGHT_LOG_ERASED;
+    } else if(slot[0] != FLIGHT_DIRECTORY_TAG || get16(slot + 14) != halfCrc(slot, generation)) {
+        return FLIGHT_LOG_CORRUPT;
+    }
+
+    entry->config = slot[1];
+    entry->flight = get16(slot + 2);
+    entry->session = get16(slot + 4);
+    entry->first_page = get32(slot + 6);
+    entry->start_ms = get32(slot + 10);
+
+    if(!halfErased(close) && get16(close + 14) == halfCrc(close, generation)) {
+        entry->closed = true;
+        entry->state = close[0];
+        entry->resets = close[1];
+        entry->end_page = get32(close + 2);
+        entry->records = get32(close + 6);
+        entry->end_ms = get32(close + 10);
+    }
+
+    return FLIGHT_LOG_OK;
+}
+
+/**
+ * @brief byte offset of a slot from the start of the log
+ */
+uint32_t flightDirectorySlotOffset(uint16_t slot) {
+    return FLIGHT_LOG_PAGE_SIZE + (uint32_t)slot * FLIGHT_DIRECTORY_SLOT_SIZE;
+}
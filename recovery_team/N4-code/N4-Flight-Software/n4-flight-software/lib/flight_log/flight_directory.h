@@ -0,0 +1,84 @@
+/**
+ * @file flight_directory.h
+ * @brief Flight directory of the flight log, shared by the flight software and the
+ * data recovery tools
+ *
+ * The log keeps every flight until the ground erases it. The directory takes the
+ * FLIGHT_LOG_DIRECTORY_PAGES pages after the header page and holds one FLIGHT_DIRECTORY_SLOT_SIZE
+ * slot per flight, filled in order. It is read in one go at boot, so the current flight is
+ * found without scanning the log. A flight holds the log pages from its first page up to
+ * the first page of the next flight, or the end of the log.
+ *
+ * Flash bits can only be programmed from 1 to 0 without an erase, so a slot is written in
+ * two halves that each start out erased:
+ *
+ * open - written with the first page of the flight:
+ *
+ * | field      | type   |                                                  |
+ * |------------|--------|--------------------------------------------------|
+ * | tag        | uint8  | FLIGHT_DIRECTORY_TAG, 0xFF if the slot is free   |
+ * | config     | uint8  | FLIGHT_CONFIG bits of the software that flew     |
+ * | flight     | uint16 | flight number since the log was last erased      |
+ * | session    | uint16 | logging session the flight started in            |
+ * | first page | uint32 | first log page of the flight                     |
+ * | start      | uint32 | ms since boot when the flight was opened         |
+ * | crc        | uint16 | CRC-16/CCITT of the bytes above                  |
+ *
+ * close - written when the flight reaches POST_FLIGHT_GROUND, erased if it never did:
+ *
+ * | field      | type   |                                                  |
+ * |------------|--------|--------------------------------------------------|
+ * | state      | uint8  | flight state when it was closed                  |
+ * | resets     | uint8  | times logging resumed after a reset in the air   |
+ * | end page   | uint32 | first log page after the flight when it closed   |
+ * | records    | uint32 | records logged in the flight, across resets      |
+ * | end        | uint32 | ms since boot when the flight was closed         |
+ * | crc        | uint16 | CRC-16/CCITT of the bytes above                  |
+ *
+ * Both CRCs have the low 16 bits of the log generation XORed in, like the page CRCs.
+ * Every value is little-endian.
+ */
+
+#ifndef FLIGHT_DIRECTORY_H
+#define FLIGHT_DIRECTORY_H
+
+#include "flight_log.h"
+
+#define FLIGHT_LOG_DIRECTORY_PAGES 16           /*!< pages reserved for the directory in a new log */
+#define FLIGHT_DIRECTORY_SLOT_SIZE 32           /*!< bytes per flight */
+#define FLIGHT_DIRECTORY_HALF_SIZE 16           /*!< bytes in the open and in the close half of a slot */
+#define FLIGHT_DIRECTORY_SLOTS_PER_PAGE (FLIGHT_LOG_PAGE_SIZE / FLIGHT_DIRECTORY_SLOT_SIZE)
+#define FLIGHT_DIRECTORY_TAG 0x46               /*!< "F" - first byte of a used slot */
+
+/**
+ * FLIGHT_CONFIG bits - the logging options of the software that opened the flight
+ */
+#define FLIGHT_CONFIG_HISTORY 0x01              /*!< pre-launch history logged on launch detection */
+#define FLIGHT_CONFIG_SD 0x02                   /*!< pages mirrored to the SD card */
+#define FLIGHT_CONFIG_TRACING 0x04              /*!< event trace written to SPIFFS */
+
+static_assert(FLIGHT_LOG_PAGE_SIZE % FLIGHT_DIRECTORY_SLOT_SIZE == 0, "directory slots must not cross pages");
+
+/**
+ * One directory slot
+ */
+typedef struct {
+    uint8_t config;                 /*!< FLIGHT_CONFIG bits */
+    uint16_t flight;                /*!< flight number since the log was last erased */
+    uint16_t session;               /*!< logging session the flight started in */
+    uint32_t first_page;            /*!< first log page of the flight */
+    uint32_t start_ms;              /*!< ms since boot when the flight was opened */
+    bool closed;                    /*!< false until the flight reached POST_FLIGHT_GROUND - the fields below are 0 */
+    uint8_t state;                  /*!< flight state when the flight was closed */
+    uint8_t resets;                 /*!< times logging resumed after a reset in the air */
+    uint32_t end_page;              /*!< first log page after the flight when it was closed */
+    uint32_t records;               /*!< records logged in the flight, across resets */
+    uint32_t end_ms;                /*!< ms since boot when the flight was closed */
+} flight_entry_t;
+
+size_t flightDirectoryEncodeOpen(const flight_entry_t* entry, uint32_t generation, uint8_t* slot);
+size_t flightDirectoryEncodeClose(const flight_entry_t* entry, uint32_t generation, uint8_t* half);
+FLIGHT_LOG_STATUS flightDirectoryDecode(const uint8_t* slot, uint32_t generation, flight_entry_t* entry);
+uint32_t flightDirectorySlotOffset(uint16_t slot);
+
+#endif // FLIGHT_DIRECTORY_H
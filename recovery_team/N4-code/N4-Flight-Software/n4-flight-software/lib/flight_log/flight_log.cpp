@@ -0,0 +1,269 @@
+/**
+ * @file flight_log.cpp
+ * @brief Encode and decode the on-flash flight records
+ */
+
+#include "flight_log.h"
+#include "flight_log_le.h"
+
+/**
+ * @brief round to the nearest integer and clamp to the range of the field
+ * NaN is stored as 0
+ */
+static int32_t scaleClamp(double value, double scale, int32_t min, int32_t max) {
+    double scaled = value * scale;
+
+    if(!(scaled == scaled)) {
+        return 0;
+    } else if(scaled >= max) {
+        return max;
+    } else if(scaled <= min) {
+        return min;
+    }
+
+    return (int32_t)(scaled >= 0 ? scaled + 0.5 : scaled - 0.5);
+}
+
+/**
+ * @brief write the log header
+ * @param buffer at least FLIGHT_LOG_HEADER_SIZE bytes
+ * @param generation times the log has been erased
+ * @param directory_pages pages in the flight directory after the header page
+ * @return number of bytes written
+ */
+size_t flightLogEncodeHeader(uint8_t* buffer, uint32_t generation, uint16_t directory_pages) {
+    uint8_t* p = put32(buffer, FLIGHT_LOG_MAGIC);
+    *p++ = FLIGHT_LOG_SCHEMA_VERSION;
+    *p++ = FLIGHT_LOG_HEADER_SIZE;
+    p = put16(p, FLIGHT_LOG_RECORD_SIZE);
+    p = put32(p, generation);
+    p = put16(p, directory_pages);
+    put16(p, 0);
+
+    return FLIGHT_LOG_HEADER_SIZE;
+}
+
+/**
+ * @brief read and check the log header
+ * @param buffer FLIGHT_LOG_HEADER_SIZE bytes from the start of the log
+ * @param header decoded header
+ */
+FLIGHT_LOG_STATUS flightLogDecodeHeader(const uint8_t* buffer, flight_log_header_t* header) {
+    header->magic = get32(buffer);
+    header->version = buffer[4];
+    header->header_size = buffer[5];
+    header->record_size = get16(buffer + 6);
+    header->generation = get32(buffer + 8);
+    header->directory_pages = get16(buffer + 12);
+
+    if(header->magic == 0xFFFFFFFFUL) {
+        return FLIGHT_LOG_ERASED;
+    } else if(header->magic != FLIGHT_LOG_MAGIC) {
+        return FLIGHT_LOG_BAD_MAGIC;
+    } else if(header->version != FLIGHT_LOG_SCHEMA_VERSION || header->header_size != FLIGHT_LOG_HEADER_SIZE ||
+              header->record_size != FLIGHT_LOG_RECORD_SIZE) {
+        return FLIGHT_LOG_UNSUPPORTED_VERSION;
+    }
+
+    return FLIGHT_LOG_OK;
+}
+
+/**
+ * @brief the first log page - the one after the header page and the flight directory
+ */
+uint32_t flightLogFirstPage(const flight_log_header_t* header) {
+    return 1 + header->directory_pages;
+}
+
+/* how each field is stored, in record order */
+static const flight_log_field_info_t field_info[FLIGHT_LOG_FIELD_COUNT] = {
+    #define FLIGHT_LOG_FIELD(name, bytes, is_signed, scale, column, unit) {column, unit, bytes, is_signed, scale},
+    #include "flight_log_fields.def"
+    #undef FLIGHT_LOG_FIELD
+};
+
+/**
+ * @brief how a field is stored
+ * @param field FLIGHT_LOG_FIELD
+ * @return NULL if there is no such field
+ */
+const flight_log_field_info_t* flightLogFieldInfo(uint8_t field) {
+    return field < FLIGHT_LOG_FIELD_COUNT ? &field_info[field] : NULL;
+}
+
+/**
+ * @brief convert a sample to the scaled integers stored in the record
+ * @param sample sample to convert
+ * @param fields FLIGHT_LOG_FIELD_COUNT values, in record order
+ */
+void flightLogToFields(const flight_log_sample_t* sample, int32_t* fields) {
+    fields[FIELD_TIMESTAMP] = sample->timestamp_ms;
+    fields[FIELD_RECORD_NUMBER] = sample->record_number;
+    fields[FIELD_FLAGS] = (sample->state & 0x0F) | ((sample->operation_mode & 0x01) << 4) | ((sample->log_policy & 0x07) << 5);
+
+    fields[FIELD_AX] = scaleClamp(sample->ax, FLIGHT_LOG_ACCEL_SCALE, INT16_MIN, INT16_MAX);
+    fields[FIELD_AY] = scaleClamp(sample->ay, FLIGHT_LOG_ACCEL_SCALE, INT16_MIN, INT16_MAX);
+    fields[FIELD_AZ] = scaleClamp(sample->az, FLIGHT_LOG_ACCEL_SCALE, INT16_MIN, INT16_MAX);
+    fields[FIELD_GX] = scaleClamp(sample->gx, FLIGHT_LOG_GYRO_SCALE, INT16_MIN, INT16_MAX);
+    fields[FIELD_GY] = scaleClamp(sample->gy, FLIGHT_LOG_GYRO_SCALE, INT16_MIN, INT16_MAX);
+    fields[FIELD_GZ] = scaleClamp(sample->gz, FLIGHT_LOG_GYRO_SCALE, INT16_MIN, INT16_MAX);
+    fields[FIELD_PITCH] = scaleClamp(sample->pitch, FLIGHT_LOG_ANGLE_SCALE, INT16_MIN, INT16_MAX);
+    fields[FIELD_ROLL] = scaleClamp(sample->roll, FLIGHT_LOG_ANGLE_SCALE, INT16_MIN, INT16_MAX);
+
+    fields[FIELD_LATITUDE] = scaleClamp(sample->latitude, FLIGHT_LOG_COORDINATE_SCALE, -900000000L, 900000000L);
+    fields[FIELD_LONGITUDE] = scaleClamp(sample->longitude, FLIGHT_LOG_COORDINATE_SCALE, -1800000000L, 1800000000L);
+    fields[FIELD_GPS_ALTITUDE] = sample->gps_altitude;
+
+    // hPa to Pa
+    fields[FIELD_PRESSURE] = scaleClamp(sample->pressure, FLIGHT_LOG_PRESSURE_SCALE, 0, INT32_MAX);
+    fields[FIELD_TEMPERATURE] = scaleClamp(sample->temperature, FLIGHT_LOG_TEMPERATURE_SCALE, INT16_MIN, INT16_MAX);
+    fields[FIELD_REL_ALTITUDE] = scaleClamp(sample->rel_altitude, FLIGHT_LOG_ALTITUDE_SCALE, INT32_MIN, INT32_MAX);
+    fields[FIELD_VELOCITY] = scaleClamp(sample->velocity, FLIGHT_LOG_VELOCITY_SCALE, INT16_MIN, INT16_MAX);
+}
+
+/**
+ * @brief convert the scaled integers stored in a record back to a sample
+ * @param fields FLIGHT_LOG_FIELD_COUNT values, in record order
+ * @param sample decoded sample
+ */
+void flightLogFromFields(const int32_t* fields, flight_log_sample_t* sample) {
+    sample->timestamp_ms = fields[FIELD_TIMESTAMP];
+    sample->record_number = fields[FIELD_RECORD_NUMBER];
+    sample->state = fields[FIELD_FLAGS] & 0x0F;
+    sample->operation_mode = (fields[FIELD_FLAGS] >> 4) & 0x01;
+    sample->log_policy = (fields[FIELD_FLAGS] >> 5) & 0x07;
+
+    sample->ax = fields[FIELD_AX] / FLIGHT_LOG_ACCEL_SCALE;
+    sample->ay = fields[FIELD_AY] / FLIGHT_LOG_ACCEL_SCALE;
+    sample->az = fields[FIELD_AZ] / FLIGHT_LOG_ACCEL_SCALE;
+    sample->gx = fields[FIELD_GX] / FLIGHT_LOG_GYRO_SCALE;
+    sample->gy = fields[FIELD_GY] / FLIGHT_LOG_GYRO_SCALE;
+    sample->gz = fields[FIELD_GZ] / FLIGHT_LOG_GYRO_SCALE;
+    sample->pitch = fields[FIELD_PITCH] / FLIGHT_LOG_ANGLE_SCALE;
+    sample->roll = fields[FIELD_ROLL] / FLIGHT_LOG_ANGLE_SCALE;
+
+    sample->latitude = fields[FIELD_LATITUDE] / FLIGHT_LOG_COORDINATE_SCALE;
+    sample->longitude = fields[FIELD_LONGITUDE] / FLIGHT_LOG_COORDINATE_SCALE;
+    sample->gps_altitude = fields[FIELD_GPS_ALTITUDE];
+
+    sample->pressure = (uint32_t)fields[FIELD_PRESSURE] / FLIGHT_LOG_PRESSURE_SCALE;
+    sample->temperature = fields[FIELD_TEMPERATURE] / FLIGHT_LOG_TEMPERATURE_SCALE;
+    sample->rel_altitude = fields[FIELD_REL_ALTITUDE] / FLIGHT_LOG_ALTITUDE_SCALE;
+    sample->velocity = fields[FIELD_VELOCITY] / FLIGHT_LOG_VELOCITY_SCALE;
+}
+
+/**
+ * @brief pack scaled fields into a fixed size record
+ * @param fields FLIGHT_LOG_FIELD_COUNT values, in record order
+ * @param buffer at least FLIGHT_LOG_RECORD_SIZE bytes
+ * @return number of bytes written
+ */
+size_t flightLogPackFields(const int32_t* fields, uint8_t* buffer) {
+    uint8_t* p = buffer;
+
+    for(uint8_t i = 0; i < FLIGHT_LOG_FIELD_COUNT; i++) {
+        if(field_info[i].bytes == 4) {
+            p = put32(p, fields[i]);
+        } else if(field_info[i].bytes == 2) {
+            p = put16(p, fields[i]);
+        } else {
+            *p++ = fields[i];
+        }
+    }
+
+    return p - buffer;
+}
+
+/**
+ * @brief unpack a fixed size record into scaled fields
+ * @param buffer FLIGHT_LOG_RECORD_SIZE bytes
+ * @param fields FLIGHT_LOG_FIELD_COUNT values, in record order
+ * @return FLIGHT_LOG_ERASED once we reach erased flash - the end of the recorded data
+ */
+FLIGHT_LOG_STATUS flightLogUnpackFields(const uint8_t* buffer, int32_t* fields) {
+    const uint8_t* p = buffer;
+
+    for(uint8_t i = 0; i < FLIGHT_LOG_FIELD_COUNT; i++) {
+        if(field_info[i].bytes == 4) {
+            fields[i] = get32(p);
+        } else if(field_info[i].bytes == 2) {
+            fields[i] = field_info[i].is_signed ? (int16_t)get16(p) : get16(p);
+        } else {
+            fields[i] = *p;
+        }
+        p += field_info[i].bytes;
+    }
+
+    if((uint32_t)fields[FIELD_TIMESTAMP] == 0xFFFFFFFFUL && (uint32_t)fields[FIELD_RECORD_NUMBER] == 0xFFFFFFFFUL) {
+        return FLIGHT_LOG_ERASED;
+    }
+
+    return FLIGHT_LOG_OK;
+}
+
+/**
+ * @brief CRC-16/CCITT, polynomial 0x1021
+ * @param data bytes to add to the CRC
+ * @param len number of bytes
+ * @param crc CRC so far, 0xFFFF to start
+ */
+uint16_t flightLogCrc16(const uint8_t* data, size_t len, uint16_t crc) {
+    while(len--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for(uint8_t bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief CRC of a page - length and session from the header, then the payload, with the
+ * generation folded in
+ */
+static uint16_t pageCrc(const uint8_t* page, uint8_t length, uint32_t generation) {
+    uint16_t crc = flightLogCrc16(page + 1, 3, 0xFFFF);
+    crc = flightLogCrc16(page + FLIGHT_LOG_PAGE_HEADER_SIZE, length, crc);
+
+    return crc ^ (uint16_t)generation;
+}
+
+/**
+ * @brief fill in the header of a page whose payload is complete
+ * @param page FLIGHT_LOG_PAGE_HEADER_SIZE + length bytes, payload after the header
+ * @param length payload bytes used
+ * @param session logging session
+ * @param generation log generation from the log header
+ */
+void flightLogEncodePageHeader(uint8_t* page, uint8_t length, uint16_t session, uint32_t generation) {
+    page[0] = FLIGHT_LOG_PAGE_MAGIC;
+    page[1] = length;
+    put16(page + 2, session);
+    put16(page + 4, pageCrc(page, length, generation));
+}
+
+/**
+ * @brief read and check a page header against the payload
+ * @param page FLIGHT_LOG_PAGE_SIZE bytes
+ * @param generation log generation from the log header
+ * @param header decoded header
+ * @return FLIGHT_LOG_ERASED if the page was never written, FLIGHT_LOG_CORRUPT if the page
+ * was torn, damaged or left over from an older generation
+ */
+FLIGHT_LOG_STATUS flightLogDecodePageHeader(const uint8_t* page, uint32_t generation, flight_log_page_t* header) {
+    header->magic = page[0];
+    header->length = page[1];
+    header->session = get16(page + 2);
+    header->crc = get16(page + 4);
+
+    if(header->magic == 0xFF) {
+        return FLIGHT_LOG_ERASED;
+    } else if(header->magic != FLIGHT_LOG_PAGE_MAGIC || header->length > FLIGHT_LOG_PAGE_PAYLOAD) {
+        return FLIGHT_LOG_CORRUPT;
+    } else if(header->crc != pageCrc(page, header->length, generation)) {
+        return FLIGHT_LOG_CORRUPT;
+    }
+
+    return FLIGHT_LOG_OK;
+}
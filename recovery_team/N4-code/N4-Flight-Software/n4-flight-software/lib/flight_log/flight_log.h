@@ -0,0 +1,186 @@
+/**
+ * @file flight_log.h
+ * @brief On-flash flight record format shared by the flight software and the data recovery tool
+ *
+ * The log starts with a header holding a magic number and the schema version, followed by
+ * the flight directory and the log pages. A sample is a fixed set of fields, each stored as a
+ * little-endian scaled integer:
+ *
+ * | field              | type   | unit                        |
+ * |--------------------|--------|-----------------------------|
+ * | timestamp          | uint32 | ms since boot               |
+ * | record_number      | uint32 |                             |
+ * | flags              | uint8  | bits 0-3 state, bit 4 mode, |
+ * |                    |        | bits 5-7 log policy         |
+ * | ax, ay, az         | int16  | 1/2048 g (raw counts ±16g)  |
+ * | gx, gy, gz         | int16  | 1/32.8 deg/s (raw ±1000dps) |
+ * | pitch, roll        | int16  | 0.01 deg                    |
+ * | latitude,longitude | int32  | 1e-7 deg                    |
+ * | gps_altitude       | uint16 | m                           |
+ * | pressure           | uint32 | Pa                          |
+ * | temperature        | int16  | 0.01 deg C                  |
+ * | rel_altitude       | int32  | cm                          |
+ * | velocity           | int16  | 0.1 m/s                     |
+ *
+ * Values outside the range of a field are clamped. The layout is defined once, in
+ * flight_log_fields.def, and checked at compile time. Any change to the record, page or
+ * header layout must bump FLIGHT_LOG_SCHEMA_VERSION.
+ *
+ * The fixed size record is only stored whole as a keyframe - the samples are delta
+ * compressed, see flight_log_codec.h.
+ *
+ * The log is split into FLIGHT_LOG_PAGE_SIZE pages, matching the flash program page. The
+ * first page only holds the log header, and the flight directory takes the pages right after
+ * it - see flight_directory.h. The log pages start after the directory, at
+ * flightLogFirstPage(). Every log page starts with a page header, and its payload holds whole
+ * frames, the first of them a keyframe. The page CRC covers the length, session and payload,
+ * so a page torn by a reset during programming is detected and skipped without losing the
+ * pages after it.
+ *
+ * | field   | type   |                                                     |
+ * |---------|--------|-----------------------------------------------------|
+ * | magic   | uint8  | FLIGHT_LOG_PAGE_MAGIC, 0xFF if the page is erased   |
+ * | length  | uint8  | payload bytes used                                  |
+ * | session | uint16 | incremented every time logging resumes after a boot |
+ * | crc     | uint16 | CRC-16/CCITT of length, session and payload         |
+ *
+ * The log header carries a generation number that is incremented every time the log is
+ * erased, and the low 16 bits of the generation are XORed into every page CRC. The log is
+ * erased block by block ahead of the write position, so pages left over from an older
+ * generation fail the CRC and are never mistaken for part of the current log.
+ */
+
+#ifndef FLIGHT_LOG_H
+#define FLIGHT_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FLIGHT_LOG_MAGIC 0x4C46344EUL           /*!< "N4FL" when read as bytes */
+#define FLIGHT_LOG_SCHEMA_VERSION 1             /*!< bump on every record, page or header layout change */
+#define FLIGHT_LOG_HEADER_SIZE 16               /*!< bytes in the log header */
+#define FLIGHT_LOG_RECORD_SIZE 47               /*!< bytes in one fixed size record */
+#define FLIGHT_LOG_FIELD_COUNT 18               /*!< scaled integer fields in one record */
+#define FLIGHT_LOG_PAGE_SIZE 256                /*!< bytes in one log page - the flash program page */
+#define FLIGHT_LOG_PAGE_HEADER_SIZE 6           /*!< bytes in the page header */
+#define FLIGHT_LOG_PAGE_PAYLOAD (FLIGHT_LOG_PAGE_SIZE - FLIGHT_LOG_PAGE_HEADER_SIZE)  /*!< frame bytes in one page */
+#define FLIGHT_LOG_PAGE_MAGIC 0xA5              /*!< first byte of a written page */
+
+#define FLIGHT_LOG_ACCEL_SCALE 2048.0f          /*!< counts per g */
+#define FLIGHT_LOG_GYRO_SCALE 32.8f             /*!< counts per deg/s */
+#define FLIGHT_LOG_ANGLE_SCALE 100.0f           /*!< counts per deg */
+#define FLIGHT_LOG_COORDINATE_SCALE 1e7         /*!< counts per deg */
+#define FLIGHT_LOG_TEMPERATURE_SCALE 100.0f     /*!< counts per deg C */
+#define FLIGHT_LOG_ALTITUDE_SCALE 100.0f        /*!< counts per m */
+#define FLIGHT_LOG_VELOCITY_SCALE 10.0f         /*!< counts per m/s */
+#define FLIGHT_LOG_PRESSURE_SCALE 100.0f        /*!< counts (Pa) per hPa */
+
+/**
+ * Record fields, in the order they are stored
+ */
+typedef enum {
+    #define FLIGHT_LOG_FIELD(name, bytes, is_signed, scale, column, unit) FIELD_##name,
+    #include "flight_log_fields.def"
+    #undef FLIGHT_LOG_FIELD
+} FLIGHT_LOG_FIELD;
+
+static_assert(0
+    #define FLIGHT_LOG_FIELD(name, bytes, is_signed, scale, column, unit) + 1
+    #include "flight_log_fields.def"
+    #undef FLIGHT_LOG_FIELD
+    == FLIGHT_LOG_FIELD_COUNT, "flight_log_fields.def does not match FLIGHT_LOG_FIELD_COUNT");
+
+static_assert(0
+    #define FLIGHT_LOG_FIELD(name, bytes, is_signed, scale, column, unit) + bytes
+    #include "flight_log_fields.def"
+    #undef FLIGHT_LOG_FIELD
+    == FLIGHT_LOG_RECORD_SIZE, "flight_log_fields.def does not match FLIGHT_LOG_RECORD_SIZE");
+
+static_assert(1 + FLIGHT_LOG_RECORD_SIZE <= FLIGHT_LOG_PAGE_PAYLOAD, "a keyframe must fit in one page");
+
+/**
+ * How one field is stored, see flight_log_fields.def
+ */
+typedef struct {
+    const char* column;             /*!< column name */
+    const char* unit;               /*!< unit after scaling */
+    uint8_t bytes;                  /*!< bytes in the fixed size record */
+    bool is_signed;                 /*!< stored as a signed integer */
+    double scale;                   /*!< stored counts per unit */
+} flight_log_field_info_t;
+
+/**
+ * Result of decoding a header or record
+ */
+typedef enum {
+    FLIGHT_LOG_OK = 0,
+    FLIGHT_LOG_ERASED,                  /*!< erased flash - the end of the recorded data */
+    FLIGHT_LOG_BAD_MAGIC,               /*!< not a flight log */
+    FLIGHT_LOG_UNSUPPORTED_VERSION,     /*!< written with another schema version */
+    FLIGHT_LOG_TRUNCATED,               /*!< the frame continues past the end of the buffer */
+    FLIGHT_LOG_CORRUPT                  /*!< the frame cannot be decoded */
+} FLIGHT_LOG_STATUS;
+
+/**
+ * The log header
+ */
+typedef struct {
+    uint32_t magic;                 /*!< FLIGHT_LOG_MAGIC */
+    uint8_t version;                /*!< schema version the log was written with */
+    uint8_t header_size;            /*!< FLIGHT_LOG_HEADER_SIZE */
+    uint16_t record_size;           /*!< FLIGHT_LOG_RECORD_SIZE, the keyframe payload */
+    uint32_t generation;            /*!< times the log has been erased */
+    uint16_t directory_pages;       /*!< pages in the flight directory */
+} flight_log_header_t;
+
+/**
+ * The header at the start of every page after the log header
+ */
+typedef struct {
+    uint8_t magic;                  /*!< FLIGHT_LOG_PAGE_MAGIC */
+    uint8_t length;                 /*!< payload bytes used */
+    uint16_t session;               /*!< logging session the page was written in */
+    uint16_t crc;                   /*!< CRC of length, session and payload */
+} flight_log_page_t;
+
+/**
+ * One decoded flight record, in the units used by the flight software
+ */
+typedef struct {
+    uint32_t timestamp_ms;          /*!< time the sample was taken, ms since boot */
+    uint32_t record_number;         /*!< sample counter */
+    uint8_t operation_mode;         /*!< SAFE or ARMED, see states.h */
+    uint8_t state;                  /*!< flight state, see states.h */
+    uint8_t log_policy;             /*!< logging rate the sample was kept under, see log_policy.h */
+    float ax;                       /*!< x axis acceleration in g */
+    float ay;                       /*!< y axis acceleration in g */
+    float az;                       /*!< z axis acceleration in g */
+    float gx;                       /*!< x axis angular velocity in deg/s */
+    float gy;                       /*!< y axis angular velocity in deg/s */
+    float gz;                       /*!< z axis angular velocity in deg/s */
+    float pitch;                    /*!< pitch angle in deg */
+    float roll;                     /*!< roll angle in deg */
+    double latitude;                /*!< latitude in deg */
+    double longitude;               /*!< longitude in deg */
+    uint16_t gps_altitude;          /*!< GPS altitude in m */
+    float pressure;                 /*!< atmospheric pressure in hPa, as returned by the BMP180 */
+    float temperature;              /*!< altimeter temperature in deg C */
+    float rel_altitude;             /*!< altitude relative to the launch site in m */
+    float velocity;                 /*!< vertical velocity in m/s */
+} flight_log_sample_t;
+
+size_t flightLogEncodeHeader(uint8_t* buffer, uint32_t generation, uint16_t directory_pages);
+FLIGHT_LOG_STATUS flightLogDecodeHeader(const uint8_t* buffer, flight_log_header_t* header);
+uint32_t flightLogFirstPage(const flight_log_header_t* header);
+
+const flight_log_field_info_t* flightLogFieldInfo(uint8_t field);
+void flightLogToFields(const flight_log_sample_t* sample, int32_t* fields);
+void flightLogFromFields(const int32_t* fields, flight_log_sample_t* sample);
+size_t flightLogPackFields(const int32_t* fields, uint8_t* buffer);
+FLIGHT_LOG_STATUS flightLogUnpackFields(const uint8_t* buffer, int32_t* fields);
+
+uint16_t flightLogCrc16(const uint8_t* data, size_t len, uint16_t crc);
+void flightLogEncodePageHeader(uint8_t* page, uint8_t length, uint16_t session, uint32_t generation);
+FLIGHT_LOG_STATUS flightLogDecodePageHeader(const uint8_t* page, uint32_t generation, flight_log_page_t* header);
+
+#endif // FLIGHT_LOG_H
@@ -0,0 +1,168 @@
+/**
+ * @file flight_log_codec.cpp
+ * @brief Implement the flight log delta compression
+ */
+
+#include <string.h>
+#include "flight_log_codec.h"
+
+#define PREDICTED_FIELDS 2          /*!< timestamp and record number use the linear predictor */
+#define DELTA_TAG_MAX ((1 << (FLIGHT_LOG_FIELD_COUNT - 16)) - 1)   /*!< largest first byte of a delta frame */
+
+/**
+ * @brief predicted value of a field from the previous frames
+ */
+static inline int32_t predict(const flight_log_codec_t* codec, uint8_t field) {
+    if(field < PREDICTED_FIELDS) {
+        return (uint32_t)codec->previous[field] + (uint32_t)codec->step[field];
+    }
+
+    return codec->previous[field];
+}
+
+/**
+ * @brief remember the frame just coded - the encoder and decoder must call this identically
+ */
+static void update(flight_log_codec_t* codec, const int32_t* fields, bool keyframe) {
+    for(uint8_t i = 0; i < PREDICTED_FIELDS; i++) {
+        codec->step[i] = keyframe ? 0 : (uint32_t)fields[i] - (uint32_t)codec->previous[i];
+    }
+
+    memcpy(codec->previous, fields, sizeof(codec->previous));
+    codec->since_keyframe = keyframe ? 0 : codec->since_keyframe + 1;
+    codec->have_keyframe = true;
+}
+
+/**
+ * @brief forget the stream history - the next frame is a keyframe
+ */
+void flightLogCodecReset(flight_log_codec_t* codec) {
+    memset(codec, 0, sizeof(*codec));
+}
+
+/**
+ * @brief compress one record
+ * @param codec encoder state
+ * @param fields FLIGHT_LOG_FIELD_COUNT values, see flightLogToFields()
+ * @param buffer at least FLIGHT_LOG_FRAME_BUFFER_SIZE bytes
+ * @return frame size in bytes, at most FLIGHT_LOG_KEYFRAME_SIZE
+ */
+size_t flightLogCompress(flight_log_codec_t* codec, const int32_t* fields, uint8_t* buffer) {
+    if(codec->have_keyframe && codec->since_keyframe + 1 < FLIGHT_LOG_KEYFRAME_INTERVAL) {
+        uint8_t* p = buffer + 3;
+        uint32_t changed = 0;
+
+        for(uint8_t i = 0; i < FLIGHT_LOG_FIELD_COUNT; i++) {
+            int32_t residual = (uint32_t)fields[i] - (uint32_t)predict(codec, i);
+            if(residual == 0) {
+                continue;
+            }
+
+            changed |= 1UL << i;
+
+            // zigzag maps small negative and positive residuals to small unsigned values
+            uint32_t value = ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+            while(value >= 0x80) {
+                *p++ = (value & 0x7F) | 0x80;
+                value >>= 7;
+            }
+            *p++ = value;
+        }
+
+        size_t size = p - buffer;
+        if(size <= FLIGHT_LOG_KEYFRAME_SIZE) {
+            buffer[0] = changed >> 16;
+            buffer[1] = changed >> 8;
+            buffer[2] = changed;
+
+            update(codec, fields, false);
+            return size;
+        }
+    }
+
+    buffer[0] = FLIGHT_LOG_KEYFRAME_TAG;
+    flightLogPackFields(fields, buffer + 1);
+    update(codec, fields, true);
+
+    return FLIGHT_LOG_KEYFRAME_SIZE;
+}
+
+/**
+ * @brief decompress one frame
+ * @param codec decoder state
+ * @param buffer start of the frame
+ * @param len bytes available from the start of the frame
+ * @param fields FLIGHT_LOG_FIELD_COUNT decoded values
+ * @param used size of the frame in bytes
+ * @return FLIGHT_LOG_ERASED at the end of the recorded data, FLIGHT_LOG_TRUNCATED if the
+ * frame continues past len, FLIGHT_LOG_CORRUPT on an unknown tag or a delta frame before
+ * the first keyframe
+ */
+FLIGHT_LOG_STATUS flightLogDecompress(flight_log_codec_t* codec, const uint8_t* buffer, size_t len, int32_t* fields, size_t* used) {
+    if(len < 1) {
+        return FLIGHT_LOG_TRUNCATED;
+    }
+
+    uint8_t tag = buffer[0];
+
+    if(tag == FLIGHT_LOG_ERASED_TAG) {
+        return FLIGHT_LOG_ERASED;
+    }
+
+    if(tag == FLIGHT_LOG_KEYFRAME_TAG) {
+        if(len < FLIGHT_LOG_KEYFRAME_SIZE) {
+            return FLIGHT_LOG_TRUNCATED;
+        }
+
+        flightLogUnpackFields(buffer + 1, fields);
+        update(codec, fields, true);
+        *used = FLIGHT_LOG_KEYFRAME_SIZE;
+
+        return FLIGHT_LOG_OK;
+    }
+
+    if(tag > DELTA_TAG_MAX || !codec->have_keyframe) {
+        return FLIGHT_LOG_CORRUPT;
+    }
+
+    if(len < 3) {
+        return FLIGHT_LOG_TRUNCATED;
+    }
+
+    uint32_t changed = ((uint32_t)buffer[0] << 16) | ((uint32_t)buffer[1] << 8) | buffer[2];
+    const uint8_t* p = buffer + 3;
+    const uint8_t* end = buffer + len;
+
+    for(uint8_t i = 0; i < FLIGHT_LOG_FIELD_COUNT; i++) {
+        if(!(changed & (1UL << i))) {
+            fields[i] = predict(codec, i);
+            continue;
+        }
+
+        uint32_t value = 0;
+        uint8_t shift = 0;
+        while(1) {
+            if(p >= end) {
+                return FLIGHT_LOG_TRUNCATED;
+            } else if(shift > 28) {
+                return FLIGHT_LOG_CORRUPT;
+            }
+
+            uint8_t byte = *p++;
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            shift += 7;
+
+            if(!(byte & 0x80)) {
+                break;
+            }
+        }
+
+        int32_t residual = (value >> 1) ^ -(int32_t)(value & 1);
+        fields[i] = (uint32_t)predict(codec, i) + (uint32_t)residual;
+    }
+
+    update(codec, fields, false);
+    *used = p - buffer;
+
+    return FLIGHT_LOG_OK;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file flight_log_codec.h
+ * @brief Streaming delta compression of flight log records
+ *
+ * Consecutive samples are highly correlated, so instead of the fixed size record most
+ * samples are stored as the difference of every field from its prediction:
+ * - timestamp and record number are predicted to advance by the same step as last time
+ * - every other field is predicted to stay the same
+ *
+ * Frame layout, selected by the first byte:
+ * - 0xFF            erased flash - the end of the recorded data
+ * - 0xFE            keyframe: the fixed size record follows, see flight_log.h
+ * - 0x00 - 0x03     delta frame: a 3 byte big-endian bitmap of the fields that differ from
+ *                   their prediction, then a zigzag varint residual for each of those fields
+ *
+ * A keyframe is written every FLIGHT_LOG_KEYFRAME_INTERVAL frames and after every
+ * flightLogCodecReset(), so decoding can start at any keyframe. A delta frame that would
+ * be larger than a keyframe is written as a keyframe instead.
+ */
+
+#ifndef FLIGHT_LOG_CODEC_H
+#define FLIGHT_LOG_CODEC_H
+
+#include "flight_log.h"
+
+#define FLIGHT_LOG_KEYFRAME_TAG 0xFE                /*!< first byte of a keyframe */
+#define FLIGHT_LOG_ERASED_TAG 0xFF                  /*!< first byte of erased flash */
+#define FLIGHT_LOG_KEYFRAME_INTERVAL 64             /*!< frames between keyframes */
+#define FLIGHT_LOG_KEYFRAME_SIZE (1 + FLIGHT_LOG_RECORD_SIZE)       /*!< largest frame written */
+#define FLIGHT_LOG_FRAME_BUFFER_SIZE (3 + 5 * FLIGHT_LOG_FIELD_COUNT)   /*!< scratch space flightLogCompress() needs */
+
+/**
+ * Encoder or decoder state - one per stream
+ */
+typedef struct {
+    int32_t previous[FLIGHT_LOG_FIELD_COUNT];   /*!< fields of the previous frame */
+    int32_t step[2];                            /*!< last timestamp and record number increments */
+    uint16_t since_keyframe;                    /*!< frames since the last keyframe */
+    bool have_keyframe;                         /*!< false until the first keyframe - the next frame must be one */
+} flight_log_codec_t;
+
+void flightLogCodecReset(flight_log_codec_t* codec);
+size_t flightLogCompress(flight_log_codec_t* codec, const int32_t* fields, uint8_t* buffer);
+FLIGHT_LOG_STATUS flightLogDecompress(flight_log_codec_t* codec, const uint8_t* buffer, size_t len, int32_t* fields, size_t* used);
+
+#endif // FLIGHT_LOG_CODEC_H
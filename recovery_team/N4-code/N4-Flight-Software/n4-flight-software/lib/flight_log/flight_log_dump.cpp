@@ -0,0 +1,63 @@
+/**
+ * @file flight_log_dump.cpp
+ * @brief Implement the binary flash dump frames
+ */
+
+#include "flight_log_dump.h"
+#include "flight_log_le.h"
+
+/**
+ * @brief CRC-32 (IEEE 802.3, as used by zip) with a 16 entry table, a nibble at a time
+ * @param crc CRC so far, 0 to start
+ */
+uint32_t flightLogCrc32(const uint8_t* data, size_t len, uint32_t crc) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    crc = ~crc;
+    while(len--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
+/**
+ * @brief encode a frame header. The CRC starts at buffer + 2
+ * @param buffer at least FLIGHT_LOG_DUMP_FRAME_HEADER_SIZE bytes
+ * @return bytes written
+ */
+size_t flightLogDumpFrameHeader(uint8_t* buffer, uint8_t type, uint32_t index, uint16_t length) {
+    put16(buffer, FLIGHT_LOG_DUMP_SYNC);
+    buffer[2] = type;
+    put32(buffer + 3, index);
+    put16(buffer + 7, length);
+
+    return FLIGHT_LOG_DUMP_FRAME_HEADER_SIZE;
+}
+
+/**
+ * @param buffer at least FLIGHT_LOG_DUMP_INFO_SIZE bytes
+ * @return bytes written
+ */
+size_t flightLogDumpEncodeInfo(const flight_log_dump_info_t* info, uint8_t* buffer) {
+    put32(buffer, info->capacity);
+    put32(buffer + 4, info->block_size);
+    put32(buffer + 8, info->block_count);
+    put32(buffer + 12, info->log_address);
+    put32(buffer + 16, info->log_size);
+
+    return FLIGHT_LOG_DUMP_INFO_SIZE;
+}
+
+void flightLogDumpDecodeInfo(const uint8_t* buffer, flight_log_dump_info_t* info) {
+    info->capacity = get32(buffer);
+    info->block_size = get32(buffer + 4);
+    info->block_count = get32(buffer + 8);
+    info->log_address = get32(buffer + 12);
+    info->log_size = get32(buffer + 16);
+}
@@ -0,0 +1,77 @@
+/**
+ * @file flight_log_dump.h
+ * @brief Binary flash dump protocol between the data recovery tool and the ground receiver
+ *
+ * The receiver drives the transfer by sending 5 byte requests, a command byte followed by a
+ * little-endian uint32 argument:
+ * - 'I' 0      send the info frame
+ * - 'S' block  stream every block from block to the end of the chip, then an end frame
+ * - 'R' block  send one block again - used for the blocks that failed their CRC
+ * - 'Q' 0      leave binary mode
+ *
+ * The recovery tool answers with frames:
+ *
+ * | field  | type   |                                                    |
+ * |--------|--------|----------------------------------------------------|
+ * | sync   | uint16 | FLIGHT_LOG_DUMP_SYNC                               |
+ * | type   | uint8  | FLIGHT_LOG_DUMP_INFO, _BLOCK or _END               |
+ * | index  | uint32 | block number, 0 for the other frames               |
+ * | length | uint16 | payload bytes                                      |
+ * | data   |        | payload                                            |
+ * | crc    | uint32 | CRC-32 of type, index, length and payload          |
+ *
+ * The info frame payload is 5 uint32: chip capacity, block size, block count, and the flash
+ * address and size of the flight log file, so the receiver can cut the log out of the image.
+ *
+ * Every value is little-endian.
+ */
+
+#ifndef FLIGHT_LOG_DUMP_H
+#define FLIGHT_LOG_DUMP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FLIGHT_LOG_DUMP_SYNC 0x344EU            /*!< "N4" when read as bytes */
+#define FLIGHT_LOG_DUMP_BLOCK_SIZE 4096         /*!< flash bytes in one block frame */
+#define FLIGHT_LOG_DUMP_FRAME_HEADER_SIZE 9     /*!< bytes before the payload */
+#define FLIGHT_LOG_DUMP_FRAME_OVERHEAD (FLIGHT_LOG_DUMP_FRAME_HEADER_SIZE + 4)  /*!< header and CRC */
+#define FLIGHT_LOG_DUMP_REQUEST_SIZE 5          /*!< bytes in one receiver request */
+#define FLIGHT_LOG_DUMP_INFO_SIZE 20            /*!< bytes in the info frame payload */
+
+/**
+ * Frame types
+ */
+typedef enum {
+    FLIGHT_LOG_DUMP_INFO = 'I',
+    FLIGHT_LOG_DUMP_BLOCK = 'B',
+    FLIGHT_LOG_DUMP_END = 'E'
+} FLIGHT_LOG_DUMP_FRAME;
+
+/**
+ * Receiver requests
+ */
+typedef enum {
+    FLIGHT_LOG_DUMP_REQUEST_INFO = 'I',
+    FLIGHT_LOG_DUMP_REQUEST_STREAM = 'S',
+    FLIGHT_LOG_DUMP_REQUEST_BLOCK = 'R',
+    FLIGHT_LOG_DUMP_REQUEST_QUIT = 'Q'
+} FLIGHT_LOG_DUMP_REQUEST;
+
+/**
+ * The info frame payload
+ */
+typedef struct {
+    uint32_t capacity;              /*!< bytes in the flash chip */
+    uint32_t block_size;            /*!< bytes in one block frame */
+    uint32_t block_count;           /*!< block frames in the chip */
+    uint32_t log_address;           /*!< flash address of the flight log file */
+    uint32_t log_size;              /*!< bytes in the flight log file */
+} flight_log_dump_info_t;
+
+uint32_t flightLogCrc32(const uint8_t* data, size_t len, uint32_t crc);
+size_t flightLogDumpFrameHeader(uint8_t* buffer, uint8_t type, uint32_t index, uint16_t length);
+size_t flightLogDumpEncodeInfo(const flight_log_dump_info_t* info, uint8_t* buffer);
+void flightLogDumpDecodeInfo(const uint8_t* buffer, flight_log_dump_info_t* info);
+
+#endif // FLIGHT_LOG_DUMP_H
@@ -0,0 +1,36 @@
+/**
+ * @file flight_log_le.h
+ * @brief Little-endian byte packing used by every on-flash and on-wire format
+ *
+ * The put functions return the byte after the value, so fields can be written one after
+ * the other.
+ */
+
+#ifndef FLIGHT_LOG_LE_H
+#define FLIGHT_LOG_LE_H
+
+#include <stdint.h>
+
+static inline uint8_t* put16(uint8_t* p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+    return p + 2;
+}
+
+static inline uint8_t* put32(uint8_t* p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = value >> 24;
+    return p + 4;
+}
+
+static inline uint16_t get16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t get32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#endif // FLIGHT_LOG_LE_H
@@ -0,0 +1,241 @@
+/**
+ * @file telemetry_batch.cpp
+ * @brief Collect telemetry samples into batches and decide when to send them
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "telemetry_batch.h"
+
+#define NO_STATE 0xFF                   /*!< before the first sample - the first sample is sent right away */
+
+/**
+ * @brief set up an empty batch
+ * @param buffer message buffer - the largest payload the sender can publish
+ * @param capacity bytes in the buffer
+ * @param max_samples most samples in one batch, 1 sends every sample on its own
+ * @param max_age_ms time after which a batch is sent even if it is not full
+ */
+void telemetryBatchInit(telemetry_batch_t* batch, uint8_t* buffer, size_t capacity, uint8_t max_samples, uint32_t max_age_ms) {
+    memset(batch, 0, sizeof(*batch));
+    batch->buffer = buffer;
+    batch->capacity = capacity;
+    batch->max_samples = max_samples ? max_samples : 1;
+    batch->max_age_ms = max_age_ms;
+    batch->state = NO_STATE;
+}
+
+/**
+ * @brief account for one added sample and check whether the batch is now due
+ */
+static void sampleAdded(telemetry_batch_t* batch, uint8_t state, size_t next_size, uint32_t now_ms) {
+    if(batch->count == 0) {
+        batch->first_ms = now_ms;
+    }
+    batch->count++;
+    batch->stats.samples++;
+
+    if(state != batch->state) {
+        batch->due = TELEMETRY_FLUSH_STATE;
+    } else if(batch->count >= batch->max_samples || batch->length + next_size > batch->capacity) {
+        batch->due = TELEMETRY_FLUSH_FULL;
+    }
+    batch->state = state;
+}
+
+/**
+ * @brief check that a sample can join the batch. A sample that cannot makes the batch due,
+ * so that the caller sends it and adds the sample to the next one
+ */
+static bool canAdd(telemetry_batch_t* batch, uint8_t schema, size_t size) {
+    if(batch->count == 0) {
+        batch->schema = schema;
+        return size <= batch->capacity;
+    }
+
+    if(batch->due != TELEMETRY_FLUSH_NONE || batch->schema != schema || batch->length + size > batch->capacity) {
+        if(batch->due == TELEMETRY_FLUSH_NONE) {
+            batch->due = TELEMETRY_FLUSH_FULL;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief add a sample as a binary frame record
+ * @param fields FLIGHT_LOG_FIELD_COUNT scaled values, see flightLogToFields()
+ * @return false if the batch must be sent first
+ */
+bool telemetryBatchAddFields(telemetry_batch_t* batch, const int32_t* fields, uint32_t now_ms) {
+    size_t size = (batch->count == 0 ? TELEMETRY_FRAME_HEADER_SIZE : 0) + FLIGHT_LOG_RECORD_SIZE;
+    if(!canAdd(batch, TELEMETRY_SCHEMA_RECORD, size)) {
+        return false;
+    }
+
+    if(batch->count == 0) {
+        batch->length = telemetryFrameEncodeHeader(batch->buffer, TELEMETRY_SCHEMA_RECORD, 0);
+    }
+    batch->length += flightLogPackFields(fields, batch->buffer + batch->length);
+
+    // the frame header always holds the current count
+    batch->buffer[3] = batch->count + 1;
+
+    sampleAdded(batch, fields[FIELD_FLAGS] & 0x0F, FLIGHT_LOG_RECORD_SIZE, now_ms);
+    return true;
+}
+
+/**
+ * @brief add a sample as a delta compressed sample
+ * @param encoder stream state. Samples must go to the batch in the order they are encoded
+ * @param fields FLIGHT_LOG_FIELD_COUNT scaled values, see flightLogToFields()
+ * @return false if the batch must be sent first - the sample is not encoded yet
+ */
+bool telemetryBatchAddDelta(telemetry_batch_t* batch, telemetry_delta_encoder_t* encoder, const int32_t* fields, uint32_t now_ms) {
+    // checked against the largest sample, since encoding it advances the stream
+    size_t size = (batch->count == 0 ? TELEMETRY_DELTA_HEADER_SIZE : 0) + TELEMETRY_DELTA_MAX_SAMPLE_SIZE;
+    if(!canAdd(batch, TELEMETRY_SCHEMA_DELTA, size)) {
+        return false;
+    }
+
+    if(batch->count == 0) {
+        batch->length = telemetryDeltaEncodeHeader(encoder, batch->buffer, 0);
+    }
+
+    uint8_t sample[FLIGHT_LOG_FRAME_BUFFER_SIZE];
+    size_t length = telemetryDeltaEncode(encoder, fields, sample);
+    memcpy(batch->buffer + batch->length, sample, length);
+    batch->length += length;
+
+    batch->buffer[3] = batch->count + 1;
+
+    sampleAdded(batch, fields[FIELD_FLAGS] & 0x0F, TELEMETRY_DELTA_MAX_SAMPLE_SIZE, now_ms);
+    return true;
+}
+
+/**
+ * @brief add a sample as a CSV row
+ * @param row the row, newline included
+ * @param len length of the row
+ * @param state flight state of the sample
+ * @return false if the batch must be sent first
+ */
+bool telemetryBatchAddRow(telemetry_batch_t* batch, const char* row, size_t len, uint8_t state, uint32_t now_ms) {
+    if(!canAdd(batch, TELEMETRY_BATCH_CSV, len)) {
+        return false;
+    }
+
+    memcpy(batch->buffer + batch->length, row, len);
+    batch->length += len;
+
+    // rows vary in length - assume the next one is as long as this one
+    sampleAdded(batch, state, len, now_ms);
+    return true;
+}
+
+/**
+ * @brief check whether the batch must be sent now
+ * @return the reason, TELEMETRY_FLUSH_NONE if it can wait
+ */
+TELEMETRY_FLUSH telemetryBatchDue(telemetry_batch_t* batch, uint32_t now_ms) {
+    if(batch->due == TELEMETRY_FLUSH_NONE && batch->count && now_ms - batch->first_ms >= batch->max_age_ms) {
+        batch->due = TELEMETRY_FLUSH_AGE;
+    }
+    return batch->due;
+}
+
+/**
+ * @brief time until the batch is due by age
+ * @return UINT32_MAX if the batch is empty
+ */
+uint32_t telemetryBatchWaitMs(const telemetry_batch_t* batch, uint32_t now_ms) {
+    if(batch->count == 0) {
+        return UINT32_MAX;
+    }
+
+    uint32_t age = now_ms - batch->first_ms;
+    return age >= batch->max_age_ms ? 0 : batch->max_age_ms - age;
+}
+
+/**
+ * @brief empty the batch once the sender has published it, or given up on it
+ * @param published false if the sender could not publish the batch
+ */
+void telemetryBatchSent(telemetry_batch_t* batch, bool published) {
+    if(batch->count == 0) {
+        return;
+    }
+
+    if(published) {
+        batch->stats.messages++;
+        batch->stats.bytes += batch->length;
+    } else {
+        batch->stats.failed++;
+    }
+
+    switch(batch->due) {
+        case TELEMETRY_FLUSH_STATE: batch->stats.state_flushes++; break;
+        case TELEMETRY_FLUSH_AGE: batch->stats.age_flushes++; break;
+        default: batch->stats.full_flushes++; break;
+    }
+
+    batch->length = 0;
+    batch->count = 0;
+    batch->due = TELEMETRY_FLUSH_NONE;
+}
+
+/**
+ * @brief one line batching report, with the message and byte rates since the last report
+ */
+size_t telemetryBatchFormatStats(telemetry_batch_t* batch, char* buffer, size_t len, uint32_t now_ms) {
+    const telemetry_batch_stats_t* s = &batch->stats;
+    uint32_t elapsed_ms = now_ms - batch->reported_ms;
+    uint32_t messages = s->messages - batch->reported.messages;
+    uint32_t bytes = s->bytes - batch->reported.bytes;
+
+    uint32_t messages_x10 = elapsed_ms ? (uint32_t)((uint64_t)messages * 10000 / elapsed_ms) : 0;
+    uint32_t bytes_per_s = elapsed_ms ? (uint32_t)((uint64_t)bytes * 1000 / elapsed_ms) : 0;
+    uint32_t samples_x10 = s->messages ? (uint32_t)((uint64_t)(s->samples - batch->count) * 10 / (s->messages + s->failed)) : 0;
+
+    batch->reported = *s;
+    batch->reported_ms = now_ms;
+
+    return snprintf(buffer, len, "TELEMETRY msg/s=%lu.%lu B/s=%lu samples/msg=%lu.%lu samples=%lu msgs=%lu failed=%lu full=%lu age=%lu state=%lu",
+                    (unsigned long)(messages_x10 / 10), (unsigned long)(messages_x10 % 10),
+                    (unsigned long)bytes_per_s,
+                    (unsigned long)(samples_x10 / 10), (unsigned long)(samples_x10 % 10),
+                    (unsigned long)s->samples,
+                    (unsigned long)s->messages,
+                    (unsigned long)s->failed,
+                    (unsigned long)s->full_flushes,
+                    (unsigned long)s->age_flushes,
+                    (unsigned long)s->state_flushes);
+}
+
+/**
+ * @brief start decimating a sample stream
+ * @param divider keep one sample in divider, 1 keeps them all
+ */
+void telemetryDecimatorInit(telemetry_decimator_t* decimator, uint8_t divider) {
+    decimator->divider = divider ? divider : 1;
+    decimator->skipped = 0;
+    decimator->state = 0xFF;
+}
+
+/**
+ * @brief decide whether the next sample is sent
+ * A sample in a new flight state is always kept, so state changes reach the ground as soon
+ * as without decimation. The count restarts from it
+ * @param state flight state of the sample
+ * @return true if the sample is to be sent
+ */
+bool telemetryDecimatorKeep(telemetry_decimator_t* decimator, uint8_t state) {
+    if(state != decimator->state || decimator->skipped + 1 >= decimator->divider) {
+        decimator->state = state;
+        decimator->skipped = 0;
+        return true;
+    }
+
+    decimator->skipped++;
+    return false;
+}
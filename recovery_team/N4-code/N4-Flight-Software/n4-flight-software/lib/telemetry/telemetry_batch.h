@@ -0,0 +1,96 @@
+/**
+ * @file telemetry_batch.h
+ * @brief Pack several telemetry samples into one MQTT message
+ *
+ * Every publish costs an MQTT header, a TCP segment and a broker round, whatever its size.
+ * The batch collects samples - binary frame records, delta compressed samples or CSV rows -
+ * and tells the sender when to publish them:
+ * - when it holds max_samples samples, or the next one would not fit in the buffer
+ * - when its first sample is max_age_ms old
+ * - right after a sample in a new flight state, so state changes reach the ground without
+ *   waiting for the batch to fill
+ *
+ * A binary batch is one telemetry frame with count samples, see telemetry_frame.h and
+ * telemetry_delta.h. A CSV batch is the rows one after the other - every row ends with a
+ * newline.
+ *
+ * Not thread safe - owned by the telemetry task.
+ */
+
+#ifndef TELEMETRY_BATCH_H
+#define TELEMETRY_BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "telemetry_frame.h"
+#include "telemetry_delta.h"
+
+#define TELEMETRY_BATCH_CSV 0           /*!< schema of a batch of CSV rows */
+#define TELEMETRY_BATCH_SAMPLES 10      /*!< most samples in one message. 1 sends every sample on its own */
+#define TELEMETRY_BATCH_MS 200          /*!< time in ms after which a batch is sent even if it is not full */
+
+/**
+ * Why a batch was sent
+ */
+typedef enum {
+    TELEMETRY_FLUSH_NONE = 0,           /*!< not due yet */
+    TELEMETRY_FLUSH_FULL,               /*!< max_samples, or out of buffer */
+    TELEMETRY_FLUSH_AGE,                /*!< the first sample reached max_age_ms */
+    TELEMETRY_FLUSH_STATE               /*!< the flight state changed */
+} TELEMETRY_FLUSH;
+
+/**
+ * A structure to hold the batching statistics
+ */
+typedef struct {
+    uint32_t samples;                   /*!< samples added */
+    uint32_t messages;                  /*!< batches sent */
+    uint32_t bytes;                     /*!< payload bytes sent */
+    uint32_t failed;                    /*!< batches the sender could not publish */
+    uint32_t full_flushes;
+    uint32_t age_flushes;
+    uint32_t state_flushes;
+} telemetry_batch_stats_t;
+
+/**
+ * The batch being filled
+ */
+typedef struct {
+    uint8_t* buffer;                    /*!< message buffer, capacity bytes */
+    size_t capacity;
+    uint8_t max_samples;
+    uint32_t max_age_ms;
+    uint8_t schema;                     /*!< TELEMETRY_SCHEMA of a telemetry frame, TELEMETRY_BATCH_CSV for CSV rows */
+    size_t length;                      /*!< bytes used */
+    uint8_t count;                      /*!< samples in the batch */
+    uint32_t first_ms;                  /*!< when the first sample was added */
+    uint8_t state;                      /*!< flight state of the last sample added */
+    TELEMETRY_FLUSH due;                /*!< set once the batch must be sent */
+    telemetry_batch_stats_t stats;
+    telemetry_batch_stats_t reported;   /*!< stats at the last report */
+    uint32_t reported_ms;
+} telemetry_batch_t;
+
+/**
+ * Sample decimation for a link slower than the sample rate - keeps every divider-th
+ * sample, and the first sample in a new flight state
+ */
+typedef struct {
+    uint8_t divider;                    /*!< keep one sample in divider, 1 keeps them all */
+    uint8_t skipped;                    /*!< samples dropped since the last one kept */
+    uint8_t state;                      /*!< flight state of the last sample kept */
+} telemetry_decimator_t;
+
+void telemetryBatchInit(telemetry_batch_t* batch, uint8_t* buffer, size_t capacity, uint8_t max_samples, uint32_t max_age_ms);
+bool telemetryBatchAddFields(telemetry_batch_t* batch, const int32_t* fields, uint32_t now_ms);
+bool telemetryBatchAddDelta(telemetry_batch_t* batch, telemetry_delta_encoder_t* encoder, const int32_t* fields, uint32_t now_ms);
+bool telemetryBatchAddRow(telemetry_batch_t* batch, const char* row, size_t len, uint8_t state, uint32_t now_ms);
+TELEMETRY_FLUSH telemetryBatchDue(telemetry_batch_t* batch, uint32_t now_ms);
+uint32_t telemetryBatchWaitMs(const telemetry_batch_t* batch, uint32_t now_ms);
+void telemetryBatchSent(telemetry_batch_t* batch, bool published);
+size_t telemetryBatchFormatStats(telemetry_batch_t* batch, char* buffer, size_t len, uint32_t now_ms);
+
+void telemetryDecimatorInit(telemetry_decimator_t* decimator, uint8_t divider);
+bool telemetryDecimatorKeep(telemetry_decimator_t* decimator, uint8_t state);
+
+#endif // TELEMETRY_BATCH_H
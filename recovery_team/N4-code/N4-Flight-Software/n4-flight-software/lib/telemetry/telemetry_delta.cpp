@@ -0,0 +1,173 @@
+/**
+ * @file telemetry_delta.cpp
+ * @brief Encode and decode delta compressed telemetry streams
+ */
+
+#include <string.h>
+#include "telemetry_delta.h"
+
+/**
+ * @brief start a stream. The first sample is a keyframe with sequence number 0
+ * @param keyframe_interval samples from one keyframe to the next, at most
+ * FLIGHT_LOG_KEYFRAME_INTERVAL
+ */
+void telemetryDeltaEncoderInit(telemetry_delta_encoder_t* encoder, uint16_t keyframe_interval) {
+    flightLogCodecReset(&encoder->codec);
+    encoder->sequence = 0;
+    encoder->keyframe_interval = keyframe_interval ? keyframe_interval : 1;
+}
+
+/**
+ * @brief fill in the header of a frame whose first sample is the next one encoded
+ * @param buffer at least TELEMETRY_DELTA_HEADER_SIZE bytes
+ * @param count samples that follow
+ * @return number of bytes written
+ */
+size_t telemetryDeltaEncodeHeader(const telemetry_delta_encoder_t* encoder, uint8_t* buffer, uint8_t count) {
+    size_t len = telemetryFrameEncodeHeader(buffer, TELEMETRY_SCHEMA_DELTA, count);
+    buffer[len++] = encoder->sequence;
+    buffer[len++] = encoder->sequence >> 8;
+
+    return len;
+}
+
+/**
+ * @brief compress the next sample of the stream
+ * @param fields FLIGHT_LOG_FIELD_COUNT scaled values, see flightLogToFields()
+ * @param buffer at least FLIGHT_LOG_FRAME_BUFFER_SIZE bytes of scratch space
+ * @return sample size in bytes, at most TELEMETRY_DELTA_MAX_SAMPLE_SIZE
+ */
+size_t telemetryDeltaEncode(telemetry_delta_encoder_t* encoder, const int32_t* fields, uint8_t* buffer) {
+    if(encoder->sequence % encoder->keyframe_interval == 0) {
+        // forget the history so that the codec writes a keyframe
+        flightLogCodecReset(&encoder->codec);
+    }
+
+    encoder->sequence++;
+    return flightLogCompress(&encoder->codec, fields, buffer);
+}
+
+/**
+ * @brief start receiving a stream. Nothing decodes until the first keyframe
+ */
+void telemetryDeltaDecoderInit(telemetry_delta_decoder_t* decoder) {
+    memset(decoder, 0, sizeof(*decoder));
+    flightLogCodecReset(&decoder->codec);
+}
+
+/**
+ * @brief size of a sample without decoding it - to step over the samples that cannot be
+ * decoded while waiting for a keyframe
+ * @return 0 if the sample is truncated or corrupt
+ */
+static size_t sampleSize(const uint8_t* buffer, size_t len) {
+    if(len < 1) {
+        return 0;
+    } else if(buffer[0] == FLIGHT_LOG_KEYFRAME_TAG) {
+        return len < FLIGHT_LOG_KEYFRAME_SIZE ? 0 : FLIGHT_LOG_KEYFRAME_SIZE;
+    } else if(buffer[0] >= 1 << (FLIGHT_LOG_FIELD_COUNT - 16) || len < 3) {
+        return 0;
+    }
+
+    uint32_t changed = ((uint32_t)buffer[0] << 16) | ((uint32_t)buffer[1] << 8) | buffer[2];
+    size_t size = 3;
+
+    // one varint per changed field - the last byte of each has the top bit clear
+    while(changed) {
+        if(!(changed & 1)) {
+            changed >>= 1;
+            continue;
+        }
+
+        while(size < len && (buffer[size] & 0x80)) {
+            size++;
+        }
+        if(size >= len) {
+            return 0;
+        }
+        size++;
+        changed >>= 1;
+    }
+
+    return size;
+}
+
+/**
+ * @brief decode the samples of a received frame
+ * Frames must be passed in the order they were received. A frame that does not continue the
+ * sequence counts the missing samples as lost, and its samples are dropped up to the next
+ * keyframe.
+ * @param frame from telemetryFrameDecode(), TELEMETRY_SCHEMA_DELTA
+ * @param fields frame->count rows of FLIGHT_LOG_FIELD_COUNT values
+ * @param sequences frame->count sequence numbers, one per decoded sample
+ * @param decoded number of samples written to fields and sequences
+ * @return TELEMETRY_CORRUPT or TELEMETRY_TRUNCATED if a sample did not decode - the samples
+ * before it are still valid, the decoder waits for the next keyframe
+ */
+TELEMETRY_STATUS telemetryDeltaDecode(telemetry_delta_decoder_t* decoder, const telemetry_frame_t* frame,
+                                      int32_t (*fields)[FLIGHT_LOG_FIELD_COUNT], uint16_t* sequences, uint8_t* decoded) {
+    *decoded = 0;
+    if(frame->schema != TELEMETRY_SCHEMA_DELTA) {
+        return TELEMETRY_UNKNOWN_SCHEMA;
+    }
+
+    decoder->stats.frames++;
+
+    if(decoder->started && frame->sequence != decoder->expected) {
+        // a jump back means the sender restarted - nothing to count as lost
+        uint16_t gap = frame->sequence - decoder->expected;
+        if(gap < 0x8000) {
+            decoder->stats.lost += gap;
+        }
+
+        if(decoder->synced) {
+            decoder->stats.resyncs++;
+        }
+        decoder->synced = false;
+    }
+    decoder->started = true;
+    decoder->expected = frame->sequence + frame->count;
+
+    const uint8_t* p = frame->samples;
+    size_t remaining = frame->length;
+
+    for(uint8_t i = 0; i < frame->count; i++) {
+        if(!decoder->synced && (remaining < 1 || p[0] != FLIGHT_LOG_KEYFRAME_TAG)) {
+            size_t size = sampleSize(p, remaining);
+            if(size == 0) {
+                decoder->stats.corrupt++;
+                decoder->stats.skipped += frame->count - i;
+                return remaining < 1 ? TELEMETRY_TRUNCATED : TELEMETRY_CORRUPT;
+            }
+
+            decoder->stats.skipped++;
+            p += size;
+            remaining -= size;
+            continue;
+        }
+
+        size_t used;
+        FLIGHT_LOG_STATUS status = flightLogDecompress(&decoder->codec, p, remaining, fields[*decoded], &used);
+        if(status != FLIGHT_LOG_OK) {
+            // the rest of the frame cannot be trusted
+            decoder->synced = false;
+            decoder->stats.resyncs++;
+            decoder->stats.corrupt++;
+            decoder->stats.skipped += frame->count - i;
+            return status == FLIGHT_LOG_TRUNCATED ? TELEMETRY_TRUNCATED : TELEMETRY_CORRUPT;
+        }
+
+        if(p[0] == FLIGHT_LOG_KEYFRAME_TAG) {
+            decoder->stats.keyframes++;
+        }
+        decoder->synced = true;
+        decoder->stats.samples++;
+        sequences[*decoded] = frame->sequence + i;
+        (*decoded)++;
+
+        p += used;
+        remaining -= used;
+    }
+
+    return TELEMETRY_OK;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file telemetry_delta.h
+ * @brief Delta compressed telemetry with keyframes and sequence numbers
+ *
+ * Most fields barely change from one sample to the next, so TELEMETRY_SCHEMA_DELTA frames
+ * carry the samples compressed with the flight log codec, see flight_log_codec.h: a delta
+ * sample is a bitmap of the fields that changed and a zigzag varint per changed field,
+ * typically a few bytes instead of FLIGHT_LOG_RECORD_SIZE.
+ *
+ * A delta can only be decoded by a receiver that has every sample before it, and a radio
+ * link loses messages. So:
+ * - every sample has a 16 bit sequence number. A frame holds the number of its first
+ *   sample, and the samples that follow are numbered one after the other
+ * - every keyframe_interval samples the encoder sends a keyframe, the full record, that
+ *   decodes on its own
+ * - when a frame does not start at the expected sequence number, the decoder counts the
+ *   missing samples and drops every sample until the next keyframe, since their deltas
+ *   build on samples it never got
+ *
+ * A lost message therefore costs at most keyframe_interval samples, never the rest of the
+ * stream.
+ */
+
+#ifndef TELEMETRY_DELTA_H
+#define TELEMETRY_DELTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "flight_log_codec.h"
+#include "telemetry_frame.h"
+
+#define TELEMETRY_DELTA_MAX_SAMPLE_SIZE FLIGHT_LOG_KEYFRAME_SIZE    /*!< largest sample telemetryDeltaEncode() writes */
+#define TELEMETRY_KEYFRAME_INTERVAL 20                              /*!< samples from one keyframe to the next - the most samples a lost message costs. At most 64 */
+
+/**
+ * Sender side stream state
+ */
+typedef struct {
+    flight_log_codec_t codec;
+    uint16_t sequence;                  /*!< sequence number of the next sample */
+    uint16_t keyframe_interval;         /*!< samples from one keyframe to the next */
+} telemetry_delta_encoder_t;
+
+/**
+ * A structure to hold the receiver statistics
+ */
+typedef struct {
+    uint32_t frames;                    /*!< delta frames received */
+    uint32_t samples;                   /*!< samples decoded */
+    uint32_t keyframes;                 /*!< keyframes decoded */
+    uint32_t lost;                      /*!< samples missing from the sequence */
+    uint32_t skipped;                   /*!< samples received but dropped while waiting for a keyframe */
+    uint32_t resyncs;                   /*!< times the decoder lost the stream and waited for a keyframe */
+    uint32_t corrupt;                   /*!< frames with a sample that did not decode */
+} telemetry_delta_stats_t;
+
+/**
+ * Receiver side stream state
+ */
+typedef struct {
+    flight_log_codec_t codec;
+    uint16_t expected;                  /*!< sequence number of the next sample */
+    bool started;                       /*!< false until the first frame - nothing is lost before it */
+    bool synced;                        /*!< false until a keyframe, and again after every loss */
+    telemetry_delta_stats_t stats;
+} telemetry_delta_decoder_t;
+
+void telemetryDeltaEncoderInit(telemetry_delta_encoder_t* encoder, uint16_t keyframe_interval);
+size_t telemetryDeltaEncodeHeader(const telemetry_delta_encoder_t* encoder, uint8_t* buffer, uint8_t count);
+size_t telemetryDeltaEncode(telemetry_delta_encoder_t* encoder, const int32_t* fields, uint8_t* buffer);
+
+void telemetryDeltaDecoderInit(telemetry_delta_decoder_t* decoder);
+TELEMETRY_STATUS telemetryDeltaDecode(telemetry_delta_decoder_t* decoder, const telemetry_frame_t* frame,
+                                      int32_t (*fields)[FLIGHT_LOG_FIELD_COUNT], uint16_t* sequences, uint8_t* decoded);
+
+#endif // TELEMETRY_DELTA_H
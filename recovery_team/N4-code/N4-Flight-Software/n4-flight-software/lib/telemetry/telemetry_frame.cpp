@@ -0,0 +1,93 @@
+/**
+ * @file telemetry_frame.cpp
+ * @brief Encode and decode binary telemetry frames
+ */
+
+#include "telemetry_frame.h"
+
+/**
+ * @brief fill in the frame header
+ * @param buffer at least TELEMETRY_FRAME_HEADER_SIZE bytes
+ * @param schema TELEMETRY_SCHEMA of the samples that follow
+ * @param count samples that follow
+ * @return number of bytes written
+ */
+size_t telemetryFrameEncodeHeader(uint8_t* buffer, uint8_t schema, uint8_t count) {
+    buffer[0] = TELEMETRY_FRAME_MAGIC;
+    buffer[1] = TELEMETRY_FRAME_VERSION;
+    buffer[2] = schema;
+    buffer[3] = count;
+
+    return TELEMETRY_FRAME_HEADER_SIZE;
+}
+
+/**
+ * @brief build a frame holding one sample
+ * @param buffer at least TELEMETRY_FRAME_SIZE(1) bytes
+ * @param fields FLIGHT_LOG_FIELD_COUNT scaled values, see flightLogToFields()
+ * @return number of bytes written
+ */
+size_t telemetryFrameEncode(uint8_t* buffer, const int32_t* fields) {
+    size_t len = telemetryFrameEncodeHeader(buffer, TELEMETRY_SCHEMA_RECORD, 1);
+    return len + flightLogPackFields(fields, buffer + len);
+}
+
+/**
+ * @brief check a received frame and find its samples
+ * @param buffer the received message
+ * @param len bytes in the message
+ * @param frame decoded header. samples points into buffer
+ * @return TELEMETRY_BAD_MAGIC if the message is not a frame
+ */
+TELEMETRY_STATUS telemetryFrameDecode(const uint8_t* buffer, size_t len, telemetry_frame_t* frame) {
+    if(len < TELEMETRY_FRAME_HEADER_SIZE || buffer[0] != TELEMETRY_FRAME_MAGIC) {
+        return TELEMETRY_BAD_MAGIC;
+    } else if(buffer[1] != TELEMETRY_FRAME_VERSION) {
+        return TELEMETRY_UNSUPPORTED_VERSION;
+    }
+
+    frame->version = buffer[1];
+    frame->schema = buffer[2];
+    frame->count = buffer[3];
+    frame->sequence = 0;
+
+    if(frame->schema == TELEMETRY_SCHEMA_RECORD) {
+        if(len < TELEMETRY_FRAME_SIZE((size_t)frame->count)) {
+            return TELEMETRY_TRUNCATED;
+        }
+
+        frame->samples = buffer + TELEMETRY_FRAME_HEADER_SIZE;
+        frame->length = (size_t)frame->count * FLIGHT_LOG_RECORD_SIZE;
+    } else if(frame->schema == TELEMETRY_SCHEMA_DELTA) {
+        // the samples vary in size - telemetryDeltaDecode() finds out whether they are all there
+        if(len < TELEMETRY_DELTA_HEADER_SIZE) {
+            return TELEMETRY_TRUNCATED;
+        }
+
+        frame->sequence = buffer[4] | (buffer[5] << 8);
+        frame->samples = buffer + TELEMETRY_DELTA_HEADER_SIZE;
+        frame->length = len - TELEMETRY_DELTA_HEADER_SIZE;
+    } else {
+        return TELEMETRY_UNKNOWN_SCHEMA;
+    }
+
+    return TELEMETRY_OK;
+}
+
+/**
+ * @brief unpack one sample of a decoded TELEMETRY_SCHEMA_RECORD frame. Delta frames are
+ * decoded in order with telemetryDeltaDecode()
+ * @param frame from telemetryFrameDecode()
+ * @param index sample number, below frame->count
+ * @param fields FLIGHT_LOG_FIELD_COUNT scaled values, see flightLogFromFields()
+ */
+TELEMETRY_STATUS telemetryFrameSample(const telemetry_frame_t* frame, uint8_t index, int32_t* fields) {
+    if(frame->schema != TELEMETRY_SCHEMA_RECORD) {
+        return TELEMETRY_UNKNOWN_SCHEMA;
+    } else if(index >= frame->count) {
+        return TELEMETRY_TRUNCATED;
+    }
+
+    flightLogUnpackFields(frame->samples + (size_t)index * FLIGHT_LOG_RECORD_SIZE, fields);
+    return TELEMETRY_OK;
+}
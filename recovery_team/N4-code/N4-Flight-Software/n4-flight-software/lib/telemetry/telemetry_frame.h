@@ -0,0 +1,84 @@
+/**
+ * @file telemetry_frame.h
+ * @brief Binary telemetry frame sent to ground, shared by the flight software and the ground
+ * tools
+ *
+ * A frame is one MQTT message. It starts with a 4 byte header, followed by the samples in
+ * the layout given by the schema ID:
+ *
+ * | field   | type   |                                                        |
+ * |---------|--------|--------------------------------------------------------|
+ * | magic   | uint8  | TELEMETRY_FRAME_MAGIC                                  |
+ * | version | uint8  | TELEMETRY_FRAME_VERSION - the layout of this header    |
+ * | schema  | uint8  | TELEMETRY_SCHEMA - the layout of the samples           |
+ * | count   | uint8  | samples in the frame                                   |
+ *
+ * TELEMETRY_SCHEMA_RECORD samples are fixed size flight log records, see flight_log.h and
+ * flight_log_fields.def, so the ground sees the same scaled integers as the flight log.
+ *
+ * TELEMETRY_SCHEMA_DELTA samples start with the uint16 sequence number of the first sample,
+ * followed by count delta compressed samples, see telemetry_delta.h.
+ *
+ * The magic is not a printable character, so the ground can tell a frame from a CSV
+ * telemetry row by its first byte. Every value is little-endian.
+ */
+
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "flight_log.h"
+
+#define TELEMETRY_FRAME_MAGIC 0xD4              /*!< first byte of a frame */
+#define TELEMETRY_FRAME_VERSION 1               /*!< bump on every frame header layout change */
+#define TELEMETRY_FRAME_HEADER_SIZE 4           /*!< bytes before the first sample */
+#define TELEMETRY_FRAME_MAX_SAMPLES 255         /*!< the count is one byte */
+#define TELEMETRY_DELTA_HEADER_SIZE (TELEMETRY_FRAME_HEADER_SIZE + 2)  /*!< bytes before the first sample of a TELEMETRY_SCHEMA_DELTA frame */
+
+/**
+ * Sample layouts
+ */
+typedef enum {
+    TELEMETRY_SCHEMA_RECORD = 1,        /*!< FLIGHT_LOG_RECORD_SIZE byte flight log records */
+    TELEMETRY_SCHEMA_DELTA = 2          /*!< sequence number, then flight log codec frames */
+} TELEMETRY_SCHEMA;
+
+static_assert(FLIGHT_LOG_RECORD_SIZE == 47 && FLIGHT_LOG_FIELD_COUNT == 18,
+              "the flight log record changed - add a telemetry schema for it");
+
+/**
+ * @brief bytes in a TELEMETRY_SCHEMA_RECORD frame of count samples
+ */
+#define TELEMETRY_FRAME_SIZE(count) (TELEMETRY_FRAME_HEADER_SIZE + (count) * FLIGHT_LOG_RECORD_SIZE)
+
+/**
+ * Status of decoding a frame
+ */
+typedef enum {
+    TELEMETRY_OK = 0,
+    TELEMETRY_BAD_MAGIC,                /*!< not a frame - e.g. a CSV row */
+    TELEMETRY_UNSUPPORTED_VERSION,      /*!< sent by a newer frame layout */
+    TELEMETRY_UNKNOWN_SCHEMA,           /*!< sample layout this decoder does not know */
+    TELEMETRY_TRUNCATED,                /*!< shorter than its header says */
+    TELEMETRY_CORRUPT                   /*!< a sample does not decode */
+} TELEMETRY_STATUS;
+
+/**
+ * A decoded frame header
+ */
+typedef struct {
+    uint8_t version;                /*!< TELEMETRY_FRAME_VERSION */
+    uint8_t schema;                 /*!< TELEMETRY_SCHEMA */
+    uint8_t count;                  /*!< samples in the frame */
+    uint16_t sequence;              /*!< sequence number of the first sample - TELEMETRY_SCHEMA_DELTA only */
+    const uint8_t* samples;         /*!< first sample, inside the decoded buffer */
+    size_t length;                  /*!< bytes from samples to the end of the frame */
+} telemetry_frame_t;
+
+size_t telemetryFrameEncodeHeader(uint8_t* buffer, uint8_t schema, uint8_t count);
+size_t telemetryFrameEncode(uint8_t* buffer, const int32_t* fields);
+TELEMETRY_STATUS telemetryFrameDecode(const uint8_t* buffer, size_t len, telemetry_frame_t* frame);
+TELEMETRY_STATUS telemetryFrameSample(const telemetry_frame_t* frame, uint8_t index, int32_t* fields);
+
+#endif // TELEMETRY_FRAME_H
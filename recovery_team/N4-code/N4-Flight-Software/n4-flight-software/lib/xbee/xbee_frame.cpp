@@ -0,0 +1,189 @@
+/**
+ * @file xbee_frame.cpp
+ * @brief Encode and parse XBee API mode frames
+ */
+
+#include <string.h>
+#include "xbee_frame.h"
+
+/* parser states */
+#define WAIT_DELIMITER 0
+#define LENGTH_HIGH 1
+#define LENGTH_LOW 2
+#define FRAME_DATA 3
+#define CHECKSUM 4
+
+/**
+ * @brief true for the bytes that must be escaped after the delimiter
+ */
+static inline bool needsEscape(uint8_t byte) {
+    return byte == XBEE_START_DELIMITER || byte == XBEE_ESCAPE || byte == XBEE_XON || byte == XBEE_XOFF;
+}
+
+/**
+ * @brief write one byte, escaped if it has to be
+ * @return bytes written
+ */
+static inline size_t putEscaped(uint8_t* buffer, uint8_t byte) {
+    if(needsEscape(byte)) {
+        buffer[0] = XBEE_ESCAPE;
+        buffer[1] = byte ^ XBEE_ESCAPE_XOR;
+        return 2;
+    }
+
+    buffer[0] = byte;
+    return 1;
+}
+
+/**
+ * @brief build a Transmit Request frame, escaped and ready for the UART
+ * @param buffer at least XBEE_TRANSMIT_BUFFER_SIZE(len) bytes
+ * @param destination 64 bit address of the receiving module, XBEE_BROADCAST for all
+ * @param frame_id 0 asks the module not to answer with a Transmit Status frame
+ * @param data RF data
+ * @param len at most XBEE_MAX_RF_DATA bytes
+ * @return bytes written, 0 if the data is too long
+ */
+size_t xbeeEncodeTransmit(uint8_t* buffer, uint64_t destination, uint8_t frame_id, const uint8_t* data, size_t len) {
+    if(len > XBEE_MAX_RF_DATA) {
+        return 0;
+    }
+
+    uint8_t header[XBEE_TRANSMIT_HEADER_SIZE];
+    header[0] = XBEE_API_TRANSMIT_REQUEST;
+    header[1] = frame_id;
+    for(uint8_t i = 0; i < 8; i++) {
+        header[2 + i] = destination >> (56 - 8 * i);
+    }
+    header[10] = 0xFF;                  // 16 bit address unknown
+    header[11] = 0xFE;
+    header[12] = 0;                     // broadcast radius - the maximum
+    header[13] = 0;                     // transmit options - the module defaults
+
+    uint16_t length = XBEE_TRANSMIT_HEADER_SIZE + len;
+    uint8_t sum = 0;
+    size_t n = 0;
+
+    buffer[n++] = XBEE_START_DELIMITER;
+    n += putEscaped(buffer + n, length >> 8);
+    n += putEscaped(buffer + n, length);
+
+    for(uint8_t i = 0; i < XBEE_TRANSMIT_HEADER_SIZE; i++) {
+        sum += header[i];
+        n += putEscaped(buffer + n, header[i]);
+    }
+    for(size_t i = 0; i < len; i++) {
+        sum += data[i];
+        n += putEscaped(buffer + n, data[i]);
+    }
+
+    n += putEscaped(buffer + n, 0xFF - sum);
+    return n;
+}
+
+/**
+ * @brief start parsing a byte stream. Bytes before the first delimiter are discarded
+ */
+void xbeeParserInit(xbee_parser_t* parser) {
+    parser->state = WAIT_DELIMITER;
+    parser->escaped = false;
+    parser->length = 0;
+    parser->received = 0;
+    parser->sum = 0;
+    memset(&parser->stats, 0, sizeof(parser->stats));
+}
+
+/**
+ * @brief feed the next byte received from the module
+ * @return XBEE_PARSE_FRAME once a frame is complete - its frame data is in parser->data,
+ * parser->length bytes, until the next call
+ */
+XBEE_PARSE xbeeParse(xbee_parser_t* parser, uint8_t byte) {
+    if(byte == XBEE_START_DELIMITER) {
+        // a delimiter is never escaped, so it always starts a new frame
+        if(parser->state != WAIT_DELIMITER) {
+            parser->stats.discarded += parser->received + 1;
+        }
+        parser->state = LENGTH_HIGH;
+        parser->escaped = false;
+        return XBEE_PARSE_MORE;
+    }
+
+    if(parser->state == WAIT_DELIMITER) {
+        parser->stats.discarded++;
+        return XBEE_PARSE_MORE;
+    }
+
+    if(byte == XBEE_ESCAPE) {
+        parser->escaped = true;
+        return XBEE_PARSE_MORE;
+    } else if(parser->escaped) {
+        byte ^= XBEE_ESCAPE_XOR;
+        parser->escaped = false;
+    }
+
+    switch(parser->state) {
+        case LENGTH_HIGH:
+            parser->length = byte << 8;
+            parser->state = LENGTH_LOW;
+            break;
+
+        case LENGTH_LOW:
+            parser->length |= byte;
+            parser->received = 0;
+            parser->sum = 0;
+            if(parser->length > XBEE_MAX_FRAME_DATA) {
+                parser->state = WAIT_DELIMITER;
+                parser->stats.too_long++;
+                return XBEE_PARSE_TOO_LONG;
+            }
+            parser->state = parser->length ? FRAME_DATA : CHECKSUM;
+            break;
+
+        case FRAME_DATA:
+            parser->data[parser->received++] = byte;
+            parser->sum += byte;
+            if(parser->received == parser->length) {
+                parser->state = CHECKSUM;
+            }
+            break;
+
+        case CHECKSUM:
+            parser->state = WAIT_DELIMITER;
+            if((uint8_t)(parser->sum + byte) != 0xFF) {
+                parser->stats.bad_checksum++;
+                return XBEE_PARSE_BAD_CHECKSUM;
+            }
+            parser->stats.frames++;
+            return XBEE_PARSE_FRAME;
+    }
+
+    return XBEE_PARSE_MORE;
+}
+
+/**
+ * @brief find the RF data of a Transmit Request or Receive Packet frame
+ * @param frame frame data, e.g. parser->data
+ * @param len frame data length
+ * @param data set to the first byte of RF data, inside frame
+ * @param data_len set to the RF data length
+ * @return false for any other frame type, or a frame too short for its header
+ */
+bool xbeeFrameRfData(const uint8_t* frame, size_t len, const uint8_t** data, size_t* data_len) {
+    size_t header;
+    if(len > 0 && frame[0] == XBEE_API_TRANSMIT_REQUEST) {
+        header = XBEE_TRANSMIT_HEADER_SIZE;
+    } else if(len > 0 && frame[0] == XBEE_API_RECEIVE_PACKET) {
+        header = XBEE_RECEIVE_HEADER_SIZE;
+    } else {
+        return false;
+    }
+
+    if(len < header) {
+        return false;
+    }
+
+    *data = frame + header;
+    *data_len = len - header;
+    return true;
+}
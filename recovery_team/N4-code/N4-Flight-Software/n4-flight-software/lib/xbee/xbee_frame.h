@@ -0,0 +1,89 @@
+/**
+ * @file xbee_frame.h
+ * @brief XBee API mode frames, shared by the flight software and the ground tools
+ *
+ * In API mode the XBee exchanges framed packets with its host instead of a raw byte stream:
+ *
+ * | field      | size   |                                                       |
+ * |------------|--------|-------------------------------------------------------|
+ * | delimiter  | 1      | XBEE_START_DELIMITER                                  |
+ * | length     | 2      | big-endian, bytes of frame data                       |
+ * | frame data | length | frame type, then the fields of that frame type        |
+ * | checksum   | 1      | 0xFF less the low byte of the sum of the frame data   |
+ *
+ * The modules must run with AP=2, escaped API mode: after the delimiter every 0x7E, 0x7D,
+ * 0x11 and 0x13 is sent as XBEE_ESCAPE followed by the byte XOR 0x20. A delimiter then only
+ * ever starts a frame, so a receiver that lost bytes resynchronises at the next one.
+ *
+ * The flight computer sends telemetry in Transmit Request frames (0x10). The ground XBee
+ * hands it to its host in Receive Packet frames (0x90). Both carry the payload - the RF
+ * data - after a fixed header, see xbeeFrameRfData().
+ */
+
+#ifndef XBEE_FRAME_H
+#define XBEE_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define XBEE_START_DELIMITER 0x7E
+#define XBEE_ESCAPE 0x7D
+#define XBEE_ESCAPE_XOR 0x20
+#define XBEE_XON 0x11
+#define XBEE_XOFF 0x13
+
+#define XBEE_API_TRANSMIT_REQUEST 0x10          /*!< host to module: send RF data */
+#define XBEE_API_RECEIVE_PACKET 0x90            /*!< module to host: RF data received */
+#define XBEE_TRANSMIT_HEADER_SIZE 14            /*!< type, frame ID, 64 bit and 16 bit destination, radius, options */
+#define XBEE_RECEIVE_HEADER_SIZE 12             /*!< type, 64 bit and 16 bit source, options */
+
+#define XBEE_BROADCAST 0x000000000000FFFFULL    /*!< 64 bit broadcast address */
+#define XBEE_MAX_RF_DATA 256                    /*!< largest payload - NP of the XBee-PRO 900HP. Other modules may take less */
+#define XBEE_MAX_FRAME_DATA (XBEE_TRANSMIT_HEADER_SIZE + XBEE_MAX_RF_DATA)   /*!< largest frame data the parser accepts */
+
+/**
+ * @brief worst case bytes on the wire for a transmit request with len bytes of RF data -
+ * every byte after the delimiter escaped
+ */
+#define XBEE_TRANSMIT_BUFFER_SIZE(len) (1 + 2 * (2 + XBEE_TRANSMIT_HEADER_SIZE + (len) + 1))
+
+/**
+ * Result of feeding one byte to the parser
+ */
+typedef enum {
+    XBEE_PARSE_MORE = 0,                /*!< no complete frame yet */
+    XBEE_PARSE_FRAME,                   /*!< parser->data holds a frame with a good checksum */
+    XBEE_PARSE_BAD_CHECKSUM,            /*!< a frame arrived damaged and was dropped */
+    XBEE_PARSE_TOO_LONG                 /*!< a frame longer than XBEE_MAX_FRAME_DATA was dropped */
+} XBEE_PARSE;
+
+/**
+ * A structure to hold the parser statistics
+ */
+typedef struct {
+    uint32_t frames;                    /*!< frames with a good checksum */
+    uint32_t bad_checksum;
+    uint32_t too_long;
+    uint32_t discarded;                 /*!< bytes outside any frame, or in a frame cut short by a delimiter */
+} xbee_parser_stats_t;
+
+/**
+ * Receiver state - one per byte stream
+ */
+typedef struct {
+    uint8_t state;                      /*!< which part of the frame comes next */
+    bool escaped;                       /*!< the previous byte was XBEE_ESCAPE */
+    uint16_t length;                    /*!< frame data length from the header */
+    uint16_t received;                  /*!< frame data bytes received */
+    uint8_t sum;                        /*!< running sum of the frame data */
+    uint8_t data[XBEE_MAX_FRAME_DATA];  /*!< frame data of the last frame */
+    xbee_parser_stats_t stats;
+} xbee_parser_t;
+
+size_t xbeeEncodeTransmit(uint8_t* buffer, uint64_t destination, uint8_t frame_id, const uint8_t* data, size_t len);
+
+void xbeeParserInit(xbee_parser_t* parser);
+XBEE_PARSE xbeeParse(xbee_parser_t* parser, uint8_t byte);
+bool xbeeFrameRfData(const uint8_t* frame, size_t len, const uint8_t** data, size_t* data_len);
+
+#endif // XBEE_FRAME_H
@@ -0,0 +1,180 @@
+/**
+ * @file trace_decoder.cpp
+ * @brief expand a binary trace file from the flight computer into readable log lines
+ *
+ * The event dictionary is built from src/trace_events.def, the same file the flight software
+ * is compiled with. A trace written with a different dictionary is refused, since its event
+ * IDs and arguments would be decoded wrongly.
+ *
+ * usage:
+ *   trace_decoder trace.bin           one line per event: time, level, event, message
+ *   trace_decoder --dictionary        the ID to format string dictionary as CSV
+ *
+ * build from this directory:
+ * g++ -O2 -std=c++11 -I../../src -I../../lib/flight_log trace_decoder.cpp ../../src/states.cpp -o trace_decoder
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "trace_format.h"
+#include "states.h"
+#include "flight_log_le.h"
+
+/**
+ * One dictionary entry
+ */
+typedef struct {
+    const char* name;
+    uint8_t level;
+    const char* format;
+} trace_dictionary_entry_t;
+
+static const trace_dictionary_entry_t dictionary[] = {
+    #define TRACE_EVENT(name, level, format) {#name, LOG_LEVEL::level, format},
+    #include "trace_events.def"
+    #undef TRACE_EVENT
+};
+
+static const char* levelString(uint8_t level) {
+    static const char* names[] = {"DEBUG", "INFO", "WARNING", "CRITICAL", "ERROR"};
+    return level < sizeof(names) / sizeof(names[0]) ? names[level] : "UNKNOWN";
+}
+
+/**
+ * @brief expand the format string of an event with its arguments
+ * Missing arguments print as "?", extra arguments are appended
+ */
+static void expand(FILE* out, const char* format, const int32_t* args, uint8_t arg_count) {
+    uint8_t next = 0;
+
+    for(const char* p = format; *p; p++) {
+        if(*p != '%' || p[1] == '\0') {
+            fputc(*p, out);
+            continue;
+        }
+
+        char conversion = *++p;
+        if(conversion == '%') {
+            fputc('%', out);
+            continue;
+        }
+
+        if(next >= arg_count) {
+            fputc('?', out);
+            continue;
+        }
+
+        int32_t arg = args[next++];
+        switch(conversion) {
+            case 'd':
+                fprintf(out, "%d", arg);
+                break;
+            case 'u':
+                fprintf(out, "%u", (uint32_t)arg);
+                break;
+            case 'x':
+                fprintf(out, "0x%x", (uint32_t)arg);
+                break;
+            case 'f': {
+                float value;
+                memcpy(&value, &arg, sizeof(value));
+                fprintf(out, "%g", value);
+                break;
+            }
+            case 'S':
+                fputs(flightStateString(arg), out);
+                break;
+            default:
+                fprintf(out, "%%%c", conversion);
+                break;
+        }
+    }
+
+    while(next < arg_count) {
+        fprintf(out, " [%d]", args[next++]);
+    }
+}
+
+static void printDictionary() {
+    printf("id,level,name,format\n");
+    for(uint8_t id = 0; id < TRACE_EVENT_COUNT; id++) {
+        printf("%u,%s,%s,\"%s\"\n", id, levelString(dictionary[id].level), dictionary[id].name, dictionary[id].format);
+    }
+}
+
+static int decode(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) {
+        fprintf(stderr, "could not open %s\n", path);
+        return 1;
+    }
+
+    uint8_t header[TRACE_HEADER_SIZE];
+    if(fread(header, 1, sizeof(header), f) != sizeof(header) || get32(header) != TRACE_MAGIC) {
+        fprintf(stderr, "%s is not a trace file\n", path);
+        fclose(f);
+        return 1;
+    }
+
+    if(header[4] != TRACE_VERSION) {
+        fprintf(stderr, "trace version %u, this decoder reads version %u\n", header[4], TRACE_VERSION);
+        fclose(f);
+        return 1;
+    }
+
+    uint32_t hash = get32(header + 8);
+    if(hash != TRACE_DICTIONARY_HASH) {
+        fprintf(stderr, "trace written with another dictionary (%u events, hash %08x, expected %u events, hash %08x)\n"
+                        "rebuild the decoder from the trace_events.def the flight software was built with\n",
+                header[5], hash, TRACE_EVENT_COUNT, TRACE_DICTIONARY_HASH);
+        fclose(f);
+        return 1;
+    }
+
+    uint8_t record[TRACE_RECORD_MAX_SIZE];
+    uint32_t events = 0;
+
+    while(fread(record, 1, TRACE_RECORD_HEADER_SIZE, f) == TRACE_RECORD_HEADER_SIZE) {
+        uint32_t timestamp_us = get32(record);
+        uint8_t id = record[4];
+        uint8_t arg_count = record[5];
+
+        if(id >= TRACE_EVENT_COUNT || arg_count > TRACE_MAX_ARGS) {
+            fprintf(stderr, "corrupt record after %u events\n", events);
+            fclose(f);
+            return 1;
+        }
+
+        int32_t args[TRACE_MAX_ARGS];
+        if(fread(record + TRACE_RECORD_HEADER_SIZE, 4, arg_count, f) != arg_count) {
+            fprintf(stderr, "trace truncated after %u events\n", events);
+            break;
+        }
+        for(uint8_t i = 0; i < arg_count; i++) {
+            args[i] = get32(record + TRACE_RECORD_HEADER_SIZE + 4 * i);
+        }
+
+        printf("%10.6f %-8s %-20s ", timestamp_us / 1e6, levelString(dictionary[id].level), dictionary[id].name);
+        expand(stdout, dictionary[id].format, args, arg_count);
+        printf("\n");
+        events++;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if(argc == 2 && strcmp(argv[1], "--dictionary") == 0) {
+        printDictionary();
+        return 0;
+    }
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s trace.bin | --dictionary\n", argv[0]);
+        return 1;
+    }
+
+    return decode(argv[1]);
+}
@@ -0,0 +1,154 @@
+/**
+ * @file cyclic_executive.cpp
+ * @brief Implement the cyclic executive frame timing functions
+ */
+
+#include "cyclic_executive.h"
+
+#define TIMER_PRESCALER 80          /*!< 80MHz APB clock / 80 = 1us timer ticks */
+
+CyclicExecutive cyclic_executive;
+
+/**
+ * @brief timer interrupt - release the executive task
+ */
+static void IRAM_ATTR cyclicTimerISR() {
+    cyclic_executive.onTimer();
+}
+
+/**
+ * @brief class constructor
+ */
+CyclicExecutive::CyclicExecutive() {
+    this->resetStats();
+}
+
+/**
+ * @brief start the frame timer. Must be called from the task that runs the frames,
+ * so that the timer interrupt is allocated on the same core
+ *
+ * @param frame_rate frames per second
+ * @param timer_id hardware timer to use (0-3)
+ * @return true on success and false on fail
+ */
+bool CyclicExecutive::begin(uint32_t frame_rate, uint8_t timer_id) {
+    this->_task = xTaskGetCurrentTaskHandle();
+    this->_period_us = 1000000UL / frame_rate;
+    this->_frame_number = 0;
+
+    this->_timer = timerBegin(timer_id, TIMER_PRESCALER, true);
+    if(this->_timer == NULL) {
+        return false;
+    }
+
+    timerAttachInterrupt(this->_timer, &cyclicTimerISR, true);
+    timerAlarmWrite(this->_timer, this->_period_us, true);
+    timerAlarmEnable(this->_timer);
+
+    return true;
+}
+
+/**
+ * @brief called from the timer interrupt
+ */
+void IRAM_ATTR CyclicExecutive::onTimer() {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    this->_release_us = micros();
+    vTaskNotifyGiveFromISR(this->_task, &higher_priority_task_woken);
+
+    if(higher_priority_task_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/**
+ * @brief block until the timer releases the next frame
+ * @return the frame number. It counts timer releases, including missed ones, so that
+ * sub-frame schedules stay phase locked to the timer
+ */
+uint32_t CyclicExecutive::waitForFrame() {
+    uint32_t releases = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    this->_frame_start_us = micros();
+    this->_frame_release_us = this->_release_us;
+
+    uint32_t release_latency = this->_frame_start_us - this->_frame_release_us;
+    this->_stats.release_latency_sum_us += release_latency;
+    if(release_latency > this->_stats.release_latency_max_us) {
+        this->_stats.release_latency_max_us = release_latency;
+    }
+
+    if(releases > 1) {
+        this->_stats.missed_frames += releases - 1;
+    } else if(this->_frame_number > 0) {
+        // only compare back to back frames
+        uint32_t interval = this->_frame_start_us - this->_previous_start_us;
+        uint32_t jitter = interval > this->_period_us ? interval - this->_period_us : this->_period_us - interval;
+        if(jitter > this->_stats.period_jitter_max_us) {
+            this->_stats.period_jitter_max_us = jitter;
+        }
+    }
+
+    this->_previous_start_us = this->_frame_start_us;
+    this->_frame_number += releases;
+
+    return this->_frame_number;
+}
+
+/**
+ * @brief mark the end of the frame work
+ */
+void CyclicExecutive::endFrame() {
+    uint32_t now = micros();
+    uint32_t exec_time = now - this->_frame_start_us;
+    uint32_t response_time = now - this->_frame_release_us;
+
+    this->_stats.frames++;
+
+    if(exec_time > this->_stats.exec_max_us) {
+        this->_stats.exec_max_us = exec_time;
+    }
+
+    if(response_time > this->_stats.response_max_us) {
+        this->_stats.response_max_us = response_time;
+    }
+
+    // the next release has already happened - this frame ran late
+    if(response_time > this->_period_us) {
+        this->_stats.overruns++;
+    }
+}
+
+/**
+ * @brief convert a wait time to a whole number of frames, rounding up
+ */
+uint32_t CyclicExecutive::framesForMs(uint32_t ms) {
+    return (ms * 1000UL + this->_period_us - 1) / this->_period_us;
+}
+
+/**
+ * @brief clear the timing statistics
+ */
+void CyclicExecutive::resetStats() {
+    memset(&this->_stats, 0, sizeof(this->_stats));
+}
+
+/**
+ * @brief format the timing statistics
+ * @return number of characters written
+ */
+size_t CyclicExecutive::formatStats(char* buffer, size_t len) {
+    uint32_t latency_avg = this->_stats.frames ? this->_stats.release_latency_sum_us / this->_stats.frames : 0;
+
+    return snprintf(buffer, len, "CYCLIC period=%luus frames=%lu overruns=%lu missed=%lu lat_avg=%luus lat_max=%luus jitter_max=%luus exec_max=%luus resp_max=%luus",
+                    (unsigned long)this->_period_us,
+                    (unsigned long)this->_stats.frames,
+                    (unsigned long)this->_stats.overruns,
+                    (unsigned long)this->_stats.missed_frames,
+                    (unsigned long)latency_avg,
+                    (unsigned long)this->_stats.release_latency_max_us,
+                    (unsigned long)this->_stats.period_jitter_max_us,
+                    (unsigned long)this->_stats.exec_max_us,
+                    (unsigned long)this->_stats.response_max_us);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file cyclic_executive.h
+ * @brief Hardware timer driven frame scheduler for the sense-estimate-decide loop
+ *
+ * A hardware timer interrupt releases one high priority task at a fixed frame rate.
+ * The task calls waitForFrame(), runs the frame work in a fixed order and then calls
+ * endFrame(). The executive keeps the overrun and jitter statistics:
+ * - release latency: time from the timer interrupt to the task starting the frame
+ * - period jitter: deviation of the frame start to frame start time from the nominal period
+ * - response time: time from the timer interrupt to the end of the frame. Its maximum is
+ *   the worst-case decision latency of the flight state machine
+ * - overruns: frames that took longer than one period
+ * - missed frames: timer releases that happened while the previous frame was still running
+ */
+
+#ifndef CYCLIC_EXECUTIVE_H
+#define CYCLIC_EXECUTIVE_H
+
+#include <Arduino.h>
+
+/**
+ * A structure to hold the cyclic executive timing statistics
+ */
+typedef struct {
+    uint32_t frames;                    /*!< frames run since the statistics were reset */
+    uint32_t overruns;                  /*!< frames that took longer than one period */
+    uint32_t missed_frames;             /*!< releases skipped because the previous frame was still running */
+    uint32_t release_latency_max_us;    /*!< worst timer interrupt to frame start time */
+    uint32_t release_latency_sum_us;    /*!< sum of the release latencies - for the average */
+    uint32_t period_jitter_max_us;      /*!< worst deviation of the frame start interval from the period */
+    uint32_t response_max_us;           /*!< worst timer interrupt to frame end time */
+    uint32_t exec_max_us;               /*!< worst frame execution time */
+} cyclic_stats_t;
+
+class CyclicExecutive {
+    private:
+        hw_timer_t* _timer = NULL;
+        TaskHandle_t _task = NULL;                  /*!< the task released by the timer */
+        uint32_t _period_us = 0;                    /*!< frame period */
+        volatile uint32_t _release_us = 0;          /*!< time of the last timer interrupt */
+        uint32_t _frame_start_us = 0;               /*!< start of the current frame */
+        uint32_t _frame_release_us = 0;             /*!< release time of the current frame */
+        uint32_t _previous_start_us = 0;            /*!< start of the previous frame */
+        uint32_t _frame_number = 0;                 /*!< frames since begin() */
+        cyclic_stats_t _stats;
+
+    public:
+        CyclicExecutive();
+        bool begin(uint32_t frame_rate, uint8_t timer_id);
+        uint32_t waitForFrame();
+        void endFrame();
+        void onTimer();
+        uint32_t framesForMs(uint32_t ms);
+        void resetStats();
+        size_t formatStats(char* buffer, size_t len);
+};
+
+extern CyclicExecutive cyclic_executive;
+
+#endif // CYCLIC_EXECUTIVE_H
@@ -6,7 +6,12 @@
 #ifndef DATA_TYPES_H
 #define DATA_TYPES_H
 
-#include <Arduino.h>
+#if defined(ARDUINO)
+    #include <Arduino.h>
+#else
+    /* host builds - benchmarks and the recovery tools */
+    #include <stdint.h>
+#endif
 
 /**
  * A structure to represent acceleration data
@@ -38,7 +43,7 @@ typedef struct GPS_Data{
     double latitude;            /*!< latitude coordinate */
     double longitude;           /*!< longitude coordinate */
     uint16_t gps_altitude;      /*!< altitude read by the GPS */
-    uint time;                  /*!< time read by the GPS */
+    uint32_t time;              /*!< time read by the GPS */
 } gps_type_t;
 
 /**
@@ -57,6 +62,7 @@ typedef struct Altimeter_Data{
  */
 typedef struct Telemetry_Data {
     uint32_t record_number;     /*!< current row number for flight data logging  */
+    uint32_t timestamp_ms;      /*!< time the sample was taken, ms since boot */
     uint8_t operation_mode;     /*!< operation mode to tell whether we are in SAFE or FLIGHT mode */
     uint8_t state;              /*!< current flight state. See states.h */
     altimeter_type_t alt_data;  /*!< altimeter data */
@@ -0,0 +1,65 @@
+/**
+ * @file log_policy.cpp
+ * @brief flash logging rate for each flight state
+ */
+
+#include "log_policy.h"
+#include "states.h"
+#include "defs.h"
+
+/**
+ * @brief logging policy of a flight state
+ */
+LOG_POLICY logPolicyForState(uint8_t state) {
+    switch(state) {
+        case PRE_FLIGHT_GROUND:
+        case POST_FLIGHT_GROUND:
+            return LOG_POLICY_GROUND;
+
+        case DROGUE_DESCENT:
+        case MAIN_DESCENT:
+            return LOG_POLICY_DESCENT;
+
+        default:
+            return LOG_POLICY_FULL;
+    }
+}
+
+/**
+ * @brief minimum time between logged samples
+ * @return interval in ms, 0 to log every sample
+ */
+uint16_t logPolicyInterval(LOG_POLICY policy) {
+    switch(policy) {
+        case LOG_POLICY_GROUND:
+            return LOG_INTERVAL_GROUND;
+
+        case LOG_POLICY_DESCENT:
+            return LOG_INTERVAL_DESCENT;
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief convert the logging policy to string
+ */
+const char* logPolicyString(LOG_POLICY policy) {
+    switch(policy) {
+        case LOG_POLICY_FULL:
+            return "FULL";
+
+        case LOG_POLICY_DESCENT:
+            return "DESCENT";
+
+        case LOG_POLICY_GROUND:
+            return "GROUND";
+
+        case LOG_POLICY_HISTORY:
+            return "HISTORY";
+
+        default:
+            return "UNKNOWN";
+    }
+}
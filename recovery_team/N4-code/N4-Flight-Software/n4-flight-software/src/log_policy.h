@@ -0,0 +1,29 @@
+/**
+ * @file log_policy.h
+ * @brief flash logging rate for each flight state
+ *
+ * The pad wait and the time after landing are logged decimated, everything from launch
+ * through the deployments at the full sample rate, and the descent under parachute at a
+ * medium rate. The policy is stored in every log record, see flight_log.h
+ */
+
+#ifndef LOG_POLICY_H
+#define LOG_POLICY_H
+
+#include <stdint.h>
+
+/**
+ * Logging policies. 0 must stay the full rate, since older logs read back as policy 0
+ */
+typedef enum {
+    LOG_POLICY_FULL = 0,        /*!< every sample */
+    LOG_POLICY_DESCENT,         /*!< one sample every LOG_INTERVAL_DESCENT ms */
+    LOG_POLICY_GROUND,          /*!< one sample every LOG_INTERVAL_GROUND ms */
+    LOG_POLICY_HISTORY          /*!< every sample - pre-launch history logged at launch detection */
+} LOG_POLICY;
+
+LOG_POLICY logPolicyForState(uint8_t state);
+uint16_t logPolicyInterval(LOG_POLICY policy);
+const char* logPolicyString(LOG_POLICY policy);
+
+#endif
@@ -7,6 +7,15 @@
 #include "logger.h"
 #include "data_types.h"
 #include "defs.h"
+#include "timing_probe.h"
+#include "flight_log.h"
+#include "flight_log_codec.h"
+#include "log_policy.h"
+#include "states.h"
+
+#if LOGGER_PAGE_SIZE != FLIGHT_LOG_PAGE_SIZE
+    #error "LOGGER_PAGE_SIZE must match the flight log page size"
+#endif
 
 telemetry_type_t t;
 char pckt_buff[50];
@@ -28,6 +37,9 @@ DataLogger::DataLogger(uint8_t cs_pin, uint8_t led_pin, char* filename, SerialFl
     strcpy(this->_filename, filename);
     this->_file = file;
 
+    memset(&this->_stats, 0, sizeof(this->_stats));
+    memset(&this->_flight, 0, sizeof(this->_flight));
+    flightLogCodecReset(&this->_codec);
 }
 
 /**
@@ -76,6 +88,17 @@ void DataLogger::loggerFormat() {
 bool DataLogger::loggerInit() {
     char filename[20];
 
+    /* hand all page buffers to the log task */
+    this->_free_pages = xQueueCreate(LOGGER_PAGE_BUFFERS, sizeof(uint8_t));
+    this->_full_pages = xQueueCreate(LOGGER_PAGE_BUFFERS, sizeof(uint8_t));
+    if(this->_free_pages == NULL || this->_full_pages == NULL) {
+        return false;
+    }
+
+    for(uint8_t i = 0; i < LOGGER_PAGE_BUFFERS; i++) {
+        xQueueSend(this->_free_pages, &i, 0);
+    }
+
     if (!SerialFlash.begin(this->_cs_pin)) {
         return false;
 
@@ -111,17 +134,16 @@ bool DataLogger::loggerInit() {
         //     }
 
             if(SerialFlash.exists(this->_filename)) {
-                // erase file contents 
-                Serial.println("flight_data.txt file found. Erasing file contents");
-                SerialFlashFile flight_file;
-                flight_file = SerialFlash.open(this->_filename);
-                flight_file.erase();
-                Serial.println("Done erasing file contents");
+                // keep what is already logged - a reset in flight must not wipe the flight.
+                // The log is only erased by a command from the ground, see loggerRequestErase()
+                Serial.println("flight_data.txt file found. Resuming the log");
+                this->_file = SerialFlash.open(this->_filename);
             } else {
                 Serial.println("flightk_data.txt file does not exist. Creating file...");
                 uint8_t file_create_status = SerialFlash.createErasable(this->_filename, this->_file_size);
                 if (!file_create_status) {
                     Serial.println(F("Failed to create file"));
+                    return false;
                 } else {
                     Serial.println(F("Created flight_data.txt file. Ready for data logging!"));
                     this->_file = SerialFlash.open(this->_filename);
@@ -133,6 +155,9 @@ bool DataLogger::loggerInit() {
         
         // this->loggerEquals(); 
 
+        this->_page_count = this->_file.size() / LOGGER_PAGE_SIZE;
+        this->resumeLog();
+
         return true;
     }
 }
@@ -150,70 +175,685 @@ void DataLogger::loggerTest() {
 }
 
 /**
- * @brief write the provided data to the file created
- * @param data this is a struct pointer to the struct that contains the data that needs to 
- * be written to the memory
- * 
- * 
+ * @brief queue the provided data for writing to the file created
+ * Samples are kept at the rate of the logging policy of their flight state. The first sample
+ * after a state change is always kept, so a new policy applies from the transition on.
+ *
+ * On the pad every sample first goes through the history ring, which delays the log by
+ * LOGGER_HISTORY_SAMPLES samples. Samples leaving the ring are logged at the ground rate. When
+ * launch is detected the whole ring is logged at full rate, oldest first, ahead of the live
+ * samples - so the ignition transient that happens before launch detection is kept
+ * @param packet the record to write to the memory
+ *
 */
 void DataLogger::loggerWrite(telemetry_type_t packet){
-    // write the record to the flash chip
-    
-    // sprintf(pckt_buff, 
-    //         "%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n",
-    //         packet.acc_data.ax,
-    //         packet.acc_data.ay,
-    //         packet.acc_data.az,
-    //         packet.acc_data.pitch,
-    //         packet.acc_data.roll,
-    //         packet.alt_data.pressure);
-
-    // write the packet to memory
-    this->_file.write((uint8_t*)&packet, sizeof(packet));
-
-    // Serial.print( packet.record_number );
-    // Serial.print( "," );
-    // Serial.print( packet.operation_mode );
-    // Serial.print( "," );
-    // Serial.print( packet.state );
-    // Serial.print( "," );
-    // Serial.print( packet.acc_data.ax );
-    // Serial.print( "," );
-    // Serial.print( packet.acc_data.ay );
-    // Serial.print( "," );
-    // Serial.print( packet.acc_data. az );
-    // Serial.print( "," );
-    // Serial.print( packet.acc_data.pitch );
-    // Serial.print( "," );
-    // Serial.print( packet.acc_data.roll );
-    // Serial.print( "," );
-    // Serial.print( packet.gyro_data.gx );
-    // Serial.print( "," );
-    // Serial.print( packet.gyro_data.gy );
-    // Serial.print( "," );
-    // Serial.print( packet.gyro_data.gz );
-    // Serial.print( "," );
-    // Serial.print( packet.alt_data.altitude );
-    // Serial.print( "," );
-    // Serial.print( packet.alt_data.velocity );
-    // Serial.print( "," );
-    // Serial.print( packet.alt_data.pressure );
-    // Serial.print( "," );
-    // Serial.println( packet.alt_data.temperature );
-
-    // Serial.println(F("logged"));
-    
-    // at this point, the flash memory is ready for writing and reading 
-    // check that the passed struct is not null
-    // if(data == NULL) {
-    //     // do sth here 
-    //     // maybe log error
-    // } else {
-    //     // data valid, ready to proceed
-    // }
+    LOG_POLICY policy = logPolicyForState(packet.state);
+    int32_t fields[FLIGHT_LOG_FIELD_COUNT];
+
+    #if LOGGER_HISTORY_SAMPLES
+        if(packet.state == PRE_FLIGHT_GROUND) {
+            if(this->_history_count == LOGGER_HISTORY_SAMPLES) {
+                this->historyPop(fields);
+                if(this->keepSample(fields[FIELD_FLAGS] & 0x0F, fields[FIELD_TIMESTAMP], policy)) {
+                    this->writeFields(fields, policy, 0);
+                }
+            }
+
+            this->packetToFields(&packet, fields);
+            this->historyPush(fields);
+            return;
+        }
+
+        if(this->_history_count > 0) {
+            this->flushHistory();
+        }
+    #endif
+
+    if(this->keepSample(packet.state, packet.timestamp_ms, policy)) {
+        this->packetToFields(&packet, fields);
+        this->writeFields(fields, policy, 0);
+    }
+}
+
+/**
+ * @brief apply the logging policy
+ * @return true if the sample is to be logged
+ */
+bool DataLogger::keepSample(uint8_t state, uint32_t timestamp_ms, LOG_POLICY policy) {
+    uint16_t interval = logPolicyInterval(policy);
+
+    if(interval && state == this->_last_state && timestamp_ms - this->_last_log_ms < interval) {
+        this->_stats.decimated++;
+        return false;
+    }
+
+    this->_last_state = state;
+    this->_last_log_ms = timestamp_ms;
+    this->_policy = policy;
+
+    return true;
+}
+
+/**
+ * @brief convert a sample to the scaled fields of a log record
+ * The log policy bits are filled in by writeFields()
+ */
+void DataLogger::packetToFields(const telemetry_type_t* packet, int32_t* fields) {
+    flight_log_sample_t sample;
+
+    sample.timestamp_ms = packet->timestamp_ms;
+    sample.record_number = packet->record_number;
+    sample.operation_mode = packet->operation_mode;
+    sample.state = packet->state;
+    sample.log_policy = 0;
+    sample.ax = packet->acc_data.ax;
+    sample.ay = packet->acc_data.ay;
+    sample.az = packet->acc_data.az;
+    sample.gx = packet->gyro_data.gx;
+    sample.gy = packet->gyro_data.gy;
+    sample.gz = packet->gyro_data.gz;
+    sample.pitch = packet->acc_data.pitch;
+    sample.roll = packet->acc_data.roll;
+    sample.latitude = packet->gps_data.latitude;
+    sample.longitude = packet->gps_data.longitude;
+    sample.gps_altitude = packet->gps_data.gps_altitude;
+    sample.pressure = packet->alt_data.pressure;
+    sample.temperature = packet->alt_data.temperature;
+    sample.rel_altitude = packet->alt_data.rel_altitude;
+    sample.velocity = packet->alt_data.velocity;
+
+    flightLogToFields(&sample, fields);
+}
+
+/**
+ * @brief compress one record into the page buffers
+ * The page is programmed later by the flash writer task. If every page buffer is still
+ * waiting to be programmed the record is dropped and counted as an overrun
+ * @param fields scaled record fields
+ * @param policy logging policy the record was kept under
+ * @param wait ticks to wait for a free page buffer
+ */
+void DataLogger::writeFields(int32_t* fields, LOG_POLICY policy, TickType_t wait) {
+    uint8_t frame[FLIGHT_LOG_FRAME_BUFFER_SIZE];
+
+    fields[FIELD_FLAGS] = (fields[FIELD_FLAGS] & 0x1F) | ((policy & 0x07) << 5);
+
+    if(this->_fill_page < 0 && !this->acquirePage(wait)) {
+        this->_stats.overruns++;
+        return;
+    }
+
+    size_t frame_size = flightLogCompress(&this->_codec, fields, frame);
+
+    // frames never continue on the next page, so every page can be decoded on its own
+    if(frame_size > (size_t)(LOGGER_PAGE_SIZE - this->_fill_offset)) {
+        this->handOverPage();
+        if(!this->acquirePage(wait)) {
+            this->_stats.overruns++;
+            return;
+        }
+
+        // a new page starts with a keyframe
+        frame_size = flightLogCompress(&this->_codec, fields, frame);
+    }
+
+    memcpy(&this->_pages[this->_fill_page][this->_fill_offset], frame, frame_size);
+    this->_fill_offset += frame_size;
+    this->_stats.records++;
+    this->_stats.frame_bytes += frame_size;
+}
+
+#if LOGGER_HISTORY_SAMPLES
+/**
+ * @brief add a record to the history ring. The ring must not be full
+ */
+void DataLogger::historyPush(const int32_t* fields) {
+    uint16_t index = (this->_history_head + this->_history_count) % LOGGER_HISTORY_SAMPLES;
+
+    flightLogPackFields(fields, this->_history[index]);
+    this->_history_count++;
+}
+
+/**
+ * @brief take the oldest record from the history ring. The ring must not be empty
+ */
+void DataLogger::historyPop(int32_t* fields) {
+    flightLogUnpackFields(this->_history[this->_history_head], fields);
 
-    // TODO: maybe return the size of memory written 
+    this->_history_head = (this->_history_head + 1) % LOGGER_HISTORY_SAMPLES;
+    this->_history_count--;
+}
+
+/**
+ * @brief log the whole history ring at full rate, oldest first
+ * The burst is larger than the page buffers, so this waits for the flash writer task to free
+ * pages. The live samples queue up meanwhile
+ */
+void DataLogger::flushHistory() {
+    int32_t fields[FLIGHT_LOG_FIELD_COUNT];
+
+    while(this->_history_count > 0) {
+        this->historyPop(fields);
+        this->writeFields(fields, LOG_POLICY_HISTORY, LOGGER_HISTORY_FLUSH_WAIT / portTICK_PERIOD_MS);
+    }
+
+    this->_stats.history_flushes++;
+}
+#endif
+
+/**
+ * @brief take a free page buffer to fill
+ * The payload starts after the page header, which the flash writer task fills in. The codec
+ * is reset so that the first frame in the page is a keyframe
+ * @param wait ticks to wait for a free page buffer
+ * @return true if a page buffer was free
+ */
+bool DataLogger::acquirePage(TickType_t wait) {
+    uint8_t page;
+
+    if(this->_free_pages == NULL || xQueueReceive(this->_free_pages, &page, wait) != pdTRUE) {
+        return false;
+    }
+
+    this->_fill_page = page;
+    this->_fill_offset = FLIGHT_LOG_PAGE_HEADER_SIZE;
+    flightLogCodecReset(&this->_codec);
+
+    return true;
+}
+
+/**
+ * @brief pass the page being filled to the flash writer task
+ */
+void DataLogger::handOverPage() {
+    uint8_t page = this->_fill_page;
+
+    this->_page_length[page] = this->_fill_offset;
+    this->_fill_page = -1;
+
+    // cannot fail - the queue holds every page
+    xQueueSend(this->_full_pages, &page, 0);
+}
+
+/**
+ * @brief write out the partially filled page
+ * Must be called from the task that calls loggerWrite()
+ */
+void DataLogger::loggerFlush() {
+    if(this->_fill_page >= 0 && this->_fill_offset > FLIGHT_LOG_PAGE_HEADER_SIZE) {
+        this->handOverPage();
+    }
+}
+
+/**
+ * @brief wait for a page that is ready to be programmed. Called by the flash writer task
+ * @param page index of the page to pass to loggerProgramPage()
+ * @param wait ticks to wait for a page
+ * @return true if a page is ready
+ */
+bool DataLogger::loggerNextPage(uint8_t* page, TickType_t wait) {
+    if(this->_full_pages == NULL) {
+        vTaskDelay(wait);
+        return false;
+    }
+
+    return xQueueReceive(this->_full_pages, page, wait) == pdTRUE;
+}
+
+/**
+ * @brief program one page to the flash memory and return the buffer to the log task
+ * Every page goes to its own flash page, so a partially filled page wastes the rest of its
+ * flash page. SerialFlash polls the chip until the previous program or erase completes, so
+ * the time spent here includes waiting for the flash
+ */
+void DataLogger::loggerProgramPage(uint8_t page) {
+    uint16_t length = this->_page_length[page];
+    flightLogEncodePageHeader(this->_pages[page], length - FLIGHT_LOG_PAGE_HEADER_SIZE, this->_session, this->_generation);
+
+    // the mirror keeps logging after the flash is full
+    if(this->_mirror != NULL) {
+        this->_mirror(this->_pages[page], length);
+    }
+
+    if(!this->_log_ready || this->_next_page >= this->_page_count) {
+        this->_stats.pages_dropped++;
+        xQueueSend(this->_free_pages, &page, 0);
+        return;
+    }
+
+    // loggerService() fell behind - the page waits for this erase
+    if(this->_next_page >= this->_erased_until) {
+        this->_stats.erase_stalls++;
+        this->eraseNextBlock();
+    }
+
+    if(!this->_flight_open) {
+        this->openFlight();
+    }
+
+    uint32_t start = micros();
+
+    PROBE_START(PROBE_FLASH_WRITE);
+    this->_file.seek(this->_next_page * LOGGER_PAGE_SIZE);
+    this->_file.write(this->_pages[page], length);
+    PROBE_STOP(PROBE_FLASH_WRITE);
+
+    uint32_t write_time = micros() - start;
+    if(write_time > this->_stats.page_write_max_us) {
+        this->_stats.page_write_max_us = write_time;
+    }
+    if(write_time > LOGGER_PAGE_STALL_US) {
+        this->_stats.stalls++;
+    }
+
+    this->_next_page++;
+    this->_stats.bytes_written += length;
+    this->_stats.pages_written++;
+
+    xQueueSend(this->_free_pages, &page, 0);
+}
 
+/**
+ * @brief pass every page to a second sink before it is programmed
+ * The mirror runs in the flash writer task and must not block, see SDLogger::sdQueuePage()
+ * @param mirror called with the page and its length, NULL to stop mirroring
+ */
+void DataLogger::loggerSetMirror(logger_mirror_t mirror) {
+    this->_mirror = mirror;
+}
+
+/**
+ * @brief erase the log, and with it every flight, on the next loggerService() call
+ * Only the ground station asks for this - a reset never erases the log
+ */
+void DataLogger::loggerRequestErase() {
+    this->_erase_requested = true;
+}
+
+/**
+ * @brief write the landing summary of the current flight on the next loggerService() call
+ * Called when the flight reaches POST_FLIGHT_GROUND. The next boot on the ground starts a
+ * new flight
+ */
+void DataLogger::loggerCloseFlight() {
+    this->_close_requested = true;
+}
+
+/**
+ * @brief give the flight being logged a directory slot. Called with its first page
+ * When the directory is full the pages stay in the last flight until the log is erased
+ */
+void DataLogger::openFlight() {
+    if(this->_flight_count >= this->_directory_slots) {
+        return;
+    }
+
+    memset(&this->_flight, 0, sizeof(this->_flight));
+    this->_flight.flight = this->_flight_count;
+    this->_flight.session = this->_session;
+    this->_flight.first_page = this->_next_page;
+    this->_flight.start_ms = millis();
+    this->_flight.config = (LOGGER_HISTORY_SAMPLES ? FLIGHT_CONFIG_HISTORY : 0) |
+                           (LOG_TO_SD ? FLIGHT_CONFIG_SD : 0) |
+                           (TRACING ? FLIGHT_CONFIG_TRACING : 0);
+
+    uint8_t slot[FLIGHT_DIRECTORY_HALF_SIZE];
+    this->_file.seek(flightDirectorySlotOffset(this->_flight_count));
+    this->_file.write(slot, flightDirectoryEncodeOpen(&this->_flight, this->_generation, slot));
+
+    this->_flight_count++;
+    this->_flight_open = true;
+}
+
+/**
+ * @brief program the close half of the current flight's slot
+ * The slot is only programmed once - a flight closed before a reset stays closed
+ */
+void DataLogger::closeFlight() {
+    if(!this->_flight_open || this->_flight.closed) {
+        return;
+    }
+
+    this->_flight.closed = true;
+    this->_flight.state = this->_last_state;
+    this->_flight.resets = (uint8_t)(this->_session - this->_flight.session);
+    this->_flight.end_page = this->_next_page;
+    this->_flight.records = this->_stats.records;
+    if(this->_flight.session != this->_session) {
+        // continued after a reset - add the records logged before it
+        this->_flight.records += this->countRecords(this->_flight.first_page, this->_resume_page);
+    }
+    this->_flight.end_ms = millis();
+
+    uint8_t half[FLIGHT_DIRECTORY_HALF_SIZE];
+    this->_file.seek(flightDirectorySlotOffset(this->_flight.flight) + FLIGHT_DIRECTORY_HALF_SIZE);
+    this->_file.write(half, flightDirectoryEncodeClose(&this->_flight, this->_generation, half));
+
+    Serial.print(F("Closed flight "));
+    Serial.println(this->_flight.flight);
+}
+
+/**
+ * @brief background log maintenance. Called by the flash writer task between pages
+ * Keeps erase blocks erased ahead of the write position so that pages never wait for an
+ * erase. One block is started per call, and only when no page is waiting, so a page queues
+ * behind at most one erase
+ * @param on_ground true on the pad, where more blocks are erased ahead
+ */
+void DataLogger::loggerService(bool on_ground) {
+    if(this->_erase_requested) {
+        this->_erase_requested = false;
+
+        // only the header block is erased now - the rest is erased ahead of the writes
+        SerialFlash.eraseBlock(this->_file.getFlashAddress());
+        this->_session = 0;
+        this->startLog(this->_generation + 1);
+        Serial.println(F("Erased flight log"));
+    }
+
+    if(!this->_log_ready) {
+        return;
+    }
+
+    if(this->_close_requested) {
+        this->_close_requested = false;
+        this->closeFlight();
+    }
+
+    uint32_t target = (on_ground ? LOGGER_ERASE_AHEAD_GROUND_BLOCKS : LOGGER_ERASE_AHEAD_BLOCKS) * this->_block_pages;
+
+    if(this->_erased_until - this->_next_page < target && uxQueueMessagesWaiting(this->_full_pages) == 0 && SerialFlash.ready()) {
+        this->eraseNextBlock();
+    }
+}
+
+/**
+ * @brief start erasing the block after the erased space
+ * SerialFlash returns as soon as the erase has started - the next flash access waits for it
+ * @return false if the erased space already reaches the end of the file
+ */
+bool DataLogger::eraseNextBlock() {
+    if(this->_erased_until >= this->_page_count) {
+        return false;
+    }
+
+    SerialFlash.eraseBlock(this->_file.getFlashAddress() + this->_erased_until * LOGGER_PAGE_SIZE);
+    this->_erased_until += this->_block_pages;
+    this->_stats.blocks_erased++;
+
+    return true;
+}
+
+/**
+ * @brief write the log header to the first page of the file
+ * The first erase block must already be erased. The flight directory follows the header
+ * page, and the first flight gets its slot with the first page
+ * @param generation times the log has been erased
+ */
+void DataLogger::startLog(uint32_t generation) {
+    uint8_t header[FLIGHT_LOG_HEADER_SIZE];
+
+    this->_generation = generation;
+    this->_first_page = 1 + FLIGHT_LOG_DIRECTORY_PAGES;
+    this->_next_page = this->_first_page;
+    this->_erased_until = this->_block_pages;
+
+    // the directory must be erased before its slots are programmed
+    while(this->_erased_until < this->_first_page && this->eraseNextBlock()) {
+    }
+
+    /* the log starts with the header so the recovery tool knows which record schema to decode */
+    this->_file.seek(0);
+    this->_file.write(header, flightLogEncodeHeader(header, generation, FLIGHT_LOG_DIRECTORY_PAGES));
+
+    this->_directory_slots = FLIGHT_LOG_DIRECTORY_PAGES * FLIGHT_DIRECTORY_SLOTS_PER_PAGE;
+    this->_flight_count = 0;
+    this->_flight_open = false;
+    this->_log_ready = true;
+}
+
+/**
+ * @brief check that a whole page reads back erased
+ * @param scratch LOGGER_PAGE_SIZE bytes
+ */
+bool DataLogger::pageErased(uint32_t page, uint8_t* scratch) {
+    this->_file.seek(page * LOGGER_PAGE_SIZE);
+    this->_file.read(scratch, LOGGER_PAGE_SIZE);
+
+    for(uint16_t i = 0; i < LOGGER_PAGE_SIZE; i++) {
+        if(scratch[i] != 0xFF) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief check that a page was written by the current log generation
+ * @param scratch LOGGER_PAGE_SIZE bytes
+ * @param page_header decoded page header
+ */
+bool DataLogger::pageValid(uint32_t page, uint8_t* scratch, flight_log_page_t* page_header) {
+    this->_file.seek(page * LOGGER_PAGE_SIZE);
+    this->_file.read(scratch, LOGGER_PAGE_SIZE);
+
+    return flightLogDecodePageHeader(scratch, this->_generation, page_header) == FLIGHT_LOG_OK;
+}
+
+/**
+ * @brief decode the records of a page
+ * @param state set to the flight state of the last record, PRE_FLIGHT_GROUND if no record decodes
+ * @return records in the page
+ */
+uint16_t DataLogger::pageRecords(const uint8_t* page, const flight_log_page_t* page_header, uint8_t* state) {
+    flight_log_codec_t codec;
+    int32_t fields[FLIGHT_LOG_FIELD_COUNT];
+    uint16_t records = 0;
+    size_t offset = 0;
+
+    *state = PRE_FLIGHT_GROUND;
+
+    flightLogCodecReset(&codec);
+    while(offset < page_header->length) {
+        size_t used;
+        if(flightLogDecompress(&codec, page + FLIGHT_LOG_PAGE_HEADER_SIZE + offset, page_header->length - offset, fields, &used) != FLIGHT_LOG_OK) {
+            break;
+        }
+        offset += used;
+        records++;
+        *state = fields[FIELD_FLAGS] & 0x0F;
+    }
+
+    return records;
+}
+
+/**
+ * @brief count the records logged in a range of pages. Pages torn by a reset are skipped
+ * Reads every page, so only called on the ground when a flight closes
+ */
+uint32_t DataLogger::countRecords(uint32_t first_page, uint32_t end_page) {
+    uint8_t scratch[LOGGER_PAGE_SIZE];
+    flight_log_page_t page_header;
+    uint8_t state;
+    uint32_t records = 0;
+
+    for(uint32_t page = first_page; page < end_page; page++) {
+        if(this->pageValid(page, scratch, &page_header)) {
+            records += this->pageRecords(scratch, &page_header, &state);
+        }
+    }
+
+    return records;
+}
+
+/**
+ * @brief read the flight directory and pick the flight to log to
+ * The whole directory is read at once - no scan of the log. The last flight is continued if
+ * the log ended in the air, since the flight computer was reset in flight. Otherwise the next
+ * page opens a new flight
+ * @param scratch LOGGER_PAGE_SIZE bytes
+ * @param last_state flight state of the last logged record
+ */
+void DataLogger::readDirectory(uint8_t* scratch, uint8_t last_state) {
+    flight_entry_t entry;
+    FLIGHT_LOG_STATUS last_status = FLIGHT_LOG_ERASED;
+    bool free_slot = false;
+
+    this->_flight_count = 0;
+    this->_flight_open = false;
+
+    for(uint16_t slot = 0; slot < this->_directory_slots && !free_slot; slot++) {
+        if(slot % FLIGHT_DIRECTORY_SLOTS_PER_PAGE == 0) {
+            this->_file.seek(flightDirectorySlotOffset(slot));
+            this->_file.read(scratch, LOGGER_PAGE_SIZE);
+        }
+
+        // a slot torn by a reset is left used, so it is never programmed twice
+        FLIGHT_LOG_STATUS status = flightDirectoryDecode(scratch + (slot % FLIGHT_DIRECTORY_SLOTS_PER_PAGE) * FLIGHT_DIRECTORY_SLOT_SIZE, this->_generation, &entry);
+        if(status == FLIGHT_LOG_ERASED) {
+            free_slot = true;
+        } else {
+            this->_flight_count++;
+            last_status = status;
+            if(status == FLIGHT_LOG_OK) {
+                this->_flight = entry;
+            }
+        }
+    }
+
+    bool in_air = last_state >= POWERED_FLIGHT && last_state <= MAIN_DESCENT;
+    if(last_status == FLIGHT_LOG_OK && !this->_flight.closed && in_air) {
+        this->_flight_open = true;
+        Serial.print(F("Continuing flight "));
+        Serial.println(this->_flight.flight);
+    }
+}
+
+/**
+ * @brief find the end of the log and continue after it
+ * Pages are programmed in order, so the pages of the current generation come first and
+ * the end of the log is found with a binary search - a few page reads instead of erasing
+ * the whole file. A block is only written after it was erased, so in every block the
+ * written pages are followed by erased ones. Must be called before the tasks start
+ */
+void DataLogger::resumeLog() {
+    uint8_t* scratch = this->_pages[0];
+    flight_log_header_t header;
+    flight_log_page_t page_header;
+
+    this->_block_pages = SerialFlash.blockSize() / LOGGER_PAGE_SIZE;
+
+    this->_file.seek(0);
+    this->_file.read(scratch, FLIGHT_LOG_HEADER_SIZE);
+
+    FLIGHT_LOG_STATUS status = flightLogDecodeHeader(scratch, &header);
+    if(status == FLIGHT_LOG_ERASED) {
+        // the first page of the block is erased, so the whole block is
+        this->startLog(0);
+        Serial.println(F("Started a new flight log"));
+        return;
+    }
+
+    if(status != FLIGHT_LOG_OK || header.version != FLIGHT_LOG_SCHEMA_VERSION) {
+        // the old data may not have been recovered yet - leave it for the ground to erase
+        this->_log_ready = false;
+        Serial.println(F("Flight log has an unknown format. Not logging until it is erased"));
+        return;
+    }
+
+    this->_generation = header.generation;
+    this->_first_page = flightLogFirstPage(&header);
+    this->_directory_slots = header.directory_pages * FLIGHT_DIRECTORY_SLOTS_PER_PAGE;
+
+    // a page torn by a reset is followed by valid pages - look one page further
+    uint32_t low = this->_first_page;
+    uint32_t high = this->_page_count;
+    while(low < high) {
+        uint32_t mid = low + (high - low) / 2;
+
+        if(this->pageValid(mid, scratch, &page_header) || (mid + 1 < high && this->pageValid(mid + 1, scratch, &page_header))) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    // continue the session numbering from the last page
+    uint8_t last_state = PRE_FLIGHT_GROUND;
+    if(low > this->_first_page && this->pageValid(low - 1, scratch, &page_header)) {
+        this->_session = page_header.session + 1;
+        this->pageRecords(scratch, &page_header, &last_state);
+    }
+
+    this->readDirectory(scratch, last_state);
+
+    // skip a page torn by a reset while programming, up to the next block
+    while(low < this->_page_count && low % this->_block_pages != 0 && !this->pageErased(low, scratch)) {
+        this->_stats.torn_pages++;
+        low++;
+    }
+
+    if(low % this->_block_pages != 0) {
+        this->_erased_until = low - low % this->_block_pages + this->_block_pages;
+    } else if(low < this->_page_count && this->pageErased(low, scratch)) {
+        this->_erased_until = low + this->_block_pages;
+    } else {
+        // left over from an older generation - loggerService() erases it before it is written
+        this->_erased_until = low;
+    }
+
+    this->_next_page = low;
+    this->_resume_page = low;
+    this->_log_ready = true;
+
+    Serial.print(F("Resuming flight log at page "));
+    Serial.print(this->_next_page);
+    Serial.print(F(" session "));
+    Serial.print(this->_session);
+    Serial.print(F(" generation "));
+    Serial.print(this->_generation);
+    Serial.print(F(" flights "));
+    Serial.println(this->_flight_count);
+}
+
+/**
+ * @brief format the flash writer statistics
+ * The write rate is averaged since the previous call
+ * @return number of characters written
+ */
+size_t DataLogger::loggerFormatStats(char* buffer, size_t len) {
+    uint32_t now = millis();
+    uint32_t elapsed = now - this->_last_report_ms;
+    uint32_t bytes = this->_stats.bytes_written;
+    uint32_t rate = elapsed ? (uint64_t)(bytes - this->_last_report_bytes) * 1000 / elapsed : 0;
+
+    this->_last_report_ms = now;
+    this->_last_report_bytes = bytes;
+
+    // compression ratio x100 against fixed size records
+    uint32_t ratio = this->_stats.frame_bytes ? (uint64_t)this->_stats.records * FLIGHT_LOG_RECORD_SIZE * 100 / this->_stats.frame_bytes : 0;
+
+    return snprintf(buffer, len, "FLASH flight=%u/%u policy=%s history=%u rate=%luB/s written=%lu records=%lu decimated=%lu ratio=%lu.%02lu pages=%lu/%lu erased_ahead=%luKB erase_stalls=%lu stalls=%lu overruns=%lu dropped=%lu torn=%lu write_max=%luus",
+                    (unsigned)this->_flight_count,
+                    (unsigned)this->_directory_slots,
+                    logPolicyString(this->_policy),
+                    (unsigned)this->historyCount(),
+                    (unsigned long)rate,
+                    (unsigned long)bytes,
+                    (unsigned long)this->_stats.records,
+                    (unsigned long)this->_stats.decimated,
+                    (unsigned long)(ratio / 100),
+                    (unsigned long)(ratio % 100),
+                    (unsigned long)this->_next_page,
+                    (unsigned long)this->_page_count,
+                    (unsigned long)((this->_erased_until - this->_next_page) * LOGGER_PAGE_SIZE / 1024),
+                    (unsigned long)this->_stats.erase_stalls,
+                    (unsigned long)this->_stats.stalls,
+                    (unsigned long)this->_stats.overruns,
+                    (unsigned long)this->_stats.pages_dropped,
+                    (unsigned long)this->_stats.torn_pages,
+                    (unsigned long)this->_stats.page_write_max_us);
 }
 
 /**
@@ -16,6 +16,34 @@
 #include <Arduino.h>
 #include <SerialFlash.h>
 #include "data_types.h"
+#include "defs.h"
+#include "flight_log_codec.h"
+#include "flight_directory.h"
+#include "log_policy.h"
+
+/**
+ * A structure to hold the flash writer statistics
+ */
+typedef struct {
+    uint32_t records;               /*!< records accepted into the page buffers */
+    uint32_t decimated;             /*!< samples skipped by the logging policy */
+    uint32_t history_flushes;       /*!< times the pre-launch history was logged */
+    uint32_t frame_bytes;           /*!< compressed size of the accepted records */
+    uint32_t bytes_written;         /*!< bytes programmed to flash */
+    uint32_t pages_written;         /*!< pages programmed to flash */
+    uint32_t stalls;                /*!< page programs that took longer than LOGGER_PAGE_STALL_US */
+    uint32_t overruns;              /*!< records dropped because every page buffer was waiting to be programmed */
+    uint32_t pages_dropped;         /*!< pages not programmed because the log is full or cannot be appended to */
+    uint32_t torn_pages;            /*!< pages found torn by a reset when resuming the log */
+    uint32_t blocks_erased;         /*!< erase blocks erased ahead of the write position */
+    uint32_t erase_stalls;          /*!< pages that had to wait for their block to be erased */
+    uint32_t page_write_max_us;     /*!< worst page program time */
+} logger_stats_t;
+
+/**
+ * Called with every page before it is programmed, page header included - see loggerSetMirror()
+ */
+typedef void (*logger_mirror_t)(const uint8_t* page, uint16_t length);
 
 class DataLogger {
     private:
@@ -27,6 +55,72 @@ class DataLogger {
         uint8_t _flash_delay = 100;    /*!< 100ms delay gives a frequency of 20Hz */
         uint8_t _file_pointer = 0;      /*!< pointer to the start of the file- to be used when reading the file */
 
+        /* write-behind page buffers - filled by the log task, programmed by the flash writer task */
+        uint8_t _pages[LOGGER_PAGE_BUFFERS][LOGGER_PAGE_SIZE];
+        uint16_t _page_length[LOGGER_PAGE_BUFFERS];    /*!< bytes used in each handed over page, page header included */
+        int8_t _fill_page = -1;                         /*!< page being filled, -1 if none */
+        uint16_t _fill_offset = 0;                      /*!< bytes used in the page being filled */
+        QueueHandle_t _free_pages = NULL;               /*!< indices of the pages that can be filled */
+        QueueHandle_t _full_pages = NULL;               /*!< indices of the pages waiting to be programmed */
+        flight_log_codec_t _codec;                      /*!< delta compression state of the page being filled */
+        logger_stats_t _stats;
+        logger_mirror_t _mirror = NULL;                 /*!< second sink for the programmed pages, NULL if none */
+        uint32_t _last_report_ms = 0;                   /*!< time of the previous stats report */
+        uint32_t _last_report_bytes = 0;                /*!< bytes_written at the previous stats report */
+
+        /* logging policy - see log_policy.h */
+        LOG_POLICY _policy = LOG_POLICY_FULL;           /*!< policy of the last logged sample */
+        uint8_t _last_state = 0xFF;                     /*!< flight state of the last logged sample */
+        uint32_t _last_log_ms = 0;                      /*!< timestamp of the last logged sample */
+
+        #if LOGGER_HISTORY_SAMPLES
+            /* pre-launch history - the last samples on the pad, packed as fixed size records */
+            uint8_t _history[LOGGER_HISTORY_SAMPLES][FLIGHT_LOG_RECORD_SIZE];
+            uint16_t _history_head = 0;                 /*!< oldest record */
+            uint16_t _history_count = 0;                /*!< records in the ring */
+
+            void historyPush(const int32_t* fields);
+            void historyPop(int32_t* fields);
+            void flushHistory();
+            uint16_t historyCount() { return this->_history_count; }
+        #else
+            uint16_t historyCount() { return 0; }
+        #endif
+
+        /* log file position - owned by the flash writer task once the tasks run */
+        uint32_t _page_count = 0;                       /*!< log pages in the file */
+        uint32_t _first_page = 0;                       /*!< first log page, after the flight directory */
+        uint32_t _next_page = 0;                        /*!< log page programmed next */
+        uint16_t _session = 0;                          /*!< logging session written to every page header */
+        uint32_t _generation = 0;                       /*!< times the log has been erased, see flight_log.h */
+        uint32_t _block_pages = 0;                      /*!< log pages in one flash erase block */
+        uint32_t _erased_until = 0;                     /*!< log pages before this one are erased or written */
+        uint32_t _resume_page = 0;                      /*!< first log page programmed since boot */
+        bool _log_ready = false;                        /*!< false if the file holds data we cannot append to */
+        volatile bool _erase_requested = false;         /*!< set by loggerRequestErase(), handled by loggerService() */
+
+        /* flight directory, see flight_directory.h - owned by the flash writer task once the tasks run */
+        uint16_t _directory_slots = 0;                  /*!< flights the directory can hold */
+        uint16_t _flight_count = 0;                     /*!< directory slots used */
+        flight_entry_t _flight;                         /*!< the flight being logged */
+        bool _flight_open = false;                      /*!< _flight has a slot - a new flight gets one with its first page */
+        volatile bool _close_requested = false;         /*!< set by loggerCloseFlight(), handled by loggerService() */
+
+        bool keepSample(uint8_t state, uint32_t timestamp_ms, LOG_POLICY policy);
+        void packetToFields(const telemetry_type_t* packet, int32_t* fields);
+        void writeFields(int32_t* fields, LOG_POLICY policy, TickType_t wait);
+        bool acquirePage(TickType_t wait);
+        void handOverPage();
+        void startLog(uint32_t generation);
+        void resumeLog();
+        bool eraseNextBlock();
+        bool pageErased(uint32_t page, uint8_t* scratch);
+        bool pageValid(uint32_t page, uint8_t* scratch, flight_log_page_t* page_header);
+        uint16_t pageRecords(const uint8_t* page, const flight_log_page_t* page_header, uint8_t* state);
+        uint32_t countRecords(uint32_t first_page, uint32_t end_page);
+        void readDirectory(uint8_t* scratch, uint8_t last_state);
+        void openFlight();
+        void closeFlight();
 
     public:
         DataLogger(uint8_t cs_pin, uint8_t led_pin, char* filename, SerialFlashFile file, uint32_t filesize); // constructor
@@ -35,6 +129,14 @@ class DataLogger {
         void loggerInfo();
         void loggerTest();
         void loggerWrite(telemetry_type_t);
+        void loggerFlush();
+        bool loggerNextPage(uint8_t* page, TickType_t wait);
+        void loggerProgramPage(uint8_t page);
+        void loggerSetMirror(logger_mirror_t mirror);
+        size_t loggerFormatStats(char* buffer, size_t len);
+        void loggerRequestErase();
+        void loggerCloseFlight();
+        void loggerService(bool on_ground);
         void loggerRead(uint8_t file_pointer, char buffer);
         void loggerSpaces();
         void loggerEquals();
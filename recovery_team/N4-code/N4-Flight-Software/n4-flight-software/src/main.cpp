@@ -31,6 +31,18 @@
 #include "wifi-config.h"    // handle wifi connection
 #include "kalman_filter.h"  // handle kalman filter functions
 #include "ring_buffer.h"    // for apogee detection
+#include "task_profiler.h"  // per-task CPU, loop time and stack profiling
+#include "timing_probe.h"   // hot path latency histograms
+#include "cyclic_executive.h"   // timer driven sense-estimate-decide loop
+#include "seqlock.h"          // lock-free latest value snapshots shared between tasks
+#include "telemetry_format.h"  // fast telemetry CSV formatting
+#include "telemetry_frame.h"   // binary telemetry frames
+#include "telemetry_batch.h"   // several telemetry samples per MQTT message
+#include "telemetry_delta.h"   // delta compressed telemetry frames
+#include "mqtt_publisher.h"   // MQTT client owned by the publisher task
+#include "xbee_link.h"        // long range XBee downlink
+#include "sd_logger.h"        // copy of the flight log on the SD card
+#include "trace.h"            // binary event tracing
 
 /* non-task function prototypes definition */
 void initDynamicWIFI();
@@ -44,6 +56,8 @@ double altimeter_get_pressure();
 void mqtt_command_processor(const char*, const char*);
 void arm_pyros();
 void disarm_pyros();
+void changeFlightState(uint8_t new_state);
+void publishFlightEvent(const char* format, ...);
 
 void arm_pyros() {
     digitalWrite(REMOTE_SWITCH, HIGH);
@@ -58,20 +72,24 @@ void disarm_pyros() {
 }
 
 /* state machine variables*/
-uint8_t operation_mode = 0;                                         /*!< Tells whether software is in safe or flight mode - FLIGHT_MODE=1, SAFE_MODE=0 */
-uint8_t current_state = ARMED_FLIGHT_STATE::PRE_FLIGHT_GROUND;	    /*!< The starting state - we start at PRE_FLIGHT_GROUND state */
+/* these are read by many tasks - each has a single writer, see seqlock.h */
+SeqLock<uint8_t> operation_mode(0);                                 /*!< Tells whether software is in safe or flight mode - FLIGHT_MODE=1, SAFE_MODE=0. Written by the MQTT command processor */
+SeqLock<uint8_t> current_state(ARMED_FLIGHT_STATE::PRE_FLIGHT_GROUND);  /*!< The starting state - we start at PRE_FLIGHT_GROUND state. Written by changeFlightState() */
+SeqLock<uint8_t> telemetry_encoding(TELEMETRY_ENCODING);           /*!< TELEMETRY_ENCODING_CSV, _BINARY or _DELTA. Written by the MQTT command processor */
 
 uint8_t STATE_BIT_MASK = 0;
+uint16_t entered_states_mask = 0;                                   /*!< states entered since the last cyclic executive pyro check - bit n is state n */
 
 /* GPS object */
 HardwareSerial gpsSerial(2); // PIN 16 AND 17 
 TinyGPSPlus gps;
 char gps_buffer[20];
-gps_type_t gps_packet;
+SeqLock<gps_type_t> gps_packet;                 /*!< latest GPS fix - written by readGPSTask */
 
 /* system logger */
 SystemLogger SYSTEM_LOGGER;
 const char* system_log_file = "/event_log.txt";
+const char* trace_file = "/trace.bin";     /*!< binary trace, decode with scripts/trace-decoder */
 LOG_LEVEL level = INFO;
 const char* rocket_ID = "FC1";             /*!< Unique ID of the rocket. Change to the needed rocket name before uploading */
 
@@ -96,6 +114,13 @@ enum BUZZ_INTERVALS {
   ARMING_PROCEDURE = 500
 };
 
+/* cyclic executive barometer conversion steps */
+enum BARO_STEPS {
+    START_TEMPERATURE = 0,
+    READ_TEMPERATURE,
+    READ_PRESSURE
+};
+
 /* LED blink intervals */
 enum BLINK_INTERVALS {
     SAFE_BLINK = 400,
@@ -106,8 +131,6 @@ unsigned long current_non_block_time = 0;
 unsigned long last_non_block_time = 0;
 bool buzz_state = 0;
 
-uint8_t mqtt_connect_flag;
-
 /* hardware init check - to pinpoint any hardware failure during setup */
 #define BMP_CHECK_BIT           0
 #define IMU_CHECK_BIT           1   
@@ -120,11 +143,17 @@ uint8_t mqtt_connect_flag;
 uint8_t SUBSYSTEM_INIT_MASK = 0b00000000;
 
 /**
- * MQTT helper instances, if using MQTT to transmit telemetry
+ * MQTT helper instances, if using MQTT to transmit telemetry. The client itself lives in
+ * MQTTInit() so that only the publisher task can use it - see mqtt_publisher.h
  */
 
-WiFiClient wifi_client;
-PubSubClient client(wifi_client);
+uint8_t telemetry_batch_buffer[MQTT_TELEMETRY_SIZE];
+telemetry_batch_t telemetry_batch;                  /*!< owned by the telemetry task, its stats are read by the diagnostics task */
+
+#if XBEE
+    uint8_t xbee_batch_buffer[XBEE_PAYLOAD_SIZE];
+    telemetry_batch_t xbee_batch;                   /*!< telemetry batch for the XBee, owned by the telemetry task */
+#endif
 uint8_t MQTTInit(const char* broker_IP, uint16_t broker_port);
 
 /* WIFI configuration class object */
@@ -136,30 +165,32 @@ uint8_t flash_cs_pin = 5;                   /*!< External flash memory chip sele
 uint8_t remote_switch = 27;
 
 /* Flight data logging */
-uint8_t flash_led_pin = 32;                  /*!< LED pin connected to indicate flash memory formatting  */
 char filename[] = "flight_data.txt";         /*!< data log filename - Filename must be less than 20 chars, including the file extension */
 uint32_t FILE_SIZE_512K = 524288L;          /*!< 512KB */
 uint32_t FILE_SIZE_1M  = 1048576L;          /*!< 1MB */
 uint32_t FILE_SIZE_4M  = 4194304L;          /*!< 4MB */
 SerialFlashFile file;                       /*!< object representing file object for flash memory */
-unsigned long long previous_log_time = 0;   /*!< The last time we logged data to memory */
-unsigned long long current_log_time = 0;    /*!< What is the processor time right now? */
-uint16_t log_sample_interval = 5;          /*!< After how long should we sample and log data to flash memory? */
 
 /* create flash memory log object */
 DataLogger data_logger(flash_cs_pin, RED_LED_PIN, filename, file, FILE_SIZE_4M);
 
+#if LOG_TO_SD
+    SDLogger sd_logger;     /*!< copy of the flash log pages on the SD card */
+
+    void mirrorPageToSD(const uint8_t* page, uint16_t length) {
+        sd_logger.sdQueuePage(page, length);
+    }
+#endif
+
 /* position integration variables */
 long long current_time = 0;
 long long previous_time = 0;
 
-/* To store the main telemetry packet being sent over MQTT */
-char telemetry_packet_buffer[256];
 ring_buffer altitude_ring_buffer;
 double baseline = 0.0; // to store baseline pressure from the altimeter
 float curr_val;
 float oldest_val;
-uint8_t apogee_flag =0; // to signal that we have detected apogee
+SeqLock<uint8_t> apogee_flag(0); // to signal that we have detected apogee - written by the state machine only
 static int apogee_val = 0; // apogee altitude aproximmation
 uint8_t main_eject_flag = 0;
 
@@ -188,53 +219,95 @@ void checkRunTestToggle() {
     }
 }
 
+/**
+ * Task creation handles
+ */
+ TaskHandle_t readAccelerationTaskHandle;
+ TaskHandle_t readAltimeterTaskHandle;
+ TaskHandle_t readGPSTaskHandle;
+ TaskHandle_t clearTelemetryQueueTaskHandle;
+ TaskHandle_t checkFlightStateTaskHandle;
+ TaskHandle_t flightStateCallbackTaskHandle;
+ TaskHandle_t MQTT_TransmitTelemetryTaskHandle;
+ TaskHandle_t mqttPublisherTaskHandle;
+ TaskHandle_t kalmanFilterTaskHandle;
+ TaskHandle_t debugToTerminalTaskHandle;
+ TaskHandle_t logToMemoryTaskHandle;
+ TaskHandle_t flashWriterTaskHandle;
+ TaskHandle_t sdWriterTaskHandle;
+ TaskHandle_t eventLogTaskHandle;
+ TaskHandle_t opModeIndicateTaskHandle;
+ TaskHandle_t diagnosticsTaskHandle;
+ TaskHandle_t cyclicExecutiveTaskHandle;
+
+/* diagnostics task notification bits */
+#define DIAG_STATE_CHANGE   (1 << 0)    /*!< the flight state has changed */
+#define DIAG_DUMP_PROBES    (1 << 1)    /*!< dump the timing probe histograms */
+
 /*!
  * @brief process commands sent from the base station
  * @param command
  * ARM
  * DISARM
  * RESET
+ * PROBES - dump the timing probe histograms
+ * ERASE_LOG - erase the flight log. Only accepted in SAFE mode on the ground before flight
+ * TELEMETRY_CSV - send telemetry as CSV rows
+ * TELEMETRY_BINARY - send telemetry as binary frames, see telemetry_frame.h
+ * TELEMETRY_DELTA - send telemetry as delta compressed binary frames, see telemetry_delta.h
  */
 void mqtt_command_processor(const char* topic, const char* command)
 {
     // check topic
-    if(topic == "n4/commands")
+    if(strcmp(topic, MQTT_ARMING_TOPIC) == 0)
     {
-      if(command == "ARM")
+      if(strcmp(command, "ARM") == 0)
       {
           arm_pyros();
-          operation_mode = 1;
+          operation_mode.store(1);
+          TRACE(OPERATION_MODE, 1);
+          publishFlightEvent("ARMED");
           non_blocking_buzz(BUZZ_INTERVALS::ARMING_PROCEDURE); // IGNORE ARMING PROCEDURE
           debugln("ARM PYRO"); // TODO:log to syslogger
 
-      }  else if(command == "DISARM") {
+      }  else if(strcmp(command, "DISARM") == 0) {
           disarm_pyros();
-          operation_mode = 0;
+          operation_mode.store(0);
+          TRACE(OPERATION_MODE, 0);
+          publishFlightEvent("DISARMED");
           non_blocking_buzz(BUZZ_INTERVALS::ARMING_PROCEDURE);
           debugln("ARM PYRO"); // TODO:log to syslogger
-      } else if(command == "RESET"){
+      } else if(strcmp(command, "RESET") == 0){
           // reset ESP via software
           debugln("RESET"); // TODO:log to syslogger
+      } else if(strcmp(command, "PROBES") == 0) {
+          // dump the timing probe histograms
+          if(diagnosticsTaskHandle != NULL) {
+              xTaskNotify(diagnosticsTaskHandle, DIAG_DUMP_PROBES, eSetBits);
+          }
+      } else if(strcmp(command, "ERASE_LOG") == 0) {
+          bool accepted = operation_mode.load() == 0 && current_state.load() == ARMED_FLIGHT_STATE::PRE_FLIGHT_GROUND;
+          TRACE(LOG_ERASE_REQUEST, accepted, current_state.load(), operation_mode.load());
+          if(accepted) {
+              data_logger.loggerRequestErase();
+              debugln("ERASE LOG"); // TODO:log to syslogger
+          } else {
+              debugln("ERASE LOG refused - not on the ground in SAFE mode");
+          }
+      } else if(strcmp(command, "TELEMETRY_CSV") == 0) {
+          telemetry_encoding.store(TELEMETRY_ENCODING_CSV);
+          debugln("TELEMETRY CSV");
+      } else if(strcmp(command, "TELEMETRY_BINARY") == 0) {
+          telemetry_encoding.store(TELEMETRY_ENCODING_BINARY);
+          debugln("TELEMETRY BINARY");
+      } else if(strcmp(command, "TELEMETRY_DELTA") == 0) {
+          telemetry_encoding.store(TELEMETRY_ENCODING_DELTA);
+          debugln("TELEMETRY DELTA");
       }
     }
 
 }
 
-/**
- * Task creation handles
- */
- TaskHandle_t readAccelerationTaskHandle;
- TaskHandle_t readAltimeterTaskHandle;
- TaskHandle_t readGPSTaskHandle;
- TaskHandle_t clearTelemetryQueueTaskHandle;
- TaskHandle_t checkFlightStateTaskHandle;
- TaskHandle_t flightStateCallbackTaskHandle;
- TaskHandle_t MQTT_TransmitTelemetryTaskHandle;
- TaskHandle_t kalmanFilterTaskHandle;
- TaskHandle_t debugToTerminalTaskHandle;
- TaskHandle_t logToMemoryTaskHandle;
- TaskHandle_t opModeIndicateTaskHandle;
-
 /**
  * ///////////////////////// DATA TYPES /////////////////////////
 */
@@ -263,7 +336,7 @@ MPU6050 imu(MPU_ADDRESS, MPU_ACCEL_RANGE, GYRO_RANGE);
 /* create BMP object */
 SFE_BMP180 altimeter;
 double altimeter_temperature = 0.0;
-altimeter_type_t altimeter_packet;
+SeqLock<altimeter_type_t> altimeter_packet;     /*!< latest altimeter sample - written by the altimeter task or the cyclic executive */
 
 /**
 * @brief initialize Buzzer
@@ -291,7 +364,7 @@ uint8_t InitSPIFFS() {
 }
 
 /**
-* @brief initilize SD card 
+* @brief initilize SD card and open the SD copy of the flight log
  */
 uint8_t initSD() {
     if (!SD.begin(SD_CS_PIN)) {
@@ -305,29 +378,17 @@ uint8_t initSD() {
         uint8_t cardType = SD.cardType();
         if (cardType == CARD_NONE) {
             debugln("[-]No SD card attached");
+            return 0;
         } else {
             debugln("[+]Valid card found");
         }
 
-        // initialize test data file
-        File file = SD.open("data.txt", FILE_WRITE); // TODO: change file name to const char*
-        if (!file) {
-            debugln("[File does not exist. Creating file]");
-            debugln("Test data file created");
-        } else {
-            debugln("[*]Data file already exists");
-        }
-        file.close();
-
-        // initialize test state file 
-        File state_file = SD.open("/state.txt", FILE_WRITE);
-        if(!state_file) {
-            debugln("State file does not exit. Creating file...");
-
-            debugln("state file created."); // TODO: move to system logger
-        }
-
-        state_file.close();
+        #if LOG_TO_SD
+            if(!sd_logger.sdInit(SD)) {
+                return 0;
+            }
+            data_logger.loggerSetMirror(mirrorPageToSD);
+        #endif
 
         return 1;
     }
@@ -404,6 +465,29 @@ QueueHandle_t kalman_filter_queue_handle;
 //////////////////////////// ACCELERATION AND ROCKET ATTITUDE DETERMINATION /////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////
 
+/*!****************************************************************************
+ * @brief Read acceleration, angular velocity and attitude from the IMU into a telemetry packet
+ *******************************************************************************/
+void readIMU(telemetry_type_t* packet) {
+    PROBE_START(PROBE_IMU_READ);
+
+    // one burst read for every axis
+    imu.readAll();
+
+    packet->acc_data.ax = imu.acc_x_real;
+    packet->acc_data.ay = imu.acc_y_real;
+    packet->acc_data.az = imu.acc_z_real;
+
+    packet->gyro_data.gx = imu.ang_vel_x_real;
+    packet->gyro_data.gy = imu.ang_vel_y_real;
+    packet->gyro_data.gz = imu.ang_vel_z_real;
+
+    packet->acc_data.pitch = imu.pitch_angle * TO_DEG_FACTOR;
+    packet->acc_data.roll = imu.roll_angle * TO_DEG_FACTOR;
+
+    PROBE_STOP(PROBE_IMU_READ);
+}
+
 /*!****************************************************************************
  * @brief Read acceleration data from the accelerometer
  * @param pvParameters - A value that is passed as the paramater to the created task.
@@ -417,29 +501,22 @@ void readAccelerationTask(void* pvParameter) {
 
 
     while(1) {
-        acc_data_lcl.operation_mode = operation_mode; // TODO: move these to check state function
+        PROFILE_LOOP_START(PROF_READ_ACCELERATION);
+        acc_data_lcl.operation_mode = operation_mode.load(); // TODO: move these to check state function
         acc_data_lcl.record_number++;
-        acc_data_lcl.state = 0;
+        acc_data_lcl.timestamp_ms = millis();
+        acc_data_lcl.state = current_state.load();
 
-        // read acceleration
-        acc_data_lcl.acc_data.ax = imu.readXAcceleration();
-        acc_data_lcl.acc_data.ay = imu.readYAcceleration();
-        acc_data_lcl.acc_data.az = imu.readZAcceleration();
+        readIMU(&acc_data_lcl);
 
-        // read angular velocities
-        acc_data_lcl.gyro_data.gx = imu.readXAngularVelocity();
-        acc_data_lcl.gyro_data.gy = imu.readYAngularVelocity();
-        acc_data_lcl.gyro_data.gz = imu.readZAngularVelocity();
-
-        // get pitch and roll
-        acc_data_lcl.acc_data.pitch = imu.getPitch();
-        acc_data_lcl.acc_data.roll = imu.getRoll();
-    
         xQueueSend(telemetry_data_queue_handle, &acc_data_lcl, 0);
-        xQueueSend(log_to_mem_queue_handle, &acc_data_lcl, 0);
+        if(xQueueSend(log_to_mem_queue_handle, &acc_data_lcl, 0) != pdPASS) {
+            TRACE(QUEUE_FULL, 1, acc_data_lcl.record_number);
+        }
         xQueueSend(check_state_queue_handle, &acc_data_lcl, 0);
         xQueueSend(debug_to_term_queue_handle, &acc_data_lcl, 0);
 
+        PROFILE_LOOP_END(PROF_READ_ACCELERATION);
         vTaskDelay(CONSUME_TASK_DELAY/ portTICK_PERIOD_MS);
     }
 
@@ -459,7 +536,9 @@ double altimeter_get_pressure()
     status = altimeter.startTemperature();
     if(status != 0)
     {
+        PROFILE_LOOP_PAUSE(PROF_READ_ALTIMETER);
         delay(status);
+        PROFILE_LOOP_RESUME(PROF_READ_ALTIMETER);
         status = altimeter.getTemperature(T);
         altimeter_temperature = T;
         if(status != 0)
@@ -467,7 +546,9 @@ double altimeter_get_pressure()
             status = altimeter.startPressure(3);
             if(status != 0)
             {
+                PROFILE_LOOP_PAUSE(PROF_READ_ALTIMETER);
                 delay(status);
+                PROFILE_LOOP_RESUME(PROF_READ_ALTIMETER);
                 status = altimeter.getPressure(P, T);
                 if(status != 0)
                 {
@@ -483,18 +564,25 @@ double altimeter_get_pressure()
  * @brief Read atm pressure data from the barometric sensor onboard
  *******************************************************************************/
 void readAltimeterTask(void* pvParameters) {
-    telemetry_type_t alt_data_lcl;
+    altimeter_type_t alt_sample;
+    memset(&alt_sample, 0, sizeof(alt_sample));
 
     while(1) {
+        PROFILE_LOOP_START(PROF_READ_ALTIMETER);
 
         double a, P;
+        PROBE_START(PROBE_BARO_CONVERSION);
         P = altimeter_get_pressure();
         a = altimeter.altitude(P, baseline);
+        PROBE_STOP(PROBE_BARO_CONVERSION);
 
         /* send to altimeter global packet */
-        altimeter_packet.temperature = altimeter_temperature;
-        altimeter_packet.pressure = P;
-        altimeter_packet.rel_altitude = a;
+        alt_sample.temperature = altimeter_temperature;
+        alt_sample.pressure = P;
+        alt_sample.rel_altitude = a;
+        altimeter_packet.store(alt_sample);
+
+        PROFILE_LOOP_END(PROF_READ_ALTIMETER);
     }
 }
 
@@ -506,31 +594,36 @@ void readAltimeterTask(void* pvParameters) {
  * 
  *******************************************************************************/
 void readGPSTask(void* pvParameters){
-    float latitude, longitude, g_altitude;
-
     gps_type_t gps_data_lcl;
+    memset(&gps_data_lcl, 0, sizeof(gps_data_lcl));
 
     while(1){
+        PROFILE_LOOP_START(PROF_READ_GPS);
         if(gpsSerial.available() > 0) {
             gps.encode(gpsSerial.read());
 
-            /* get GPS coordinates */
-            if(gps.location.isValid()) {
-                latitude = gps.location.lat();
-                longitude = gps.location.lng();
-            } 
+            /* publish only when the parser completed a new sentence */
+            if(gps.location.isUpdated() || gps.altitude.isUpdated()) {
+                /* get GPS coordinates */
+                if(gps.location.isValid()) {
+                    gps_data_lcl.latitude = gps.location.lat();
+                    gps_data_lcl.longitude = gps.location.lng();
+                }
+
+                /* get GPS altitude */
+                if(gps.altitude.isValid()) {
+                    gps_data_lcl.gps_altitude = gps.altitude.meters();
+                }
 
-            /* get GPS altitude */
-            if(gps.altitude.isValid()) {
-                g_altitude = gps.altitude.meters();
+                gps_packet.store(gps_data_lcl);
             }
         } else {
+            PROFILE_LOOP_PAUSE(PROF_READ_GPS);
             vTaskDelay(10/portTICK_PERIOD_MS);
+            PROFILE_LOOP_RESUME(PROF_READ_GPS);
         }
 
-        gps_packet.latitude = latitude;
-        gps_packet.longitude = longitude;
-        gps_packet.gps_altitude = g_altitude;
+        PROFILE_LOOP_END(PROF_READ_GPS);
     }
 }
 
@@ -539,11 +632,13 @@ void readGPSTask(void* pvParameters){
  * 
  */
 float kalmanFilter(float z) {
+    PROBE_START(PROBE_FILTER_UPDATE);
     float estimated_altitude_pred = estimated_altitude;
     float error_covariance_pred = error_covariance_bmp + process_variance_bmp;
     kalman_gain_bmp = error_covariance_pred / (error_covariance_pred + measurement_variance_bmp);
     estimated_altitude = estimated_altitude_pred + kalman_gain_bmp * (z - estimated_altitude_pred);
     error_covariance_bmp = (1 - kalman_gain_bmp) * error_covariance_pred;
+    PROBE_STOP(PROBE_FILTER_UPDATE);
 
     return estimated_altitude;
 }
@@ -555,84 +650,187 @@ float kalmanFilter(float z) {
 void kalmanFilterTask(void* pvParameters) {
     
     while (1) {
+        PROFILE_LOOP_START(PROF_KALMAN_FILTER);
+        PROFILE_LOOP_END(PROF_KALMAN_FILTER);
         vTaskDelay(CONSUME_TASK_DELAY/portTICK_PERIOD_MS);
     }
 }
 
 /*!****************************************************************************
- * @brief check various condition from flight data to change the flight state
- * - -see states.h for more info --
+ * @brief send a flight event to the ground on the events topic, ahead of any telemetry, and
+ * on the XBee link as a text message
+ * The message is "<timestamp ms>,<event>", e.g. "52311,STATE,COASTING,APOGEE". Returns right
+ * away - the MQTT publisher task and the UART driver send it
+ * @param format printf format of the event, after the timestamp
+ *******************************************************************************/
+void publishFlightEvent(const char* format, ...) {
+    char event[MQTT_EVENT_SIZE + 1];
+    int length = snprintf(event, sizeof(event), "%lu,", (unsigned long)millis());
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(event + length, sizeof(event) - length, format, args);
+    va_end(args);
+
+    #if MQTT
+        MQTT_PUBLISHER.publishEvent(MQTT_EVENTS_TOPIC, event, MQTT_EVENT_RETAINED);
+    #endif
+
+    #if XBEE
+        XBEE_LINK.send((const uint8_t*)event, strlen(event));
+    #endif
+}
+
+/*!****************************************************************************
+ * @brief move to a new flight state
+ * All flight state changes go through here so that we can act on state transitions
  *
  *******************************************************************************/
-void checkFlightState(void* pvParameters) {
-    // get the flight state from the telemetry task
-    telemetry_type_t flight_data; 
-    
-    while (1) {
-        xQueueReceive(check_state_queue_handle, &flight_data, portMAX_DELAY);
+void changeFlightState(uint8_t new_state) {
+    uint8_t old_state = current_state.load();
+    if(new_state == old_state) {
+        return;
+    }
 
-        if(apogee_flag != 1) {
-            // states before apogee
-            // debug("altitude value:"); debugln(flight_data.alt_data.altitude);
-            if(flight_data.alt_data.rel_altitude < LAUNCH_DETECTION_THRESHOLD) {
-                current_state = ARMED_FLIGHT_STATE::PRE_FLIGHT_GROUND;
-                //debugln("PREFLIGHT");
-                delay(STATE_CHANGE_DELAY);
-            } else if(LAUNCH_DETECTION_THRESHOLD < flight_data.alt_data.rel_altitude < (LAUNCH_DETECTION_THRESHOLD+LAUNCH_DETECTION_ALTITUDE_WINDOW) ) {
-                current_state = ARMED_FLIGHT_STATE::POWERED_FLIGHT;
-                //debugln("POWERED");
-                delay(STATE_CHANGE_DELAY);
-            } 
+    current_state.store(new_state);
+    TRACE(STATE_CHANGE, old_state, new_state);
+    publishFlightEvent("STATE,%s,%s", flightStateString(old_state), flightStateString(new_state));
+
+    /* once per deployment state entered - the firing result is not known here, so this only
+       reports that the deployment was commanded */
+    if(operation_mode.load() == OPERATION_MODE::ARMED_MODE) {
+        if(new_state == ARMED_FLIGHT_STATE::DROGUE_DEPLOY) {
+            publishFlightEvent("DEPLOY_CMD,DROGUE");
+        } else if(new_state == ARMED_FLIGHT_STATE::MAIN_DEPLOY) {
+            publishFlightEvent("DEPLOY_CMD,MAIN");
+        }
+    }
 
-            // COASTING
+    #if CYCLIC_EXECUTIVE
+        /* the executive's pyro check acts on every state entered during the frame */
+        entered_states_mask |= (1 << new_state);
+    #endif
 
-            // APOGEE and APOGEE DETECTION
-            ring_buffer_put(&altitude_ring_buffer, flight_data.alt_data.rel_altitude);
-            if(ring_buffer_full(&altitude_ring_buffer) == 1) {
-                oldest_val = ring_buffer_get(&altitude_ring_buffer);
-            }
+    if(diagnosticsTaskHandle != NULL) {
+        /* report task usage at every state transition, and dump the timing probes once we land */
+        uint32_t diag_events = DIAG_STATE_CHANGE;
+        if(new_state == ARMED_FLIGHT_STATE::POST_FLIGHT_GROUND) {
+            diag_events |= DIAG_DUMP_PROBES;
+        }
+        xTaskNotify(diagnosticsTaskHandle, diag_events, eSetBits);
+    }
 
-            //debug("Curr val:");debug(flight_data.alt_data.altitude); debug("    "); debugln(oldest_val);
-            if((oldest_val - flight_data.alt_data.rel_altitude) >= APOGEE_DETECTION_THRESHOLD) {
-                if(apogee_flag == 0) {
-                    apogee_val = ( (oldest_val - flight_data.alt_data.rel_altitude) / 2 ) + oldest_val;
-
-                    current_state = ARMED_FLIGHT_STATE::APOGEE;
-                    delay(STATE_CHANGE_DELAY);
-                    //debugln("APOGEE");
-                    delay(STATE_CHANGE_DELAY);
-                    current_state = ARMED_FLIGHT_STATE::DROGUE_DEPLOY;
-                    //debugln("DROGUE");
-                    delay(STATE_CHANGE_DELAY);
-                    current_state =  ARMED_FLIGHT_STATE::DROGUE_DESCENT;
-                    //debugln("DROGUE_DESCENT");
-                    delay(STATE_CHANGE_DELAY);
-                    apogee_flag = 1;
-                }
-            }
+    if(new_state == ARMED_FLIGHT_STATE::POST_FLIGHT_GROUND) {
+        SYSTEM_LOGGER.flush();
+        TRACER.flush();
+        data_logger.loggerCloseFlight();
+    }
+}
 
-        } else if(apogee_flag == 1) {
-            if(LAUNCH_DETECTION_THRESHOLD <= flight_data.alt_data.rel_altitude <= apogee_val) {
-                if(main_eject_flag == 0) {
-                    current_state = ARMED_FLIGHT_STATE::MAIN_DEPLOY;
-                    //debugln("MAIN");
-                    delay(STATE_CHANGE_DELAY);
-                    main_eject_flag = 1;
-                } else if (main_eject_flag == 1) { // todo: confirm check_done_flag
-                    current_state = ARMED_FLIGHT_STATE::MAIN_DESCENT;
-                    //debugln("MAIN_DESC");
-                    delay(STATE_CHANGE_DELAY);
-                }
+/*!****************************************************************************
+ * @brief wait after a state change so that flightStateCallback sees the new state
+ * The cyclic executive passes 0 since it acts on the new state in the same frame, so only
+ * checkFlightState waits here
+ *******************************************************************************/
+void stateChangeDelay(uint16_t settle_delay) {
+    if(settle_delay) {
+        PROFILE_LOOP_PAUSE(PROF_CHECK_FLIGHT_STATE);
+        delay(settle_delay);
+        PROFILE_LOOP_RESUME(PROF_CHECK_FLIGHT_STATE);
+    }
+}
+
+/*!****************************************************************************
+ * @brief check various condition from flight data to change the flight state
+ * - -see states.h for more info --
+ * @param flight_data latest flight data sample
+ * @param settle_delay time in ms to wait after each state change, see stateChangeDelay
+ *
+ *******************************************************************************/
+void evaluateFlightState(telemetry_type_t* flight_data, uint16_t settle_delay) {
+    PROBE_START(PROBE_STATE_EVAL);
+
+    if(apogee_flag.load() != 1) {
+        // states before apogee
+        // debug("altitude value:"); debugln(flight_data->alt_data.altitude);
+        if(flight_data->alt_data.rel_altitude < LAUNCH_DETECTION_THRESHOLD) {
+            changeFlightState(ARMED_FLIGHT_STATE::PRE_FLIGHT_GROUND);
+            //debugln("PREFLIGHT");
+            stateChangeDelay(settle_delay);
+        } else if(LAUNCH_DETECTION_THRESHOLD < flight_data->alt_data.rel_altitude < (LAUNCH_DETECTION_THRESHOLD+LAUNCH_DETECTION_ALTITUDE_WINDOW) ) {
+            changeFlightState(ARMED_FLIGHT_STATE::POWERED_FLIGHT);
+            //debugln("POWERED");
+            stateChangeDelay(settle_delay);
+        } 
+
+        // COASTING
+
+        // APOGEE and APOGEE DETECTION
+        ring_buffer_put(&altitude_ring_buffer, flight_data->alt_data.rel_altitude);
+        if(ring_buffer_full(&altitude_ring_buffer) == 1) {
+            oldest_val = ring_buffer_get(&altitude_ring_buffer);
+        }
+
+        //debug("Curr val:");debug(flight_data->alt_data.altitude); debug("    "); debugln(oldest_val);
+        if((oldest_val - flight_data->alt_data.rel_altitude) >= APOGEE_DETECTION_THRESHOLD) {
+            if(apogee_flag.load() == 0) {
+                apogee_val = ( (oldest_val - flight_data->alt_data.rel_altitude) / 2 ) + oldest_val;
+                TRACE(APOGEE, apogee_val);
+                publishFlightEvent("APOGEE,%d", apogee_val);
+
+                changeFlightState(ARMED_FLIGHT_STATE::APOGEE);
+                stateChangeDelay(settle_delay);
+                //debugln("APOGEE");
+                stateChangeDelay(settle_delay);
+                changeFlightState(ARMED_FLIGHT_STATE::DROGUE_DEPLOY);
+                //debugln("DROGUE");
+                stateChangeDelay(settle_delay);
+                changeFlightState(ARMED_FLIGHT_STATE::DROGUE_DESCENT);
+                //debugln("DROGUE_DESCENT");
+                stateChangeDelay(settle_delay);
+                apogee_flag.store(1);
             }
+        }
 
-            if(flight_data.alt_data.rel_altitude < LAUNCH_DETECTION_THRESHOLD) {
-                current_state = ARMED_FLIGHT_STATE::POST_FLIGHT_GROUND;
-                //debugln("POST_FLIGHT");
+    } else if(apogee_flag.load() == 1) {
+        if(LAUNCH_DETECTION_THRESHOLD <= flight_data->alt_data.rel_altitude <= apogee_val) {
+            if(main_eject_flag == 0) {
+                changeFlightState(ARMED_FLIGHT_STATE::MAIN_DEPLOY);
+                //debugln("MAIN");
+                stateChangeDelay(settle_delay);
+                main_eject_flag = 1;
+            } else if (main_eject_flag == 1) { // todo: confirm check_done_flag
+                changeFlightState(ARMED_FLIGHT_STATE::MAIN_DESCENT);
+                //debugln("MAIN_DESC");
+                stateChangeDelay(settle_delay);
             }
         }
 
-        flight_data.state = current_state;
+        if(flight_data->alt_data.rel_altitude < LAUNCH_DETECTION_THRESHOLD) {
+            changeFlightState(ARMED_FLIGHT_STATE::POST_FLIGHT_GROUND);
+            //debugln("POST_FLIGHT");
+        }
+    }
+
+    flight_data->state = current_state.load();
+    PROBE_STOP(PROBE_STATE_EVAL);
+}
+
+/*!****************************************************************************
+ * @brief check the flight state for every sample received from the sensor tasks
+ *
+ *******************************************************************************/
+void checkFlightState(void* pvParameters) {
+    // get the flight state from the telemetry task
+    telemetry_type_t flight_data; 
+    
+    while (1) {
+        xQueueReceive(check_state_queue_handle, &flight_data, portMAX_DELAY);
+        PROFILE_LOOP_START(PROF_CHECK_FLIGHT_STATE);
+
+        evaluateFlightState(&flight_data, STATE_CHANGE_DELAY);
 
+        PROFILE_LOOP_END(PROF_CHECK_FLIGHT_STATE);
     }
 }
 
@@ -646,7 +844,9 @@ void checkFlightState(void* pvParameters) {
 void flightStateCallback(void* pvParameters) {
 
     while(1) {
-        switch (current_state) {
+        PROFILE_LOOP_START(PROF_FLIGHT_STATE_CALLBACK);
+        uint8_t state = current_state.load();
+        switch (state) {
             // PRE_FLIGHT_GROUND
             case ARMED_FLIGHT_STATE::PRE_FLIGHT_GROUND:
                 //debugln("PRE-FLIGHT STATE");
@@ -670,7 +870,7 @@ void flightStateCallback(void* pvParameters) {
             // DROGUE_DEPLOY
             case ARMED_FLIGHT_STATE::DROGUE_DEPLOY:
                 /* fire charges ony if the flight computer has been armed */
-                if(operation_mode == OPERATION_MODE::ARMED_MODE) {
+                if(operation_mode.load() == OPERATION_MODE::ARMED_MODE) {
                     drogueChuteDeploy();
                 }
 
@@ -682,7 +882,7 @@ void flightStateCallback(void* pvParameters) {
 
             // MAIN_DEPLOY
             case ARMED_FLIGHT_STATE::MAIN_DEPLOY:
-                if(operation_mode == OPERATION_MODE::ARMED_MODE) {
+                if(operation_mode.load() == OPERATION_MODE::ARMED_MODE) {
                     mainChuteDeploy();
                 }
 
@@ -700,15 +900,157 @@ void flightStateCallback(void* pvParameters) {
             
             // MAINTAIN AT PRE_FLIGHT_GROUND IF NO STATE IS SPECIFIED - NOT GONNA HAPPEN BUT BETTER SAFE THAN SORRY
             default:
-                debugln(current_state);
+                debugln(state);
                 break;
 
         }
         
+        PROFILE_LOOP_END(PROF_FLIGHT_STATE_CALLBACK);
         vTaskDelay(CONSUME_TASK_DELAY / portTICK_PERIOD_MS);
     }
 }
 
+/*!****************************************************************************
+ * @brief advance the barometer conversion by one cyclic executive frame
+ * The BMP180 needs a few ms per temperature and pressure conversion. Instead of blocking
+ * like altimeter_get_pressure(), the conversions are started and read back in later frames
+ *
+ * @param pressure updated with the new pressure when a sample completes
+ * @return 1 if a new pressure sample is ready, 0 otherwise
+ *******************************************************************************/
+uint8_t altimeterStep(double* pressure) {
+    static uint8_t baro_step = BARO_STEPS::START_TEMPERATURE;
+    static uint32_t wait_frames = 0;
+    static double T;
+    char status;
+
+    // conversion still running
+    if(wait_frames > 0) {
+        wait_frames--;
+        return 0;
+    }
+
+    switch (baro_step) {
+        case BARO_STEPS::START_TEMPERATURE:
+            status = altimeter.startTemperature();
+            if(status != 0) {
+                wait_frames = cyclic_executive.framesForMs(status);
+                baro_step = BARO_STEPS::READ_TEMPERATURE;
+            } else debugln("error starting temperature measurement");
+            break;
+
+        case BARO_STEPS::READ_TEMPERATURE:
+            baro_step = BARO_STEPS::START_TEMPERATURE;
+            if(altimeter.getTemperature(T) != 0) {
+                altimeter_temperature = T;
+                status = altimeter.startPressure(3);
+                if(status != 0) {
+                    wait_frames = cyclic_executive.framesForMs(status);
+                    baro_step = BARO_STEPS::READ_PRESSURE;
+                } else debugln("error starting pressure");
+            } else debugln("error getting temperature");
+            break;
+
+        case BARO_STEPS::READ_PRESSURE:
+            baro_step = BARO_STEPS::START_TEMPERATURE;
+            if(altimeter.getPressure(*pressure, T) != 0) {
+                return 1;
+            } else debugln("Error getting pressure");
+            break;
+    }
+
+    return 0;
+}
+
+/*!****************************************************************************
+ * @brief fire the pyro charges for the deployment states entered since the last check
+ * Called by the cyclic executive right after the state machine
+ *******************************************************************************/
+void cyclicPyroCheck() {
+    uint16_t entered = entered_states_mask;
+    entered_states_mask = 0;
+
+    /* fire charges ony if the flight computer has been armed */
+    if(operation_mode.load() != OPERATION_MODE::ARMED_MODE) {
+        return;
+    }
+
+    if(entered & (1 << ARMED_FLIGHT_STATE::DROGUE_DEPLOY)) {
+        drogueChuteDeploy();
+    }
+
+    if(entered & (1 << ARMED_FLIGHT_STATE::MAIN_DEPLOY)) {
+        mainChuteDeploy();
+    }
+}
+
+/*!****************************************************************************
+ * @brief run the sense-estimate-decide loop from a fixed rate hardware timer
+ * Replaces the acceleration, altimeter, kalman filter, check state and state callback tasks
+ * when CYCLIC_EXECUTIVE is set. Every frame runs, in this order:
+ * 1. IMU read - every CYCLIC_IMU_DIVIDER frames
+ * 2. barometer step - a new sample completes every few frames, see altimeterStep
+ * 3. kalman filter update - on new barometer samples
+ * 4. flight state machine - on new barometer samples
+ * 5. pyro check
+ *
+ *******************************************************************************/
+void cyclicExecutiveTask(void* pvParameters) {
+    telemetry_type_t frame_data;
+    memset(&frame_data, 0, sizeof(frame_data));
+    double pressure;
+
+    if(!cyclic_executive.begin(CYCLIC_FRAME_RATE, CYCLIC_TIMER_ID)) {
+        debugln("[-]Cyclic executive timer init failed");
+        SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::CRITICAL, system_log_file, "[-]Cyclic executive timer init failed\r\n");
+        TRACE(CYCLIC_TIMER_FAILED);
+        vTaskDelete(NULL);
+    }
+
+    while(1) {
+        uint32_t frame = cyclic_executive.waitForFrame();
+        PROFILE_LOOP_START(PROF_CYCLIC_EXECUTIVE);
+
+        /* 1. IMU */
+        uint8_t imu_frame = (frame % CYCLIC_IMU_DIVIDER) == 0;
+        if(imu_frame) {
+            readIMU(&frame_data);
+        }
+
+        /* 2. barometer */
+        if(altimeterStep(&pressure)) {
+            frame_data.alt_data.pressure = pressure;
+            frame_data.alt_data.temperature = altimeter_temperature;
+            frame_data.alt_data.rel_altitude = altimeter.altitude(pressure, baseline);
+            altimeter_packet.store(frame_data.alt_data);
+
+            /* 3. filter */
+            kalmanFilter(frame_data.alt_data.rel_altitude);
+
+            /* 4. state machine */
+            evaluateFlightState(&frame_data, 0);
+        }
+
+        /* 5. pyro check */
+        cyclicPyroCheck();
+
+        /* hand the sample to the telemetry, logging and debug tasks */
+        if(imu_frame) {
+            frame_data.record_number++;
+            frame_data.timestamp_ms = millis();
+            frame_data.operation_mode = operation_mode.load();
+            frame_data.state = current_state.load();
+
+            xQueueSend(telemetry_data_queue_handle, &frame_data, 0);
+            xQueueSend(log_to_mem_queue_handle, &frame_data, 0);
+            xQueueSend(debug_to_term_queue_handle, &frame_data, 0);
+        }
+
+        cyclic_executive.endFrame();
+        PROFILE_LOOP_END(PROF_CYCLIC_EXECUTIVE);
+    }
+}
+
 /*!****************************************************************************
  * @brief debug flight/test data to terminal, this task is called if the DEBUG_TO_TERMINAL is set to 1 (see defs.h)
  * @param pvParameter - A value that is passed as the parameter to the created task.
@@ -718,55 +1060,22 @@ void flightStateCallback(void* pvParameters) {
  *******************************************************************************/
 void debugToTerminalTask(void* pvParameters){
     telemetry_type_t telemetry_received_packet; // acceleration received from acceleration_queue
+    char telemetry_row[TELEMETRY_ROW_MAX_LENGTH];
 
     while(true){
         // get telemetry data
         xQueueReceive(debug_to_term_queue_handle, &telemetry_received_packet, 0);
+        PROFILE_LOOP_START(PROF_DEBUG_TO_TERMINAL);
+
+        /* take one coherent snapshot of the latest GPS and altimeter values */
+        gps_type_t gps_snapshot = gps_packet.load();
+        altimeter_type_t altimeter_snapshot = altimeter_packet.load();
+
+        /* see formatTelemetryRow for the field order */
+        formatTelemetryRow(telemetry_row, sizeof(telemetry_row), &telemetry_received_packet, &gps_snapshot, &altimeter_snapshot);
         
-        /**
-         * record number
-         * operation_mode
-         * state
-         * ax
-         * ay
-         * az
-         * pitch
-         * roll
-         * gx
-         * gy
-         * gz
-         * latitude
-         * longitude
-         * gps_altitude
-         * pressure
-         * temperature
-         * altitude_agl
-         * velocity
-         *
-         */
-        sprintf(telemetry_packet_buffer,
-                "%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.4f,%.4f,%.2f,%.2f,%.2f,%.2f\n",
-
-                telemetry_received_packet.record_number,
-                telemetry_received_packet.operation_mode,
-                telemetry_received_packet.state,
-                telemetry_received_packet.acc_data.ax,
-                telemetry_received_packet.acc_data.ay,
-                telemetry_received_packet.acc_data.az,
-                telemetry_received_packet.acc_data.pitch,
-                telemetry_received_packet.acc_data.roll,
-                telemetry_received_packet.gyro_data.gx,
-                telemetry_received_packet.gyro_data.gy,
-                telemetry_received_packet.gyro_data.gz,
-                gps_packet.latitude,
-                gps_packet.longitude,
-                gps_packet.gps_altitude,
-                altimeter_packet.pressure,
-                altimeter_packet.temperature,
-                altimeter_packet.rel_altitude
-              );
-        
-        debugln(telemetry_packet_buffer);
+        debugln(telemetry_row);
+        PROFILE_LOOP_END(PROF_DEBUG_TO_TERMINAL);
         vTaskDelay(CONSUME_TASK_DELAY / portTICK_PERIOD_MS);
     }
 }
@@ -783,24 +1092,142 @@ void logToMemory(void* pvParameter) {
     telemetry_type_t received_packet;
 
     while(1) {
-        xQueueReceive(log_to_mem_queue_handle, &received_packet, portMAX_DELAY);
+        // no samples for a while - e.g. after landing - write out what we have
+        if(xQueueReceive(log_to_mem_queue_handle, &received_packet, LOGGER_FLUSH_TIMEOUT / portTICK_PERIOD_MS) != pdTRUE) {
+            data_logger.loggerFlush();
+            continue;
+        }
+
+        PROFILE_LOOP_START(PROF_LOG_TO_MEMORY);
 
-        // received_packet.record_number++; 
+        /* the IMU samples do not carry the slower sensors - add their latest values */
+        received_packet.gps_data = gps_packet.load();
+        received_packet.alt_data = altimeter_packet.load();
 
-        // is it time to record?
-        current_log_time = millis();
+        // every sample is logged - the flash writer task programs the pages in the background
+        data_logger.loggerWrite(received_packet);
+
+        PROFILE_LOOP_END(PROF_LOG_TO_MEMORY);
+    }
+
+}
+
+/*!****************************************************************************
+ * @brief program the page buffers filled by logToMemory to the external flash memory
+ * Runs below the flight tasks since SerialFlash busy-polls the chip while a page programs.
+ * Between pages it runs the log maintenance - erasing ahead of the writes and erases requested
+ * from the ground
+ *
+ *******************************************************************************/
+void flashWriterTask(void* pvParameter) {
+    uint8_t page;
 
-        if(current_log_time - previous_log_time > log_sample_interval) {
-            previous_log_time = current_log_time;
-            data_logger.loggerWrite(received_packet);
+    while(1) {
+        if(data_logger.loggerNextPage(&page, LOGGER_SERVICE_INTERVAL / portTICK_PERIOD_MS)) {
+            PROFILE_LOOP_START(PROF_FLASH_WRITER);
+            data_logger.loggerProgramPage(page);
+            PROFILE_LOOP_END(PROF_FLASH_WRITER);
         }
-        
+
+        data_logger.loggerService(current_state.load() == ARMED_FLIGHT_STATE::PRE_FLIGHT_GROUND);
+    }
+}
+
+/*!****************************************************************************
+ * @brief write the queued event log messages and trace events to SPIFFS
+ * Started first thing in setup() so that logging never waits on the file system. Woken up
+ * early by CRITICAL and ERROR messages and at landing, see SystemLogger
+ *
+ *******************************************************************************/
+void eventLogTask(void* pvParameter) {
+    while(1) {
+        ulTaskNotifyTake(pdTRUE, EVENT_LOG_SERVICE_INTERVAL / portTICK_PERIOD_MS);
+
+        PROFILE_LOOP_START(PROF_EVENT_LOG);
+        SYSTEM_LOGGER.service();
+        TRACER.service();
+        PROFILE_LOOP_END(PROF_EVENT_LOG);
+    }
+}
+
+#if LOG_TO_SD
+/*!****************************************************************************
+ * @brief write the flight log pages queued by the flash writer to the SD card
+ * Runs at the flash writer priority. Only this task touches the SD card, so a slow card
+ * only costs queued pages, never a sensor sample or a flash page
+ *
+ *******************************************************************************/
+void sdWriterTask(void* pvParameter) {
+    while(1) {
+        PROFILE_LOOP_START(PROF_SD_WRITER);
+        sd_logger.sdService();
+        PROFILE_LOOP_END(PROF_SD_WRITER);
+
+        vTaskDelay(SD_SERVICE_INTERVAL / portTICK_PERIOD_MS);
     }
+}
+#endif // LOG_TO_SD
+
+/*!****************************************************************************
+ * @brief convert a telemetry sample to the scaled fields of a binary telemetry frame
+ * @param packet telemetry sample
+ * @param gps latest GPS snapshot
+ * @param altimeter latest altimeter snapshot
+ * @param fields FLIGHT_LOG_FIELD_COUNT values
+ *******************************************************************************/
+void telemetryToFields(const telemetry_type_t* packet, const gps_type_t* gps, const altimeter_type_t* altimeter, int32_t* fields) {
+    flight_log_sample_t sample;
+
+    sample.timestamp_ms = packet->timestamp_ms;
+    sample.record_number = packet->record_number;
+    sample.operation_mode = packet->operation_mode;
+    sample.state = packet->state;
+    sample.log_policy = 0;
+    sample.ax = packet->acc_data.ax;
+    sample.ay = packet->acc_data.ay;
+    sample.az = packet->acc_data.az;
+    sample.gx = packet->gyro_data.gx;
+    sample.gy = packet->gyro_data.gy;
+    sample.gz = packet->gyro_data.gz;
+    sample.pitch = packet->acc_data.pitch;
+    sample.roll = packet->acc_data.roll;
+    sample.latitude = gps->latitude;
+    sample.longitude = gps->longitude;
+    sample.gps_altitude = gps->gps_altitude;
+    sample.pressure = altimeter->pressure;
+    sample.temperature = altimeter->temperature;
+    sample.rel_altitude = altimeter->rel_altitude;
+    sample.velocity = altimeter->velocity;
+
+    flightLogToFields(&sample, fields);
+}
 
+/*!****************************************************************************
+ * @brief queue the telemetry batch as one MQTT message. Never waits for the network -
+ * the MQTT publisher task sends it
+ *******************************************************************************/
+void publishTelemetryBatch() {
+    bool queued = MQTT_PUBLISHER.publishTelemetry(MQTT_TELEMETRY_TOPIC, telemetry_batch.buffer, telemetry_batch.length);
+    telemetryBatchSent(&telemetry_batch, queued);
 }
 
 /*!****************************************************************************
- * @brief send flight data to ground
+ * @brief send the XBee telemetry batch as one frame. Never waits for the UART
+ *******************************************************************************/
+#if XBEE
+void sendXbeeBatch() {
+    bool sent = XBEE_LINK.send(xbee_batch.buffer, xbee_batch.length);
+    telemetryBatchSent(&xbee_batch, sent);
+}
+#endif
+
+/*!****************************************************************************
+ * @brief send flight data to ground over MQTT, the XBee, or both
+ * Samples are batched - see telemetry_batch.h - so that one publish carries up to
+ * TELEMETRY_BATCH_SAMPLES samples. One sample every TELEMETRY_SUMMARY_INTERVAL ms also goes
+ * to the summary topic on its own, which the publisher sends ahead of the batches.
+ * The XBee link is slow, so it gets one sample in XBEE_SAMPLE_DIVIDER, always as delta
+ * compressed frames, see telemetry_delta.h, with a stream of their own
  * @param pvParameter - A value that is passed as the parameter to the created task.
  * If pvParameter is set to the address of a variable then the variable must still exist when the created task executes -
  * so it is not valid to pass the address of a stack variable.
@@ -809,90 +1236,124 @@ void logToMemory(void* pvParameter) {
 void MQTT_TransmitTelemetry(void* pvParameters) {
     // variable to store the received packet to transmit
     telemetry_type_t telemetry_received_packet;
+    char telemetry_row[TELEMETRY_ROW_MAX_LENGTH];
+    int32_t fields[FLIGHT_LOG_FIELD_COUNT];
+    uint8_t summary_frame[TELEMETRY_FRAME_SIZE(1)];
+    uint32_t summary_due_ms = millis();
+    telemetry_delta_encoder_t delta_encoder;
+
+    telemetryBatchInit(&telemetry_batch, telemetry_batch_buffer, sizeof(telemetry_batch_buffer), TELEMETRY_BATCH_SAMPLES, TELEMETRY_BATCH_MS);
+    telemetryDeltaEncoderInit(&delta_encoder, TELEMETRY_KEYFRAME_INTERVAL);
+
+    #if XBEE
+        telemetry_delta_encoder_t xbee_encoder;
+        telemetry_decimator_t xbee_decimator;
+        telemetryBatchInit(&xbee_batch, xbee_batch_buffer, sizeof(xbee_batch_buffer), TELEMETRY_BATCH_SAMPLES, TELEMETRY_BATCH_MS);
+        telemetryDeltaEncoderInit(&xbee_encoder, TELEMETRY_KEYFRAME_INTERVAL);
+        telemetryDecimatorInit(&xbee_decimator, XBEE_SAMPLE_DIVIDER);
+    #endif
 
     while(1) {
 
-        // receive from telemetry queue
-        xQueueReceive(telemetry_data_queue_handle, &telemetry_received_packet, portMAX_DELAY);
-
-        /**
-         * PACKAGE TELEMETRY PACKET
-         */
-
-        /**
-         * record number
-         * operation_mode
-         * state
-         * ax
-         * ay
-         * az
-         * pitch
-         * roll
-         * gx
-         * gy
-         * gz
-         * latitude
-         * longitude
-         * gps_altitude
-         * pressure
-         * temperature
-         * relative_altitude
-         */
-        sprintf(telemetry_packet_buffer,
-                "%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.4f,%.4f,%.2f,%.2f,%.2f,%.2f\n",
-
-                telemetry_received_packet.record_number,
-                telemetry_received_packet.operation_mode,
-                telemetry_received_packet.state,
-                telemetry_received_packet.acc_data.ax,
-                telemetry_received_packet.acc_data.ay,
-                telemetry_received_packet.acc_data.az,
-                telemetry_received_packet.acc_data.pitch,
-                telemetry_received_packet.acc_data.roll,
-                telemetry_received_packet.gyro_data.gx,
-                telemetry_received_packet.gyro_data.gy,
-                telemetry_received_packet.gyro_data.gz,
-                gps_packet.latitude,
-                gps_packet.longitude,
-                gps_packet.gps_altitude,
-                altimeter_packet.pressure,
-                altimeter_packet.temperature,
-                altimeter_packet.rel_altitude
-        );
-
-        /* Send to MQTT topic  */
-         if(client.publish(MQTT_TELEMETRY_TOPIC, telemetry_packet_buffer) ) {
-             debugln("[+]Data sent");
-         } else {
-             debugln("[-]Data not sent");
-         }
-
-        client.publish(MQTT_TELEMETRY_TOPIC, telemetry_packet_buffer);
-    }
+        // receive from telemetry queue, until a batch is due
+        uint32_t wait_ms = telemetryBatchWaitMs(&telemetry_batch, millis());
+        #if XBEE
+            wait_ms = min(wait_ms, telemetryBatchWaitMs(&xbee_batch, millis()));
+        #endif
+        TickType_t wait = wait_ms == UINT32_MAX ? portMAX_DELAY : wait_ms / portTICK_PERIOD_MS;
+        bool received = xQueueReceive(telemetry_data_queue_handle, &telemetry_received_packet, wait) == pdTRUE;
+        PROFILE_LOOP_START(PROF_MQTT_TRANSMIT_TELEMETRY);
+
+        if(received) {
+            /* take one coherent snapshot of the latest GPS and altimeter values */
+            gps_type_t gps_snapshot = gps_packet.load();
+            altimeter_type_t altimeter_snapshot = altimeter_packet.load();
+
+            /**
+             * PACKAGE TELEMETRY PACKET
+             */
+
+            #if XBEE
+                if(telemetryDecimatorKeep(&xbee_decimator, telemetry_received_packet.state)) {
+                    telemetryToFields(&telemetry_received_packet, &gps_snapshot, &altimeter_snapshot, fields);
+                    if(!telemetryBatchAddDelta(&xbee_batch, &xbee_encoder, fields, millis())) {
+                        sendXbeeBatch();
+                        telemetryBatchAddDelta(&xbee_batch, &xbee_encoder, fields, millis());
+                    }
+                }
+            #endif
 
-    vTaskDelay(CONSUME_TASK_DELAY/ portTICK_PERIOD_MS);
-}
+            #if MQTT
+            // decimated copy for the summary topic
+            bool summary = TELEMETRY_SUMMARY_INTERVAL && (int32_t)(millis() - summary_due_ms) >= 0;
+            if(summary) {
+                summary_due_ms = millis() + TELEMETRY_SUMMARY_INTERVAL;
+            }
 
-/*!
- * @brief Try reconnecting to MQTT if connection is lost
- *
- */
-void MQTT_Reconnect() {
-    // while(1) {
-        if(!client.connected()) {
-            debugln("[..]Attempting MQTT connection..."); // TODO: SYS LOGGER
-            if (client.connect("FC")) {
-                debugln("[+]MQTT reconnected");
-                client.subscribe("n4/commands"); // TODO: USE DEFINE here
-                mqtt_connect_flag = 1;
+            uint8_t encoding = telemetry_encoding.load();
+            if(encoding == TELEMETRY_ENCODING_BINARY || encoding == TELEMETRY_ENCODING_DELTA) {
+                /* scaled integers in the flight log record layout, see telemetry_frame.h */
+                telemetryToFields(&telemetry_received_packet, &gps_snapshot, &altimeter_snapshot, fields);
+                if(encoding == TELEMETRY_ENCODING_DELTA) {
+                    if(!telemetryBatchAddDelta(&telemetry_batch, &delta_encoder, fields, millis())) {
+                        publishTelemetryBatch();
+                        telemetryBatchAddDelta(&telemetry_batch, &delta_encoder, fields, millis());
+                    }
+                } else if(!telemetryBatchAddFields(&telemetry_batch, fields, millis())) {
+                    publishTelemetryBatch();
+                    telemetryBatchAddFields(&telemetry_batch, fields, millis());
+                }
+
+                /* the summary must decode on its own, so it is always a full record */
+                if(summary) {
+                    size_t length = telemetryFrameEncode(summary_frame, fields);
+                    MQTT_PUBLISHER.publishSummary(MQTT_SUMMARY_TOPIC, summary_frame, length);
+                }
             } else {
-                mqtt_connect_flag = 0;
-                debug("failed, rc=");
-                debugln(client.state());
-                vTaskDelay(1000/portTICK_PERIOD_MS);
+                /* see formatTelemetryRow for the field order */
+                size_t length = formatTelemetryRow(telemetry_row, sizeof(telemetry_row), &telemetry_received_packet, &gps_snapshot, &altimeter_snapshot);
+                if(!telemetryBatchAddRow(&telemetry_batch, telemetry_row, length, telemetry_received_packet.state, millis())) {
+                    publishTelemetryBatch();
+                    telemetryBatchAddRow(&telemetry_batch, telemetry_row, length, telemetry_received_packet.state, millis());
+                }
+
+                if(summary) {
+                    MQTT_PUBLISHER.publishSummary(MQTT_SUMMARY_TOPIC, (const uint8_t*)telemetry_row, length);
+                }
             }
+            #endif // MQTT
         }
-    // }
+
+        #if MQTT
+            if(telemetryBatchDue(&telemetry_batch, millis()) != TELEMETRY_FLUSH_NONE) {
+                publishTelemetryBatch();
+            }
+        #endif
+
+        #if XBEE
+            if(telemetryBatchDue(&xbee_batch, millis()) != TELEMETRY_FLUSH_NONE) {
+                sendXbeeBatch();
+            }
+        #endif
+        PROFILE_LOOP_END(PROF_MQTT_TRANSMIT_TELEMETRY);
+    }
+
+    vTaskDelay(CONSUME_TASK_DELAY/ portTICK_PERIOD_MS);
+}
+
+/*!****************************************************************************
+ * @brief keep the MQTT link up, receive the ground commands and publish the queued
+ * messages - the only task that uses the MQTT client, see mqtt_publisher.h
+ *******************************************************************************/
+void mqttPublisherTask(void* pvParameters) {
+    while(1) {
+        // woken up by every queued message, and at least every MQTT_SERVICE_INTERVAL for client.loop()
+        ulTaskNotifyTake(pdTRUE, MQTT_SERVICE_INTERVAL / portTICK_PERIOD_MS);
+
+        PROFILE_LOOP_START(PROF_MQTT_PUBLISHER);
+        MQTT_PUBLISHER.service();
+        PROFILE_LOOP_END(PROF_MQTT_PUBLISHER);
+    }
 }
 
 // This function is called whenever an MQTT message is received
@@ -910,10 +1371,14 @@ void mqtt_Callback(char* topic, byte* payload, unsigned int length) {
  *
  *******************************************************************************/
 void MQTTInit(const char* broker_IP, int broker_port) {
-    // client.setBufferSize(MQTT_BUFFER_SIZE);
+    static WiFiClient wifi_client;
+    static PubSubClient client(wifi_client);
+
+    client.setBufferSize(MQTT_BUFFER_SIZE);
     debugln("[+]Initializing MQTT\n");
     client.setServer(broker_IP, broker_port);
     client.setCallback(mqtt_Callback);
+    MQTT_PUBLISHER.begin(&client, "FC", MQTT_ARMING_TOPIC);
     debugln("MQTT callback hooked!");
     delay(1000);
     debugln("[+]MQTT init OK");
@@ -925,22 +1390,123 @@ void MQTTInit(const char* broker_IP, int broker_port) {
 void xOperationModeIndicateTask(void* pvParameters) {
     while(1)
     {
-        if (operation_mode) {
+        PROFILE_LOOP_START(PROF_OP_MODE_INDICATE);
+        if (operation_mode.load()) {
             /* armed */
             digitalWrite(RED_LED_PIN, HIGH);
+            PROFILE_LOOP_PAUSE(PROF_OP_MODE_INDICATE);
             vTaskDelay(BLINK_INTERVALS::ARMED_BLINK);
+            PROFILE_LOOP_RESUME(PROF_OP_MODE_INDICATE);
             digitalWrite(RED_LED_PIN, LOW);
+            PROFILE_LOOP_END(PROF_OP_MODE_INDICATE);
             vTaskDelay(BLINK_INTERVALS::ARMED_BLINK);
-        } else if(!operation_mode) {
+        } else {
             /* safe */
             digitalWrite(GREEN_LED_PIN, HIGH);
+            PROFILE_LOOP_PAUSE(PROF_OP_MODE_INDICATE);
             vTaskDelay(BLINK_INTERVALS::SAFE_BLINK);
+            PROFILE_LOOP_RESUME(PROF_OP_MODE_INDICATE);
             digitalWrite(GREEN_LED_PIN, LOW);
+            PROFILE_LOOP_END(PROF_OP_MODE_INDICATE);
             vTaskDelay(BLINK_INTERVALS::SAFE_BLINK);
         }
     }
 }
 
+/*!****************************************************************************
+ * @brief send one line of a diagnostics report to the serial monitor, MQTT and the event log
+ *******************************************************************************/
+void diagnosticsEmit(const char* line) {
+    debugln(line);
+
+    #if MQTT
+        MQTT_PUBLISHER.publishSummary(MQTT_DIAGNOSTICS_TOPIC, (const uint8_t*)line, strlen(line));
+    #endif
+
+    SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::DEBUG, system_log_file, line);
+}
+
+/*!****************************************************************************
+ * @brief report per-task CPU load, loop execution time and stack headroom, and dump the
+ * timing probe histograms
+ *
+ * The profiler report is sent every PROFILER_REPORT_INTERVAL ms, and immediately when the
+ * flight state changes (see changeFlightState). The timing probes are dumped on the PROBES
+ * command and once we land.
+ *
+ *******************************************************************************/
+void diagnosticsTask(void* pvParameters) {
+    char report_line[128];
+
+    while(1) {
+        // no events means the report interval timed out
+        uint32_t diag_events = 0;
+        xTaskNotifyWait(0, 0xFFFFFFFF, &diag_events, PROFILER_REPORT_INTERVAL / portTICK_PERIOD_MS);
+
+        #if PROFILE_TASKS
+            if(diag_events == 0 || (diag_events & DIAG_STATE_CHANGE)) {
+                task_profiler.sample();
+
+                task_profiler.formatHeader(report_line, sizeof(report_line), diag_events ? flightStateString(current_state.load()) : "PERIODIC");
+                diagnosticsEmit(report_line);
+
+                for(uint8_t i = 0; i < PROFILER_TASK_COUNT; i++) {
+                    if(task_profiler.formatTask(i, report_line, sizeof(report_line))) {
+                        diagnosticsEmit(report_line);
+                    }
+                }
+
+                #if CYCLIC_EXECUTIVE
+                    cyclic_executive.formatStats(report_line, sizeof(report_line));
+                    diagnosticsEmit(report_line);
+                #endif
+
+                #if LOG_TO_MEMORY
+                    data_logger.loggerFormatStats(report_line, sizeof(report_line));
+                    diagnosticsEmit(report_line);
+                #endif
+
+                #if LOG_TO_SD
+                    sd_logger.sdFormatStats(report_line, sizeof(report_line));
+                    diagnosticsEmit(report_line);
+                #endif
+
+                SYSTEM_LOGGER.formatStats(report_line, sizeof(report_line));
+                diagnosticsEmit(report_line);
+
+                #if MQTT
+                    telemetryBatchFormatStats(&telemetry_batch, report_line, sizeof(report_line), millis());
+                    diagnosticsEmit(report_line);
+
+                    MQTT_PUBLISHER.formatStats(report_line, sizeof(report_line));
+                    diagnosticsEmit(report_line);
+                #endif
+
+                #if XBEE
+                    XBEE_LINK.formatStats(report_line, sizeof(report_line));
+                    diagnosticsEmit(report_line);
+                #endif
+
+                #if TRACING
+                    TRACER.formatStats(report_line, sizeof(report_line));
+                    diagnosticsEmit(report_line);
+                #endif
+            }
+        #endif // PROFILE_TASKS
+
+        #if TIMING_PROBES
+            if(diag_events & DIAG_DUMP_PROBES) {
+                diagnosticsEmit("PROBES");
+                for(uint8_t i = 0; i < PROBE_COUNT; i++) {
+                    if(timing_probes.format(i, report_line, sizeof(report_line))) {
+                        diagnosticsEmit(report_line);
+                    }
+                }
+            }
+        #endif // TIMING_PROBES
+    }
+}
+
 /*!****************************************************************************
  * @brief fires the pyro-charge to deploy the drogue chute
  * Turn on the drogue chute ejection circuit by running the GPIO 
@@ -964,7 +1530,6 @@ void drogueChuteDeploy() {
     //     DROGUE_DEPLOY_FLAG = 1;
     //     debugln("DROGUE CHUTE DEPLOYED");
     // }
-
 }
 
 /*!****************************************************************************
@@ -995,15 +1560,37 @@ void xCreateAllTasks() {
         debugln("Creating all tasks");
         //vTaskDelay(200/portTICK_PERIOD_MS);
 
-        /* READ ACCELERATION DATA */
-        BaseType_t gr = xTaskCreatePinnedToCore(readAccelerationTask, "readAccelerometer", STACK_SIZE*2, NULL, 2, &readAccelerationTaskHandle, 1);
-        if(gr == pdPASS) {
-            debugln("[+]Read acceleration task created OK.");
-            SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]Read acceleration task created OK.\r\n");
-        } else {
-            debugln("[-]Read acceleration task creation failed");
-            SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Read acceleration task creation failed\r\n");
-        }
+        #if PROFILE_TASKS
+            /* register every task handle with the profiler - stack sizes must match the ones used below */
+            task_profiler.registerTask(PROF_READ_ACCELERATION, "readAccelerometer", &readAccelerationTaskHandle, STACK_SIZE*2);
+            task_profiler.registerTask(PROF_READ_ALTIMETER, "readAltimeter", &readAltimeterTaskHandle, STACK_SIZE*2);
+            task_profiler.registerTask(PROF_READ_GPS, "readGPS", &readGPSTaskHandle, STACK_SIZE*2);
+            task_profiler.registerTask(PROF_CHECK_FLIGHT_STATE, "checkFlightState", &checkFlightStateTaskHandle, STACK_SIZE*2);
+            task_profiler.registerTask(PROF_FLIGHT_STATE_CALLBACK, "flightStateCallback", &flightStateCallbackTaskHandle, STACK_SIZE*2);
+            task_profiler.registerTask(PROF_MQTT_TRANSMIT_TELEMETRY, "transmit_telemetry", &MQTT_TransmitTelemetryTaskHandle, STACK_SIZE*2);
+            task_profiler.registerTask(PROF_KALMAN_FILTER, "kalman filter", &kalmanFilterTaskHandle, STACK_SIZE*2);
+            task_profiler.registerTask(PROF_DEBUG_TO_TERMINAL, "debugToTerminalTask", &debugToTerminalTaskHandle, STACK_SIZE*4);
+            task_profiler.registerTask(PROF_LOG_TO_MEMORY, "logToMemory", &logToMemoryTaskHandle, STACK_SIZE*4);
+            task_profiler.registerTask(PROF_OP_MODE_INDICATE, "xOperationModeIndicateTask", &opModeIndicateTaskHandle, STACK_SIZE*2);
+            task_profiler.registerTask(PROF_CYCLIC_EXECUTIVE, "cyclicExecutive", &cyclicExecutiveTaskHandle, STACK_SIZE*4);
+            task_profiler.registerTask(PROF_FLASH_WRITER, "flashWriter", &flashWriterTaskHandle, STACK_SIZE*2);
+            task_profiler.registerTask(PROF_SD_WRITER, "sdWriter", &sdWriterTaskHandle, STACK_SIZE*4);
+            task_profiler.registerTask(PROF_EVENT_LOG, "eventLog", &eventLogTaskHandle, STACK_SIZE*4);
+            task_profiler.registerTask(PROF_MQTT_PUBLISHER, "mqttPublisher", &mqttPublisherTaskHandle, STACK_SIZE*4);
+        #endif // PROFILE_TASKS
+
+        #if !CYCLIC_EXECUTIVE
+            /* READ ACCELERATION DATA */
+            BaseType_t gr = xTaskCreatePinnedToCore(readAccelerationTask, "readAccelerometer", STACK_SIZE*2, NULL, 2, &readAccelerationTaskHandle, 1);
+            if(gr == pdPASS) {
+                debugln("[+]Read acceleration task created OK.");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]Read acceleration task created OK.\r\n");
+            } else {
+                debugln("[-]Read acceleration task creation failed");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Read acceleration task creation failed\r\n");
+                TRACE(TASK_CREATE_FAILED, PROF_READ_ACCELERATION);
+            }
+        #endif // !CYCLIC_EXECUTIVE
 
         /* TASK 3: READ GPS DATA */
         BaseType_t rg = xTaskCreatePinnedToCore(readGPSTask, "readGPS", STACK_SIZE*2, NULL, 2, &readGPSTaskHandle, 1);
@@ -1015,28 +1602,30 @@ void xCreateAllTasks() {
             SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Failed to create GPS task\r\n");
         }
 
-        /* CHECK FLIGHT STATE TASK */
-         BaseType_t cf = xTaskCreatePinnedToCore(checkFlightState,"checkFlightState",STACK_SIZE*2,NULL, 2, &checkFlightStateTaskHandle, 1);
-
-         if(cf == pdPASS) {
-             debugln("[+]checkFlightState task created OK.");
-             SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]checkFlightState task created OK.\r\n");
-         } else {
-             debugln("[-]Failed to create checkFlightState task");
-             SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Failed to create checkFlightState task\r\n");
-         }
-
-        /* FLIGHT STATE CALLBACK TASK */
-        BaseType_t fs = xTaskCreatePinnedToCore(flightStateCallback, "flightStateCallback", STACK_SIZE*2, NULL, 2, &flightStateCallbackTaskHandle, 1);
-        if(fs == pdPASS) {
-            debugln("[+]flightStateCallback task created OK.");
-            SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]flightStateCallback task created OK.\r\n");
-        } else {
-            debugln("[-]Failed to create flightStateCallback task");
-            SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Failed to create flightStateCallback task\r\n");
-        }
+        #if !CYCLIC_EXECUTIVE
+            /* CHECK FLIGHT STATE TASK */
+             BaseType_t cf = xTaskCreatePinnedToCore(checkFlightState,"checkFlightState",STACK_SIZE*2,NULL, 2, &checkFlightStateTaskHandle, 1);
+
+             if(cf == pdPASS) {
+                 debugln("[+]checkFlightState task created OK.");
+                 SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]checkFlightState task created OK.\r\n");
+             } else {
+                 debugln("[-]Failed to create checkFlightState task");
+                 SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Failed to create checkFlightState task\r\n");
+             }
+
+            /* FLIGHT STATE CALLBACK TASK */
+            BaseType_t fs = xTaskCreatePinnedToCore(flightStateCallback, "flightStateCallback", STACK_SIZE*2, NULL, 2, &flightStateCallbackTaskHandle, 1);
+            if(fs == pdPASS) {
+                debugln("[+]flightStateCallback task created OK.");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]flightStateCallback task created OK.\r\n");
+            } else {
+                debugln("[-]Failed to create flightStateCallback task");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Failed to create flightStateCallback task\r\n");
+            }
+        #endif // !CYCLIC_EXECUTIVE
 
-        #if MQTT
+        #if MQTT || XBEE
             /* TRANSMIT TELEMETRY DATA */
             BaseType_t th = xTaskCreatePinnedToCore(MQTT_TransmitTelemetry, "transmit_telemetry", STACK_SIZE*2, NULL, 2, &MQTT_TransmitTelemetryTaskHandle, 1);
 
@@ -1047,19 +1636,36 @@ void xCreateAllTasks() {
             } else {
                 debugln("[-]MQTT transmit task failed to create");
                 SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]MQTT transmit task failed to create\r\n");
+                TRACE(TASK_CREATE_FAILED, PROF_MQTT_TRANSMIT_TELEMETRY);
+            }
+        #endif
+
+        #if MQTT
+            /* OWN THE MQTT CLIENT - below the flight tasks, a slow link only delays this task */
+            if(xTaskCreatePinnedToCore(mqttPublisherTask, "mqttPublisher", STACK_SIZE*4, NULL, 1, &mqttPublisherTaskHandle, 1) != pdPASS) {
+                debugln("[-]mqttPublisher task failed to create");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]mqttPublisher task failed to create\r\n");
+                TRACE(TASK_CREATE_FAILED, PROF_MQTT_PUBLISHER);
+            } else {
+                MQTT_PUBLISHER.setTask(mqttPublisherTaskHandle);
+                debugln("[+]mqttPublisher task created OK.");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]mqttPublisher task created OK.\r\n");
             }
 
         #endif
 
-        BaseType_t kf = xTaskCreatePinnedToCore(kalmanFilterTask, "kalman filter", STACK_SIZE*2, NULL, 2, &kalmanFilterTaskHandle, 1);
+        #if !CYCLIC_EXECUTIVE
+            BaseType_t kf = xTaskCreatePinnedToCore(kalmanFilterTask, "kalman filter", STACK_SIZE*2, NULL, 2, &kalmanFilterTaskHandle, 1);
 
-        if(kf == pdPASS) {
-            debugln("[+]kalmanFilter task created OK.");
-            SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]kalman_filter_queue_handle creation OK.\r\n");
-        } else {
-            debugln("[-]kalmanFilter task failed to create");
-            SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]kalmanFilter task failed to create\r\n");
-        }
+            if(kf == pdPASS) {
+                debugln("[+]kalmanFilter task created OK.");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]kalman_filter_queue_handle creation OK.\r\n");
+            } else {
+                debugln("[-]kalmanFilter task failed to create");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]kalmanFilter task failed to create\r\n");
+                TRACE(TASK_CREATE_FAILED, PROF_KALMAN_FILTER);
+            }
+        #endif // !CYCLIC_EXECUTIVE
 
         #if DEBUG_TO_TERMINAL   // set DEBUG_TO_TERMINAL to 0 to prevent serial debug data to serial monitor
 
@@ -1072,6 +1678,7 @@ void xCreateAllTasks() {
             } else {
                 debugln("[-]debugToTerminal task not created");
                 SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]debugToTerminal task not created\r\n");
+                TRACE(TASK_CREATE_FAILED, PROF_DEBUG_TO_TERMINAL);
             }
         
         #endif // DEBUG_TO_TERMINAL_TASK
@@ -1081,41 +1688,83 @@ void xCreateAllTasks() {
             if(xTaskCreatePinnedToCore(logToMemory,"logToMemory",STACK_SIZE*4,NULL,2,&logToMemoryTaskHandle,1) != pdPASS){
                 debugln("[-]logToMemory task failed to create");
                 SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]logToMemory task failed to create\r\n");
+                TRACE(TASK_CREATE_FAILED, PROF_LOG_TO_MEMORY);
 
             }else{
                 debugln("[+]logToMemory task created OK.");
                 SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]logToMemory task created OK.\r\n");
             }
+
+            /* FLASH WRITER - programs the pages filled by logToMemory */
+            if(xTaskCreatePinnedToCore(flashWriterTask,"flashWriter",STACK_SIZE*2,NULL,1,&flashWriterTaskHandle,1) != pdPASS){
+                debugln("[-]flashWriter task failed to create");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]flashWriter task failed to create\r\n");
+                TRACE(TASK_CREATE_FAILED, PROF_FLASH_WRITER);
+
+            }else{
+                debugln("[+]flashWriter task created OK.");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]flashWriter task created OK.\r\n");
+            }
+
+            #if LOG_TO_SD
+                /* SD WRITER - writes the copy of the flash pages to the SD card */
+                if(xTaskCreatePinnedToCore(sdWriterTask,"sdWriter",STACK_SIZE*4,NULL,1,&sdWriterTaskHandle,1) != pdPASS){
+                    debugln("[-]sdWriter task failed to create");
+                    SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]sdWriter task failed to create\r\n");
+                    TRACE(TASK_CREATE_FAILED, PROF_SD_WRITER);
+
+                }else{
+                    debugln("[+]sdWriter task created OK.");
+                    SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]sdWriter task created OK.\r\n");
+                }
+            #endif // LOG_TO_SD
         #endif // LOG_TO_MEMORY
 
         if(xTaskCreatePinnedToCore(xOperationModeIndicateTask,"xOperationModeIndicateTask",STACK_SIZE*2,NULL,2,&opModeIndicateTaskHandle,1) != pdPASS){
 
             debugln("[-]xOperationModeIndicateTask task failed to create");
             SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]xOperationModeIndicateTask task failed to create\r\n");
+            TRACE(TASK_CREATE_FAILED, PROF_OP_MODE_INDICATE);
         }else{
             debugln("[+]xOperationModeIndicateTask task created OK.");
             SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]xOperationModeIndicateTask task created OK.\r\n");
         }
 
-        /* READ ALTIMETER DATA */
-        BaseType_t ra = xTaskCreatePinnedToCore(readAltimeterTask,"readAltimeter",STACK_SIZE*2,NULL,2, &readAltimeterTaskHandle, 1);
-        if(ra == pdPASS) {
-            debugln("[+]readAltimeterTask created OK.");
-            SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]readAltimeterTask created OK.\r\n");
-        } else {
-            debugln("[-]Failed to create readAltimeterTask");
-            SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Failed to create readAltimeterTask\r\n");
-        }
-
-        /* RECONNECT MQTT */
-        // BaseType_t rp = xTaskCreatePinnedToCore(MQTT_Reconnect,"reconnectMQTT",STACK_SIZE*2,NULL,2, NULL, 1);
-        // if(rp == pdPASS) {
-        //     debugln("[+]reconnectMQTT created OK.");
-        //     SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]reconnectMQTT created OK.\r\n");
-        // } else {
-        //     debugln("[-]Failed to create reconnectMQTT");
-        //     SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Failed to create reconnectMQTT\r\n");
-        // }
+        #if !CYCLIC_EXECUTIVE
+            /* READ ALTIMETER DATA */
+            BaseType_t ra = xTaskCreatePinnedToCore(readAltimeterTask,"readAltimeter",STACK_SIZE*2,NULL,2, &readAltimeterTaskHandle, 1);
+            if(ra == pdPASS) {
+                debugln("[+]readAltimeterTask created OK.");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]readAltimeterTask created OK.\r\n");
+            } else {
+                debugln("[-]Failed to create readAltimeterTask");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Failed to create readAltimeterTask\r\n");
+            }
+        #endif // !CYCLIC_EXECUTIVE
+
+        #if CYCLIC_EXECUTIVE
+            /* SENSE-ESTIMATE-DECIDE LOOP - highest priority of our tasks, released by the frame timer */
+            BaseType_t ce = xTaskCreatePinnedToCore(cyclicExecutiveTask, "cyclicExecutive", STACK_SIZE*4, NULL, CYCLIC_EXECUTIVE_PRIORITY, &cyclicExecutiveTaskHandle, 1);
+            if(ce == pdPASS) {
+                debugln("[+]cyclicExecutive task created OK.");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]cyclicExecutive task created OK.\r\n");
+            } else {
+                debugln("[-]Failed to create cyclicExecutive task");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Failed to create cyclicExecutive task\r\n");
+            }
+        #endif // CYCLIC_EXECUTIVE
+
+        #if PROFILE_TASKS || TIMING_PROBES
+            /* DIAGNOSTICS - lowest priority so that it does not disturb what it measures */
+            BaseType_t dg = xTaskCreatePinnedToCore(diagnosticsTask, "diagnostics", STACK_SIZE*4, NULL, 1, &diagnosticsTaskHandle, 1);
+            if(dg == pdPASS) {
+                debugln("[+]diagnostics task created OK.");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]diagnostics task created OK.\r\n");
+            } else {
+                debugln("[-]Failed to create diagnostics task");
+                SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]Failed to create diagnostics task\r\n");
+            }
+        #endif // PROFILE_TASKS || TIMING_PROBES
 
 
         debugln();
@@ -1125,9 +1774,6 @@ void xCreateAllTasks() {
 
         // resume all tasks after creation
 
-        // delete this task
-        vTaskDelete(NULL);
-    
     
 }
 
@@ -1155,6 +1801,19 @@ void setup() {
     // SPIFFS Must be initialized first to allow event logging from the word go
     uint8_t spiffs_init_state = InitSPIFFS();
 
+    // the event log task writes the event log from here on - logToFile() only queues the message
+    if(xTaskCreatePinnedToCore(eventLogTask,"eventLog",STACK_SIZE*4,NULL,1,&eventLogTaskHandle,1) != pdPASS){
+        debugln("[-]eventLog task failed to create");
+    }else{
+        SYSTEM_LOGGER.setWriter(eventLogTaskHandle);
+        TRACER.setWriter(eventLogTaskHandle);
+    }
+
+    #if TRACING
+        TRACER.begin(SPIFFS, trace_file);
+        TRACE(BOOT, TRACE_EVENT_COUNT);
+    #endif
+
     // SYSTEM LOG FILE
     SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::WRITE, "FC1", LOG_LEVEL::INFO, system_log_file, "Flight computer Event log\r\n");
 
@@ -1166,8 +1825,7 @@ void setup() {
 
     // create and wait for dynamic WIFI connection
     initDynamicWIFI(); // TODO - uncomment on live testing and production
-    MQTTInit(MQTT_SERVER, MQTT_PORT);
-    MQTT_Reconnect();  
+    MQTTInit(MQTT_SERVER, MQTT_PORT);   // the MQTT publisher task connects
     debugln("[+]Dynamic WIFI created OK.");
 
     debugln();
@@ -1179,9 +1837,23 @@ void setup() {
     uint8_t bmp_init_state = BMPInit();
     uint8_t imu_init_state = imu.init();
     uint8_t gps_init_state = GPSInit();
-    // uint8_t sd_init_state = initSD();
+    #if LOG_TO_SD
+        uint8_t sd_init_state = initSD();
+        debug("SD card init state:"); debugln(sd_init_state);
+    #endif
     uint8_t flash_init_state = data_logger.loggerInit();
     debug("Flash memory init state:"); debugln(flash_init_state);
+    TRACE(PERIPHERALS_INIT, bmp_init_state, imu_init_state, gps_init_state, flash_init_state);
+
+    #if XBEE
+        if(XBEE_LINK.begin(UART_NUM_1, XBEE_TX_PIN, XBEE_RX_PIN, XBEE_BAUD_RATE, XBEE_DESTINATION)) {
+            debugln("[+]XBee link init OK");
+            SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]XBee link init OK\r\n");
+        } else {
+            debugln("[-]XBee link init failed");
+            SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]XBee link init failed\r\n");
+        }
+    #endif
 
     /* initialize mqtt */
     //MQTTInit(MQTT_SERVER, MQTT_PORT);
@@ -1255,6 +1927,7 @@ void setup() {
     if(telemetry_data_queue_handle == NULL) {
         debugln("[-]telemetry_data_queue_handle creation failed");
         SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]telemetry_data_queue_handle creation failed\r\n");
+        TRACE(QUEUE_CREATE_FAILED, 0);
     } else {
         debugln("[+]telemetry_data_queue_handle creation OK.");
         SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]telemetry_data_queue_handle creation OK.\r\n");
@@ -1263,6 +1936,7 @@ void setup() {
     if(log_to_mem_queue_handle == NULL) {
         debugln("[-]telemetry_data_queue_handle creation failed");
         SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]telemetry_data_queue_handle creation failed\r\n");
+        TRACE(QUEUE_CREATE_FAILED, 1);
     } else {
         debugln("[+]telemetry_data_queue_handle creation OK.");
         SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]telemetry_data_queue_handle creation OK.\r\n");
@@ -1271,6 +1945,7 @@ void setup() {
     if(check_state_queue_handle == NULL) {
         debugln("[-]check_state_queue_handle creation failed");
         SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]check_state_queue_handle creation failed\r\n");
+        TRACE(QUEUE_CREATE_FAILED, 2);
     } else {
         debugln("[+]check_state_queue_handle creation OK.");
         SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]check_state_queue_handle creation OK.\r\n");
@@ -1279,6 +1954,7 @@ void setup() {
     if(debug_to_term_queue_handle == NULL) {
         debugln("[-]debug_to_term_queue_handle creation failed");
         SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]debug_to_term_queue_handle creation failed\r\n");
+        TRACE(QUEUE_CREATE_FAILED, 3);
     } else {
         debugln("[+]debug_to_term_queue_handle creation OK.");
         SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]debug_to_term_queue_handle creation OK.\r\n");
@@ -1287,6 +1963,7 @@ void setup() {
     if(kalman_filter_queue_handle == NULL) {
         debugln("[-]kalman_filter_queue_handle creation failed");
         SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[-]kalman_filter_queue_handle creation failed\r\n");
+        TRACE(QUEUE_CREATE_FAILED, 4);
     } else {
         debugln("[+]kalman_filter_queue_handle creation OK.");
         SYSTEM_LOGGER.logToFile(SPIFFS, LOG_MODE::APPEND, "FC1", LOG_LEVEL::INFO, system_log_file, "[+]kalman_filter_queue_handle creation OK.\r\n");
@@ -1331,10 +2008,7 @@ void setup() {
  * @brief Main loop
  *******************************************************************************/
 void loop() {
-    /* enable MQTT transmit loop */
-   if (!client.connected()) {
-       MQTT_Reconnect();
-   }
-    client.loop();
+    /* the MQTT publisher task runs the MQTT client - nothing is left for the Arduino loop task */
+    vTaskDelete(NULL);
 
 } /* End of main loop*/
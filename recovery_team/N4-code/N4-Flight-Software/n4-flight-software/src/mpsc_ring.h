@@ -0,0 +1,108 @@
+/**
+ * @file mpsc_ring.h
+ * @brief Bounded lock-free queue with many producers and one consumer
+ *
+ * Every slot carries a sequence number telling which ring position it is ready for:
+ * - a producer claims position p with a compare-and-swap once slot p % N holds sequence p,
+ *   fills the slot in place and publishes it by setting the sequence to p + 1
+ * - the consumer takes position p once the slot holds p + 1, and frees it for the next lap
+ *   by setting the sequence to p + N
+ *
+ * Producers never wait for each other or for the consumer - when the ring is full claim()
+ * fails and the caller drops its value. A producer preempted between claim() and publish()
+ * only holds back the consumer, never another producer.
+ *
+ * Any number of tasks may call claim() and publish(). Only ONE task may call peek() and
+ * release(). Not for use from interrupts.
+ */
+
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+#include <stdint.h>
+
+template <typename T, uint32_t N>
+class MpscRing {
+    static_assert((N & (N - 1)) == 0, "MpscRing length must be a power of 2");
+
+    private:
+        struct Slot {
+            volatile uint32_t sequence;     /*!< ring position the slot is ready for */
+            T value;
+        };
+
+        Slot _slots[N];
+        uint32_t _enqueue_position = 0;     /*!< next position to claim, shared by the producers */
+        uint32_t _dequeue_position = 0;     /*!< next position to take, owned by the consumer */
+
+    public:
+        MpscRing() {
+            for(uint32_t i = 0; i < N; i++) {
+                this->_slots[i].sequence = i;
+            }
+        }
+
+        /**
+         * @brief claim a slot to fill
+         * @param position set to the claimed position, to pass to publish()
+         * @return the slot, NULL if the ring is full
+         */
+        T* claim(uint32_t* position) {
+            uint32_t p = __atomic_load_n(&this->_enqueue_position, __ATOMIC_RELAXED);
+
+            while(1) {
+                Slot* slot = &this->_slots[p % N];
+                int32_t lag = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - p);
+
+                if(lag == 0) {
+                    if(__atomic_compare_exchange_n(&this->_enqueue_position, &p, p + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                        *position = p;
+                        return &slot->value;
+                    }
+                } else if(lag < 0) {
+                    // the consumer has not taken this slot yet
+                    return NULL;
+                } else {
+                    p = __atomic_load_n(&this->_enqueue_position, __ATOMIC_RELAXED);
+                }
+            }
+        }
+
+        /**
+         * @brief hand a filled slot to the consumer
+         */
+        void publish(uint32_t position) {
+            __atomic_store_n(&this->_slots[position % N].sequence, position + 1, __ATOMIC_RELEASE);
+        }
+
+        /**
+         * @brief the next published value. Consumer only
+         * @return NULL if the ring is empty or the next value is still being filled
+         */
+        T* peek() {
+            Slot* slot = &this->_slots[this->_dequeue_position % N];
+            if(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != this->_dequeue_position + 1) {
+                return NULL;
+            }
+
+            return &slot->value;
+        }
+
+        /**
+         * @brief values claimed and not yet released, including any still being filled.
+         * Consumer only
+         */
+        uint32_t size() {
+            return __atomic_load_n(&this->_enqueue_position, __ATOMIC_RELAXED) - this->_dequeue_position;
+        }
+
+        /**
+         * @brief free the value returned by peek(). Consumer only
+         */
+        void release() {
+            __atomic_store_n(&this->_slots[this->_dequeue_position % N].sequence, this->_dequeue_position + N, __ATOMIC_RELEASE);
+            this->_dequeue_position++;
+        }
+};
+
+#endif // MPSC_RING_H
@@ -1,5 +1,6 @@
 #include "mpu.h"
 #include <Arduino.h>
+#include "timing_probe.h"
 
 // constructor
 MPU6050::MPU6050(uint8_t address, uint32_t accel_fs_range, uint32_t gyro_fs_range) {
@@ -65,12 +66,14 @@ uint8_t  MPU6050::init() {
  * Read X axiS acceleration
 */
 float MPU6050::readXAcceleration() {
+    PROBE_START(PROBE_IMU_REGISTER_READ);
     Wire.beginTransmission(this->_address);
     Wire.write(ACCEL_XOUT_H);
     Wire.endTransmission(true);
 
     Wire.requestFrom(static_cast<int>(this->_address), 2, static_cast<int>(WIRE_SEND_STOP));
     this->acc_x = Wire.read()<<8 | Wire.read();
+    PROBE_STOP(PROBE_IMU_REGISTER_READ);
 
     // divide by the respective factors
     if(this->_accel_fs_range == 2) {
@@ -91,12 +94,14 @@ float MPU6050::readXAcceleration() {
  * Read Y acceleration
 */
 float MPU6050::readYAcceleration() {
+    PROBE_START(PROBE_IMU_REGISTER_READ);
     Wire.beginTransmission(this->_address);
     Wire.write(ACCEL_YOUT_H);
     Wire.endTransmission(true);
 
     Wire.requestFrom(static_cast<int>(this->_address), 2, WIRE_SEND_STOP);
     this->acc_y = Wire.read()<<8 | Wire.read();
+    PROBE_STOP(PROBE_IMU_REGISTER_READ);
 
     // divide by the respective factors
     if(this->_accel_fs_range == 2) {
@@ -117,12 +122,14 @@ float MPU6050::readYAcceleration() {
  * Read Z acceleration
 */
 float MPU6050::readZAcceleration() {
+    PROBE_START(PROBE_IMU_REGISTER_READ);
     Wire.beginTransmission(this->_address);
     Wire.write(ACCEL_ZOUT_H);
     Wire.endTransmission(true);
 
     Wire.requestFrom(static_cast<int>(this->_address), 2, WIRE_SEND_STOP);
     this->acc_z = Wire.read()<<8 | Wire.read();
+    PROBE_STOP(PROBE_IMU_REGISTER_READ);
 
     // divide by the respective factors
     if(this->_accel_fs_range == 2) {
@@ -176,12 +183,14 @@ float MPU6050::getPitch() {
 }
 
 float MPU6050::readXAngularVelocity() {
+    PROBE_START(PROBE_IMU_REGISTER_READ);
     Wire.beginTransmission(this->_address);
     Wire.write(GYRO_XOUT_H);
     Wire.endTransmission(true);
 
     Wire.requestFrom(static_cast<int>(this->_address), 2, static_cast<int>(WIRE_SEND_STOP));
     this->ang_vel_x = Wire.read() << 8 | Wire.read();
+    PROBE_STOP(PROBE_IMU_REGISTER_READ);
 
     // divide by the configured settings 
     if(this->_gyro_fs_range == 250) {
@@ -198,12 +207,14 @@ float MPU6050::readXAngularVelocity() {
 }
 
 float MPU6050::readYAngularVelocity() {
+    PROBE_START(PROBE_IMU_REGISTER_READ);
     Wire.beginTransmission(this->_address);
     Wire.write(GYRO_YOUT_H);
     Wire.endTransmission(true);
 
     Wire.requestFrom(static_cast<int>(this->_address), 2, static_cast<int>(WIRE_SEND_STOP));
     this->ang_vel_y = Wire.read() << 8 | Wire.read();
+    PROBE_STOP(PROBE_IMU_REGISTER_READ);
 
     // divide by the confiured settings 
     if(this->_gyro_fs_range == 250) {
@@ -220,12 +231,14 @@ float MPU6050::readYAngularVelocity() {
 }
 
 float MPU6050::readZAngularVelocity() {
+    PROBE_START(PROBE_IMU_REGISTER_READ);
     Wire.beginTransmission(this->_address);
     Wire.write(GYRO_ZOUT_H);
     Wire.endTransmission(true);
 
     Wire.requestFrom(static_cast<int>(this->_address), 2, static_cast<int>(WIRE_SEND_STOP));
     this->ang_vel_z= Wire.read() << 8 | Wire.read();
+    PROBE_STOP(PROBE_IMU_REGISTER_READ);
 
     // divide by the confiured settings 
     if(this->_gyro_fs_range == 250) {
@@ -243,6 +256,73 @@ float MPU6050::readZAngularVelocity() {
 
 
 
+/**
+ * Read acceleration and angular velocity in one I2C transaction and compute pitch and roll
+ * from the same sample
+ * The MPU6050 auto-increments the register address, so the 14 bytes from ACCEL_XOUT_H hold
+ * every axis. This takes one transaction instead of the nine the single axis reads need -
+ * about 1.6ms on the 100kHz bus instead of about 5ms
+*/
+void MPU6050::readAll() {
+    uint8_t raw[BURST_READ_SIZE];
+
+    PROBE_START(PROBE_IMU_REGISTER_READ);
+    Wire.beginTransmission(this->_address);
+    Wire.write(ACCEL_XOUT_H);
+    Wire.endTransmission(true);
+
+    Wire.requestFrom(static_cast<int>(this->_address), BURST_READ_SIZE, static_cast<int>(WIRE_SEND_STOP));
+    for(uint8_t i = 0; i < BURST_READ_SIZE; i++) {
+        raw[i] = Wire.read();
+    }
+    PROBE_STOP(PROBE_IMU_REGISTER_READ);
+
+    this->acc_x = raw[0] << 8 | raw[1];
+    this->acc_y = raw[2] << 8 | raw[3];
+    this->acc_z = raw[4] << 8 | raw[5];
+    this->temp = raw[6] << 8 | raw[7];
+    this->ang_vel_x = raw[8] << 8 | raw[9];
+    this->ang_vel_y = raw[10] << 8 | raw[11];
+    this->ang_vel_z = raw[12] << 8 | raw[13];
+
+    // divide by the respective factors
+    float accel_factor = ACCEL_FACTOR_2G;
+    if(this->_accel_fs_range == 4) {
+        accel_factor = ACCEL_FACTOR_4G;
+    } else if(this->_accel_fs_range == 8) {
+        accel_factor = ACCEL_FACTOR_8G;
+    } else if(this->_accel_fs_range == 16) {
+        accel_factor = ACCEL_FACTOR_16G;
+    }
+
+    float gyro_factor = GYRO_FACTOR_250;
+    if(this->_gyro_fs_range == 500) {
+        gyro_factor = GYRO_FACTOR_500;
+    } else if(this->_gyro_fs_range == 1000) {
+        gyro_factor = GYRO_FACTOR_1000;
+    } else if(this->_gyro_fs_range == 2000) {
+        gyro_factor = GYRO_FACTOR_2000;
+    }
+
+    this->acc_x_real = (float) this->acc_x / accel_factor;
+    this->acc_y_real = (float) this->acc_y / accel_factor;
+    this->acc_z_real = (float) this->acc_z / accel_factor;
+    this->ang_vel_x_real = (float) this->ang_vel_x / gyro_factor;
+    this->ang_vel_y_real = (float) this->ang_vel_y / gyro_factor;
+    this->ang_vel_z_real = (float) this->ang_vel_z / gyro_factor;
+
+    // pitch and roll as in getPitch() and getRoll(), without reading the accelerometer again
+    this->acc_x_ms = this->acc_x_real * ONE_G;
+    this->acc_y_ms = this->acc_y_real * ONE_G;
+    this->acc_z_ms = this->acc_z_real * ONE_G;
+
+    // clip to [-1, +1] bound before passing to arcsine
+    if(this->acc_x_real <= 1 && this->acc_x_real >= -1) {
+        this->pitch_angle = asin(this->acc_x_real);
+    }
+    this->roll_angle = atan2(this->acc_y_ms, this->acc_z_ms);
+}
+
 /**
  * perform sensor fusion
  * perfom complementary filter to remove accelerometer high frequrecny noise 
@@ -46,6 +46,7 @@
 #define GYRO_ZOUT_L             0x48
 #define TEMP_OUT_H              0x41
 #define TEMP_OUT_L              0x42
+#define BURST_READ_SIZE         14          // ACCEL_XOUT_H to GYRO_ZOUT_L - accel, temperature, gyro
 #define ONE_G                   9.80665
 #define TO_DEG_FACTOR           57.32
 
@@ -77,6 +78,7 @@ class MPU6050 {
         float readYAngularVelocity();
         float readZAngularVelocity();
         float readTemperature();
+        void readAll();
         void filterImu();
         float getRoll();
         float getPitch();
@@ -0,0 +1,285 @@
+/**
+ * @file mqtt_publisher.cpp
+ * @brief Implement the MQTT publisher task's client handling and the outbound rings
+ */
+
+#include "mqtt_publisher.h"
+#include "trace.h"
+#include "timing_probe.h"
+
+MqttPublisher MQTT_PUBLISHER;
+
+/**
+ * @brief hand the client to the publisher. Call before the MQTT publisher task starts -
+ * from then on only that task may use the client
+ * @param client configured client - server, callback and buffer size set
+ * @param client_id MQTT client ID
+ * @param command_topic subscribed on every connect
+ */
+void MqttPublisher::begin(PubSubClient* client, const char* client_id, const char* command_topic) {
+    this->_client = client;
+    this->_client_id = client_id;
+    this->_command_topic = command_topic;
+    this->_reported_ms = millis();
+}
+
+/**
+ * @brief the task that runs service(). It is woken up whenever a message is queued
+ */
+void MqttPublisher::setTask(TaskHandle_t task) {
+    this->_task = task;
+}
+
+/**
+ * @brief copy a message into a ring and wake the publisher task
+ * @return false if the message was too long or the ring was full, and it was dropped
+ */
+template <size_t N, uint32_t L>
+bool MqttPublisher::queue(MpscRing<mqtt_message_t<N>, L>* ring, const char* topic, const uint8_t* payload, size_t length, bool retained) {
+    uint32_t position;
+    mqtt_message_t<N>* message = length <= N ? ring->claim(&position) : NULL;
+    if(message == NULL) {
+        __atomic_fetch_add(&this->_stats.dropped_full, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    message->topic = topic;
+    message->queued_ms = millis();
+    message->length = length;
+    message->retained = retained;
+    memcpy(message->payload, payload, length);
+    ring->publish(position);
+
+    if(this->_task != NULL) {
+        xTaskNotifyGive(this->_task);
+    }
+    return true;
+}
+
+/**
+ * @brief queue an event - a state change, arming or deployment. Events are sent before
+ * anything else and never dropped for age. Returns right away
+ * @param topic must stay valid until the message is published
+ * @param text truncated to MQTT_EVENT_SIZE bytes
+ * @param retained publish retained, so that late subscribers get the last event
+ * @return false if the ring was full and the event was dropped
+ */
+bool MqttPublisher::publishEvent(const char* topic, const char* text, bool retained) {
+    size_t length = strlen(text);
+    if(length > MQTT_EVENT_SIZE) {
+        length = MQTT_EVENT_SIZE;
+    }
+
+    return this->queue(&this->_events, topic, (const uint8_t*)text, length, retained);
+}
+
+/**
+ * @brief queue a summary message - decimated flight state or a diagnostics line. Sent after
+ * the events and before any telemetry. Returns right away
+ * @param topic must stay valid until the message is published
+ * @param payload message bytes
+ * @param length at most MQTT_SUMMARY_SIZE bytes
+ * @return false if the message was too long or the ring was full, and it was dropped
+ */
+bool MqttPublisher::publishSummary(const char* topic, const uint8_t* payload, size_t length) {
+    return this->queue(&this->_summary, topic, payload, length, false);
+}
+
+/**
+ * @brief queue a telemetry message. Returns right away
+ * @param topic must stay valid until the message is published
+ * @param payload message bytes
+ * @param length at most MQTT_TELEMETRY_SIZE bytes
+ * @return false if the message was too long or the ring was full, and it was dropped
+ */
+bool MqttPublisher::publishTelemetry(const char* topic, const uint8_t* payload, size_t length) {
+    return this->queue(&this->_telemetry, topic, payload, length, false);
+}
+
+/**
+ * @brief try to connect if the backoff period is over. Every failure doubles the period
+ */
+void MqttPublisher::connect(uint32_t now) {
+    if((int32_t)(now - this->_next_attempt_ms) < 0) {
+        return;
+    }
+
+    uint32_t start = micros();
+    bool connected = this->_client->connect(this->_client_id);
+    uint32_t connect_time = micros() - start;
+    if(connect_time > this->_stats.connect_max_us) {
+        this->_stats.connect_max_us = connect_time;
+    }
+
+    if(connected) {
+        this->_client->subscribe(this->_command_topic);
+        this->_stats.connects++;
+        this->_backoff_ms = MQTT_BACKOFF_MIN;
+        this->_connected = true;
+        debugln("[+]MQTT connected");
+        return;
+    }
+
+    this->_stats.connect_failures++;
+    TRACE(MQTT_CONNECT_FAILED, this->_client->state());
+    this->_next_attempt_ms = millis() + this->_backoff_ms;
+    this->_backoff_ms = this->_backoff_ms * 2 > MQTT_BACKOFF_MAX ? MQTT_BACKOFF_MAX : this->_backoff_ms * 2;
+}
+
+/**
+ * @brief publish one message
+ * @return false if the connection is gone and the message should be kept for later. A
+ * message the client refuses while still connected can never be sent, and is dropped
+ */
+bool MqttPublisher::send(const char* topic, const uint8_t* payload, uint16_t length, bool retained) {
+    uint32_t start = micros();
+    PROBE_START(PROBE_MQTT_PUBLISH);
+    bool published = this->_client->publish(topic, payload, length, retained);
+    PROBE_STOP(PROBE_MQTT_PUBLISH);
+    uint32_t publish_time = micros() - start;
+    if(publish_time > this->_stats.publish_max_us) {
+        this->_stats.publish_max_us = publish_time;
+    }
+
+    if(published) {
+        this->_stats.published++;
+        this->_stats.bytes += length;
+        return true;
+    } else if(this->_client->connected()) {
+        this->_stats.publish_failed++;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief publish every queued event
+ * @return false if the connection is gone
+ */
+bool MqttPublisher::sendEvents() {
+    mqtt_message_t<MQTT_EVENT_SIZE>* event;
+    while((event = this->_events.peek()) != NULL) {
+        if(!this->send(event->topic, event->payload, event->length, event->retained)) {
+            return false;
+        }
+
+        uint32_t latency = millis() - event->queued_ms;
+        this->_stats.events++;
+        if(latency > this->_stats.event_latency_max_ms) {
+            this->_stats.event_latency_max_ms = latency;
+        }
+        this->_events.release();
+    }
+    return true;
+}
+
+/**
+ * @brief drop stale telemetry, and the oldest telemetry while the ring is nearly full, so
+ * that producers always find room for the newest
+ */
+void MqttPublisher::dropOldTelemetry(uint32_t now) {
+    uint32_t backlog = this->_telemetry.size();
+    if(backlog > this->_stats.backlog_max) {
+        this->_stats.backlog_max = backlog;
+    }
+
+    mqtt_message_t<MQTT_TELEMETRY_SIZE>* message;
+    while((message = this->_telemetry.peek()) != NULL) {
+        if(now - message->queued_ms > MQTT_TELEMETRY_MAX_AGE) {
+            this->_stats.dropped_stale++;
+        } else if(this->_telemetry.size() >= MQTT_TELEMETRY_QUEUE_LENGTH - 1) {
+            this->_stats.dropped_oldest++;
+        } else {
+            break;
+        }
+        this->_telemetry.release();
+    }
+}
+
+/**
+ * @brief keep the link up and publish the queued messages - events first, then the summary
+ * messages, then up to MQTT_PUBLISH_BURST telemetry messages. MQTT publisher task only
+ */
+void MqttPublisher::service() {
+    uint32_t now = millis();
+
+    bool up = this->_client->connected();
+    if(!up && this->_connected) {
+        this->_stats.disconnects++;
+        this->_next_attempt_ms = now;
+        debugln("[-]MQTT connection lost");
+    }
+    this->_connected = up;
+
+    if(!up) {
+        this->connect(now);
+    }
+
+    // the link may be down for a while - keep the newest telemetry
+    this->dropOldTelemetry(now);
+
+    if(!this->_connected) {
+        return;
+    }
+
+    // ground commands arrive through the callback
+    this->_client->loop();
+
+    if(!this->sendEvents()) {
+        return;
+    }
+
+    mqtt_message_t<MQTT_SUMMARY_SIZE>* summary;
+    while((summary = this->_summary.peek()) != NULL) {
+        if(!this->send(summary->topic, summary->payload, summary->length, summary->retained)) {
+            return;
+        }
+        this->_summary.release();
+    }
+
+    mqtt_message_t<MQTT_TELEMETRY_SIZE>* message;
+    for(uint8_t i = 0; i < MQTT_PUBLISH_BURST && (message = this->_telemetry.peek()) != NULL; i++) {
+        // an event queued during the burst goes out before the next telemetry message
+        if(!this->sendEvents() || !this->send(message->topic, message->payload, message->length, message->retained)) {
+            return;
+        }
+        this->_telemetry.release();
+    }
+}
+
+/**
+ * @brief last known connection state - any task
+ */
+bool MqttPublisher::connected() {
+    return this->_connected;
+}
+
+/**
+ * @brief one line link report, with the byte rate since the last report
+ */
+size_t MqttPublisher::formatStats(char* buffer, size_t len) {
+    uint32_t now = millis();
+    uint32_t elapsed_ms = now - this->_reported_ms;
+    uint32_t bytes = this->_stats.bytes;
+    uint32_t bytes_per_s = elapsed_ms ? (uint32_t)((uint64_t)(bytes - this->_reported_bytes) * 1000 / elapsed_ms) : 0;
+    this->_reported_ms = now;
+    this->_reported_bytes = bytes;
+
+    // ev=events/slowest, drop=full/oldest/stale, conn=connects/attempts
+    return snprintf(buffer, len, "MQTT up=%u B/s=%lu pub=%lu ev=%lu/%lums fail=%lu drop=%lu/%lu/%lu backlog=%lu conn=%lu/%lu lost=%lu pub_max=%luus conn_max=%luus",
+                    this->_connected ? 1 : 0,
+                    (unsigned long)bytes_per_s,
+                    (unsigned long)this->_stats.published,
+                    (unsigned long)this->_stats.events,
+                    (unsigned long)this->_stats.event_latency_max_ms,
+                    (unsigned long)this->_stats.publish_failed,
+                    (unsigned long)this->_stats.dropped_full,
+                    (unsigned long)this->_stats.dropped_oldest,
+                    (unsigned long)this->_stats.dropped_stale,
+                    (unsigned long)this->_stats.backlog_max,
+                    (unsigned long)this->_stats.connects,
+                    (unsigned long)(this->_stats.connects + this->_stats.connect_failures),
+                    (unsigned long)this->_stats.disconnects,
+                    (unsigned long)this->_stats.publish_max_us,
+                    (unsigned long)this->_stats.connect_max_us);
+}
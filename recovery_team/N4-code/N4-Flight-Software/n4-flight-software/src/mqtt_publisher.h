@@ -0,0 +1,112 @@
+/**
+ * @file mqtt_publisher.h
+ * @brief Non-blocking MQTT publishing from a task that owns the client
+ *
+ * publishEvent(), publishSummary() and publishTelemetry() only copy the message into a RAM
+ * ring and return - they never touch the network. The MQTT publisher task calls service() to
+ * keep the client connected, run client.loop() for the ground commands, and publish the
+ * queued messages. No other task may use the client.
+ *
+ * There is one ring per channel, sent in priority order:
+ * - events - state changes, arming and deployments. Short text, always sent first and
+ *   checked again before every telemetry message, so an event waits for at most one
+ *   message already on the wire. Events are kept across a lost connection and usually
+ *   published retained, so a ground station that connects late still gets the last one
+ * - summary - decimated flight state and the diagnostics reports. Small and low rate, sent
+ *   once the events are out
+ * - telemetry - the raw sample batches, which get whatever bandwidth is left: at most
+ *   MQTT_PUBLISH_BURST per run. They are only worth sending while they are recent, so when
+ *   the link is slow or down the publisher drops the OLDEST telemetry to keep room for the
+ *   newest, and drops telemetry older than MQTT_TELEMETRY_MAX_AGE outright
+ *
+ * A producer that finds a ring full drops its own message. Every drop is counted.
+ *
+ * A lost connection is retried from service() with exponential backoff, from
+ * MQTT_BACKOFF_MIN up to MQTT_BACKOFF_MAX ms between attempts, so a dead link costs one
+ * connect attempt per backoff period instead of stalling every loop.
+ *
+ * PubSubClient only publishes at QoS 0, so "reliable" here means never dropped on our side
+ * and retained on the broker - the TCP link does the rest.
+ *
+ * All rings are bounded lock-free queues, see mpsc_ring.h: any task may publish.
+ */
+
+#ifndef MQTT_PUBLISHER_H
+#define MQTT_PUBLISHER_H
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include "defs.h"
+#include "mpsc_ring.h"
+
+/**
+ * One queued message
+ */
+template <size_t N>
+struct mqtt_message_t {
+    const char* topic;                  /*!< must outlive the message */
+    uint32_t queued_ms;                 /*!< millis() when the message was queued */
+    uint16_t length;                    /*!< bytes used in payload */
+    bool retained;                      /*!< the broker keeps the last retained message of a topic for new subscribers */
+    uint8_t payload[N];
+};
+
+/**
+ * A structure to hold the link statistics
+ */
+typedef struct {
+    uint32_t published;                 /*!< messages published */
+    uint32_t bytes;                     /*!< payload bytes published */
+    uint32_t events;                    /*!< event messages published */
+    uint32_t event_latency_max_ms;      /*!< longest time from queueing an event to publishing it */
+    uint32_t publish_failed;            /*!< messages the client refused while connected - dropped */
+    uint32_t dropped_full;              /*!< messages dropped by a producer because the ring was full */
+    uint32_t dropped_oldest;            /*!< telemetry dropped to make room for newer telemetry */
+    uint32_t dropped_stale;             /*!< telemetry dropped for being older than MQTT_TELEMETRY_MAX_AGE */
+    uint32_t connects;                  /*!< successful connects */
+    uint32_t connect_failures;
+    uint32_t disconnects;               /*!< connections lost */
+    uint32_t backlog_max;               /*!< most telemetry messages waiting at once */
+    uint32_t publish_max_us;            /*!< slowest client.publish() */
+    uint32_t connect_max_us;            /*!< slowest connect attempt */
+} mqtt_link_stats_t;
+
+class MqttPublisher {
+    private:
+        MpscRing<mqtt_message_t<MQTT_EVENT_SIZE>, MQTT_EVENT_QUEUE_LENGTH> _events;
+        MpscRing<mqtt_message_t<MQTT_SUMMARY_SIZE>, MQTT_SUMMARY_QUEUE_LENGTH> _summary;
+        MpscRing<mqtt_message_t<MQTT_TELEMETRY_SIZE>, MQTT_TELEMETRY_QUEUE_LENGTH> _telemetry;
+        TaskHandle_t _task = NULL;          /*!< notified when a message is queued */
+
+        /* owned by the MQTT publisher task */
+        PubSubClient* _client = NULL;
+        const char* _client_id = NULL;
+        const char* _command_topic = NULL;
+        volatile bool _connected = false;
+        uint32_t _backoff_ms = MQTT_BACKOFF_MIN;
+        uint32_t _next_attempt_ms = 0;
+        uint32_t _reported_ms = 0;
+        uint32_t _reported_bytes = 0;
+        mqtt_link_stats_t _stats = {};
+
+        template <size_t N, uint32_t L>
+        bool queue(MpscRing<mqtt_message_t<N>, L>* ring, const char* topic, const uint8_t* payload, size_t length, bool retained);
+        void connect(uint32_t now);
+        bool send(const char* topic, const uint8_t* payload, uint16_t length, bool retained);
+        bool sendEvents();
+        void dropOldTelemetry(uint32_t now);
+
+    public:
+        void begin(PubSubClient* client, const char* client_id, const char* command_topic);
+        void setTask(TaskHandle_t task);
+        bool publishEvent(const char* topic, const char* text, bool retained);
+        bool publishSummary(const char* topic, const uint8_t* payload, size_t length);
+        bool publishTelemetry(const char* topic, const uint8_t* payload, size_t length);
+        void service();
+        bool connected();
+        size_t formatStats(char* buffer, size_t len);
+};
+
+extern MqttPublisher MQTT_PUBLISHER;
+
+#endif // MQTT_PUBLISHER_H
@@ -0,0 +1,238 @@
+/**
+ * @file sd_logger.cpp
+ * @brief Implement the SD card copy of the flight log
+ */
+
+#include "sd_logger.h"
+
+#if (SD_BUFFER_PAGES & (SD_BUFFER_PAGES - 1)) != 0
+    #error "SD_BUFFER_PAGES must be a power of 2"
+#endif
+
+#if SD_WRITE_PAGES > SD_BUFFER_PAGES
+    #error "SD_WRITE_PAGES cannot be larger than SD_BUFFER_PAGES"
+#endif
+
+SDLogger::SDLogger() {
+    memset(&this->_stats, 0, sizeof(this->_stats));
+    this->_filename[0] = '\0';
+}
+
+/**
+ * @brief create this boot's log file and write the log header page
+ * The file is named after the first unused index so earlier flights are kept
+ */
+bool SDLogger::openLog(fs::FS& fs) {
+    uint16_t index = 0;
+    do {
+        snprintf(this->_filename, sizeof(this->_filename), "/flight_%03u.bin", index);
+    } while(fs.exists(this->_filename) && ++index < 1000);
+
+    if(index >= 1000) {
+        debugln(F("[-]No free SD log file name"));
+        return false;
+    }
+
+    this->_file = fs.open(this->_filename, FILE_WRITE);
+    if(!this->_file) {
+        debugln(F("[-]Could not create the SD log file"));
+        return false;
+    }
+
+    // allocate the whole cluster chain now - writing the last byte extends the file
+    if(!this->_file.seek(SD_LOG_FILE_SIZE - 1) || this->_file.write((uint8_t)0xFF) != 1) {
+        debugln(F("[-]Could not preallocate the SD log file"));
+        this->_file.close();
+        return false;
+    }
+    this->_file.flush();
+    this->_file.seek(0);
+
+    // a random generation so that clusters left over from deleted logs fail the page CRC
+    this->_generation = esp_random();
+
+    uint8_t header[FLIGHT_LOG_PAGE_SIZE];
+    memset(header, 0xFF, sizeof(header));
+    // one file per boot - no flight directory
+    flightLogEncodeHeader(header, this->_generation, 0);
+
+    if(this->_file.write(header, sizeof(header)) != sizeof(header)) {
+        debugln(F("[-]Could not write the SD log header"));
+        this->_file.close();
+        return false;
+    }
+    this->_file.flush();
+
+    this->_page_count = SD_LOG_FILE_SIZE / FLIGHT_LOG_PAGE_SIZE;
+    this->_next_page = 1;
+
+    return true;
+}
+
+/**
+ * @brief open the log file on a mounted SD card
+ * @param fs the mounted card, normally SD
+ * @return true if pages will be written to the card
+ */
+bool SDLogger::sdInit(fs::FS& fs) {
+    this->_ready = this->openLog(fs);
+
+    uint32_t now = millis();
+    this->_last_write_ms = now;
+    this->_last_flush_ms = now;
+    this->_last_report_ms = now;
+
+    if(this->_ready) {
+        debug(F("[+]SD log file: ")); debugln(this->_filename);
+    }
+
+    return this->_ready;
+}
+
+/**
+ * @brief queue a copy of one flash log page. Called by the flash writer task
+ * Never waits - if the SD task has fallen SD_BUFFER_PAGES pages behind, the page is dropped
+ * @param page the page, page header included
+ * @param length bytes used in the page
+ */
+void SDLogger::sdQueuePage(const uint8_t* page, uint16_t length) {
+    if(!this->_ready) {
+        return;
+    }
+
+    uint16_t head = this->_head;
+    uint16_t tail = __atomic_load_n(&this->_tail, __ATOMIC_ACQUIRE);
+
+    if((uint16_t)(head - tail) >= SD_BUFFER_PAGES) {
+        this->_stats.pages_dropped++;
+        return;
+    }
+
+    uint8_t* slot = this->_ring[head % SD_BUFFER_PAGES];
+    memcpy(slot, page, length);
+    memset(slot + length, 0xFF, FLIGHT_LOG_PAGE_SIZE - length);
+
+    __atomic_store_n(&this->_head, (uint16_t)(head + 1), __ATOMIC_RELEASE);
+    this->_stats.pages_queued++;
+}
+
+/**
+ * @brief write count pages from the tail of the ring in one block write
+ * The page CRCs are recomputed with the generation of the SD file
+ */
+void SDLogger::writeRun(uint16_t count) {
+    uint8_t* run = this->_ring[this->_tail % SD_BUFFER_PAGES];
+
+    if(this->_next_page + count > this->_page_count) {
+        this->_stats.pages_full += count;
+        __atomic_store_n(&this->_tail, (uint16_t)(this->_tail + count), __ATOMIC_RELEASE);
+        return;
+    }
+
+    for(uint16_t i = 0; i < count; i++) {
+        uint8_t* page = run + i * FLIGHT_LOG_PAGE_SIZE;
+        uint16_t session = page[2] | (page[3] << 8);
+        flightLogEncodePageHeader(page, page[1], session, this->_generation);
+    }
+
+    size_t length = (size_t)count * FLIGHT_LOG_PAGE_SIZE;
+    uint32_t start = micros();
+    size_t written = this->_file.write(run, length);
+    uint32_t write_time = micros() - start;
+
+    if(written != length) {
+        // put the file position back on the page boundary for the next run
+        this->_stats.errors++;
+        this->_file.seek((this->_next_page + count) * FLIGHT_LOG_PAGE_SIZE);
+    }
+
+    this->_stats.writes++;
+    this->_stats.bytes_written += written;
+    this->_stats.write_total_us += write_time;
+    if(write_time > this->_stats.write_max_us) {
+        this->_stats.write_max_us = write_time;
+    }
+    if(write_time > SD_WRITE_SLOW_US) {
+        this->_stats.slow_writes++;
+    }
+
+    this->_next_page += count;
+    this->_last_write_ms = millis();
+
+    __atomic_store_n(&this->_tail, (uint16_t)(this->_tail + count), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief write out the queued pages. Called by the SD writer task
+ * Pages are written once SD_WRITE_PAGES are waiting, or after SD_FLUSH_TIMEOUT so that a
+ * slowly filling log still reaches the card. The file is flushed at most every
+ * SD_FLUSH_TIMEOUT
+ */
+void SDLogger::sdService() {
+    if(!this->_ready) {
+        return;
+    }
+
+    uint32_t now = millis();
+    uint16_t pending = __atomic_load_n(&this->_head, __ATOMIC_ACQUIRE) - this->_tail;
+    bool timed_out = now - this->_last_write_ms >= SD_FLUSH_TIMEOUT;
+
+    if(pending == 0 || (pending < SD_WRITE_PAGES && !timed_out)) {
+        return;
+    }
+
+    while(pending) {
+        // a run cannot wrap around the end of the ring
+        uint16_t run = SD_BUFFER_PAGES - this->_tail % SD_BUFFER_PAGES;
+        if(run > pending) {
+            run = pending;
+        }
+        if(run > SD_WRITE_PAGES) {
+            run = SD_WRITE_PAGES;
+        }
+
+        this->writeRun(run);
+        pending -= run;
+    }
+
+    if(now - this->_last_flush_ms >= SD_FLUSH_TIMEOUT) {
+        uint32_t start = micros();
+        this->_file.flush();
+        uint32_t flush_time = micros() - start;
+
+        if(flush_time > this->_stats.flush_max_us) {
+            this->_stats.flush_max_us = flush_time;
+        }
+        this->_last_flush_ms = millis();
+    }
+}
+
+/**
+ * @brief one line SD writer report: throughput since the previous report and write latency
+ */
+size_t SDLogger::sdFormatStats(char* buffer, size_t len) {
+    uint32_t now = millis();
+    uint32_t elapsed = now - this->_last_report_ms;
+    uint32_t bytes = this->_stats.bytes_written;
+    uint32_t rate = elapsed ? (uint64_t)(bytes - this->_last_report_bytes) * 1000 / elapsed : 0;
+    uint32_t write_avg = this->_stats.writes ? this->_stats.write_total_us / this->_stats.writes : 0;
+
+    this->_last_report_ms = now;
+    this->_last_report_bytes = bytes;
+
+    return snprintf(buffer, len, "SD file=%s rate=%luB/s written=%lu pages=%lu/%lu queued=%lu writes=%lu write_avg=%luus write_max=%luus slow=%lu flush_max=%luus dropped=%lu full=%lu errors=%lu",
+                    this->_ready ? this->_filename : "none",
+                    (unsigned long)rate,
+                    (unsigned long)bytes,
+                    (unsigned long)this->_next_page,
+                    (unsigned long)this->_page_count,
+                    (unsigned long)(uint16_t)(this->_head - this->_tail),
+                    (unsigned long)this->_stats.writes,
+                    (unsigned long)write_avg,
+                    (unsigned long)this->_stats.write_max_us,
+                    (unsigned long)this->_stats.slow_writes,
+                    (unsigned long)this->_stats.flush_max_us,
+                    (unsigned long)this->_stats.pages_dropped,
+                    (unsigned long)this->_stats.pages_full,
+                    (unsigned long)this->_stats.errors);
+}
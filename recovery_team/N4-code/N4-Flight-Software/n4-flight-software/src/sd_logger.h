@@ -0,0 +1,74 @@
+/**
+ * @file sd_logger.h
+ * @brief Redundant copy of the flight log on the SD card
+ *
+ * Every page the flash writer programs is also queued here and written to a file on the SD
+ * card by a dedicated task, so the SD card never slows the flash path or the sensor tasks.
+ * The file uses the same paged format as the flash log, see flight_log.h, and is read back
+ * with the same recovery tool.
+ *
+ * The file is opened once per boot and preallocated to SD_LOG_FILE_SIZE so that the cluster
+ * chain is allocated before the flight and no FAT update happens while logging. Pages are
+ * written in runs of up to SD_WRITE_PAGES pages, a multi-sector write per run.
+ *
+ * A new file is created on every boot, with a random log generation in its header. The
+ * preallocated clusters may hold old data, which fails the page CRC and reads as the end
+ * of the log.
+ */
+
+#ifndef SD_LOGGER_H
+#define SD_LOGGER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "defs.h"
+#include "flight_log.h"
+
+/**
+ * A structure to hold the SD writer statistics
+ */
+typedef struct {
+    uint32_t pages_queued;          /*!< pages accepted into the ring */
+    uint32_t pages_dropped;         /*!< pages dropped because the SD task fell SD_BUFFER_PAGES behind */
+    uint32_t pages_full;            /*!< pages dropped because the file is full */
+    uint32_t bytes_written;         /*!< bytes written to the file */
+    uint32_t writes;                /*!< block writes to the file */
+    uint32_t slow_writes;           /*!< block writes that took longer than SD_WRITE_SLOW_US */
+    uint32_t write_total_us;        /*!< time spent in block writes */
+    uint32_t write_max_us;          /*!< worst block write time */
+    uint32_t flush_max_us;          /*!< worst file flush time */
+    uint32_t errors;                /*!< short writes */
+} sd_logger_stats_t;
+
+class SDLogger {
+    private:
+        fs::File _file;
+        char _filename[20];                             /*!< file opened at boot */
+        bool _ready = false;                            /*!< false if no file could be opened */
+        uint32_t _generation = 0;                       /*!< log generation written to every page header */
+        uint32_t _page_count = 0;                       /*!< log pages in the preallocated file */
+        uint32_t _next_page = 0;                        /*!< log page written next */
+
+        /* single producer single consumer ring - filled by the flash writer, drained by the SD task */
+        uint8_t _ring[SD_BUFFER_PAGES][FLIGHT_LOG_PAGE_SIZE];
+        uint16_t _head = 0;                             /*!< pages pushed, written by the producer only */
+        uint16_t _tail = 0;                             /*!< pages written out, written by the SD task only */
+
+        uint32_t _last_write_ms = 0;                    /*!< time of the last block write */
+        uint32_t _last_flush_ms = 0;                    /*!< time of the last file flush */
+        sd_logger_stats_t _stats;
+        uint32_t _last_report_ms = 0;                   /*!< time of the previous stats report */
+        uint32_t _last_report_bytes = 0;                /*!< bytes_written at the previous stats report */
+
+        bool openLog(fs::FS& fs);
+        void writeRun(uint16_t count);
+
+    public:
+        SDLogger();
+        bool sdInit(fs::FS& fs);
+        void sdQueuePage(const uint8_t* page, uint16_t length);
+        void sdService();
+        size_t sdFormatStats(char* buffer, size_t len);
+};
+
+#endif // SD_LOGGER_H
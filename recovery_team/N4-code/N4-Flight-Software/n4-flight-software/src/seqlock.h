@@ -0,0 +1,77 @@
+/**
+ * @file seqlock.h
+ * @brief Lock-free "latest value" snapshot shared between tasks
+ *
+ * A sequence counter guards two copies of the value. The single writer updates the copy
+ * readers are not using, bumping the counter before and after, and readers copy out the
+ * stable copy and retry if the counter moved while they were reading.
+ *
+ * - the writer never blocks and never waits for readers
+ * - a reader only retries when a write completed during its read, so a writer that is
+ *   preempted half way through an update can never stall a higher priority reader
+ * - readers always get a coherent value, never a mix of two updates
+ *
+ * Only ONE task may call store() for a given snapshot. Any number of tasks may call load().
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+
+template <typename T>
+class SeqLock {
+    private:
+        volatile uint32_t _sequence = 0;    /*!< odd while copy 0 is being written, readers use copy (sequence & 1) */
+        T _copies[2];
+
+    public:
+        SeqLock() : _copies() {}
+
+        explicit SeqLock(const T& initial) {
+            this->_copies[0] = initial;
+            this->_copies[1] = initial;
+        }
+
+        /**
+         * @brief publish a new value. Must only be called from the owning task
+         */
+        void store(const T& value) {
+            uint32_t sequence = __atomic_load_n(&this->_sequence, __ATOMIC_RELAXED);
+
+            // move readers to copy 1 while copy 0 is updated
+            __atomic_store_n(&this->_sequence, sequence + 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            this->_copies[0] = value;
+
+            // move readers back to copy 0 while copy 1 is updated
+            __atomic_store_n(&this->_sequence, sequence + 2, __ATOMIC_RELEASE);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            this->_copies[1] = value;
+        }
+
+        /**
+         * @brief get a coherent copy of the latest value
+         */
+        T load() const {
+            T value;
+            uint32_t sequence;
+
+            do {
+                sequence = __atomic_load_n(&this->_sequence, __ATOMIC_ACQUIRE);
+                value = this->_copies[sequence & 1];
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            } while(sequence != __atomic_load_n(&this->_sequence, __ATOMIC_RELAXED));
+
+            return value;
+        }
+
+        /**
+         * @brief number of completed stores - lets readers tell whether the value changed
+         */
+        uint32_t version() const {
+            return __atomic_load_n(&this->_sequence, __ATOMIC_ACQUIRE) >> 1;
+        }
+};
+
+#endif // SEQLOCK_H
@@ -0,0 +1,30 @@
+/**
+ * @file states.cpp
+ * Helper functions for the flight states
+ *
+ */
+
+#include "states.h"
+
+/**
+ * @brief convert the flight state to string
+ */
+const char* flightStateString(uint8_t state) {
+    static const char* names[] = {
+        "PRE_FLIGHT_GROUND",
+        "POWERED_FLIGHT",
+        "COASTING",
+        "APOGEE",
+        "DROGUE_DEPLOY",
+        "DROGUE_DESCENT",
+        "MAIN_DEPLOY",
+        "MAIN_DESCENT",
+        "POST_FLIGHT_GROUND"
+    };
+
+    if(state > POST_FLIGHT_GROUND) {
+        return "UNKNOWN";
+    }
+
+    return names[state];
+}
@@ -6,6 +6,8 @@
 #ifndef STATES_H
 #define STATES_H
 
+#include <stdint.h>
+
 typedef enum {
 	PRE_FLIGHT_GROUND = 0,
 	POWERED_FLIGHT,
@@ -18,4 +20,6 @@ typedef enum {
 	POST_FLIGHT_GROUND
 } ARMED_FLIGHT_STATE;
 
+const char* flightStateString(uint8_t state);
+
 #endif
@@ -6,71 +6,170 @@
 
 #include "system_logger.h"
 
+#if EVENT_LOG_LINE_SIZE > 256
+    #error "EVENT_LOG_LINE_SIZE must fit the uint8_t line length"
+#endif
+
 /**
- * @brief write event logs to file 
- * @param 
+ * @brief queue an event log message. Returns right away - the event log task writes it
+ * @param fs file system of the log file
+ * @param mode LOG_MODE::WRITE clears the file before this message, LOG_MODE::APPEND appends
+ * @param client ID of the flight computer
+ * @param log_level LOG_LEVEL - CRITICAL and ERROR messages are flushed to the file right away
+ * @param file log file name. Must stay valid until the message is written
+ * @param msg the message
  */
 void SystemLogger::logToFile (fs::FS &fs, uint8_t mode, const char* client, uint8_t log_level, const char* file,  const char* msg) {
-    char log_buffer[256];
     // get the timestamp
     unsigned long raw_timestamp = millis();
 
+    uint32_t position;
+    event_log_entry_t* entry = this->_ring.claim(&position);
+    if(entry == NULL) {
+        // the event log task has fallen EVENT_LOG_QUEUE_LENGTH messages behind
+        __atomic_fetch_add(&this->_stats.dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
 
     // construct the log message
     // timestamp clientID log_level msg
-    sprintf(log_buffer,
-            "%d:%s:%s:%s\n",
+    int length = snprintf(entry->text, sizeof(entry->text),
+            "%lu:%s:%s:%s\n",
             raw_timestamp,
             client,
             this->getLogLevelString(log_level),
             msg
     );
 
-    // open the file in the specified mode
-    if(mode == 0) {
-        // clear the file contents
-        // this is used just before flight to make sure we do not have previous data
-        // on the log file
-        File f = fs.open(file, FILE_WRITE);
-        if(!f) {
-            Serial.println("Failed to open file ");
-            return;
-        }
+    entry->fs = &fs;
+    entry->file = file;
+    entry->mode = mode;
+    entry->level = log_level;
+    entry->length = length < 0 ? 0 : (length >= (int)sizeof(entry->text) ? sizeof(entry->text) - 1 : length);
 
-        // log to file
-        if(f.print(log_buffer)) {
-            Serial.println("Log OK");
-        } else {
-            Serial.println("- write failed");
-        }
+    // hand the slot to the event log task
+    this->_ring.publish(position);
+    __atomic_fetch_add(&this->_stats.queued, 1, __ATOMIC_RELAXED);
 
-        // close file
-        f.close();
+    if(log_level >= LOG_LEVEL::CRITICAL && this->_writer != NULL) {
+        xTaskNotifyGive(this->_writer);
+    }
+}
 
-    } else if(mode == 1) {
-        File f = fs.open(file, FILE_APPEND);
-        if(!f) {
-            Serial.println("Failed to open file ");
-            return;
+/**
+ * @brief the task that runs service(). It is woken up for messages that must be flushed now
+ */
+void SystemLogger::setWriter(TaskHandle_t writer) {
+    this->_writer = writer;
+}
+
+/**
+ * @brief write the next messages to the file at the next service() call and flush it
+ */
+void SystemLogger::flush() {
+    this->_flush_requested = true;
+
+    if(this->_writer != NULL) {
+        xTaskNotifyGive(this->_writer);
+    }
+}
+
+/**
+ * @brief open a log file, closing the one open before
+ */
+bool SystemLogger::openFile(fs::FS* fs, const char* file, uint8_t mode) {
+    if(this->_open_fs != NULL) {
+        this->_file.close();
+        this->_open_fs = NULL;
+    }
+
+    // clearing the file is used just before flight to make sure we do not have previous data
+    this->_file = fs->open(file, mode == LOG_MODE::WRITE ? FILE_WRITE : FILE_APPEND);
+    if(!this->_file) {
+        this->_stats.open_failures++;
+        Serial.println("Failed to open file ");
+        return false;
+    }
+
+    this->_open_fs = fs;
+    this->_open_name = file;
+    return true;
+}
+
+/**
+ * @brief write every queued message to its file. Called by the event log task only
+ * Messages go to the open file without reopening it, unless they name another file or
+ * clear the file
+ */
+void SystemLogger::service() {
+    bool flush_now = this->_flush_requested;
+    this->_flush_requested = false;
+
+    uint32_t start = micros();
+    bool busy = false;
+
+    // stops when the ring is empty or the next message is still being formatted
+    event_log_entry_t* entry;
+    while((entry = this->_ring.peek()) != NULL) {
+        busy = true;
+
+        bool same_file = this->_open_fs == entry->fs && (this->_open_name == entry->file || strcmp(this->_open_name, entry->file) == 0);
+        if(entry->mode == LOG_MODE::WRITE || !same_file) {
+            if(this->_dirty) {
+                this->_file.flush();
+                this->_dirty = false;
+            }
+            this->openFile(entry->fs, entry->file, entry->mode);
         }
 
-        // log to file
-        if(f.print(log_buffer)) {
-            Serial.println("Log OK");
-        } else {
-            Serial.println("- write failed");
+        if(this->_open_fs != NULL) {
+            this->_file.write((const uint8_t*)entry->text, entry->length);
+            this->_dirty = true;
+            this->_stats.written++;
         }
 
-        // close file
-        f.close();
+        if(entry->level >= LOG_LEVEL::CRITICAL) {
+            flush_now = true;
+        }
+
+        this->_ring.release();
+    }
+
+    uint32_t now = millis();
+    if(this->_dirty && (flush_now || now - this->_last_flush_ms >= EVENT_LOG_FLUSH_INTERVAL)) {
+        this->_file.flush();
+        this->_dirty = false;
+        this->_last_flush_ms = now;
+        this->_stats.flushes++;
+        busy = true;
+    }
 
+    if(busy) {
+        uint32_t write_time = micros() - start;
+        if(write_time > this->_stats.write_max_us) {
+            this->_stats.write_max_us = write_time;
+        }
     }
 }
 
+/**
+ * @brief one line event log report
+ */
+size_t SystemLogger::formatStats(char* buffer, size_t len) {
+    return snprintf(buffer, len, "EVENTS queued=%lu written=%lu dropped=%lu flushes=%lu open_failures=%lu write_max=%luus",
+                    (unsigned long)this->_stats.queued,
+                    (unsigned long)this->_stats.written,
+                    (unsigned long)this->_stats.dropped,
+                    (unsigned long)this->_stats.flushes,
+                    (unsigned long)this->_stats.open_failures,
+                    (unsigned long)this->_stats.write_max_us);
+}
+
 /**
  * @brief read log file to console
  */
  void SystemLogger::readLogFile(fs::FS &fs, const char* file) {
+        // messages still in the ring are not in the file yet
         Serial.printf("Reading file: %s\r\n", file);
         File f = fs.open(file);
 
@@ -1,7 +1,16 @@
 /**
  * @file system_logger.h
- * 
- * Declarations for flight events logging 
+ *
+ * Declarations for flight events logging
+ *
+ * logToFile() only formats the message into a RAM ring and returns - it never touches the
+ * file system. The event log task calls service() to append the queued messages to the file,
+ * which stays open between batches. The file is flushed every EVENT_LOG_FLUSH_INTERVAL, right
+ * away on a CRITICAL or ERROR message, and when flush() is called, e.g. at landing.
+ *
+ * The ring is a bounded lock-free queue, see mpsc_ring.h: any task may log, and a task
+ * preempted while logging never blocks the others. When the ring is full the message is
+ * dropped and counted.
  */
 
 #ifndef SYSTEMLOGGER_H
@@ -10,14 +19,59 @@
 #include <Arduino.h>
 #include <FS.h>
 #include <SPIFFS.h>
+#include "defs.h"
 #include "system_log_levels.h"
+#include "mpsc_ring.h"
+
+/**
+ * One queued message, formatted and ready to be written
+ */
+typedef struct {
+    fs::FS* fs;                         /*!< file system of the log file */
+    const char* file;                   /*!< log file name - must outlive the message */
+    uint8_t mode;                       /*!< LOG_MODE */
+    uint8_t level;                      /*!< LOG_LEVEL */
+    uint8_t length;                     /*!< bytes used in text */
+    char text[EVENT_LOG_LINE_SIZE];     /*!< the formatted log line */
+} event_log_entry_t;
+
+/**
+ * A structure to hold the event log statistics
+ */
+typedef struct {
+    uint32_t queued;                    /*!< messages accepted into the ring */
+    uint32_t dropped;                   /*!< messages dropped because the ring was full */
+    uint32_t written;                   /*!< messages written to the file */
+    uint32_t flushes;                   /*!< file flushes */
+    uint32_t open_failures;             /*!< times the log file could not be opened */
+    uint32_t write_max_us;              /*!< worst batch write and flush time */
+} event_log_stats_t;
 
 class SystemLogger {
+	private:
+        MpscRing<event_log_entry_t, EVENT_LOG_QUEUE_LENGTH> _ring;
+        TaskHandle_t _writer = NULL;        /*!< notified when a message must reach the file right away */
+        volatile bool _flush_requested = false;
+
+        /* owned by the event log task */
+        File _file;
+        fs::FS* _open_fs = NULL;            /*!< file system of the open file, NULL if none is open */
+        const char* _open_name = NULL;      /*!< name of the open file */
+        bool _dirty = false;                /*!< written since the last flush */
+        uint32_t _last_flush_ms = 0;
+        event_log_stats_t _stats = {};
+
+        bool openFile(fs::FS* fs, const char* file, uint8_t mode);
+
 	public:
         const char* getLogLevelString(uint8_t log_level);
 		void logToConsole (const uint32_t timestamp, const char* client, uint8_t log_level, const char* msg);
 		void logToFile (fs::FS &fs, uint8_t mode, const char* client, uint8_t log_level, const char* file,  const char* msg);
 		void readLogFile(fs::FS &fs, const char* file);
+        void setWriter(TaskHandle_t writer);
+        void service();
+        void flush();
+        size_t formatStats(char* buffer, size_t len);
 };
-	
+
 #endif
@@ -0,0 +1,168 @@
+/**
+ * @file task_profiler.cpp
+ * @brief Implement the per-task profiler functions
+ */
+
+#include "task_profiler.h"
+
+#define PROFILER_MAX_SYSTEM_TASKS 32        /*!< size of the snapshot table for uxTaskGetSystemState - includes the system tasks */
+
+TaskProfiler task_profiler;
+
+/**
+ * @brief class constructor - clears all task slots
+ */
+TaskProfiler::TaskProfiler() {
+    memset(this->_tasks, 0, sizeof(this->_tasks));
+}
+
+/**
+ * @brief add a task to the profiler
+ *
+ * @param id task slot, see PROFILED_TASK
+ * @param name task name used in the report
+ * @param handle pointer to the task handle global. Tasks that were not created are skipped in the report
+ * @param stack_size stack depth the task was created with
+ */
+void TaskProfiler::registerTask(uint8_t id, const char* name, TaskHandle_t* handle, uint32_t stack_size) {
+    if(id >= PROFILER_TASK_COUNT) {
+        return;
+    }
+
+    this->_tasks[id].name = name;
+    this->_tasks[id].handle = handle;
+    this->_tasks[id].stack_size = stack_size;
+}
+
+/**
+ * @brief mark the start of a loop iteration. Call after the task has unblocked
+ */
+void TaskProfiler::loopStart(uint8_t id) {
+    this->_tasks[id].loop_work_us = 0;
+    this->_tasks[id].loop_start_us = micros();
+}
+
+/**
+ * @brief stop timing the loop iteration. Call before a blocking call inside the loop body
+ */
+void TaskProfiler::loopPause(uint8_t id) {
+    task_profile_t* t = &this->_tasks[id];
+    t->loop_work_us += micros() - t->loop_start_us;
+}
+
+/**
+ * @brief carry on timing the loop iteration after a blocking call, see loopPause()
+ */
+void TaskProfiler::loopResume(uint8_t id) {
+    this->_tasks[id].loop_start_us = micros();
+}
+
+/**
+ * @brief mark the end of a loop iteration. Call before the task blocks again
+ */
+void TaskProfiler::loopEnd(uint8_t id) {
+    task_profile_t* t = &this->_tasks[id];
+    uint32_t elapsed = t->loop_work_us + (micros() - t->loop_start_us);
+
+    t->busy_us += elapsed;
+    t->loop_count++;
+    if(elapsed > t->wcet_us) {
+        t->wcet_us = elapsed;
+    }
+}
+
+/**
+ * @brief compute CPU load, average loop time and stack headroom for every created task
+ * since the previous call
+ *
+ * CPU load comes from the FreeRTOS run-time counters when they are enabled, and from the
+ * measured loop body time otherwise, which leaves out the paused, blocked time. It is
+ * given as a percentage of one core.
+ */
+void TaskProfiler::sample() {
+    uint32_t now = micros();
+    uint32_t window_us = now - this->_last_sample_us;
+    this->_last_sample_us = now;
+
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+    static TaskStatus_t system_state[PROFILER_MAX_SYSTEM_TASKS];
+    uint32_t total_run_time = 0;
+    UBaseType_t system_task_count = uxTaskGetSystemState(system_state, PROFILER_MAX_SYSTEM_TASKS, &total_run_time);
+    uint32_t run_time_window = total_run_time - this->_last_total_run_time;
+    this->_last_total_run_time = total_run_time;
+#endif
+
+    for(uint8_t i = 0; i < PROFILER_TASK_COUNT; i++) {
+        task_profile_t* t = &this->_tasks[i];
+        if(t->handle == NULL || *t->handle == NULL) {
+            continue;
+        }
+
+        // take a copy - the task keeps updating its counters while we work
+        uint32_t loop_count = t->loop_count;
+        uint32_t busy_us = t->busy_us;
+
+        uint32_t loops = loop_count - t->last_loop_count;
+        uint32_t busy = busy_us - t->last_busy_us;
+        t->last_loop_count = loop_count;
+        t->last_busy_us = busy_us;
+
+        t->loops_per_interval = loops;
+        t->avg_loop_us = loops ? busy / loops : 0;
+        t->cpu_permille = window_us ? (uint64_t)busy * 1000 / window_us : 0;
+
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+        for(UBaseType_t s = 0; s < system_task_count; s++) {
+            if(system_state[s].xHandle == *t->handle) {
+                uint32_t run_time = system_state[s].ulRunTimeCounter - t->last_run_time;
+                t->last_run_time = system_state[s].ulRunTimeCounter;
+                if(run_time_window) {
+                    t->cpu_permille = (uint64_t)run_time * 1000 / run_time_window;
+                }
+                break;
+            }
+        }
+#endif
+
+        t->stack_free = uxTaskGetStackHighWaterMark(*t->handle);
+    }
+}
+
+/**
+ * @brief format the first line of a report
+ * @param reason why this report was generated e.g PERIODIC or the new flight state
+ * @return number of characters written
+ */
+size_t TaskProfiler::formatHeader(char* buffer, size_t len, const char* reason) {
+    return snprintf(buffer, len, "PROF %s t=%lu heap=%lu",
+                    reason,
+                    (unsigned long)millis(),
+                    (unsigned long)ESP.getFreeHeap());
+}
+
+/**
+ * @brief format the report line of one task
+ * name cpu=<% of one core> loops=<iterations in interval> avg=<us> wcet=<us> stk=<free>/<size>
+ *
+ * @return number of characters written, 0 if the task was not created
+ */
+size_t TaskProfiler::formatTask(uint8_t id, char* buffer, size_t len) {
+    if(id >= PROFILER_TASK_COUNT) {
+        return 0;
+    }
+
+    task_profile_t* t = &this->_tasks[id];
+    if(t->handle == NULL || *t->handle == NULL) {
+        return 0;
+    }
+
+    return snprintf(buffer, len, "%s cpu=%u.%u%% loops=%lu avg=%luus wcet=%luus stk=%lu/%lu",
+                    t->name,
+                    t->cpu_permille / 10,
+                    t->cpu_permille % 10,
+                    (unsigned long)t->loops_per_interval,
+                    (unsigned long)t->avg_loop_us,
+                    (unsigned long)t->wcet_us,
+                    (unsigned long)t->stack_free,
+                    (unsigned long)t->stack_size);
+}
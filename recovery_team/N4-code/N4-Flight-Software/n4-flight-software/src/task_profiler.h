@@ -0,0 +1,98 @@
+/**
+ * @file task_profiler.h
+ * @brief Per-task CPU load, loop execution time and stack headroom profiling
+ *
+ * Every profiled task marks the start and end of its loop body with
+ * PROFILE_LOOP_START() and PROFILE_LOOP_END(). Only the work is timed - a loop body that
+ * blocks part way through wraps the blocking call in PROFILE_LOOP_PAUSE() and
+ * PROFILE_LOOP_RESUME(), so blocked time never counts as CPU time or loop time.
+ * The profiler task then periodically
+ * samples these counters together with the FreeRTOS run-time stats and the stack
+ * high water mark of each task handle, and builds a compact one-line-per-task report.
+ *
+ * Each task only writes its own slot, and all counters are 32-bit, so no locking
+ * is needed between the profiled tasks and the profiler task.
+ */
+
+#ifndef TASK_PROFILER_H
+#define TASK_PROFILER_H
+
+#include <Arduino.h>
+#include "defs.h"
+
+/**
+ * Tasks created in xCreateAllTasks()
+ */
+typedef enum {
+    PROF_READ_ACCELERATION = 0,
+    PROF_READ_ALTIMETER,
+    PROF_READ_GPS,
+    PROF_CHECK_FLIGHT_STATE,
+    PROF_FLIGHT_STATE_CALLBACK,
+    PROF_MQTT_TRANSMIT_TELEMETRY,
+    PROF_KALMAN_FILTER,
+    PROF_DEBUG_TO_TERMINAL,
+    PROF_LOG_TO_MEMORY,
+    PROF_OP_MODE_INDICATE,
+    PROF_CYCLIC_EXECUTIVE,
+    PROF_FLASH_WRITER,
+    PROF_SD_WRITER,
+    PROF_EVENT_LOG,
+    PROF_MQTT_PUBLISHER,
+    PROFILER_TASK_COUNT
+} PROFILED_TASK;
+
+/**
+ * A structure to hold the profiling counters of one task
+ */
+typedef struct {
+    const char* name;               /*!< task name as shown in the report */
+    TaskHandle_t* handle;           /*!< pointer to the task handle - the handle is only valid once the task is created */
+    uint32_t stack_size;            /*!< stack depth the task was created with */
+    uint32_t loop_start_us;         /*!< start time of the current loop iteration, or of its last resume */
+    uint32_t loop_work_us;          /*!< work done in the current loop iteration before its last pause */
+    uint32_t loop_count;            /*!< total loop iterations since boot */
+    uint32_t busy_us;               /*!< total time spent inside the loop body since boot */
+    uint32_t wcet_us;               /*!< worst-case loop iteration time since boot */
+    uint32_t last_loop_count;       /*!< loop_count at the previous report */
+    uint32_t last_busy_us;          /*!< busy_us at the previous report */
+    uint32_t last_run_time;         /*!< FreeRTOS run-time counter at the previous report */
+    uint16_t cpu_permille;          /*!< CPU load over the last report interval, in 0.1% */
+    uint32_t avg_loop_us;           /*!< average loop iteration time over the last report interval */
+    uint32_t loops_per_interval;    /*!< loop iterations in the last report interval */
+    uint32_t stack_free;            /*!< minimum free stack ever seen */
+} task_profile_t;
+
+class TaskProfiler {
+    private:
+        task_profile_t _tasks[PROFILER_TASK_COUNT];
+        uint32_t _last_sample_us = 0;           /*!< time of the previous report */
+        uint32_t _last_total_run_time = 0;      /*!< total FreeRTOS run time at the previous report */
+
+    public:
+        TaskProfiler();
+        void registerTask(uint8_t id, const char* name, TaskHandle_t* handle, uint32_t stack_size);
+        void loopStart(uint8_t id);
+        void loopPause(uint8_t id);
+        void loopResume(uint8_t id);
+        void loopEnd(uint8_t id);
+        void sample();
+        size_t formatHeader(char* buffer, size_t len, const char* reason);
+        size_t formatTask(uint8_t id, char* buffer, size_t len);
+};
+
+extern TaskProfiler task_profiler;
+
+#if PROFILE_TASKS
+    #define PROFILE_LOOP_START(id) task_profiler.loopStart(id)
+    #define PROFILE_LOOP_PAUSE(id) task_profiler.loopPause(id)
+    #define PROFILE_LOOP_RESUME(id) task_profiler.loopResume(id)
+    #define PROFILE_LOOP_END(id) task_profiler.loopEnd(id)
+#else
+    #define PROFILE_LOOP_START(id)
+    #define PROFILE_LOOP_PAUSE(id)
+    #define PROFILE_LOOP_RESUME(id)
+    #define PROFILE_LOOP_END(id)
+#endif // PROFILE_TASKS
+
+#endif // TASK_PROFILER_H
@@ -0,0 +1,244 @@
+/**
+ * @file telemetry_format.cpp
+ * @brief Implement the fixed precision number formatting and the telemetry CSV row builder
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "telemetry_format.h"
+
+#define FORMAT_EXACT_LIMIT 4503599627370496.0   /*!< 2^52 - above this the scaled value no longer has a fraction bit */
+#define FORMAT_TIE_TOLERANCE 2.3e-16            /*!< relative bound on the product rounding error - just over 2^-52 */
+
+static const double pow10_table[FORMAT_MAX_DECIMALS + 1] = {
+    1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0, 1000000.0, 10000000.0, 100000000.0, 1000000000.0
+};
+
+/**
+ * @brief copy formatted characters to the output and NUL terminate
+ * @return number of characters copied, truncated to fit len
+ */
+static size_t copyOut(char* buffer, size_t len, const char* start, size_t count) {
+    if(len == 0) {
+        return 0;
+    }
+
+    if(count > len - 1) {
+        count = len - 1;
+    }
+
+    memcpy(buffer, start, count);
+    buffer[count] = '\0';
+
+    return count;
+}
+
+/**
+ * @brief exact rounding error of a double multiplication (Dekker's product)
+ * a * b == product + error exactly, as long as nothing overflows
+ */
+static double productError(double a, double b, double product) {
+    const double split = 134217729.0;   // 2^27 + 1
+
+    double t = split * a;
+    double a_hi = t - (t - a);
+    double a_lo = a - a_hi;
+
+    t = split * b;
+    double b_hi = t - (t - b);
+    double b_lo = b - b_hi;
+
+    return ((a_hi * b_hi - product) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo;
+}
+
+/**
+ * @brief decide whether the scaled value rounds up, the way printf does
+ * printf rounds the exact binary value of the double, not the rounded product, so values
+ * within one ulp of a tie are settled with the exact product error
+ *
+ * @param magnitude absolute value being formatted
+ * @param scale 10^decimals
+ * @param scaled magnitude * scale
+ * @param whole integer part of scaled
+ * @param fraction scaled - whole
+ */
+static bool roundsUp(double magnitude, double scale, double scaled, uint64_t whole, double fraction) {
+    double tolerance = scaled * FORMAT_TIE_TOLERANCE;
+    double distance = fraction - 0.5;
+
+    if(distance > tolerance) {
+        return true;
+    } else if(distance < -tolerance) {
+        return false;
+    }
+
+    // the sign of a rounded sum is always the sign of the exact sum
+    distance += productError(magnitude, scale, scaled);
+    if(distance != 0) {
+        return distance > 0;
+    }
+
+    // exact tie - round half to even
+    return (whole & 1) != 0;
+}
+
+/**
+ * @brief format an unsigned integer in decimal
+ * @return number of characters written, not counting the terminating NUL
+ */
+size_t formatUnsigned(char* buffer, size_t len, uint32_t value) {
+    char digits[10];
+    char* p = digits + sizeof(digits);
+
+    do {
+        *--p = '0' + (value % 10);
+        value /= 10;
+    } while(value);
+
+    return copyOut(buffer, len, p, digits + sizeof(digits) - p);
+}
+
+/**
+ * @brief format a number with a fixed number of decimals, same output as printf("%.*f")
+ * @param buffer output buffer, always NUL terminated
+ * @param len size of the output buffer
+ * @param value number to format
+ * @param decimals digits after the decimal point, up to FORMAT_MAX_DECIMALS
+ * @return number of characters written, not counting the terminating NUL
+ */
+size_t formatFixed(char* buffer, size_t len, double value, uint8_t decimals) {
+    if(decimals > FORMAT_MAX_DECIMALS) {
+        decimals = FORMAT_MAX_DECIMALS;
+    }
+
+    double scale = pow10_table[decimals];
+    bool negative = signbit(value);
+    double magnitude = negative ? -value : value;
+    double scaled = magnitude * scale;
+
+    // too large to split into exact integer parts, infinity and NaN (which fails every comparison)
+    if(!(scaled < FORMAT_EXACT_LIMIT)) {
+        if(len == 0) {
+            return 0;
+        }
+        int written = snprintf(buffer, len, "%.*f", decimals, value);
+        if(written < 0) {
+            buffer[0] = '\0';
+            return 0;
+        }
+        return (size_t)written < len ? written : len - 1;
+    }
+
+    uint64_t whole = (uint64_t)scaled;
+    if(roundsUp(magnitude, scale, scaled, whole, scaled - (double)whole)) {
+        whole++;
+    }
+
+    // 16 integer digits, the point, 9 decimals and the sign
+    char digits[28];
+    char* p = digits + sizeof(digits);
+
+    uint64_t integer_part;
+    uint32_t fraction_part;
+
+    // stay in 32-bit arithmetic whenever the value allows it - 64-bit division is a libgcc call on the ESP32
+    if(whole <= UINT32_MAX) {
+        uint32_t whole32 = (uint32_t)whole;
+        integer_part = whole32 / (uint32_t)scale;
+        fraction_part = whole32 - (uint32_t)integer_part * (uint32_t)scale;
+    } else {
+        integer_part = whole / (uint64_t)scale;
+        fraction_part = (uint32_t)(whole - integer_part * (uint64_t)scale);
+    }
+
+    for(uint8_t i = 0; i < decimals; i++) {
+        *--p = '0' + (fraction_part % 10);
+        fraction_part /= 10;
+    }
+
+    if(decimals) {
+        *--p = '.';
+    }
+
+    while(integer_part > UINT32_MAX) {
+        *--p = '0' + (integer_part % 10);
+        integer_part /= 10;
+    }
+
+    uint32_t integer_part32 = (uint32_t)integer_part;
+    do {
+        *--p = '0' + (integer_part32 % 10);
+        integer_part32 /= 10;
+    } while(integer_part32);
+
+    if(negative) {
+        *--p = '-';
+    }
+
+    return copyOut(buffer, len, p, digits + sizeof(digits) - p);
+}
+
+/**
+ * @brief append one character if there is room for it and the terminating NUL
+ */
+static size_t appendChar(char* buffer, size_t len, size_t pos, char c) {
+    if(pos + 1 < len) {
+        buffer[pos++] = c;
+        buffer[pos] = '\0';
+    }
+
+    return pos;
+}
+
+/**
+ * @brief build one telemetry CSV row
+ *
+ * record_number,operation_mode,state,ax,ay,az,pitch,roll,gx,gy,gz,latitude,longitude,gps_altitude,pressure,temperature,relative_altitude\n
+ * Same as the previous sprintf format: 2 decimals everywhere except 4 for latitude and longitude
+ *
+ * @param buffer output buffer - TELEMETRY_ROW_MAX_LENGTH is enough for any in-range values
+ * @param len size of the output buffer
+ * @param packet telemetry sample
+ * @param gps latest GPS snapshot
+ * @param altimeter latest altimeter snapshot
+ * @return length of the row
+ */
+size_t formatTelemetryRow(char* buffer, size_t len, const telemetry_type_t* packet, const gps_type_t* gps, const altimeter_type_t* altimeter) {
+    const double values[] = {
+        packet->acc_data.ax,
+        packet->acc_data.ay,
+        packet->acc_data.az,
+        packet->acc_data.pitch,
+        packet->acc_data.roll,
+        packet->gyro_data.gx,
+        packet->gyro_data.gy,
+        packet->gyro_data.gz,
+        gps->latitude,
+        gps->longitude,
+        (double)gps->gps_altitude,
+        altimeter->pressure,
+        altimeter->temperature,
+        altimeter->rel_altitude
+    };
+    const uint8_t decimals[] = {2, 2, 2, 2, 2, 2, 2, 2, 4, 4, 2, 2, 2, 2};
+
+    size_t pos = 0;
+    if(len == 0) {
+        return 0;
+    }
+    buffer[0] = '\0';
+
+    pos += formatUnsigned(buffer + pos, len - pos, packet->record_number);
+    pos = appendChar(buffer, len, pos, ',');
+    pos += formatUnsigned(buffer + pos, len - pos, packet->operation_mode);
+    pos = appendChar(buffer, len, pos, ',');
+    pos += formatUnsigned(buffer + pos, len - pos, packet->state);
+
+    for(uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        pos = appendChar(buffer, len, pos, ',');
+        pos += formatFixed(buffer + pos, len - pos, values[i], decimals[i]);
+    }
+
+    return appendChar(buffer, len, pos, '\n');
+}
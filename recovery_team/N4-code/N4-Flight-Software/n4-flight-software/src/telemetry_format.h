@@ -0,0 +1,25 @@
+/**
+ * @file telemetry_format.h
+ * @brief Allocation-free number to ASCII formatting for telemetry and debug rows
+ *
+ * formatFixed() gives the same output as printf("%.<n>f") - including round half to even
+ * on exact ties and "-0.00" for small negative values - without going through newlib's
+ * float printf. Values it cannot format exactly with integer arithmetic (very large, NaN,
+ * infinity) fall back to snprintf.
+ */
+
+#ifndef TELEMETRY_FORMAT_H
+#define TELEMETRY_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "data_types.h"
+
+#define TELEMETRY_ROW_MAX_LENGTH 256            /*!< buffer size for one telemetry CSV row */
+#define FORMAT_MAX_DECIMALS 9                   /*!< maximum digits after the decimal point */
+
+size_t formatUnsigned(char* buffer, size_t len, uint32_t value);
+size_t formatFixed(char* buffer, size_t len, double value, uint8_t decimals);
+size_t formatTelemetryRow(char* buffer, size_t len, const telemetry_type_t* packet, const gps_type_t* gps, const altimeter_type_t* altimeter);
+
+#endif // TELEMETRY_FORMAT_H
@@ -0,0 +1,134 @@
+/**
+ * @file timing_probe.cpp
+ * @brief Implement the timing probe histogram functions
+ */
+
+#include "timing_probe.h"
+
+TimingProbes timing_probes;
+
+/**
+ * @brief class constructor - clears all histograms
+ */
+TimingProbes::TimingProbes() {
+    this->reset();
+}
+
+/**
+ * @brief clear all histograms
+ */
+void TimingProbes::reset() {
+    memset(this->_histograms, 0, sizeof(this->_histograms));
+}
+
+/**
+ * @brief find the histogram bucket of a measurement
+ * Values below 4 cycles get their own bucket, every power of two above that is split in 4
+ */
+uint8_t TimingProbes::bucketIndex(uint32_t cycles) {
+    if(cycles < (1 << PROBE_SUB_BUCKET_BITS)) {
+        return cycles;
+    }
+
+    uint8_t msb = 31 - __builtin_clz(cycles);
+    uint8_t shift = msb - PROBE_SUB_BUCKET_BITS;
+
+    return ((msb - PROBE_SUB_BUCKET_BITS + 1) << PROBE_SUB_BUCKET_BITS) + ((cycles >> shift) - (1 << PROBE_SUB_BUCKET_BITS));
+}
+
+/**
+ * @brief largest cycle count that falls into a histogram bucket
+ */
+uint32_t TimingProbes::bucketUpperBound(uint8_t index) {
+    if(index < (1 << PROBE_SUB_BUCKET_BITS)) {
+        return index;
+    }
+
+    uint8_t msb = (index >> PROBE_SUB_BUCKET_BITS) - 1 + PROBE_SUB_BUCKET_BITS;
+    uint8_t shift = msb - PROBE_SUB_BUCKET_BITS;
+    uint64_t mantissa = (index & ((1 << PROBE_SUB_BUCKET_BITS) - 1)) + (1 << PROBE_SUB_BUCKET_BITS);
+
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/**
+ * @brief add one measurement to the histogram of a probe
+ * @param id probe ID, see PROBE_ID
+ * @param cycles measured duration in CPU cycles
+ */
+void TimingProbes::record(uint8_t id, uint32_t cycles) {
+    probe_histogram_t* h = &this->_histograms[id];
+
+    h->buckets[this->bucketIndex(cycles)]++;
+    h->count++;
+    if(cycles > h->max_cycles) {
+        h->max_cycles = cycles;
+    }
+}
+
+/**
+ * @brief get the upper edge of the bucket holding the given percentile
+ */
+uint32_t TimingProbes::percentile(uint8_t id, uint8_t percent) {
+    probe_histogram_t* h = &this->_histograms[id];
+    uint32_t target = ((uint64_t)h->count * percent + 99) / 100;
+    uint32_t seen = 0;
+
+    for(uint8_t i = 0; i < PROBE_BUCKET_COUNT; i++) {
+        seen += h->buckets[i];
+        if(seen >= target && seen > 0) {
+            // the bucket edge may overshoot the largest value actually seen
+            uint32_t upper = this->bucketUpperBound(i);
+            return upper < h->max_cycles ? upper : h->max_cycles;
+        }
+    }
+
+    return h->max_cycles;
+}
+
+/**
+ * @brief convert the probe ID to string
+ */
+const char* TimingProbes::getProbeName(uint8_t id) {
+    static const char* names[] = {
+        "IMU_READ",
+        "IMU_REG_READ",
+        "BARO_CONV",
+        "FILTER",
+        "STATE_EVAL",
+        "FLASH_WRITE",
+        "MQTT_PUBLISH"
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == PROBE_COUNT, "every probe ID needs a name");
+
+    if(id >= PROBE_COUNT) {
+        return "UNKNOWN";
+    }
+
+    return names[id];
+}
+
+/**
+ * @brief format the latency summary of a probe
+ * name n=<count> p50=<us> p99=<us> max=<us>
+ *
+ * @return number of characters written, 0 if the probe has no measurements
+ */
+size_t TimingProbes::format(uint8_t id, char* buffer, size_t len) {
+    if(id >= PROBE_COUNT || this->_histograms[id].count == 0) {
+        return 0;
+    }
+
+    // cycles to tenths of a microsecond
+    uint32_t cpu_mhz = ESP.getCpuFreqMHz();
+    uint32_t p50 = (uint64_t)this->percentile(id, 50) * 10 / cpu_mhz;
+    uint32_t p99 = (uint64_t)this->percentile(id, 99) * 10 / cpu_mhz;
+    uint32_t max = (uint64_t)this->_histograms[id].max_cycles * 10 / cpu_mhz;
+
+    return snprintf(buffer, len, "%s n=%lu p50=%lu.%luus p99=%lu.%luus max=%lu.%luus",
+                    this->getProbeName(id),
+                    (unsigned long)this->_histograms[id].count,
+                    (unsigned long)(p50 / 10), (unsigned long)(p50 % 10),
+                    (unsigned long)(p99 / 10), (unsigned long)(p99 % 10),
+                    (unsigned long)(max / 10), (unsigned long)(max % 10));
+}
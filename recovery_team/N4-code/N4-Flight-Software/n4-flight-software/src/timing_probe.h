@@ -0,0 +1,88 @@
+/**
+ * @file timing_probe.h
+ * @brief Cycle-accurate timing probes for the flight software hot paths
+ *
+ * A probe measures the time between PROBE_START(id) and PROBE_STOP(id) in CPU cycles
+ * using the Xtensa CCOUNT register, and adds it to a fixed-bucket latency histogram
+ * for that probe ID. Set TIMING_PROBES to 0 in defs.h to compile all probes out.
+ *
+ * The histogram buckets are log-linear: 4 buckets per power of two, so every bucket
+ * is at most 25% wide. p50/p99 are reported as the upper edge of their bucket.
+ *
+ * CCOUNT is per core - a probe must start and stop on the same core, which holds for
+ * all our tasks since they are pinned to core 1. Every probe ID is only updated from
+ * one task, so the histograms need no locking.
+ */
+
+#ifndef TIMING_PROBE_H
+#define TIMING_PROBE_H
+
+#include <Arduino.h>
+#include "defs.h"
+
+#define PROBE_SUB_BUCKET_BITS   2                                       /*!< 2^2 = 4 buckets per power of two */
+#define PROBE_BUCKET_COUNT      ((32 - PROBE_SUB_BUCKET_BITS + 1) << PROBE_SUB_BUCKET_BITS)  /*!< enough buckets for any 32-bit cycle count */
+
+/**
+ * Instrumented hot paths
+ */
+typedef enum {
+    PROBE_IMU_READ = 0,         /*!< full IMU sample in readAccelerationTask */
+    PROBE_IMU_REGISTER_READ,    /*!< one MPU6050 read over I2C - a register pair, or the burst of every axis */
+    PROBE_BARO_CONVERSION,      /*!< BMP180 temperature and pressure conversion */
+    PROBE_FILTER_UPDATE,        /*!< kalman filter update */
+    PROBE_STATE_EVAL,           /*!< flight state evaluation */
+    PROBE_FLASH_WRITE,          /*!< flight data write to the SPI flash */
+    PROBE_MQTT_PUBLISH,         /*!< one MQTT publish by the MQTT publisher task */
+    PROBE_COUNT
+} PROBE_ID;
+
+/**
+ * A structure to hold the latency histogram of one probe
+ */
+typedef struct {
+    uint32_t count;                             /*!< number of measurements */
+    uint32_t max_cycles;                        /*!< longest measurement */
+    uint32_t buckets[PROBE_BUCKET_COUNT];       /*!< measurement count per bucket */
+} probe_histogram_t;
+
+/**
+ * @brief read the CPU cycle counter of the current core
+ */
+static inline uint32_t probe_ccount() {
+#if defined(__XTENSA__)
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+#else
+    return ESP.getCycleCount();
+#endif
+}
+
+class TimingProbes {
+    private:
+        probe_histogram_t _histograms[PROBE_COUNT];
+
+        uint8_t bucketIndex(uint32_t cycles);
+        uint32_t bucketUpperBound(uint8_t index);
+        uint32_t percentile(uint8_t id, uint8_t percent);
+
+    public:
+        TimingProbes();
+        void record(uint8_t id, uint32_t cycles);
+        void reset();
+        size_t format(uint8_t id, char* buffer, size_t len);
+        const char* getProbeName(uint8_t id);
+};
+
+extern TimingProbes timing_probes;
+
+#if TIMING_PROBES
+    #define PROBE_START(id) uint32_t _probe_start_##id = probe_ccount()
+    #define PROBE_STOP(id) timing_probes.record(id, probe_ccount() - _probe_start_##id)
+#else
+    #define PROBE_START(id)
+    #define PROBE_STOP(id)
+#endif // TIMING_PROBES
+
+#endif // TIMING_PROBE_H
@@ -0,0 +1,150 @@
+/**
+ * @file trace.cpp
+ * @brief Implement the binary event tracer
+ */
+
+#include "trace.h"
+#include "flight_log_le.h"
+
+Tracer TRACER;
+
+/**
+ * @brief create the trace file and write its header. The file is cleared on every boot
+ * @param fs file system for the trace, normally SPIFFS
+ * @param file trace file name
+ * @return true if the file is open
+ */
+bool Tracer::begin(fs::FS& fs, const char* file) {
+    this->_file = fs.open(file, FILE_WRITE);
+    if(!this->_file) {
+        debugln("[-]Could not create the trace file");
+        return false;
+    }
+
+    uint8_t header[TRACE_HEADER_SIZE];
+    put32(header, TRACE_MAGIC);
+    header[4] = TRACE_VERSION;
+    header[5] = TRACE_EVENT_COUNT;
+    header[6] = 0;
+    header[7] = 0;
+    put32(header + 8, TRACE_DICTIONARY_HASH);
+
+    this->_file.write(header, sizeof(header));
+    this->_file.flush();
+    this->_stats.bytes_written += sizeof(header);
+    this->_last_flush_ms = millis();
+    this->_ready = true;
+
+    return true;
+}
+
+/**
+ * @brief the task that runs service(). It is woken up for events that must be flushed now
+ */
+void Tracer::setWriter(TaskHandle_t writer) {
+    this->_writer = writer;
+}
+
+/**
+ * @brief queue one event. Use TRACE() rather than calling this directly
+ */
+void Tracer::record(uint8_t id, uint8_t level, const int32_t* args, uint8_t arg_count) {
+    uint32_t position;
+    trace_record_t* record = this->_ring.claim(&position);
+    if(record == NULL) {
+        __atomic_fetch_add(&this->_stats.dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    record->timestamp_us = micros();
+    record->id = id;
+    record->level = level;
+    record->arg_count = arg_count;
+    for(uint8_t i = 0; i < arg_count; i++) {
+        record->args[i] = args[i];
+    }
+
+    this->_ring.publish(position);
+
+    if(level >= LOG_LEVEL::CRITICAL && this->_writer != NULL) {
+        xTaskNotifyGive(this->_writer);
+    }
+}
+
+/**
+ * @brief write the next events to the file at the next service() call and flush it
+ */
+void Tracer::flush() {
+    this->_flush_requested = true;
+
+    if(this->_writer != NULL) {
+        xTaskNotifyGive(this->_writer);
+    }
+}
+
+/**
+ * @brief write every queued event to the trace file. Called by the event log task only
+ * Records are packed into one buffer and written in as few file writes as possible
+ */
+void Tracer::service() {
+    if(!this->_ready) {
+        return;
+    }
+
+    bool flush_now = this->_flush_requested;
+    this->_flush_requested = false;
+
+    uint8_t batch[TRACE_BATCH_SIZE];
+    size_t used = 0;
+    trace_record_t* record;
+
+    while((record = this->_ring.peek()) != NULL) {
+        if(used + TRACE_RECORD_MAX_SIZE > sizeof(batch)) {
+            this->_file.write(batch, used);
+            this->_stats.bytes_written += used;
+            used = 0;
+        }
+
+        put32(batch + used, record->timestamp_us);
+        batch[used + 4] = record->id;
+        batch[used + 5] = record->arg_count;
+        used += TRACE_RECORD_HEADER_SIZE;
+
+        for(uint8_t i = 0; i < record->arg_count; i++) {
+            put32(batch + used, record->args[i]);
+            used += 4;
+        }
+
+        if(record->level >= LOG_LEVEL::CRITICAL) {
+            flush_now = true;
+        }
+
+        this->_stats.written++;
+        this->_ring.release();
+    }
+
+    if(used) {
+        this->_file.write(batch, used);
+        this->_stats.bytes_written += used;
+        this->_dirty = true;
+    }
+
+    uint32_t now = millis();
+    if(this->_dirty && (flush_now || now - this->_last_flush_ms >= EVENT_LOG_FLUSH_INTERVAL)) {
+        this->_file.flush();
+        this->_dirty = false;
+        this->_last_flush_ms = now;
+        this->_stats.flushes++;
+    }
+}
+
+/**
+ * @brief one line tracer report
+ */
+size_t Tracer::formatStats(char* buffer, size_t len) {
+    return snprintf(buffer, len, "TRACE written=%lu bytes=%lu dropped=%lu flushes=%lu",
+                    (unsigned long)this->_stats.written,
+                    (unsigned long)this->_stats.bytes_written,
+                    (unsigned long)this->_stats.dropped,
+                    (unsigned long)this->_stats.flushes);
+}
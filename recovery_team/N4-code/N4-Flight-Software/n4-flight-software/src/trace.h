@@ -0,0 +1,99 @@
+/**
+ * @file trace.h
+ * @brief Binary event tracing with the formatting deferred to the host
+ *
+ * TRACE(STATE_CHANGE, old_state, new_state) stores the event ID from trace_events.def, a
+ * microsecond timestamp and the raw integer arguments in a lock-free RAM ring - no string
+ * is formatted or stored on the flight computer. The event log task appends the ring to
+ * TRACE_FILE, and scripts/trace-decoder expands the file into readable log lines.
+ *
+ * Events below TRACE_MIN_LEVEL, and every event when TRACING is 0, compile to nothing.
+ * Any task may trace. CRITICAL and ERROR events wake the event log task, which flushes them
+ * right away. Not for use from interrupts.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "defs.h"
+#include "trace_format.h"
+#include "mpsc_ring.h"
+
+/**
+ * One traced event waiting to be written
+ */
+typedef struct {
+    uint32_t timestamp_us;              /*!< micros() when the event was traced */
+    uint8_t id;                         /*!< TRACE_EVENT_ID */
+    uint8_t level;                      /*!< LOG_LEVEL */
+    uint8_t arg_count;                  /*!< arguments used */
+    int32_t args[TRACE_MAX_ARGS];
+} trace_record_t;
+
+/**
+ * A structure to hold the tracer statistics
+ */
+typedef struct {
+    uint32_t dropped;                   /*!< events dropped because the ring was full */
+    uint32_t written;                   /*!< events written to the file */
+    uint32_t bytes_written;             /*!< bytes written to the file, header included */
+    uint32_t flushes;                   /*!< file flushes */
+} trace_stats_t;
+
+class Tracer {
+    private:
+        MpscRing<trace_record_t, TRACE_QUEUE_LENGTH> _ring;
+        TaskHandle_t _writer = NULL;        /*!< notified when an event must reach the file right away */
+        volatile bool _flush_requested = false;
+
+        /* owned by the event log task */
+        File _file;
+        bool _ready = false;                /*!< false until the trace file is open */
+        bool _dirty = false;                /*!< written since the last flush */
+        uint32_t _last_flush_ms = 0;
+        trace_stats_t _stats = {};
+
+    public:
+        bool begin(fs::FS& fs, const char* file);
+        void setWriter(TaskHandle_t writer);
+        void record(uint8_t id, uint8_t level, const int32_t* args, uint8_t arg_count);
+        void service();
+        void flush();
+        size_t formatStats(char* buffer, size_t len);
+};
+
+extern Tracer TRACER;
+
+/**
+ * @brief pass a float argument - the decoder prints it with %f
+ */
+static inline int32_t traceFloat(float value) {
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline void traceEvent(uint8_t id, uint8_t level) {
+    TRACER.record(id, level, NULL, 0);
+}
+
+template <typename First, typename... Rest>
+static inline void traceEvent(uint8_t id, uint8_t level, First first, Rest... rest) {
+    static_assert(1 + sizeof...(Rest) <= TRACE_MAX_ARGS, "too many trace arguments");
+    const int32_t args[] = {(int32_t)first, (int32_t)rest...};
+    TRACER.record(id, level, args, 1 + sizeof...(Rest));
+}
+
+#if TRACING
+    #define TRACE(event, ...) do { \
+        if(TRACE_LEVEL_##event >= TRACE_MIN_LEVEL) { \
+            traceEvent(TRACE_##event, TRACE_LEVEL_##event, ##__VA_ARGS__); \
+        } \
+    } while(0)
+#else
+    #define TRACE(event, ...) do {} while(0)
+#endif // TRACING
+
+#endif // TRACE_H
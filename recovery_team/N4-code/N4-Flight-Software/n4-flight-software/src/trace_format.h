@@ -0,0 +1,79 @@
+/**
+ * @file trace_format.h
+ * @brief Binary trace file format shared by the flight software and the trace decoder
+ *
+ * The trace file starts with a header:
+ *
+ * | field   | type   |                                                   |
+ * |---------|--------|---------------------------------------------------|
+ * | magic   | uint32 | TRACE_MAGIC                                       |
+ * | version | uint8  | TRACE_VERSION                                     |
+ * | count   | uint8  | events in the dictionary the trace was written with |
+ * | -       | uint16 | reserved, 0                                       |
+ * | hash    | uint32 | TRACE_DICTIONARY_HASH                             |
+ *
+ * followed by one record per event:
+ *
+ * | field     | type          |                                     |
+ * |-----------|---------------|-------------------------------------|
+ * | timestamp | uint32        | us since boot                       |
+ * | id        | uint8         | position in trace_events.def        |
+ * | count     | uint8         | arguments that follow               |
+ * | args      | int32 x count | raw arguments, see trace_events.def |
+ *
+ * Every value is little-endian. The format strings never leave the host - the decoder
+ * builds the same dictionary from trace_events.def and checks the hash before decoding.
+ */
+
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+#include "system_log_levels.h"
+
+#define TRACE_MAGIC 0x5254344EUL            /*!< "N4TR" when read as bytes */
+#define TRACE_VERSION 1                     /*!< bump on every header or record layout change */
+#define TRACE_HEADER_SIZE 12                /*!< bytes in the trace file header */
+#define TRACE_RECORD_HEADER_SIZE 6          /*!< bytes in a record before the arguments */
+#define TRACE_MAX_ARGS 4                    /*!< most arguments one event can carry */
+#define TRACE_RECORD_MAX_SIZE (TRACE_RECORD_HEADER_SIZE + 4 * TRACE_MAX_ARGS)    /*!< largest record */
+
+/**
+ * Trace event IDs - TRACE_<name>
+ */
+typedef enum {
+    #define TRACE_EVENT(name, level, format) TRACE_##name,
+    #include "trace_events.def"
+    #undef TRACE_EVENT
+    TRACE_EVENT_COUNT
+} TRACE_EVENT_ID;
+
+/**
+ * Trace event levels - TRACE_LEVEL_<name>
+ */
+enum {
+    #define TRACE_EVENT(name, level, format) TRACE_LEVEL_##name = LOG_LEVEL::level,
+    #include "trace_events.def"
+    #undef TRACE_EVENT
+};
+
+/**
+ * @brief FNV-1a hash of a string, evaluated by the compiler
+ */
+constexpr uint32_t traceHash(const char* s, uint32_t hash = 0x811C9DC5UL) {
+    return *s ? traceHash(s + 1, (hash ^ (uint8_t)*s) * 0x01000193UL) : hash;
+}
+
+/**
+ * Hash of every event name, level, format and position. Written to the trace header so that
+ * the decoder can tell that it was built from the same dictionary
+ */
+constexpr uint32_t TRACE_DICTIONARY_HASH = 0
+    #define TRACE_EVENT(name, level, format) ^ (traceHash(#name "|" format, 0x811C9DC5UL + LOG_LEVEL::level) * (2 * TRACE_##name + 1))
+    #include "trace_events.def"
+    #undef TRACE_EVENT
+    ;
+
+static_assert(TRACE_EVENT_COUNT <= 255, "trace event IDs must fit in a uint8_t");
+
+#endif // TRACE_FORMAT_H
@@ -0,0 +1,107 @@
+/**
+ * @file xbee_link.cpp
+ * @brief Implement the XBee downlink on the ESP32 UART driver
+ */
+
+#include "xbee_link.h"
+
+XbeeLink XBEE_LINK;
+
+/**
+ * @brief set up the UART and install the driver with the TX ring
+ * @param port UART the XBee is wired to - not UART0, that is the debug console
+ * @param tx_pin ESP32 pin wired to the XBee DIN
+ * @param rx_pin ESP32 pin wired to the XBee DOUT
+ * @param baud must match the module BD setting
+ * @param destination 64 bit address of the ground XBee, XBEE_BROADCAST for all
+ * @return false if the driver could not be installed - send() then drops every frame
+ */
+bool XbeeLink::begin(uart_port_t port, int tx_pin, int rx_pin, uint32_t baud, uint64_t destination) {
+    this->_port = port;
+    this->_destination = destination;
+    this->_reported_ms = millis();
+
+    uart_config_t config = {};
+    config.baud_rate = baud;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    config.source_clk = UART_SCLK_APB;
+
+    this->_lock = xSemaphoreCreateMutex();
+    if(this->_lock == NULL ||
+       uart_param_config(port, &config) != ESP_OK ||
+       uart_set_pin(port, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK ||
+       uart_driver_install(port, XBEE_RX_BUFFER_SIZE, XBEE_TX_BUFFER_SIZE, 0, NULL, 0) != ESP_OK) {
+        return false;
+    }
+
+    this->_ready = true;
+    return true;
+}
+
+/**
+ * @brief queue one message for the ground. Never waits for the UART
+ * @param data message, e.g. a telemetry frame
+ * @param len at most XBEE_PAYLOAD_SIZE bytes
+ * @return false if the message was dropped
+ */
+bool XbeeLink::send(const uint8_t* data, size_t len) {
+    if(!this->_ready) {
+        return false;
+    }
+
+    if(len > XBEE_PAYLOAD_SIZE) {
+        __atomic_fetch_add(&this->_stats.dropped_long, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    // the lock is only held to copy the frame into the ring
+    xSemaphoreTake(this->_lock, portMAX_DELAY);
+
+    size_t length = xbeeEncodeTransmit(this->_frame, this->_destination, 0, data, len);
+    size_t free_space = 0;
+    bool fits = uart_get_tx_buffer_free_size(this->_port, &free_space) == ESP_OK && free_space >= length;
+
+    if(fits) {
+        uart_write_bytes(this->_port, this->_frame, length);
+        this->_stats.frames++;
+        this->_stats.bytes += length;
+        this->_stats.payload_bytes += len;
+
+        uint32_t backlog = XBEE_TX_BUFFER_SIZE - free_space + length;
+        if(backlog > this->_stats.backlog_max) {
+            this->_stats.backlog_max = backlog;
+        }
+    } else {
+        this->_stats.dropped_full++;
+    }
+
+    xSemaphoreGive(this->_lock);
+    return fits;
+}
+
+/**
+ * @brief one line link report, with the byte rate since the last report
+ */
+size_t XbeeLink::formatStats(char* buffer, size_t len) {
+    uint32_t now = millis();
+    uint32_t elapsed_ms = now - this->_reported_ms;
+    uint32_t bytes = this->_stats.bytes;
+    uint32_t bytes_per_s = elapsed_ms ? (uint32_t)((uint64_t)(bytes - this->_reported_bytes) * 1000 / elapsed_ms) : 0;
+    this->_reported_ms = now;
+    this->_reported_bytes = bytes;
+
+    // drop=full/long, B/s against the UART line rate of XBEE_BAUD_RATE / 10
+    return snprintf(buffer, len, "XBEE up=%u B/s=%lu/%lu frames=%lu bytes=%lu payload=%lu drop=%lu/%lu backlog_max=%lu",
+                    this->_ready ? 1 : 0,
+                    (unsigned long)bytes_per_s,
+                    (unsigned long)(XBEE_BAUD_RATE / 10),
+                    (unsigned long)this->_stats.frames,
+                    (unsigned long)bytes,
+                    (unsigned long)this->_stats.payload_bytes,
+                    (unsigned long)this->_stats.dropped_full,
+                    (unsigned long)this->_stats.dropped_long,
+                    (unsigned long)this->_stats.backlog_max);
+}
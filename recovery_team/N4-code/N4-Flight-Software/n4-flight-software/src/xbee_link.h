@@ -0,0 +1,59 @@
+/**
+ * @file xbee_link.h
+ * @brief Long range telemetry downlink through an XBee in API mode
+ *
+ * send() wraps a message in an escaped Transmit Request frame, see xbee_frame.h, and hands
+ * it to the ESP32 UART driver. The driver is installed with an XBEE_TX_BUFFER_SIZE byte TX
+ * ring that its interrupt drains into the UART at XBEE_BAUD_RATE, so send() only copies the
+ * frame and returns. A frame that does not fit in the ring is dropped and counted - a slow
+ * radio costs samples, never time in the calling task. A frame goes into the ring whole or
+ * not at all, so the ground parser never sees half a frame.
+ *
+ * The frame ID is 0, so the module sends no Transmit Status frames back and nothing needs
+ * to be read from it.
+ *
+ * Any task may call send().
+ */
+
+#ifndef XBEE_LINK_H
+#define XBEE_LINK_H
+
+#include <Arduino.h>
+#include <driver/uart.h>
+#include "defs.h"
+#include "xbee_frame.h"
+
+static_assert(XBEE_PAYLOAD_SIZE <= XBEE_MAX_RF_DATA, "XBEE_PAYLOAD_SIZE is larger than any XBee accepts");
+
+/**
+ * A structure to hold the link statistics
+ */
+typedef struct {
+    uint32_t frames;                    /*!< frames queued for the UART */
+    uint32_t bytes;                     /*!< bytes queued, escaping and framing included */
+    uint32_t payload_bytes;             /*!< RF data bytes queued */
+    uint32_t dropped_full;              /*!< frames dropped because the TX ring was full */
+    uint32_t dropped_long;              /*!< messages longer than XBEE_PAYLOAD_SIZE */
+    uint32_t backlog_max;               /*!< most bytes waiting in the TX ring */
+} xbee_link_stats_t;
+
+class XbeeLink {
+    private:
+        uart_port_t _port = UART_NUM_1;
+        uint64_t _destination = XBEE_BROADCAST;
+        bool _ready = false;
+        SemaphoreHandle_t _lock = NULL;     /*!< keeps the free space check and the write together */
+        uint8_t _frame[XBEE_TRANSMIT_BUFFER_SIZE(XBEE_PAYLOAD_SIZE)];
+        uint32_t _reported_ms = 0;
+        uint32_t _reported_bytes = 0;
+        xbee_link_stats_t _stats = {};
+
+    public:
+        bool begin(uart_port_t port, int tx_pin, int rx_pin, uint32_t baud, uint64_t destination);
+        bool send(const uint8_t* data, size_t len);
+        size_t formatStats(char* buffer, size_t len);
+};
+
+extern XbeeLink XBEE_LINK;
+
+#endif // XBEE_LINK_H
@@ -0,0 +1,81 @@
+/**
+ * @file flight_data_fixture.h
+ * @brief Recorded flight data for the host tests and benchmarks
+ *
+ * log-data/raw-log.csv is in the old 17 column log format, without timestamps:
+ * record,mode,state,ax,ay,az,pitch,roll,gx,gy,gz,lat,lon,gps_alt,pressure,temp,alt
+ *
+ * Header only - include it from the test source and add -I../common to the build line.
+ */
+
+#ifndef FLIGHT_DATA_FIXTURE_H
+#define FLIGHT_DATA_FIXTURE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "data_types.h"
+#include "flight_log.h"
+
+#define FIXTURE_LOG_INTERVAL_MS 10      /*!< log interval the timestamps are synthesized at */
+
+/**
+ * @brief read the rows of the old 17 column log format
+ * @param jitter_ms up to this many ms of scheduling jitter added to every log interval
+ * @return false if the file cannot be read
+ */
+static bool loadCsv(const char* path, std::vector<flight_log_sample_t>& samples, uint32_t jitter_ms = 0) {
+    FILE* f = fopen(path, "r");
+    if(f == NULL) {
+        return false;
+    }
+
+    std::mt19937 rng(1);
+    uint32_t timestamp = 0;
+    char line[512];
+
+    while(fgets(line, sizeof(line), f)) {
+        flight_log_sample_t s;
+        unsigned record, mode, state;
+        float gps_alt;
+        memset(&s, 0, sizeof(s));
+
+        int n = sscanf(line, "%u,%u,%u,%f,%f,%f,%f,%f,%f,%f,%f,%lf,%lf,%f,%f,%f,%f",
+                       &record, &mode, &state, &s.ax, &s.ay, &s.az, &s.pitch, &s.roll,
+                       &s.gx, &s.gy, &s.gz, &s.latitude, &s.longitude, &gps_alt,
+                       &s.pressure, &s.temperature, &s.rel_altitude);
+        if(n != 17) {
+            continue;
+        }
+
+        timestamp += FIXTURE_LOG_INTERVAL_MS + (jitter_ms ? rng() % (jitter_ms + 1) : 0);
+        s.timestamp_ms = timestamp;
+        s.record_number = record;
+        s.operation_mode = mode;
+        s.state = state;
+        s.gps_altitude = (uint16_t)gps_alt;
+        samples.push_back(s);
+    }
+
+    fclose(f);
+    return true;
+}
+
+/**
+ * @brief scale the samples to log fields, FLIGHT_LOG_FIELD_COUNT per sample
+ * @param max_count convert at most this many samples
+ * @return samples converted
+ */
+static size_t samplesToFields(const std::vector<flight_log_sample_t>& samples, size_t max_count, std::vector<int32_t>& fields) {
+    size_t count = samples.size() < max_count ? samples.size() : max_count;
+
+    fields.resize(count * FLIGHT_LOG_FIELD_COUNT);
+    for(size_t i = 0; i < count; i++) {
+        flightLogToFields(&samples[i], &fields[i * FLIGHT_LOG_FIELD_COUNT]);
+    }
+
+    return count;
+}
+
+#endif // FLIGHT_DATA_FIXTURE_H
@@ -0,0 +1,78 @@
+/**
+ * @file telemetry_fixture.h
+ * @brief Batch a sample stream into telemetry messages like the telemetry task
+ *
+ * Uses the flight batching and keyframe settings, TELEMETRY_BATCH_SAMPLES, TELEMETRY_BATCH_MS
+ * and TELEMETRY_KEYFRAME_INTERVAL, so the tests measure what the rocket sends.
+ *
+ * Header only - include it from the test source, add -I../common to the build line and link
+ * telemetry_frame.cpp, telemetry_delta.cpp and telemetry_batch.cpp.
+ */
+
+#ifndef TELEMETRY_FIXTURE_H
+#define TELEMETRY_FIXTURE_H
+
+#include <vector>
+#include "flight_data_fixture.h"
+#include "telemetry_frame.h"
+#include "telemetry_delta.h"
+#include "telemetry_batch.h"
+
+typedef std::vector<uint8_t> message_t;
+
+/**
+ * @brief batch the samples into messages like MQTT_TransmitTelemetry
+ * @param capacity message size limit, e.g. MQTT_TELEMETRY_SIZE or XBEE_PAYLOAD_SIZE
+ * @param delta TELEMETRY_SCHEMA_DELTA frames, otherwise TELEMETRY_SCHEMA_RECORD frames
+ * @param first_sequence sequence number of the first delta sample
+ * @param divider send one sample in divider, see telemetryDecimatorKeep()
+ * @param sent if not NULL, the index of every sample sent, in sequence number order
+ */
+static void batchTelemetry(const std::vector<int32_t>& fields, size_t count, size_t capacity, bool delta,
+                           uint16_t first_sequence, std::vector<message_t>& messages,
+                           uint8_t divider = 1, std::vector<size_t>* sent = NULL) {
+    std::vector<uint8_t> buffer(capacity);
+    telemetry_batch_t batch;
+    telemetry_delta_encoder_t encoder;
+    telemetry_decimator_t decimator;
+
+    telemetryBatchInit(&batch, buffer.data(), buffer.size(), TELEMETRY_BATCH_SAMPLES, TELEMETRY_BATCH_MS);
+    telemetryDeltaEncoderInit(&encoder, TELEMETRY_KEYFRAME_INTERVAL);
+    telemetryDecimatorInit(&decimator, divider);
+    encoder.sequence = first_sequence;
+
+    for(size_t i = 0; i < count; i++) {
+        const int32_t* sample = &fields[i * FLIGHT_LOG_FIELD_COUNT];
+        uint32_t now = sample[FIELD_TIMESTAMP];
+
+        if(!telemetryDecimatorKeep(&decimator, sample[FIELD_FLAGS] & 0x0F)) {
+            continue;
+        }
+        if(sent) {
+            sent->push_back(i);
+        }
+
+        bool added = delta ? telemetryBatchAddDelta(&batch, &encoder, sample, now) : telemetryBatchAddFields(&batch, sample, now);
+        if(!added) {
+            messages.push_back(message_t(buffer.data(), buffer.data() + batch.length));
+            telemetryBatchSent(&batch, true);
+            if(delta) {
+                telemetryBatchAddDelta(&batch, &encoder, sample, now);
+            } else {
+                telemetryBatchAddFields(&batch, sample, now);
+            }
+        }
+
+        if(telemetryBatchDue(&batch, now) != TELEMETRY_FLUSH_NONE) {
+            messages.push_back(message_t(buffer.data(), buffer.data() + batch.length));
+            telemetryBatchSent(&batch, true);
+        }
+    }
+
+    if(batch.count) {
+        messages.push_back(message_t(buffer.data(), buffer.data() + batch.length));
+        telemetryBatchSent(&batch, true);
+    }
+}
+
+#endif // TELEMETRY_FIXTURE_H
@@ -0,0 +1,159 @@
+/**
+ * @file flight_log_codec_bench.cpp
+ * @brief host benchmark and round trip check for the flight log delta compression
+ *
+ * Compresses two sample streams and reports the compressed size against the in-memory
+ * telemetry_type_t and the fixed size keyframe record, plus compress/decompress ns per sample:
+ * - log-data/raw-log.csv, recorded on the bench. It has no timestamps, so they are
+ *   synthesized at a 10ms log interval with up to 2ms of scheduling jitter
+ * - a synthetic flight with sensor noise on every channel, which is the worst case
+ *
+ * Every decompressed record must match the scaled fields of the original sample exactly.
+ *
+ * build and run from this directory:
+ * g++ -O2 -std=c++11 -I../common -I../../src -I../../lib/flight_log flight_log_codec_bench.cpp ../../lib/flight_log/flight_log.cpp ../../lib/flight_log/flight_log_codec.cpp -o bench && ./bench ../../log-data/raw-log.csv
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <random>
+#include <vector>
+#include "flight_data_fixture.h"
+#include "flight_log_codec.h"
+
+#define LOG_INTERVAL_MS FIXTURE_LOG_INTERVAL_MS
+#define LOG_JITTER_MS 2
+#define SYNTHETIC_SAMPLES 20000
+#define BENCH_REPEATS 20
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief a 100Hz flight with noise on every sensor: pad, 3s boost, coast to apogee, descent
+ */
+static void syntheticFlight(std::vector<flight_log_sample_t>& samples) {
+    std::mt19937 rng(2);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    float altitude = 0, velocity = 0;
+
+    for(uint32_t i = 0; i < SYNTHETIC_SAMPLES; i++) {
+        float t = i * LOG_INTERVAL_MS / 1000.0f;
+        float dt = LOG_INTERVAL_MS / 1000.0f;
+        float accel = 0;
+        uint8_t state = 0;
+
+        if(t > 20 && t < 23) {
+            accel = 60;
+            state = 1;
+        } else if(t >= 23 && velocity > 0) {
+            accel = -9.81f;
+            state = 2;
+        } else if(t >= 23) {
+            accel = velocity < -8 ? 0 : -9.81f;
+            state = 4;
+        }
+
+        if(t > 20 && altitude >= 0) {
+            velocity += accel * dt;
+            altitude += velocity * dt;
+        }
+
+        flight_log_sample_t s;
+        s.timestamp_ms = i * LOG_INTERVAL_MS;
+        s.record_number = i;
+        s.operation_mode = 1;
+        s.state = state;
+        s.log_policy = 0;
+        s.ax = 0.01f * noise(rng);
+        s.ay = 0.01f * noise(rng);
+        s.az = (accel + 9.81f) / 9.81f + 0.02f * noise(rng);
+        s.gx = 0.3f * noise(rng);
+        s.gy = 0.3f * noise(rng);
+        s.gz = 0.3f * noise(rng) + (state == 2 ? 40.0f : 0.0f);
+        s.pitch = 90.0f + 0.05f * noise(rng);
+        s.roll = 0.05f * noise(rng);
+        // GPS updates at 1Hz
+        uint32_t fix = i / 100;
+        s.latitude = -1.1 + fix * 1e-6;
+        s.longitude = 37.0 + fix * 2e-6;
+        s.gps_altitude = 1500 + (uint16_t)(fix ? altitude : 0);
+        s.pressure = 850.0f * expf(-altitude / 8400.0f) + 0.03f * noise(rng);
+        s.temperature = 24.0f + 0.02f * noise(rng);
+        s.rel_altitude = altitude + 0.3f * noise(rng);
+        s.velocity = velocity + 0.5f * noise(rng);
+        samples.push_back(s);
+    }
+}
+
+static bool run(const char* name, const std::vector<flight_log_sample_t>& samples) {
+    std::vector<int32_t> fields;
+    size_t count = samplesToFields(samples, samples.size(), fields);
+    std::vector<uint8_t> stream(count * FLIGHT_LOG_KEYFRAME_SIZE + FLIGHT_LOG_FRAME_BUFFER_SIZE);
+    flight_log_codec_t codec;
+
+    size_t compressed = 0;
+    double start = nowNs();
+    for(int r = 0; r < BENCH_REPEATS; r++) {
+        flightLogCodecReset(&codec);
+        compressed = 0;
+        for(size_t i = 0; i < count; i++) {
+            compressed += flightLogCompress(&codec, &fields[i * FLIGHT_LOG_FIELD_COUNT], &stream[compressed]);
+        }
+    }
+    double compress_ns = (nowNs() - start) / (count * BENCH_REPEATS);
+
+    int32_t decoded[FLIGHT_LOG_FIELD_COUNT];
+    size_t mismatches = 0;
+    start = nowNs();
+    for(int r = 0; r < BENCH_REPEATS; r++) {
+        flightLogCodecReset(&codec);
+        size_t pos = 0;
+        for(size_t i = 0; i < count; i++) {
+            size_t used;
+            FLIGHT_LOG_STATUS status = flightLogDecompress(&codec, &stream[pos], compressed - pos, decoded, &used);
+            if(status != FLIGHT_LOG_OK || memcmp(decoded, &fields[i * FLIGHT_LOG_FIELD_COUNT], sizeof(decoded))) {
+                mismatches++;
+                break;
+            }
+            pos += used;
+        }
+    }
+    double decompress_ns = (nowNs() - start) / (count * BENCH_REPEATS);
+
+    size_t raw = count * sizeof(telemetry_type_t);
+    size_t fixed = count * FLIGHT_LOG_RECORD_SIZE;
+
+    printf("%s: %zu samples\n", name, count);
+    printf("  telemetry_type_t   %8zu B  (%zu B/sample)\n", raw, sizeof(telemetry_type_t));
+    printf("  fixed records      %8zu B  (%d B/sample)  %.2fx\n", fixed, FLIGHT_LOG_RECORD_SIZE, (double)raw / fixed);
+    printf("  delta frames       %8zu B  (%.2f B/sample) %.2fx vs struct, %.2fx vs fixed\n",
+           compressed, (double)compressed / count, (double)raw / compressed, (double)fixed / compressed);
+    printf("  compress %.1f ns/sample, decompress %.1f ns/sample, round trip %s\n\n",
+           compress_ns, decompress_ns, mismatches ? "FAILED" : "ok");
+
+    return mismatches == 0;
+}
+
+int main(int argc, char** argv) {
+    const char* csv = argc > 1 ? argv[1] : "../../log-data/raw-log.csv";
+    std::vector<flight_log_sample_t> recorded, synthetic;
+    bool ok = true;
+
+    if(loadCsv(csv, recorded, LOG_JITTER_MS) && !recorded.empty()) {
+        ok &= run(csv, recorded);
+    } else {
+        printf("could not read %s\n\n", csv);
+    }
+
+    syntheticFlight(synthetic);
+    ok &= run("synthetic flight", synthetic);
+
+    return ok ? 0 : 1;
+}
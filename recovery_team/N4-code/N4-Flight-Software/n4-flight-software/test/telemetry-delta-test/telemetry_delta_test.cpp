@@ -0,0 +1,139 @@
+/**
+ * @file telemetry_delta_test.cpp
+ * @brief host round trip test for the delta compressed telemetry, see telemetry_delta.h
+ *
+ * Batches log-data/raw-log.csv into TELEMETRY_SCHEMA_DELTA frames the way the telemetry task
+ * does, then decodes the messages:
+ * - all of them: every sample must come back exactly, in order. Reports the bytes per
+ *   sample against TELEMETRY_SCHEMA_RECORD frames
+ * - with every LOSS_INTERVAL-th message lost: every decoded sample must still be exact,
+ *   the lost samples must be counted, and decoding must resume at the next keyframe
+ * - with one message cut short: the decoder must report it, keep the samples before the
+ *   cut and resume at the next keyframe
+ *
+ * The stream starts just below the 16 bit sequence number wrap, so the wrap is covered too.
+ *
+ * build and run from this directory:
+ * g++ -O2 -std=c++11 -I../common -I../../src -I../../lib/flight_log -I../../lib/telemetry telemetry_delta_test.cpp ../../lib/flight_log/flight_log.cpp ../../lib/flight_log/flight_log_codec.cpp ../../lib/telemetry/telemetry_frame.cpp ../../lib/telemetry/telemetry_delta.cpp ../../lib/telemetry/telemetry_batch.cpp -o test && ./test ../../log-data/raw-log.csv
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "telemetry_fixture.h"
+
+#define BATCH_CAPACITY 1000             /*!< about the firmware MQTT_TELEMETRY_SIZE */
+#define FIRST_SEQUENCE 65000            /*!< wraps within the recorded data */
+#define LOSS_INTERVAL 7
+
+/**
+ * @brief decode the messages and check every decoded sample against the original
+ * @param lose drop every LOSS_INTERVAL-th message before decoding
+ * @param truncate cut this message short, -1 for none
+ * @return false on any mismatch
+ */
+static bool decode(const std::vector<int32_t>& fields, size_t count, const std::vector<message_t>& messages,
+                   bool lose, int truncate, telemetry_delta_decoder_t* decoder, size_t* decoded_total, size_t* dropped_total) {
+    static int32_t decoded[TELEMETRY_FRAME_MAX_SAMPLES][FLIGHT_LOG_FIELD_COUNT];
+    uint16_t sequences[TELEMETRY_FRAME_MAX_SAMPLES];
+    bool ok = true;
+
+    telemetryDeltaDecoderInit(decoder);
+    *decoded_total = 0;
+    *dropped_total = 0;
+
+    for(size_t m = 0; m < messages.size(); m++) {
+        const message_t& message = messages[m];
+        telemetry_frame_t frame;
+
+        if(telemetryFrameDecode(message.data(), message.size(), &frame) != TELEMETRY_OK) {
+            printf("  message %zu: frame does not decode\n", m);
+            return false;
+        }
+
+        if(lose && m % LOSS_INTERVAL == LOSS_INTERVAL - 1) {
+            *dropped_total += frame.count;
+            continue;
+        }
+
+        if((int)m == truncate) {
+            frame.length -= 5;
+        }
+
+        uint8_t n;
+        TELEMETRY_STATUS status = telemetryDeltaDecode(decoder, &frame, decoded, sequences, &n);
+        if((status != TELEMETRY_OK) != ((int)m == truncate)) {
+            printf("  message %zu: status %d\n", m, status);
+            ok = false;
+        }
+
+        for(uint8_t i = 0; i < n; i++) {
+            size_t index = (uint16_t)(sequences[i] - FIRST_SEQUENCE);
+            if(index >= count || memcmp(decoded[i], &fields[index * FLIGHT_LOG_FIELD_COUNT], sizeof(decoded[i])) != 0) {
+                printf("  message %zu: sample %zu does not match\n", m, index);
+                ok = false;
+            }
+            (*decoded_total)++;
+        }
+    }
+
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const char* csv = argc > 1 ? argv[1] : "../../log-data/raw-log.csv";
+    std::vector<flight_log_sample_t> samples;
+
+    if(!loadCsv(csv, samples) || samples.empty()) {
+        printf("could not read %s\n", csv);
+        return 1;
+    }
+
+    std::vector<int32_t> fields;
+    size_t count = samplesToFields(samples, samples.size(), fields);
+
+    std::vector<message_t> records, deltas;
+    batchTelemetry(fields, count, BATCH_CAPACITY, false, FIRST_SEQUENCE, records);
+    batchTelemetry(fields, count, BATCH_CAPACITY, true, FIRST_SEQUENCE, deltas);
+
+    size_t record_bytes = 0, delta_bytes = 0;
+    for(size_t i = 0; i < records.size(); i++) {
+        record_bytes += records[i].size();
+    }
+    for(size_t i = 0; i < deltas.size(); i++) {
+        delta_bytes += deltas[i].size();
+    }
+
+    printf("%s: %zu samples, keyframe every %d\n", csv, count, TELEMETRY_KEYFRAME_INTERVAL);
+    printf("  record frames %8zu B in %5zu messages (%.2f B/sample)\n", record_bytes, records.size(), (double)record_bytes / count);
+    printf("  delta frames  %8zu B in %5zu messages (%.2f B/sample) %.2fx\n", delta_bytes, deltas.size(),
+           (double)delta_bytes / count, (double)record_bytes / delta_bytes);
+
+    telemetry_delta_decoder_t decoder;
+    size_t decoded, dropped;
+    bool ok = true;
+
+    // every message
+    bool pass = decode(fields, count, deltas, false, -1, &decoder, &decoded, &dropped) && decoded == count && decoder.stats.lost == 0;
+    printf("  no loss: %zu/%zu samples decoded, round trip %s\n", decoded, count, pass ? "ok" : "FAILED");
+    ok &= pass;
+
+    // lost messages - each loss may cost up to a keyframe interval on top of the lost samples
+    pass = decode(fields, count, deltas, true, -1, &decoder, &decoded, &dropped) &&
+           decoder.stats.lost == dropped && decoded + dropped + decoder.stats.skipped == count &&
+           decoder.stats.skipped <= decoder.stats.resyncs * (TELEMETRY_KEYFRAME_INTERVAL - 1);
+    printf("  every %dth message lost: %zu decoded, %u lost, %u dropped waiting for %u resyncs, %s\n", LOSS_INTERVAL,
+           decoded, decoder.stats.lost, decoder.stats.skipped, decoder.stats.resyncs, pass ? "ok" : "FAILED");
+    ok &= pass;
+
+    // one message cut short - its last sample and the samples up to the next keyframe are dropped
+    int truncate = deltas.size() / 2;
+    pass = decode(fields, count, deltas, false, truncate, &decoder, &decoded, &dropped) &&
+           decoder.stats.corrupt == 1 && decoded + decoder.stats.skipped == count &&
+           decoder.stats.skipped <= TELEMETRY_KEYFRAME_INTERVAL;
+    printf("  message %d truncated: %zu decoded, %u dropped, %s\n", truncate, decoded, decoder.stats.skipped, pass ? "ok" : "FAILED");
+    ok &= pass;
+
+    return ok ? 0 : 1;
+}
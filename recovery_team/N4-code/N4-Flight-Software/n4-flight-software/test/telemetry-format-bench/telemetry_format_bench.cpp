@@ -0,0 +1,144 @@
+/**
+ * @file telemetry_format_bench.cpp
+ * @brief host benchmark and output check for the telemetry row formatter
+ *
+ * Checks that formatFixed() matches snprintf("%.*f") on random and edge case values, that
+ * formatTelemetryRow() matches the sprintf row format used before, and compares ns/row.
+ *
+ * build and run from this directory:
+ * g++ -O2 -std=c++11 -I../../src telemetry_format_bench.cpp ../../src/telemetry_format.cpp -o bench && ./bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <time.h>
+#include <random>
+#include "telemetry_format.h"
+
+#define ROWS 200000
+#define RANDOM_VALUES 2000000
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* the row format as it was sprintf'd by the telemetry and debug tasks */
+static int sprintfRow(char* buffer, const telemetry_type_t* p, const gps_type_t* g, const altimeter_type_t* a) {
+    return sprintf(buffer,
+                   "%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.4f,%.4f,%.2f,%.2f,%.2f,%.2f\n",
+                   p->record_number, p->operation_mode, p->state,
+                   p->acc_data.ax, p->acc_data.ay, p->acc_data.az, p->acc_data.pitch, p->acc_data.roll,
+                   p->gyro_data.gx, p->gyro_data.gy, p->gyro_data.gz,
+                   g->latitude, g->longitude, (double)g->gps_altitude,
+                   a->pressure, a->temperature, a->rel_altitude);
+}
+
+static int checkValue(double value, uint8_t decimals) {
+    char expected[512], actual[512];
+    snprintf(expected, sizeof(expected), "%.*f", decimals, value);
+    size_t n = formatFixed(actual, sizeof(actual), value, decimals);
+
+    if(strcmp(expected, actual) != 0 || n != strlen(expected)) {
+        printf("MISMATCH %.17g decimals=%d expected=%s got=%s\n", value, decimals, expected, actual);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> uniform(-1000.0, 1000.0);
+    int failures = 0;
+
+    /* edge cases - exact ties, values one ulp either side of a tie, signed zero, huge and non-finite values */
+    const double edge[] = {
+        0.0, -0.0, 0.5, 1.5, 2.5, -2.5, 0.125, 0.375, -0.125, 2.675, 1.005, 1.015, 1.025, 0.045,
+        -0.001, -0.005, 0.005, 0.015, 99.995, 999999.995, 1e-320, -1e-320, DBL_MIN,
+        4503599627370495.5, 4503599627370496.0, 1e15, 1e16, 1e22, 1e300, -1e300, DBL_MAX,
+        INFINITY, -INFINITY, NAN, 4294967295.5, 4294967296.25, 42949672.955
+    };
+    for(size_t i = 0; i < sizeof(edge) / sizeof(edge[0]); i++) {
+        for(uint8_t d = 0; d <= FORMAT_MAX_DECIMALS; d++) {
+            failures += checkValue(edge[i], d);
+            failures += checkValue(nextafter(edge[i], INFINITY), d);
+            failures += checkValue(nextafter(edge[i], -INFINITY), d);
+        }
+    }
+
+    /* every k/2^n tie from 0 to 100 at 2 and 4 decimals */
+    for(int k = 0; k < 100 * 1024; k++) {
+        failures += checkValue(k / 1024.0, 2);
+        failures += checkValue(-k / 1024.0, 4);
+    }
+
+    /* random values at every precision, plus random bit patterns */
+    for(int i = 0; i < RANDOM_VALUES; i++) {
+        double v = uniform(rng);
+        failures += checkValue(v, i % (FORMAT_MAX_DECIMALS + 1));
+        failures += checkValue((float)v, 2);
+
+        uint64_t bits = rng();
+        double r;
+        memcpy(&r, &bits, sizeof(r));
+        failures += checkValue(r, i % (FORMAT_MAX_DECIMALS + 1));
+    }
+
+    /* realistic telemetry rows */
+    static telemetry_type_t packets[1024];
+    static gps_type_t gps[1024];
+    static altimeter_type_t altimeter[1024];
+    for(int i = 0; i < 1024; i++) {
+        packets[i].record_number = i * 37;
+        packets[i].operation_mode = i & 1;
+        packets[i].state = i % 9;
+        packets[i].acc_data.ax = uniform(rng) / 50;
+        packets[i].acc_data.ay = uniform(rng) / 50;
+        packets[i].acc_data.az = uniform(rng) / 50;
+        packets[i].acc_data.pitch = uniform(rng) / 10;
+        packets[i].acc_data.roll = uniform(rng) / 10;
+        packets[i].gyro_data.gx = uniform(rng);
+        packets[i].gyro_data.gy = uniform(rng);
+        packets[i].gyro_data.gz = uniform(rng);
+        gps[i].latitude = -1.0 - uniform(rng) / 1e4;
+        gps[i].longitude = 37.0 + uniform(rng) / 1e4;
+        gps[i].gps_altitude = 1500 + i;
+        altimeter[i].pressure = 85000 + uniform(rng) * 10;
+        altimeter[i].temperature = 25 + uniform(rng) / 100;
+        altimeter[i].rel_altitude = uniform(rng) * 3;
+    }
+
+    char expected[TELEMETRY_ROW_MAX_LENGTH], actual[TELEMETRY_ROW_MAX_LENGTH];
+    for(int i = 0; i < 1024; i++) {
+        sprintfRow(expected, &packets[i], &gps[i], &altimeter[i]);
+        formatTelemetryRow(actual, sizeof(actual), &packets[i], &gps[i], &altimeter[i]);
+        if(strcmp(expected, actual) != 0) {
+            printf("ROW MISMATCH\n  sprintf: %s  format:  %s", expected, actual);
+            failures++;
+        }
+    }
+
+    /* timing */
+    size_t sink = 0;
+    double start = nowNs();
+    for(int i = 0; i < ROWS; i++) {
+        sink += sprintfRow(expected, &packets[i & 1023], &gps[i & 1023], &altimeter[i & 1023]);
+    }
+    double sprintf_ns = (nowNs() - start) / ROWS;
+
+    start = nowNs();
+    for(int i = 0; i < ROWS; i++) {
+        sink += formatTelemetryRow(actual, sizeof(actual), &packets[i & 1023], &gps[i & 1023], &altimeter[i & 1023]);
+    }
+    double format_ns = (nowNs() - start) / ROWS;
+
+    printf("sprintf:            %8.1f ns/row\n", sprintf_ns);
+    printf("formatTelemetryRow: %8.1f ns/row (%.1fx)\n", format_ns, sprintf_ns / format_ns);
+    printf("mismatches: %d (checksum %zu)\n", failures, sink);
+
+    return failures ? 1 : 0;
+}
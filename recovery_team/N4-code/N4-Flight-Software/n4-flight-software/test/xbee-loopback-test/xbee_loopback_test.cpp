@@ -0,0 +1,205 @@
+/**
+ * @file xbee_loopback_test.cpp
+ * @brief host loopback test for the XBee API frames, see xbee_frame.h
+ *
+ * Stands in for the UART and the ground: the bytes the flight computer would write to the
+ * XBee are fed straight into the ground parser.
+ * - escaping: a payload holding every byte value comes back intact, and no delimiter, escape
+ *   or XON/XOFF byte is left unescaped on the wire
+ * - telemetry: log-data/raw-log.csv is decimated and batched into delta frames of at most
+ *   XBEE_PAYLOAD_SIZE bytes like the telemetry task, see telemetry_fixture.h, framed, and parsed back in random sized chunks with line
+ *   noise between frames, one frame damaged and one frame cut short. Every frame with a good
+ *   checksum must come back exactly, the damaged ones must be caught, and every decoded
+ *   sample must match the original
+ *
+ * The telemetry test runs for every XBEE_SAMPLE_DIVIDER up to MAX_DIVIDER, and reports the
+ * bytes per sample on the wire, the sample rate the link sustains and the link load.
+ *
+ * build and run from this directory:
+ * g++ -O2 -std=c++11 -I../common -I../../src -I../../lib/flight_log -I../../lib/telemetry -I../../lib/xbee xbee_loopback_test.cpp ../../lib/xbee/xbee_frame.cpp ../../lib/flight_log/flight_log.cpp ../../lib/flight_log/flight_log_codec.cpp ../../lib/telemetry/telemetry_frame.cpp ../../lib/telemetry/telemetry_delta.cpp ../../lib/telemetry/telemetry_batch.cpp -o test && ./test ../../log-data/raw-log.csv
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "telemetry_fixture.h"
+#include "xbee_frame.h"
+
+#define PAYLOAD_SIZE XBEE_MAX_RF_DATA   /*!< XBEE_PAYLOAD_SIZE, the NP of the XBee-PRO 900HP */
+#define BAUD_RATE 9600                  /*!< BD default of the modules */
+#define SAMPLE_RATE 100                 /*!< samples/s reaching the telemetry task - the IMU rate of the cyclic executive */
+#define MAX_DIVIDER 4                   /*!< XBEE_SAMPLE_DIVIDER values tried, from 1 */
+#define DESTINATION 0x0013A20041B2C3D4ULL
+
+typedef std::vector<uint8_t> bytes_t;
+
+/**
+ * @brief frame one payload like XbeeLink::send()
+ */
+static bytes_t frame(const bytes_t& payload) {
+    bytes_t wire(XBEE_TRANSMIT_BUFFER_SIZE(PAYLOAD_SIZE));
+    wire.resize(xbeeEncodeTransmit(wire.data(), DESTINATION, 0, payload.data(), payload.size()));
+    return wire;
+}
+
+static bool isSpecial(uint8_t byte) {
+    return byte == XBEE_START_DELIMITER || byte == XBEE_ESCAPE || byte == XBEE_XON || byte == XBEE_XOFF;
+}
+
+static bool testEscaping() {
+    bytes_t payload(PAYLOAD_SIZE);
+    for(size_t i = 0; i < payload.size(); i++) {
+        payload[i] = i;
+    }
+
+    bytes_t wire = frame(payload);
+    bool clean = wire[0] == XBEE_START_DELIMITER;
+    for(size_t i = 1; i < wire.size(); i++) {
+        if(isSpecial(wire[i]) && wire[i] != XBEE_ESCAPE) {
+            clean = false;
+        }
+    }
+
+    xbee_parser_t parser;
+    xbeeParserInit(&parser);
+    XBEE_PARSE result = XBEE_PARSE_MORE;
+    for(size_t i = 0; i < wire.size(); i++) {
+        result = xbeeParse(&parser, wire[i]);
+    }
+
+    const uint8_t* data;
+    size_t len;
+    bool ok = clean && result == XBEE_PARSE_FRAME &&
+              xbeeFrameRfData(parser.data, parser.length, &data, &len) &&
+              len == payload.size() && memcmp(data, payload.data(), len) == 0;
+
+    printf("escaping: %zu payload bytes -> %zu bytes on the wire, %s\n", payload.size(), wire.size(), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static bool testTelemetry(const std::vector<int32_t>& fields, size_t count, uint8_t divider) {
+    std::mt19937 rng(3);
+
+    // the flight side - decimated and batched like the telemetry task
+    std::vector<message_t> payloads;
+    std::vector<size_t> sent;
+    batchTelemetry(fields, count, PAYLOAD_SIZE, true, 0, payloads, divider, &sent);
+
+    // the wire - noise between some frames, one frame damaged, one cut short
+    size_t damaged = payloads.size() / 3;
+    size_t cut = 2 * payloads.size() / 3;
+    bytes_t wire;
+    size_t frame_bytes = 0;
+
+    for(size_t i = 0; i < payloads.size(); i++) {
+        bytes_t f = frame(payloads[i]);
+        frame_bytes += f.size();
+
+        if(i == damaged) {
+            // flip a bit in the middle, keeping clear of the bytes with a meaning on the wire
+            size_t at = f.size() / 2;
+            while(isSpecial(f[at]) || isSpecial(f[at] ^ 1) || isSpecial(f[at - 1])) {
+                at++;
+            }
+            f[at] ^= 1;
+        } else if(i == cut) {
+            f.resize(f.size() / 2);
+        }
+
+        if(i % 10 == 0) {
+            for(int n = rng() % 8; n > 0; n--) {
+                uint8_t noise = rng();
+                wire.push_back(noise == XBEE_START_DELIMITER ? 0 : noise);
+            }
+        }
+        wire.insert(wire.end(), f.begin(), f.end());
+    }
+
+    // the ground - parse the stream in random sized reads
+    xbee_parser_t parser;
+    telemetry_delta_decoder_t decoder;
+    static int32_t decoded[TELEMETRY_FRAME_MAX_SAMPLES][FLIGHT_LOG_FIELD_COUNT];
+    uint16_t sequences[TELEMETRY_FRAME_MAX_SAMPLES];
+    size_t received = 0, decoded_total = 0, mismatches = 0, next_payload = 0;
+    bool ok = true;
+
+    xbeeParserInit(&parser);
+    telemetryDeltaDecoderInit(&decoder);
+
+    for(size_t pos = 0; pos < wire.size();) {
+        size_t chunk = 1 + rng() % 64;
+        for(size_t end = pos + chunk; pos < end && pos < wire.size(); pos++) {
+            if(xbeeParse(&parser, wire[pos]) != XBEE_PARSE_FRAME) {
+                continue;
+            }
+
+            const uint8_t* data;
+            size_t len;
+            telemetry_frame_t tf;
+            if(!xbeeFrameRfData(parser.data, parser.length, &data, &len) ||
+               telemetryFrameDecode(data, len, &tf) != TELEMETRY_OK) {
+                printf("  frame %zu does not decode\n", received);
+                ok = false;
+                continue;
+            }
+
+            // match the frame to the payload it was sent as
+            while(next_payload < payloads.size() && (payloads[next_payload].size() != len || memcmp(payloads[next_payload].data(), data, len))) {
+                next_payload++;
+            }
+            if(next_payload == payloads.size() || next_payload == damaged || next_payload == cut) {
+                printf("  frame %zu is not one of the payloads sent intact\n", received);
+                ok = false;
+            }
+            received++;
+
+            uint8_t n;
+            telemetryDeltaDecode(&decoder, &tf, decoded, sequences, &n);
+            for(uint8_t i = 0; i < n; i++) {
+                if(sequences[i] >= sent.size() || memcmp(decoded[i], &fields[sent[sequences[i]] * FLIGHT_LOG_FIELD_COUNT], sizeof(decoded[i]))) {
+                    mismatches++;
+                }
+            }
+            decoded_total += n;
+        }
+    }
+
+    // the cut frame runs into the next delimiter, so it is discarded rather than failing its checksum
+    ok &= received == payloads.size() - 2 && parser.stats.bad_checksum == 1 && mismatches == 0 &&
+          decoder.stats.resyncs == 2 && decoded_total + decoder.stats.lost + decoder.stats.skipped == sent.size();
+
+    // the load the link carries at SAMPLE_RATE, against the UART line rate
+    double wire_per_sample = (double)frame_bytes / sent.size();
+    double load = (double)SAMPLE_RATE / divider * wire_per_sample / (BAUD_RATE / 10);
+    printf("telemetry, divider %u: %zu of %zu samples in %zu frames, %.2f bytes per sample on the wire\n",
+           divider, sent.size(), count, payloads.size(), wire_per_sample);
+    printf("  at %d baud the link carries %.0f samples/s, %d samples/s load it to %.0f%%\n",
+           BAUD_RATE, BAUD_RATE / 10 / wire_per_sample, SAMPLE_RATE, load * 100);
+    printf("  %zu frames received, %u bad checksum, %u bytes discarded, %zu samples decoded, %u lost, %u dropped waiting for a keyframe, %s\n",
+           received, parser.stats.bad_checksum, parser.stats.discarded, decoded_total, decoder.stats.lost, decoder.stats.skipped,
+           ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const char* csv = argc > 1 ? argv[1] : "../../log-data/raw-log.csv";
+    std::vector<flight_log_sample_t> samples;
+
+    if(!loadCsv(csv, samples) || samples.empty()) {
+        printf("could not read %s\n", csv);
+        return 1;
+    }
+
+    // the test indexes samples by sequence number
+    std::vector<int32_t> fields;
+    size_t count = samplesToFields(samples, 65536, fields);
+
+    bool ok = testEscaping();
+    for(uint8_t divider = 1; divider <= MAX_DIVIDER; divider++) {
+        ok &= testTelemetry(fields, count, divider);
+    }
+
+    return ok ? 0 : 1;
+}